@@ -6,6 +6,10 @@
 #include "framework.h"
 #include "CityGML2IFC.h"
 #include "CityGML2IFCDlg.h"
+#include "_conversion_server.h"
+
+#include <io.h>
+#include <fcntl.h>
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -52,6 +56,30 @@ BOOL CCityGML2IFCApp::InitInstance()
 
 	CWinApp::InitInstance();
 
+	// CityGML2IFC.exe --serve [workers] [queue capacity] [memory budget, MB]
+	// Jobs (JSON lines) from stdin, results to stdout
+	if ((__argc >= 2) && (wcscmp(__targv[1], L"--serve") == 0))
+	{
+		wchar_t szAppPath[_MAX_PATH];
+		::GetModuleFileName(::GetModuleHandle(nullptr), szAppPath, _countof(szAppPath));
+
+		fs::path pthExe = szAppPath;
+		wstring strRootFolder = pthExe.parent_path().wstring();
+		strRootFolder += L"\\";
+
+		int iWorkersCount = __argc >= 3 ? _wtoi(__targv[2]) : (int)thread::hardware_concurrency();
+		int iQueueCapacity = __argc >= 4 ? _wtoi(__targv[3]) : 4 * max(iWorkersCount, 1);
+		int64_t iMemoryBudget = __argc >= 5 ? _wtoi64(__targv[4]) * 1024 * 1024 : 0;
+
+		_setmode(0, _O_BINARY);
+		_setmode(1, _O_BINARY);
+
+		_conversion_server server(strRootFolder, iWorkersCount, (size_t)max(iQueueCapacity, 1), iMemoryBudget, 0, 1);
+		server.run();
+
+		return FALSE;
+	}
+
 
 	// Create the shell manager, in case the dialog contains
 	// any shell tree view or shell list view controls.
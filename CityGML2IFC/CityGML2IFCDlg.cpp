@@ -47,12 +47,40 @@ void STDCALL LogCallbackImpl(enumLogEvent enLogEvent, const char* szEvent)
 	g_pMainDialog->m_edtProgress.ReplaceSel(CA2W(strEntry.c_str()));
 }
 
+// ************************************************************************************************
+void STDCALL ProgressCallbackImpl(enumPhase enPhase, int64_t iDone, int64_t iTotal)
+{
+	ASSERT(g_pMainDialog != nullptr);
+
+	CString strTitle;
+	if (iDone < iTotal)
+	{
+		strTitle.Format(L"CityGML2IFC - %S %lld/%lld", _allocations::getName(enPhase), iDone, iTotal);
+	}
+	else
+	{
+		strTitle = L"CityGML2IFC";
+	}
+
+	g_pMainDialog->SetWindowText(strTitle);
+}
+
 // ************************************************************************************************
 /*static*/ UINT CCityGML2IFCDlg::ThreadProc(LPVOID pParam)
 {
 	auto pDialog = (CCityGML2IFCDlg*)pParam;
 	ASSERT(pDialog != nullptr);
 
+	pDialog->m_cancellationToken.reset();
+	::EnableWindow(pDialog->GetDlgItem(IDC_BUTTON_CANCEL)->GetSafeHwnd(), TRUE);
+
+	// The settings are loaded once per run (the files of a folder share them); the next run reads
+	// CityGML2IFC.settings again, i.e. the edits are applied
+	ASSERT(!pDialog->m_strRootFolder.empty());
+
+	bool bCreated = false;
+	auto pEnvironment = _conversion_environment::acquire(pDialog->m_strRootFolder, LogCallbackImpl, bCreated);
+
 	if (!pDialog->m_strInputFile.IsEmpty())
 	{
 		pDialog->ExportFile((LPCTSTR)pDialog->m_strInputFile);
@@ -70,7 +98,10 @@ void STDCALL LogCallbackImpl(enumLogEvent enLogEvent, const char* szEvent)
 		pDialog->ExportFiles(strInputFolder);
 	}*/
 
+	_conversion_environment::release(pEnvironment);
+
 	::EnableWindow(pDialog->GetDlgItem(IDOK)->GetSafeHwnd(), TRUE);
+	::EnableWindow(pDialog->GetDlgItem(IDC_BUTTON_CANCEL)->GetSafeHwnd(), FALSE);
 
 	return 0;
 }
@@ -109,7 +140,9 @@ void CCityGML2IFCDlg::ExportFile(const wstring& strInputFile)
 	wstring strOutputFile = strInputFile;
 	strOutputFile += L".ifc";
 
-	_gml2ifc_exporter exporter(m_strRootFolder, LogCallbackImpl, nullptr);	
+	_gml2ifc_exporter exporter(m_strRootFolder, LogCallbackImpl, nullptr);
+	exporter.setProgressCallback(ProgressCallbackImpl);
+	exporter.setCancellationToken(&m_cancellationToken);
 	//exporter.retrieveSRSData(strInputFile);// TEST
 	exporter.execute(strInputFile, strOutputFile);	
 }
@@ -118,6 +151,11 @@ void CCityGML2IFCDlg::ExportFiles(const fs::path& pthInputFolder)
 {
 	for (const auto& entry : fs::directory_iterator(pthInputFolder))
 	{
+		if (m_cancellationToken.isCancelled())
+		{
+			return;
+		}
+
 		if (fs::is_directory(entry))
 		{
 			ExportFiles(entry.path());
@@ -155,6 +193,8 @@ void CCityGML2IFCDlg::ImportFile(const wstring& strInputFile)
 	}
 
 	m_pExporter = new _gml2ifc_exporter(m_strRootFolder, LogCallbackImpl, nullptr);
+	m_pExporter->setProgressCallback(ProgressCallbackImpl);
+	m_pExporter->setCancellationToken(&m_cancellationToken);
 	m_pExporter->importGML(strInputFile);	
 
 	auto& setLODs = m_pExporter->getLODs();
@@ -176,9 +216,12 @@ void CCityGML2IFCDlg::ExportFileAsIFC(const wstring& strInputFile)
 	assert(m_pExporter != nullptr);
 
 	::EnableWindow(GetDlgItem(IDOK)->GetSafeHwnd(), FALSE);
+	::EnableWindow(GetDlgItem(IDC_BUTTON_CANCEL)->GetSafeHwnd(), TRUE);
 	m_chkHihgestLOD.EnableWindow(FALSE);
 	m_lbLODs.EnableWindow(FALSE);
 
+	m_cancellationToken.reset();
+
 	string strEvent = "Input file: '";
 	strEvent += CW2A(strInputFile.c_str());
 	strEvent += "'";
@@ -249,6 +292,7 @@ void CCityGML2IFCDlg::ExportFileAsIFC(const wstring& strInputFile)
 	m_pExporter->exportAsIFC(!strLODs.empty() ? strLODs.c_str() : nullptr, strOutputFile);
 
 	::EnableWindow(GetDlgItem(IDOK)->GetSafeHwnd(), TRUE);
+	::EnableWindow(GetDlgItem(IDC_BUTTON_CANCEL)->GetSafeHwnd(), FALSE);
 	m_chkHihgestLOD.EnableWindow(TRUE);
 	m_lbLODs.EnableWindow(!m_chkHihgestLOD.GetCheck());
 }
@@ -292,6 +336,7 @@ CCityGML2IFCDlg::CCityGML2IFCDlg(CWnd* pParent /*=nullptr*/)
 	, m_pThread(nullptr)
 	, m_strRootFolder(L"")
 	, m_pExporter(nullptr)
+	, m_cancellationToken()
 	, m_strInputFile(_T(""))
 {
 	m_hIcon = AfxGetApp()->LoadIcon(IDR_MAINFRAME);
@@ -322,6 +367,7 @@ BEGIN_MESSAGE_MAP(CCityGML2IFCDlg, CDialogEx)
 	ON_BN_CLICKED(IDC_BUTTON_INPUT_FILE, &CCityGML2IFCDlg::OnBnClickedButtonInputFile)
 	ON_BN_CLICKED(IDC_BUTTON_CLOSE, &CCityGML2IFCDlg::OnBnClickedButtonClose)
 	ON_BN_CLICKED(IDC_CHECK_HIGHEST_LOD, &CCityGML2IFCDlg::OnBnClickedCheckHighestLod)
+	ON_BN_CLICKED(IDC_BUTTON_CANCEL, &CCityGML2IFCDlg::OnBnClickedButtonCancel)
 END_MESSAGE_MAP()
 
 // ************************************************************************************************
@@ -481,3 +527,11 @@ void CCityGML2IFCDlg::OnBnClickedCheckHighestLod()
 {
 	m_lbLODs.EnableWindow(!m_chkHihgestLOD.GetCheck());
 }
+
+void CCityGML2IFCDlg::OnBnClickedButtonCancel()
+{
+	// Checked between Buildings/Features and between files
+	m_cancellationToken.cancel();
+
+	::EnableWindow(GetDlgItem(IDC_BUTTON_CANCEL)->GetSafeHwnd(), FALSE);
+}
@@ -31,6 +31,7 @@ private: // Members
 
 	wstring m_strRootFolder;
 	_gml2ifc_exporter* m_pExporter;
+	_cancellation_token m_cancellationToken;
 
 protected: // Methods
 	
@@ -75,4 +76,5 @@ public:
 	CListBox m_lbLODs;
 	CButton m_chkHihgestLOD;
 	afx_msg void OnBnClickedCheckHighestLod();
+	afx_msg void OnBnClickedButtonCancel();
 };
@@ -0,0 +1,282 @@
+#include "pch.h"
+#include "_city_model.h"
+
+#include <cassert>
+#include <algorithm>
+#include <iterator>
+
+// ************************************************************************************************
+_city_site::_city_site()
+	: m_strName()
+	, m_strDescription()
+	, m_enSRS(enumCitySRS::None)
+	, m_strEPSGCode()
+	, m_arLowerCorner()
+	, m_arUpperCorner()
+{
+}
+
+/*virtual*/ _city_site::~_city_site()
+{
+}
+
+void _city_site::getCenter(double& dX, double& dY, double& dZ) const
+{
+	dX = 0.;
+	dY = 0.;
+	dZ = 0.;
+
+	if (hasSRSData())
+	{
+		dX = (m_arLowerCorner[0] + m_arUpperCorner[0]) / 2.;
+		dY = (m_arLowerCorner[1] + m_arUpperCorner[1]) / 2.;
+		dZ = (m_arLowerCorner[2] + m_arUpperCorner[2]) / 2.;
+	}
+}
+
+void _city_site::getOffset(double& dX, double& dY, double& dZ) const
+{
+	if (m_enSRS == enumCitySRS::ReferencePoint)
+	{
+		dX = 0.;
+		dY = 0.;
+		dZ = 0.;
+
+		return;
+	}
+
+	getCenter(dX, dY, dZ);
+}
+
+// ************************************************************************************************
+_city_object::_city_object(enumCityObject enObject, OwlInstance iInstance, const string& strTag, const string& strClassName)
+	: m_enObject(enObject)
+	, m_iInstance(iInstance)
+	, m_strTag(strTag)
+	, m_strClassName(strClassName)
+	, m_enFeature(enumCityFeature::Other)
+	, m_iSite(-1)
+	, m_vecElements()
+	, m_vecAttributes()
+	, m_iAttributesCount(0)
+	, m_vecGeometryLODs()
+	, m_dHighestLOD(-DBL_MAX)
+	, m_geometryBuffer()
+	, m_dReadTime(0.)
+{
+	assert(m_iInstance != 0);
+}
+
+/*virtual*/ _city_object::~_city_object()
+{
+}
+
+int64_t _city_object::getGeometriesCount() const
+{
+	int64_t iGeometriesCount = 0;
+	for (const auto& element : m_vecElements)
+	{
+		iGeometriesCount += element.m_iGeometriesCount;
+	}
+
+	return iGeometriesCount;
+}
+
+// ************************************************************************************************
+_city_model::_city_model()
+	: m_modelSite()
+	, m_vecSites()
+	, m_vecBuildings()
+	, m_vecFeatures()
+	, m_mapObjects()
+	, m_setSRSs()
+	, m_vecLODs()
+	, m_mapLODs()
+	, m_vecPathLODs()
+	, m_mapPathLODs()
+	, m_vecPaths()
+	, m_mapPaths()
+	, m_dReadTime(0.)
+{
+	clear();
+}
+
+/*virtual*/ _city_model::~_city_model()
+{
+	clear();
+}
+
+void _city_model::clear()
+{
+	m_modelSite = _city_site();
+	m_vecSites.clear();
+
+	for (auto pBuilding : m_vecBuildings)
+	{
+		delete pBuilding;
+	}
+	m_vecBuildings.clear();
+
+	for (auto pFeature : m_vecFeatures)
+	{
+		delete pFeature;
+	}
+	m_vecFeatures.clear();
+
+	m_mapObjects.clear();
+	m_setSRSs.clear();
+
+	m_vecLODs.clear();
+	m_mapLODs.clear();
+	m_vecPathLODs.clear();
+	m_mapPathLODs.clear();
+	m_vecPaths.clear();
+	m_mapPaths.clear();
+
+	addLOD("");
+	addPathLODs(vector<int>());
+	addPaths(vector<int>{ 0 });
+
+	m_dReadTime = 0.;
+}
+
+_city_object* _city_model::addObject(enumCityObject enObject, OwlInstance iInstance, const string& strTag, const string& strClassName)
+{
+	assert(m_mapObjects.find(iInstance) == m_mapObjects.end());
+
+	auto pObject = new _city_object(enObject, iInstance, strTag, strClassName);
+	if (enObject == enumCityObject::Building)
+	{
+		m_vecBuildings.push_back(pObject);
+	}
+	else
+	{
+		m_vecFeatures.push_back(pObject);
+	}
+
+	m_mapObjects[iInstance] = pObject;
+
+	return pObject;
+}
+
+int64_t _city_model::addSite(const _city_site& site)
+{
+	m_vecSites.push_back(site);
+
+	return (int64_t)m_vecSites.size() - 1;
+}
+
+int _city_model::addLOD(const string& strLOD)
+{
+	auto itLOD = m_mapLODs.find(strLOD);
+	if (itLOD != m_mapLODs.end())
+	{
+		return itLOD->second;
+	}
+
+	m_vecLODs.push_back(strLOD);
+	m_mapLODs[strLOD] = (int)m_vecLODs.size() - 1;
+
+	return (int)m_vecLODs.size() - 1;
+}
+
+int _city_model::addPathLODs(const vector<int>& vecLODs)
+{
+	auto itPathLODs = m_mapPathLODs.find(vecLODs);
+	if (itPathLODs != m_mapPathLODs.end())
+	{
+		return itPathLODs->second;
+	}
+
+	m_vecPathLODs.push_back(vecLODs);
+	m_mapPathLODs[vecLODs] = (int)m_vecPathLODs.size() - 1;
+
+	return (int)m_vecPathLODs.size() - 1;
+}
+
+int _city_model::addPathLOD(int iPathLODs, int iLOD)
+{
+	assert((iPathLODs >= 0) && (iPathLODs < (int)m_vecPathLODs.size()));
+	assert((iLOD >= 0) && (iLOD < (int)m_vecLODs.size()));
+
+	// No LOD
+	if (iLOD == 0)
+	{
+		return iPathLODs;
+	}
+
+	const auto& vecPathLODs = m_vecPathLODs[iPathLODs];
+
+	auto itLOD = lower_bound(vecPathLODs.begin(), vecPathLODs.end(), iLOD);
+	if ((itLOD != vecPathLODs.end()) && (*itLOD == iLOD))
+	{
+		return iPathLODs;
+	}
+
+	vector<int> vecLODs = vecPathLODs;
+	vecLODs.insert(vecLODs.begin() + (itLOD - vecPathLODs.begin()), iLOD);
+
+	return addPathLODs(vecLODs);
+}
+
+int _city_model::addPaths(const vector<int>& vecPathLODs)
+{
+	auto itPaths = m_mapPaths.find(vecPathLODs);
+	if (itPaths != m_mapPaths.end())
+	{
+		return itPaths->second;
+	}
+
+	m_vecPaths.push_back(vecPathLODs);
+	m_mapPaths[vecPathLODs] = (int)m_vecPaths.size() - 1;
+
+	return (int)m_vecPaths.size() - 1;
+}
+
+int _city_model::addPathsLOD(int iPaths, int iLOD)
+{
+	assert((iPaths >= 0) && (iPaths < (int)m_vecPaths.size()));
+
+	// No LOD
+	if (iLOD == 0)
+	{
+		return iPaths;
+	}
+
+	vector<int> vecPathLODs;
+	for (auto iPathLODs : m_vecPaths[iPaths])
+	{
+		vecPathLODs.push_back(addPathLOD(iPathLODs, iLOD));
+	}
+
+	sort(vecPathLODs.begin(), vecPathLODs.end());
+	vecPathLODs.erase(unique(vecPathLODs.begin(), vecPathLODs.end()), vecPathLODs.end());
+
+	return addPaths(vecPathLODs);
+}
+
+int _city_model::mergePaths(int iPaths1, int iPaths2)
+{
+	assert((iPaths1 >= 0) && (iPaths1 < (int)m_vecPaths.size()));
+	assert((iPaths2 >= 0) && (iPaths2 < (int)m_vecPaths.size()));
+
+	if (iPaths1 == iPaths2)
+	{
+		return iPaths1;
+	}
+
+	vector<int> vecPathLODs;
+	set_union(
+		m_vecPaths[iPaths1].begin(), m_vecPaths[iPaths1].end(),
+		m_vecPaths[iPaths2].begin(), m_vecPaths[iPaths2].end(),
+		back_inserter(vecPathLODs));
+
+	return addPaths(vecPathLODs);
+}
+
+const _city_object* _city_model::getObject(OwlInstance iInstance) const
+{
+	auto itObject = m_mapObjects.find(iInstance);
+
+	return itObject != m_mapObjects.end() ? itObject->second : nullptr;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "_geometry_buffer.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cfloat>
+using namespace std;
+
+// ************************************************************************************************
+enum class enumCityObject : int
+{
+	Building = 0,
+	Feature,
+};
+
+// ************************************************************************************************
+// Building/Feature Element; selects the IFC entity and the default/overridden material
+enum class enumCityElement : int
+{
+	WallSurface = 0,
+	RoofSurface,
+	Door,
+	Window,
+	Other, // Proxy/Unknown
+};
+
+// ************************************************************************************************
+// Feature; selects the IFC entity
+enum class enumCityFeature : int
+{
+	Transportation = 0, // Transportation, TrafficSpace, TrafficArea, Bridge, Tunnel
+	Geographic, // Relief, LandUse, Water, Vegetation
+	Furniture,
+	Other,
+};
+
+// ************************************************************************************************
+enum class enumCityAttributeValue : int
+{
+	Real = 0,
+	Reals, // Several values; exported as text
+	Text,
+};
+
+// ************************************************************************************************
+enum class enumCityAttributeUnit : int
+{
+	None = 0,
+	Length,
+	Area,
+};
+
+// ************************************************************************************************
+enum class enumCitySRS : int
+{
+	None = 0,
+	Envelope, // boundedBy
+	ReferencePoint, // CadastralParcel; the site is not moved
+	Metadata, // CityJSON geographicalExtent
+};
+
+// ************************************************************************************************
+// A property/attribute of a Building/Feature (or of an element); the name is resolved against the
+// settings ($PROPERTY: override name, type, property set) on export
+class _city_attribute
+{
+
+public: // Members
+
+	string m_strName; // XML Element/Attribute without the prefix
+	bool m_bAttribute; // XML Attribute
+	enumCityAttributeValue m_enValue;
+	double m_dValue;
+	string m_strValue; // UTF-8
+	enumCityAttributeUnit m_enUnit;
+
+public: // Methods
+
+	_city_attribute(const string& strName, bool bAttribute, double dValue, enumCityAttributeUnit enUnit)
+		: m_strName(strName)
+		, m_bAttribute(bAttribute)
+		, m_enValue(enumCityAttributeValue::Real)
+		, m_dValue(dValue)
+		, m_strValue()
+		, m_enUnit(enUnit)
+	{}
+
+	_city_attribute(const string& strName, bool bAttribute, enumCityAttributeValue enValue, const string& strValue)
+		: m_strName(strName)
+		, m_bAttribute(bAttribute)
+		, m_enValue(enValue)
+		, m_dValue(0.)
+		, m_strValue(strValue)
+		, m_enUnit(enumCityAttributeUnit::None)
+	{}
+
+	virtual ~_city_attribute()
+	{}
+};
+
+// ************************************************************************************************
+// The LODs of an Element/Element Geometry; the city model has all LODs, the LOD selection of an
+// export is applied to these on emission (see _citygml_exporter::isElementFiltered()). An instance
+// reached by several paths (e.g. shared by lod2MultiSurface and lod3MultiSurface) has all of them.
+class _city_lod
+{
+
+public: // Members
+
+	int m_iLOD; // The geometry's or a property's above it, e.g. lod2MultiSurface; see _city_model::getLOD()
+	int m_iPaths; // The paths from the Building/Feature, the LODs of each; see _city_model::getPaths()
+	double m_dPathLOD; // The lowest LOD on a path, the highest of the paths; -DBL_MAX - a path without LOD
+
+public: // Methods
+
+	_city_lod()
+		: m_iLOD(0)
+		, m_iPaths(0)
+		, m_dPathLOD(-DBL_MAX)
+	{}
+};
+
+// ************************************************************************************************
+// Building/Feature Element; the ranges index the attributes of the object and the Element Geometries
+// of its _geometry_buffer
+class _city_element
+{
+
+public: // Members
+
+	OwlInstance m_iInstance; // Id
+	string m_strTag;
+	string m_strClassName;
+	enumCityElement m_enElement;
+
+	int64_t m_iFirstAttribute;
+	int64_t m_iAttributesCount;
+
+	int64_t m_iFirstGeometry;
+	int64_t m_iGeometriesCount;
+
+	_city_lod m_lod;
+
+public: // Methods
+
+	_city_element(OwlInstance iInstance, const string& strTag, const string& strClassName, enumCityElement enElement)
+		: m_iInstance(iInstance)
+		, m_strTag(strTag)
+		, m_strClassName(strClassName)
+		, m_enElement(enElement)
+		, m_iFirstAttribute(0)
+		, m_iAttributesCount(0)
+		, m_iFirstGeometry(0)
+		, m_iGeometriesCount(0)
+		, m_lod()
+	{}
+
+	virtual ~_city_element()
+	{}
+};
+
+// ************************************************************************************************
+// IfcSite; the model (root) or a Building/Parcel with its own SRS data
+class _city_site
+{
+
+public: // Members
+
+	string m_strName;
+	string m_strDescription;
+	enumCitySRS m_enSRS;
+	string m_strEPSGCode; // Empty - no SRS data
+	double m_arLowerCorner[3];
+	double m_arUpperCorner[3]; // ReferencePoint - the same point
+
+public: // Methods
+
+	_city_site();
+	virtual ~_city_site();
+
+	bool hasSRSData() const { return !m_strEPSGCode.empty(); }
+	void getCenter(double& dX, double& dY, double& dZ) const;
+	void getOffset(double& dX, double& dY, double& dZ) const; // The origin of the site
+};
+
+// ************************************************************************************************
+// A Building/Feature: the records and the geometry read from the OWL model; the objects are read
+// independently of each other (see _citygml_exporter::readCityObjects())
+class _city_object
+{
+
+public: // Members
+
+	enumCityObject m_enObject;
+	OwlInstance m_iInstance; // Id
+	string m_strTag;
+	string m_strClassName;
+	enumCityFeature m_enFeature; // Feature
+	int64_t m_iSite; // -1 - the model's site
+
+	vector<_city_element> m_vecElements;
+	vector<_city_attribute> m_vecAttributes; // The object's, then the elements'
+	int64_t m_iAttributesCount; // The object's
+	vector<_city_lod> m_vecGeometryLODs; // Element Geometry : LODs
+	double m_dHighestLOD; // HIGHEST_LOD; -DBL_MAX - no LOD
+	_geometry_buffer m_geometryBuffer;
+
+	// Metrics
+	double m_dReadTime; // ms
+
+public: // Methods
+
+	_city_object(enumCityObject enObject, OwlInstance iInstance, const string& strTag, const string& strClassName);
+	virtual ~_city_object();
+
+	int64_t getGeometriesCount() const; // Element Geometries
+};
+
+// ************************************************************************************************
+// The city model read from the OWL model, all LODs; the IFC models of the exports (any LOD selection)
+// are created from it and don't access the OWL model
+class _city_model
+{
+
+private: // Members
+
+	_city_site m_modelSite;
+	vector<_city_site> m_vecSites; // Buildings, Parcels
+	vector<_city_object*> m_vecBuildings;
+	vector<_city_object*> m_vecFeatures;
+	map<OwlInstance, _city_object*> m_mapObjects; // Id : Building/Feature
+	set<string> m_setSRSs; // EPSG codes
+
+	// LODs; 0 - no LOD/the empty set
+	vector<string> m_vecLODs;
+	map<string, int> m_mapLODs; // LOD : Index
+	vector<vector<int>> m_vecPathLODs; // Sorted LOD indices
+	map<vector<int>, int> m_mapPathLODs; // LOD indices : Index
+	vector<vector<int>> m_vecPaths; // Sorted Path LODs indices; 0 - a path without LOD
+	map<vector<int>, int> m_mapPaths; // Path LODs indices : Index
+
+	// Metrics
+	double m_dReadTime; // ms
+
+public: // Methods
+
+	_city_model();
+	virtual ~_city_model();
+
+	void clear();
+
+	_city_object* addObject(enumCityObject enObject, OwlInstance iInstance, const string& strTag, const string& strClassName);
+	int64_t addSite(const _city_site& site);
+
+	_city_site& getModelSite() { return m_modelSite; }
+	const _city_site& getModelSite() const { return m_modelSite; }
+	const _city_site& getSite(int64_t iSite) const { return iSite == -1 ? m_modelSite : m_vecSites[iSite]; }
+	int64_t getSitesCount() const { return (int64_t)m_vecSites.size(); }
+	const vector<_city_object*>& getBuildings() const { return m_vecBuildings; }
+	const vector<_city_object*>& getFeatures() const { return m_vecFeatures; }
+	const _city_object* getObject(OwlInstance iInstance) const;
+	set<string>& getSRSs() { return m_setSRSs; }
+	const set<string>& getSRSs() const { return m_setSRSs; }
+
+	int addLOD(const string& strLOD);
+	int addPathLODs(const vector<int>& vecLODs);
+	int addPathLOD(int iPathLODs, int iLOD); // The set iPathLODs + iLOD
+	int addPaths(const vector<int>& vecPathLODs);
+	int addPathsLOD(int iPaths, int iLOD); // Each path of iPaths + iLOD
+	int mergePaths(int iPaths1, int iPaths2);
+	const string& getLOD(int iLOD) const { return m_vecLODs[iLOD]; }
+	const vector<string>& getLODs() const { return m_vecLODs; }
+	const vector<vector<int>>& getPathLODs() const { return m_vecPathLODs; }
+	const vector<vector<int>>& getPaths() const { return m_vecPaths; }
+
+	double getReadTime() const { return m_dReadTime; }
+	void setReadTime(double dReadTime) { m_dReadTime = dReadTime; }
+};
@@ -0,0 +1,949 @@
+#include "pch.h"
+#include "_city_model_cache.h"
+#include "_input_stream.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WINDOWS
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// ************************************************************************************************
+#define CITY_MODEL_CACHE_MAGIC "G2ICMC\r\n"
+#define CITY_MODEL_CACHE_HEADER_SIZE 72 // Magic, Version, Format, Content hash, Content size, Content time, Settings key, Directory offset, Directory size
+
+// ************************************************************************************************
+_binary_writer::_binary_writer()
+	: m_vecData()
+{
+}
+
+/*virtual*/ _binary_writer::~_binary_writer()
+{
+}
+
+void _binary_writer::write(const void* pData, size_t iSize)
+{
+	assert((pData != nullptr) || (iSize == 0));
+
+	m_vecData.insert(m_vecData.end(), (const unsigned char*)pData, (const unsigned char*)pData + iSize);
+
+	// 8-byte alignment
+	m_vecData.resize((m_vecData.size() + 7) & ~(size_t)7, 0);
+}
+
+void _binary_writer::writeString(const string& strValue)
+{
+	writeInt((int64_t)strValue.size());
+	write(strValue.data(), strValue.size());
+}
+
+// ************************************************************************************************
+_binary_reader::_binary_reader(const unsigned char* szData, size_t iSize)
+	: m_szData(szData)
+	, m_iSize(iSize)
+	, m_iPosition(0)
+	, m_bFailed(false)
+{
+	assert((m_szData != nullptr) || (m_iSize == 0));
+}
+
+/*virtual*/ _binary_reader::~_binary_reader()
+{
+}
+
+bool _binary_reader::read(void* pData, size_t iSize)
+{
+	size_t iAlignedSize = (iSize + 7) & ~(size_t)7;
+	if (m_bFailed || (iAlignedSize > m_iSize - m_iPosition))
+	{
+		m_bFailed = true;
+
+		memset(pData, 0, iSize);
+
+		return false;
+	}
+
+	memcpy(pData, m_szData + m_iPosition, iSize);
+	m_iPosition += iAlignedSize;
+
+	return true;
+}
+
+int64_t _binary_reader::readInt()
+{
+	int64_t iValue = 0;
+	read(&iValue, sizeof(iValue));
+
+	return iValue;
+}
+
+double _binary_reader::readDouble()
+{
+	double dValue = 0.;
+	read(&dValue, sizeof(dValue));
+
+	return dValue;
+}
+
+string _binary_reader::readString()
+{
+	int64_t iLength = readInt();
+	if ((iLength < 0) || ((uint64_t)iLength > m_iSize - m_iPosition))
+	{
+		m_bFailed = true;
+
+		return "";
+	}
+
+	string strValue((const char*)m_szData + m_iPosition, (size_t)iLength);
+	m_iPosition += ((size_t)iLength + 7) & ~(size_t)7;
+
+	return strValue;
+}
+
+// ************************************************************************************************
+/*static*/ atomic<uint32_t> _city_model_cache::s_iTempFilesCount(0);
+
+_city_model_cache::_city_model_cache(const wstring& strInputFile, uint64_t iSettingsKey)
+	: m_strInputFile(strInputFile)
+	, m_strFile(strInputFile + L".citymodel")
+	, m_iSettingsKey(iSettingsKey)
+	, m_iContentHash(0)
+	, m_iContentSize(0)
+	, m_iContentTime(-1)
+	, m_bLoaded(false)
+	, m_enFormat(enumCityModelFormat::Unknown)
+	, m_setLODs()
+	, m_mapCoordinates()
+	, m_iCityModelOffset(0)
+	, m_iCityModelSize(0)
+{
+	assert(!m_strInputFile.empty());
+}
+
+/*virtual*/ _city_model_cache::~_city_model_cache()
+{
+}
+
+bool _city_model_cache::open()
+{
+	m_bLoaded = false;
+	m_enFormat = enumCityModelFormat::Unknown;
+	m_setLODs.clear();
+	m_mapCoordinates.clear();
+	m_iCityModelOffset = 0;
+	m_iCityModelSize = 0;
+
+	// Input
+	int64_t iContentSize = _mapped_file::getFileSize(m_strInputFile);
+	if (iContentSize < 0)
+	{
+		return false;
+	}
+
+	m_iContentSize = (uint64_t)iContentSize;
+	m_iContentTime = _mapped_file::getFileTime(m_strInputFile);
+
+	// Cache file; another content/version - written again on save
+	_mapped_file cacheFile(m_strFile);
+	bool bCacheFile = cacheFile.open();
+
+	// Not written since the cache file - the hash of the file
+	if (!bCacheFile || !readContentHash(cacheFile.getData(), cacheFile.getSize(), m_iContentHash))
+	{
+		_mapped_file inputFile(m_strInputFile);
+		if (!inputFile.open())
+		{
+			return false;
+		}
+
+		m_iContentHash = hashContent(inputFile.getData(), inputFile.getSize());
+		m_iContentSize = (uint64_t)inputFile.getSize();
+	}
+
+	if (bCacheFile)
+	{
+		m_bLoaded = readDirectory(cacheFile.getData(), cacheFile.getSize(), true, m_iCityModelOffset, m_iCityModelSize);
+		if (!m_bLoaded)
+		{
+			m_enFormat = enumCityModelFormat::Unknown;
+			m_setLODs.clear();
+			m_mapCoordinates.clear();
+			m_iCityModelOffset = 0;
+			m_iCityModelSize = 0;
+		}
+	}
+
+	return true;
+}
+
+// The file may have been written again since open() (another job); the block is taken from the
+// directory of the mapping being read
+bool _city_model_cache::load(_city_model* pCityModel)
+{
+	assert(pCityModel != nullptr);
+
+	pCityModel->clear();
+
+	_mapped_file cacheFile(m_strFile);
+	if (!cacheFile.open())
+	{
+		return false;
+	}
+
+	uint64_t iCityModelOffset = 0;
+	uint64_t iCityModelSize = 0;
+	if (!readDirectory(cacheFile.getData(), cacheFile.getSize(), false, iCityModelOffset, iCityModelSize) ||
+		(iCityModelSize == 0))
+	{
+		return false;
+	}
+
+	_binary_reader reader(cacheFile.getData() + iCityModelOffset, (size_t)iCityModelSize);
+
+	readSite(reader, pCityModel->getModelSite());
+
+	int64_t iSitesCount = reader.readInt();
+	for (int64_t iSite = 0; (iSite < iSitesCount) && !reader.isFailed(); iSite++)
+	{
+		_city_site site;
+		readSite(reader, site);
+
+		pCityModel->addSite(site);
+	}
+
+	int64_t iSRSsCount = reader.readInt();
+	for (int64_t iSRS = 0; (iSRS < iSRSsCount) && !reader.isFailed(); iSRS++)
+	{
+		pCityModel->getSRSs().insert(reader.readString());
+	}
+
+	// LODs, Path LODs, Paths; the indices are referenced by the objects
+	int64_t iLODsCount = reader.readInt();
+	for (int64_t iLOD = 0; (iLOD < iLODsCount) && !reader.isFailed(); iLOD++)
+	{
+		if (pCityModel->addLOD(reader.readString()) != iLOD)
+		{
+			pCityModel->clear();
+
+			return false;
+		}
+	}
+
+	int64_t iPathLODsCount = reader.readInt();
+	for (int64_t iPathLODs = 0; (iPathLODs < iPathLODsCount) && !reader.isFailed(); iPathLODs++)
+	{
+		vector<int> vecPathLODs;
+		reader.readArray(vecPathLODs);
+
+		for (auto iLOD : vecPathLODs)
+		{
+			if ((iLOD <= 0) || (iLOD >= (int)pCityModel->getLODs().size()))
+			{
+				pCityModel->clear();
+
+				return false;
+			}
+		}
+
+		if (pCityModel->addPathLODs(vecPathLODs) != iPathLODs)
+		{
+			pCityModel->clear();
+
+			return false;
+		}
+	}
+
+	int64_t iPathsCount = reader.readInt();
+	for (int64_t iPaths = 0; (iPaths < iPathsCount) && !reader.isFailed(); iPaths++)
+	{
+		vector<int> vecPaths;
+		reader.readArray(vecPaths);
+
+		for (auto iPathLODs : vecPaths)
+		{
+			if ((iPathLODs < 0) || (iPathLODs >= (int)pCityModel->getPathLODs().size()))
+			{
+				pCityModel->clear();
+
+				return false;
+			}
+		}
+
+		if (pCityModel->addPaths(vecPaths) != iPaths)
+		{
+			pCityModel->clear();
+
+			return false;
+		}
+	}
+
+	// Buildings, Features
+	int64_t iObjectsCount = reader.readInt();
+	for (int64_t iObject = 0; (iObject < iObjectsCount) && !reader.isFailed(); iObject++)
+	{
+		if (!readObject(reader, pCityModel))
+		{
+			break;
+		}
+	}
+
+	if (reader.isFailed())
+	{
+		pCityModel->clear();
+
+		return false;
+	}
+
+	return true;
+}
+
+bool _city_model_cache::save(const _city_model* pCityModel)
+{
+	assert(pCityModel != nullptr);
+	assert(m_iContentSize > 0);
+
+	// City Model
+	_binary_writer writer;
+
+	writeSite(writer, pCityModel->getModelSite());
+
+	writer.writeInt(pCityModel->getSitesCount());
+	for (int64_t iSite = 0; iSite < pCityModel->getSitesCount(); iSite++)
+	{
+		writeSite(writer, pCityModel->getSite(iSite));
+	}
+
+	writer.writeInt((int64_t)pCityModel->getSRSs().size());
+	for (const auto& strSRS : pCityModel->getSRSs())
+	{
+		writer.writeString(strSRS);
+	}
+
+	writer.writeInt((int64_t)pCityModel->getLODs().size());
+	for (const auto& strLOD : pCityModel->getLODs())
+	{
+		writer.writeString(strLOD);
+	}
+
+	writer.writeInt((int64_t)pCityModel->getPathLODs().size());
+	for (const auto& vecPathLODs : pCityModel->getPathLODs())
+	{
+		writer.writeArray(vecPathLODs);
+	}
+
+	writer.writeInt((int64_t)pCityModel->getPaths().size());
+	for (const auto& vecPaths : pCityModel->getPaths())
+	{
+		writer.writeArray(vecPaths);
+	}
+
+	writer.writeInt((int64_t)(pCityModel->getBuildings().size() + pCityModel->getFeatures().size()));
+	for (auto pBuilding : pCityModel->getBuildings())
+	{
+		writeObject(writer, pBuilding);
+	}
+
+	for (auto pFeature : pCityModel->getFeatures())
+	{
+		writeObject(writer, pFeature);
+	}
+
+	// A file per job (process, counter); the last one wins
+#ifdef _WINDOWS
+	uint64_t iProcessId = (uint64_t)_getpid();
+#else
+	uint64_t iProcessId = (uint64_t)getpid();
+#endif
+	wstring strTempFile = m_strFile + L"." + to_wstring(iProcessId) + L"." + to_wstring(++s_iTempFilesCount) + L".tmp";
+
+#ifdef _WINDOWS
+	FILE* pFile = _wfopen(strTempFile.c_str(), L"wb");
+#else
+	FILE* pFile = fopen((LPCSTR)CW2A(strTempFile.c_str()), "wb");
+#endif
+	if (pFile == nullptr)
+	{
+		return false;
+	}
+
+	bool bSucceeded = true;
+
+	// Header (see below)
+	unsigned char szHeader[CITY_MODEL_CACHE_HEADER_SIZE] = {};
+	bSucceeded &= fwrite(szHeader, 1, sizeof(szHeader), pFile) == sizeof(szHeader);
+
+	uint64_t iOffset = CITY_MODEL_CACHE_HEADER_SIZE;
+
+	// City Model
+	bSucceeded &= fwrite(writer.getData().data(), 1, writer.getData().size(), pFile) == writer.getData().size();
+
+	uint64_t iCityModelOffset = m_iCityModelOffset;
+	uint64_t iCityModelSize = m_iCityModelSize;
+	m_iCityModelOffset = iOffset;
+	m_iCityModelSize = (uint64_t)writer.getData().size();
+	iOffset += (uint64_t)writer.getData().size();
+
+	// Directory
+	_binary_writer directoryWriter;
+	writeDirectory(directoryWriter);
+
+	bSucceeded &= fwrite(directoryWriter.getData().data(), 1, directoryWriter.getData().size(), pFile) == directoryWriter.getData().size();
+
+	// Header
+	_binary_writer headerWriter;
+	headerWriter.write(CITY_MODEL_CACHE_MAGIC, 8);
+	headerWriter.writeInt(CITY_MODEL_CACHE_VERSION);
+	headerWriter.writeInt((int64_t)m_enFormat);
+	headerWriter.writeInt((int64_t)m_iContentHash);
+	headerWriter.writeInt((int64_t)m_iContentSize);
+	headerWriter.writeInt(m_iContentTime);
+	headerWriter.writeInt((int64_t)m_iSettingsKey);
+	headerWriter.writeInt((int64_t)iOffset);
+	headerWriter.writeInt((int64_t)directoryWriter.getData().size());
+	assert(headerWriter.getData().size() == CITY_MODEL_CACHE_HEADER_SIZE);
+
+	bSucceeded &= fseek(pFile, 0, SEEK_SET) == 0;
+	bSucceeded &= fwrite(headerWriter.getData().data(), 1, headerWriter.getData().size(), pFile) == headerWriter.getData().size();
+	bSucceeded &= fclose(pFile) == 0;
+
+	if (bSucceeded)
+	{
+#ifdef _WINDOWS
+		bSucceeded = ::MoveFileExW(strTempFile.c_str(), m_strFile.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+		bSucceeded = rename((LPCSTR)CW2A(strTempFile.c_str()), (LPCSTR)CW2A(m_strFile.c_str())) == 0;
+#endif
+	}
+
+	if (!bSucceeded)
+	{
+#ifdef _WINDOWS
+		_wremove(strTempFile.c_str());
+#else
+		remove((LPCSTR)CW2A(strTempFile.c_str()));
+#endif
+		m_iCityModelOffset = iCityModelOffset;
+		m_iCityModelSize = iCityModelSize;
+
+		return false;
+	}
+
+	m_bLoaded = true;
+
+	return true;
+}
+
+/*static*/ uint64_t _city_model_cache::getSettingsKey(uint64_t iSettingsHash, const char* szConverterVersion)
+{
+	assert(szConverterVersion != nullptr);
+
+	string strKey = to_string(iSettingsHash) + ";" + szConverterVersion;
+
+	return hashContent((const unsigned char*)strKey.data(), strKey.size());
+}
+
+void _city_model_cache::setModelData(enumCityModelFormat enFormat, const set<string>& setLODs)
+{
+	// Another format/LODs - a new input
+	if (m_bLoaded && ((m_enFormat != enFormat) || (m_setLODs != setLODs)))
+	{
+		m_bLoaded = false;
+		m_mapCoordinates.clear();
+		m_iCityModelOffset = 0;
+		m_iCityModelSize = 0;
+	}
+
+	m_enFormat = enFormat;
+	m_setLODs = setLODs;
+}
+
+void _city_model_cache::setWGS84(int iCRS, float fX, float fY, float fZ, const string& strCoordinates)
+{
+	assert(!strCoordinates.empty());
+
+	m_mapCoordinates[make_tuple(iCRS, fX, fY, fZ)] = strCoordinates;
+}
+
+bool _city_model_cache::getWGS84(int iCRS, float fX, float fY, float fZ, string& strCoordinates) const
+{
+	auto itCoordinates = m_mapCoordinates.find(make_tuple(iCRS, fX, fY, fZ));
+	if (itCoordinates == m_mapCoordinates.end())
+	{
+		return false;
+	}
+
+	strCoordinates = itCoordinates->second;
+
+	return true;
+}
+
+// The content hash of a file of this version and settings, for an input of the same size and last
+// write time; another time (e.g. copied) - the input is hashed, the file is still used if it matches
+bool _city_model_cache::readContentHash(const unsigned char* szData, size_t iSize, uint64_t& iContentHash) const
+{
+	assert(szData != nullptr);
+
+	if (m_iContentTime < 0)
+	{
+		return false;
+	}
+
+	_binary_reader reader(szData, iSize);
+
+	char szMagic[8];
+	reader.read(szMagic, sizeof(szMagic));
+	int64_t iVersion = reader.readInt();
+	reader.readInt(); // Format
+	uint64_t iFileContentHash = (uint64_t)reader.readInt();
+	uint64_t iContentSize = (uint64_t)reader.readInt();
+	int64_t iContentTime = reader.readInt();
+	uint64_t iSettingsKey = (uint64_t)reader.readInt();
+
+	if (reader.isFailed() ||
+		(memcmp(szMagic, CITY_MODEL_CACHE_MAGIC, sizeof(szMagic)) != 0) ||
+		(iVersion != CITY_MODEL_CACHE_VERSION) ||
+		(iContentSize != m_iContentSize) ||
+		(iContentTime != m_iContentTime) ||
+		(iSettingsKey != m_iSettingsKey))
+	{
+		return false;
+	}
+
+	iContentHash = iFileContentHash;
+
+	return true;
+}
+
+// Not replaced in the meantime, e.g. by another job
+bool _city_model_cache::isCurrent(const unsigned char* szData, size_t iSize) const
+{
+	assert(szData != nullptr);
+
+	_binary_reader reader(szData, iSize);
+
+	char szMagic[8];
+	reader.read(szMagic, sizeof(szMagic));
+	int64_t iVersion = reader.readInt();
+	reader.readInt(); // Format
+	uint64_t iContentHash = (uint64_t)reader.readInt();
+	uint64_t iContentSize = (uint64_t)reader.readInt();
+	reader.readInt(); // Content time
+	uint64_t iSettingsKey = (uint64_t)reader.readInt();
+
+	return !reader.isFailed() &&
+		(memcmp(szMagic, CITY_MODEL_CACHE_MAGIC, sizeof(szMagic)) == 0) &&
+		(iVersion == CITY_MODEL_CACHE_VERSION) &&
+		(iContentHash == m_iContentHash) &&
+		(iContentSize == m_iContentSize) &&
+		(iSettingsKey == m_iSettingsKey);
+}
+
+// bModelData - the format, the LODs and the SRS transformations are read as well
+bool _city_model_cache::readDirectory(const unsigned char* szData, size_t iSize, bool bModelData, uint64_t& iCityModelOffset, uint64_t& iCityModelSize)
+{
+	assert(szData != nullptr);
+
+	if (!isCurrent(szData, iSize))
+	{
+		return false;
+	}
+
+	_binary_reader headerReader(szData, iSize);
+
+	char szMagic[8];
+	headerReader.read(szMagic, sizeof(szMagic));
+	headerReader.readInt(); // Version
+	int64_t iFormat = headerReader.readInt();
+	headerReader.readInt(); // Content hash
+	headerReader.readInt(); // Content size
+	headerReader.readInt(); // Content time
+	headerReader.readInt(); // Settings key
+	uint64_t iDirectoryOffset = (uint64_t)headerReader.readInt();
+	uint64_t iDirectorySize = (uint64_t)headerReader.readInt();
+
+	if (headerReader.isFailed() || (iDirectoryOffset + iDirectorySize > (uint64_t)iSize))
+	{
+		return false;
+	}
+
+	_binary_reader reader(szData + iDirectoryOffset, (size_t)iDirectorySize);
+
+	// Skipped by load()
+	set<string> setLODs;
+	map<tuple<int, float, float, float>, string> mapCoordinates;
+
+	int64_t iLODsCount = reader.readInt();
+	for (int64_t iLOD = 0; (iLOD < iLODsCount) && !reader.isFailed(); iLOD++)
+	{
+		setLODs.insert(reader.readString());
+	}
+
+	int64_t iCoordinatesCount = reader.readInt();
+	for (int64_t iCoordinates = 0; (iCoordinates < iCoordinatesCount) && !reader.isFailed(); iCoordinates++)
+	{
+		int iCRS = (int)reader.readInt();
+		double dX = reader.readDouble();
+		double dY = reader.readDouble();
+		double dZ = reader.readDouble();
+
+		mapCoordinates[make_tuple(iCRS, (float)dX, (float)dY, (float)dZ)] = reader.readString();
+	}
+
+	// City Model; 0 - none
+	iCityModelOffset = (uint64_t)reader.readInt();
+	iCityModelSize = (uint64_t)reader.readInt();
+
+	if (reader.isFailed() || (iCityModelOffset % 8 != 0) || (iCityModelOffset + iCityModelSize > iDirectoryOffset))
+	{
+		iCityModelOffset = 0;
+		iCityModelSize = 0;
+
+		return false;
+	}
+
+	if (bModelData)
+	{
+		m_enFormat = (enumCityModelFormat)iFormat;
+		m_setLODs = setLODs;
+		m_mapCoordinates = mapCoordinates;
+	}
+
+	return true;
+}
+
+void _city_model_cache::writeDirectory(_binary_writer& writer) const
+{
+	writer.writeInt((int64_t)m_setLODs.size());
+	for (const auto& strLOD : m_setLODs)
+	{
+		writer.writeString(strLOD);
+	}
+
+	writer.writeInt((int64_t)m_mapCoordinates.size());
+	for (const auto& itCoordinates : m_mapCoordinates)
+	{
+		writer.writeInt(get<0>(itCoordinates.first));
+		writer.writeDouble(get<1>(itCoordinates.first));
+		writer.writeDouble(get<2>(itCoordinates.first));
+		writer.writeDouble(get<3>(itCoordinates.first));
+		writer.writeString(itCoordinates.second);
+	}
+
+	writer.writeInt((int64_t)m_iCityModelOffset);
+	writer.writeInt((int64_t)m_iCityModelSize);
+}
+
+/*static*/ void _city_model_cache::writeSite(_binary_writer& writer, const _city_site& site)
+{
+	writer.writeString(site.m_strName);
+	writer.writeString(site.m_strDescription);
+	writer.writeInt((int64_t)site.m_enSRS);
+	writer.writeString(site.m_strEPSGCode);
+	writer.write(site.m_arLowerCorner, sizeof(site.m_arLowerCorner));
+	writer.write(site.m_arUpperCorner, sizeof(site.m_arUpperCorner));
+}
+
+/*static*/ void _city_model_cache::readSite(_binary_reader& reader, _city_site& site)
+{
+	site.m_strName = reader.readString();
+	site.m_strDescription = reader.readString();
+	site.m_enSRS = (enumCitySRS)reader.readInt();
+	site.m_strEPSGCode = reader.readString();
+	reader.read(site.m_arLowerCorner, sizeof(site.m_arLowerCorner));
+	reader.read(site.m_arUpperCorner, sizeof(site.m_arUpperCorner));
+}
+
+// The metrics (read time, OWL nodes) are not saved
+/*static*/ void _city_model_cache::writeObject(_binary_writer& writer, const _city_object* pObject)
+{
+	assert(pObject != nullptr);
+
+	writer.writeInt((int64_t)pObject->m_enObject);
+	writer.writeInt((int64_t)pObject->m_iInstance);
+	writer.writeString(pObject->m_strTag);
+	writer.writeString(pObject->m_strClassName);
+	writer.writeInt((int64_t)pObject->m_enFeature);
+	writer.writeInt(pObject->m_iSite);
+
+	// Elements
+	writer.writeInt((int64_t)pObject->m_vecElements.size());
+	for (const auto& element : pObject->m_vecElements)
+	{
+		writer.writeInt((int64_t)element.m_iInstance);
+		writer.writeString(element.m_strTag);
+		writer.writeString(element.m_strClassName);
+		writer.writeInt((int64_t)element.m_enElement);
+		writer.writeInt(element.m_iFirstAttribute);
+		writer.writeInt(element.m_iAttributesCount);
+		writer.writeInt(element.m_iFirstGeometry);
+		writer.writeInt(element.m_iGeometriesCount);
+		writeLOD(writer, element.m_lod);
+	}
+
+	// Attributes
+	writer.writeInt((int64_t)pObject->m_vecAttributes.size());
+	for (const auto& attribute : pObject->m_vecAttributes)
+	{
+		writer.writeString(attribute.m_strName);
+		writer.writeInt(attribute.m_bAttribute ? 1 : 0);
+		writer.writeInt((int64_t)attribute.m_enValue);
+		writer.writeDouble(attribute.m_dValue);
+		writer.writeString(attribute.m_strValue);
+		writer.writeInt((int64_t)attribute.m_enUnit);
+	}
+
+	writer.writeInt(pObject->m_iAttributesCount);
+
+	writer.writeInt((int64_t)pObject->m_vecGeometryLODs.size());
+	for (const auto& lod : pObject->m_vecGeometryLODs)
+	{
+		writeLOD(writer, lod);
+	}
+
+	writer.writeDouble(pObject->m_dHighestLOD);
+
+	writeGeometryBuffer(writer, pObject->m_geometryBuffer);
+}
+
+/*static*/ bool _city_model_cache::readObject(_binary_reader& reader, _city_model* pCityModel)
+{
+	assert(pCityModel != nullptr);
+
+	auto enObject = (enumCityObject)reader.readInt();
+	auto iInstance = (OwlInstance)reader.readInt();
+	string strTag = reader.readString();
+	string strClassName = reader.readString();
+
+	if (reader.isFailed() || (iInstance == 0) || (pCityModel->getObject(iInstance) != nullptr))
+	{
+		return false;
+	}
+
+	auto pObject = pCityModel->addObject(enObject, iInstance, strTag, strClassName);
+	pObject->m_enFeature = (enumCityFeature)reader.readInt();
+	pObject->m_iSite = reader.readInt();
+
+	if ((pObject->m_iSite < -1) || (pObject->m_iSite >= pCityModel->getSitesCount()))
+	{
+		return false;
+	}
+
+	// Elements
+	int64_t iElementsCount = reader.readInt();
+	for (int64_t iElement = 0; (iElement < iElementsCount) && !reader.isFailed(); iElement++)
+	{
+		auto iElementInstance = (OwlInstance)reader.readInt();
+		string strElementTag = reader.readString();
+		string strElementClassName = reader.readString();
+		auto enElement = (enumCityElement)reader.readInt();
+
+		_city_element element(iElementInstance, strElementTag, strElementClassName, enElement);
+		element.m_iFirstAttribute = reader.readInt();
+		element.m_iAttributesCount = reader.readInt();
+		element.m_iFirstGeometry = reader.readInt();
+		element.m_iGeometriesCount = reader.readInt();
+		if (!readLOD(reader, pCityModel, element.m_lod))
+		{
+			return false;
+		}
+
+		pObject->m_vecElements.push_back(element);
+	}
+
+	// Attributes
+	int64_t iAttributesCount = reader.readInt();
+	for (int64_t iAttribute = 0; (iAttribute < iAttributesCount) && !reader.isFailed(); iAttribute++)
+	{
+		string strName = reader.readString();
+		bool bAttribute = reader.readInt() != 0;
+		auto enValue = (enumCityAttributeValue)reader.readInt();
+		double dValue = reader.readDouble();
+		string strValue = reader.readString();
+		auto enUnit = (enumCityAttributeUnit)reader.readInt();
+
+		_city_attribute attribute(strName, bAttribute, enValue, strValue);
+		attribute.m_dValue = dValue;
+		attribute.m_enUnit = enUnit;
+
+		pObject->m_vecAttributes.push_back(attribute);
+	}
+
+	pObject->m_iAttributesCount = reader.readInt();
+
+	int64_t iGeometryLODsCount = reader.readInt();
+	for (int64_t iGeometryLOD = 0; (iGeometryLOD < iGeometryLODsCount) && !reader.isFailed(); iGeometryLOD++)
+	{
+		_city_lod lod;
+		if (!readLOD(reader, pCityModel, lod))
+		{
+			return false;
+		}
+
+		pObject->m_vecGeometryLODs.push_back(lod);
+	}
+
+	pObject->m_dHighestLOD = reader.readDouble();
+
+	readGeometryBuffer(reader, pObject->m_geometryBuffer);
+
+	return !reader.isFailed();
+}
+
+/*static*/ void _city_model_cache::writeLOD(_binary_writer& writer, const _city_lod& lod)
+{
+	writer.writeInt(lod.m_iLOD);
+	writer.writeInt(lod.m_iPaths);
+	writer.writeDouble(lod.m_dPathLOD);
+}
+
+/*static*/ bool _city_model_cache::readLOD(_binary_reader& reader, const _city_model* pCityModel, _city_lod& lod)
+{
+	assert(pCityModel != nullptr);
+
+	lod.m_iLOD = (int)reader.readInt();
+	lod.m_iPaths = (int)reader.readInt();
+	lod.m_dPathLOD = reader.readDouble();
+
+	return !reader.isFailed() &&
+		(lod.m_iLOD >= 0) && (lod.m_iLOD < (int)pCityModel->getLODs().size()) &&
+		(lod.m_iPaths >= 0) && (lod.m_iPaths < (int)pCityModel->getPaths().size());
+}
+
+/*static*/ void _city_model_cache::writeGeometryBuffer(_binary_writer& writer, const _geometry_buffer& geometryBuffer)
+{
+	writer.writeInt((int64_t)geometryBuffer.m_vecGeometries.size());
+	for (const auto& geometry : geometryBuffer.m_vecGeometries)
+	{
+		writer.writeInt((int64_t)geometry.m_enGeometry);
+		writer.writeInt((int64_t)geometry.m_iInstance);
+		writer.writeInt(geometry.m_iFirst);
+		writer.writeInt(geometry.m_iCount);
+		writer.writeInt(geometry.m_iMaterial);
+		writer.writeInt(geometry.m_iMatrix);
+	}
+
+	writer.writeArray(geometryBuffer.m_vecChildren);
+	writer.writeArray(geometryBuffer.m_vecVertices);
+	writer.writeArray(geometryBuffer.m_vecRingIndices);
+	writer.writeArray(geometryBuffer.m_vecRingOffsets);
+	writer.writeArray(geometryBuffer.m_vecFaceOffsets);
+
+	writer.writeInt((int64_t)geometryBuffer.m_vecMaterials.size());
+	for (const auto& material : geometryBuffer.m_vecMaterials)
+	{
+		writer.writeInt((int64_t)material.m_enMaterial);
+		writer.writeDouble(material.m_dR);
+		writer.writeDouble(material.m_dG);
+		writer.writeDouble(material.m_dB);
+		writer.writeDouble(material.m_dTransparency);
+	}
+
+	writer.writeArray(geometryBuffer.m_vecMatrices);
+	writer.writeArray(geometryBuffer.m_vecRoots);
+	writer.writeArray(geometryBuffer.m_vecRootOffsets);
+
+	// Mapped geometry : MappedItem
+	writer.writeInt((int64_t)geometryBuffer.m_mapMappedItems.size());
+	for (const auto& itMappedItem : geometryBuffer.m_mapMappedItems)
+	{
+		writer.writeInt((int64_t)itMappedItem.first);
+		writer.writeInt(itMappedItem.second);
+	}
+
+	// Material : Index
+	writer.writeInt((int64_t)geometryBuffer.m_mapMaterials.size());
+	for (const auto& itMaterial : geometryBuffer.m_mapMaterials)
+	{
+		writer.writeInt((int64_t)itMaterial.first);
+		writer.writeInt(itMaterial.second);
+	}
+}
+
+/*static*/ void _city_model_cache::readGeometryBuffer(_binary_reader& reader, _geometry_buffer& geometryBuffer)
+{
+	geometryBuffer.clear();
+
+	int64_t iGeometriesCount = reader.readInt();
+	for (int64_t iGeometry = 0; (iGeometry < iGeometriesCount) && !reader.isFailed(); iGeometry++)
+	{
+		auto enGeometry = (enumGeometry)reader.readInt();
+		auto iInstance = (OwlInstance)reader.readInt();
+
+		_geometry geometry(enGeometry, iInstance);
+		geometry.m_iFirst = reader.readInt();
+		geometry.m_iCount = reader.readInt();
+		geometry.m_iMaterial = reader.readInt();
+		geometry.m_iMatrix = reader.readInt();
+
+		geometryBuffer.m_vecGeometries.push_back(geometry);
+	}
+
+	reader.readArray(geometryBuffer.m_vecChildren);
+	reader.readArray(geometryBuffer.m_vecVertices);
+	reader.readArray(geometryBuffer.m_vecRingIndices);
+	reader.readArray(geometryBuffer.m_vecRingOffsets);
+	reader.readArray(geometryBuffer.m_vecFaceOffsets);
+
+	int64_t iMaterialsCount = reader.readInt();
+	for (int64_t iMaterial = 0; (iMaterial < iMaterialsCount) && !reader.isFailed(); iMaterial++)
+	{
+		_geometry_material material;
+		material.m_enMaterial = (enumGeometryMaterial)reader.readInt();
+		material.m_dR = reader.readDouble();
+		material.m_dG = reader.readDouble();
+		material.m_dB = reader.readDouble();
+		material.m_dTransparency = reader.readDouble();
+
+		geometryBuffer.m_vecMaterials.push_back(material);
+	}
+
+	reader.readArray(geometryBuffer.m_vecMatrices);
+	reader.readArray(geometryBuffer.m_vecRoots);
+	reader.readArray(geometryBuffer.m_vecRootOffsets);
+
+	int64_t iMappedItemsCount = reader.readInt();
+	for (int64_t iMappedItem = 0; (iMappedItem < iMappedItemsCount) && !reader.isFailed(); iMappedItem++)
+	{
+		auto iMappedGeometryInstance = (OwlInstance)reader.readInt();
+		geometryBuffer.m_mapMappedItems[iMappedGeometryInstance] = reader.readInt();
+	}
+
+	int64_t iMaterialsMapCount = reader.readInt();
+	for (int64_t iMaterial = 0; (iMaterial < iMaterialsMapCount) && !reader.isFailed(); iMaterial++)
+	{
+		auto iMaterialInstance = (OwlInstance)reader.readInt();
+		geometryBuffer.m_mapMaterials[iMaterialInstance] = reader.readInt();
+	}
+}
+
+// Not cryptographic; FNV-1a, 8 bytes at a time (see open() - the size is compared as well)
+/*static*/ uint64_t _city_model_cache::hashContent(const unsigned char* szData, size_t iSize)
+{
+	assert(szData != nullptr);
+
+	uint64_t iHash = 14695981039346656037ULL;
+
+	size_t iPosition = 0;
+	for (; iPosition + 8 <= iSize; iPosition += 8)
+	{
+		uint64_t iWord = 0;
+		memcpy(&iWord, szData + iPosition, sizeof(iWord));
+
+		iHash = (iHash ^ iWord) * 1099511628211ULL;
+		iHash ^= iHash >> 29;
+	}
+
+	for (; iPosition < iSize; iPosition++)
+	{
+		iHash = (iHash ^ szData[iPosition]) * 1099511628211ULL;
+	}
+
+	return iHash;
+}
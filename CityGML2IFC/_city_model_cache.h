@@ -0,0 +1,173 @@
+#pragma once
+
+#include "_city_model.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <tuple>
+#include <atomic>
+using namespace std;
+
+// ************************************************************************************************
+// Format version; a cache file of another version is written again
+#define CITY_MODEL_CACHE_VERSION 5
+
+// ************************************************************************************************
+// The format of the input; selects the exporter
+enum class enumCityModelFormat : int
+{
+	Unknown = 0,
+	GML,
+	CityGML,
+	CityJSON,
+};
+
+// ************************************************************************************************
+// Native byte order; the values are 8-byte aligned (_binary_reader copies them out of the mapping)
+class _binary_writer
+{
+
+private: // Members
+
+	vector<unsigned char> m_vecData;
+
+public: // Methods
+
+	_binary_writer();
+	virtual ~_binary_writer();
+
+	void write(const void* pData, size_t iSize);
+	void writeInt(int64_t iValue) { write(&iValue, sizeof(iValue)); }
+	void writeDouble(double dValue) { write(&dValue, sizeof(dValue)); }
+	void writeString(const string& strValue);
+
+	template<typename T>
+	void writeArray(const vector<T>& vecValues) // POD
+	{
+		writeInt((int64_t)vecValues.size());
+		write(vecValues.data(), vecValues.size() * sizeof(T));
+	}
+
+	const vector<unsigned char>& getData() const { return m_vecData; }
+};
+
+// ************************************************************************************************
+// See _binary_writer; a read past the end fails the reader (the values are 0/empty)
+class _binary_reader
+{
+
+private: // Members
+
+	const unsigned char* m_szData;
+	size_t m_iSize;
+	size_t m_iPosition;
+	bool m_bFailed;
+
+public: // Methods
+
+	_binary_reader(const unsigned char* szData, size_t iSize);
+	virtual ~_binary_reader();
+
+	bool read(void* pData, size_t iSize);
+	int64_t readInt();
+	double readDouble();
+	string readString();
+
+	template<typename T>
+	void readArray(vector<T>& vecValues) // POD
+	{
+		vecValues.clear();
+
+		int64_t iCount = readInt();
+		if ((iCount < 0) || ((uint64_t)iCount > (m_iSize - m_iPosition) / sizeof(T)))
+		{
+			m_bFailed = true;
+
+			return;
+		}
+
+		vecValues.resize((size_t)iCount);
+		read(vecValues.data(), (size_t)iCount * sizeof(T));
+	}
+
+	bool isFailed() const { return m_bFailed; }
+};
+
+// ************************************************************************************************
+// '$EXPORT $CACHE': the city model read by the exports of an input, next to it (<input>.citymodel).
+// The file is keyed by the content of the input (hash and size), the settings and the version of
+// the converter; the input is hashed only if its size or last write time differs from the ones of
+// the file. The city model holds all LODs, i.e. a single block serves any LOD selection.
+// Layout: the header, the city model and the directory (the LODs and the SRS transformations of
+// the input, the block). The file is memory-mapped on load; save writes the file again (a
+// temporary file is renamed).
+class _city_model_cache
+{
+
+private: // Members
+
+	wstring m_strInputFile;
+	wstring m_strFile;
+	uint64_t m_iSettingsKey; // See getSettingsKey()
+
+	// Input
+	uint64_t m_iContentHash;
+	uint64_t m_iContentSize;
+	int64_t m_iContentTime; // See _mapped_file::getFileTime()
+
+	// Directory
+	bool m_bLoaded; // A cache file of the input exists
+	enumCityModelFormat m_enFormat;
+	set<string> m_setLODs;
+	map<tuple<int, float, float, float>, string> m_mapCoordinates; // EPSG, X, Y, Z : WGS84
+	uint64_t m_iCityModelOffset;
+	uint64_t m_iCityModelSize; // 0 - none
+
+	static atomic<uint32_t> s_iTempFilesCount;
+
+public: // Methods
+
+	_city_model_cache(const wstring& strInputFile, uint64_t iSettingsKey);
+	virtual ~_city_model_cache();
+
+	// false - the input can't be read
+	bool open();
+
+	bool load(_city_model* pCityModel);
+	bool save(const _city_model* pCityModel);
+
+	// A cache file of other settings or of another version of the converter is written again
+	static uint64_t getSettingsKey(uint64_t iSettingsHash, const char* szConverterVersion);
+	bool hasCityModel() const { return m_iCityModelSize > 0; }
+
+	// Input
+	void setModelData(enumCityModelFormat enFormat, const set<string>& setLODs);
+	enumCityModelFormat getFormat() const { return m_enFormat; }
+	const set<string>& getLODs() const { return m_setLODs; }
+	void setWGS84(int iCRS, float fX, float fY, float fZ, const string& strCoordinates);
+	bool getWGS84(int iCRS, float fX, float fY, float fZ, string& strCoordinates) const;
+
+	const wstring& getInputFile() const { return m_strInputFile; }
+	const wstring& getFile() const { return m_strFile; }
+	uint64_t getContentSize() const { return m_iContentSize; }
+
+private: // Methods
+
+	bool readContentHash(const unsigned char* szData, size_t iSize, uint64_t& iContentHash) const;
+	bool isCurrent(const unsigned char* szData, size_t iSize) const;
+	bool readDirectory(const unsigned char* szData, size_t iSize, bool bModelData, uint64_t& iCityModelOffset, uint64_t& iCityModelSize);
+	void writeDirectory(_binary_writer& writer) const;
+
+	static void writeSite(_binary_writer& writer, const _city_site& site);
+	static void readSite(_binary_reader& reader, _city_site& site);
+	static void writeObject(_binary_writer& writer, const _city_object* pObject);
+	static bool readObject(_binary_reader& reader, _city_model* pCityModel);
+	static void writeLOD(_binary_writer& writer, const _city_lod& lod);
+	static bool readLOD(_binary_reader& reader, const _city_model* pCityModel, _city_lod& lod);
+	static void writeGeometryBuffer(_binary_writer& writer, const _geometry_buffer& geometryBuffer);
+	static void readGeometryBuffer(_binary_reader& reader, _geometry_buffer& geometryBuffer);
+
+	static uint64_t hashContent(const unsigned char* szData, size_t iSize);
+};
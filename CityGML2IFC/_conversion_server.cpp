@@ -0,0 +1,790 @@
+#include "pch.h"
+#include "_conversion_server.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <cwctype>
+#include <algorithm>
+
+#ifdef _WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+// ************************************************************************************************
+// Latency percentiles window
+#define LATENCIES_COUNT 1024
+
+// ************************************************************************************************
+// Memory estimates; the defaults are replaced by the measurements
+#define MEMORY_OVERHEAD (32 * 1024 * 1024) // Per job: exporter, schemas, buffers
+#define CITYGML_BYTES_PER_INPUT_BYTE 8.
+#define CITYJSON_BYTES_PER_INPUT_BYTE 20. // Shared vertices, i.e. a denser input
+#define CALIBRATION_WEIGHT 0.3 // Of the last measurement
+#define ESTIMATE_MARGIN 1.25
+
+// ************************************************************************************************
+static double getElapsed(const chrono::steady_clock::time_point& tpStart, const chrono::steady_clock::time_point& tpEnd)
+{
+	return chrono::duration<double, milli>(tpEnd - tpStart).count();
+}
+
+// ************************************************************************************************
+_memory_estimator::_memory_estimator()
+	: m_mtx()
+	, m_arBytesPerInputByte()
+	, m_arSamplesCount()
+{
+	m_arBytesPerInputByte[(int)enumInputFormat::CityGML] = CITYGML_BYTES_PER_INPUT_BYTE;
+	m_arBytesPerInputByte[(int)enumInputFormat::CityJSON] = CITYJSON_BYTES_PER_INPUT_BYTE;
+}
+
+/*virtual*/ _memory_estimator::~_memory_estimator()
+{
+}
+
+int64_t _memory_estimator::estimate(enumInputFormat enInputFormat, int64_t iInputSize)
+{
+	lock_guard<mutex> lock(m_mtx);
+
+	return MEMORY_OVERHEAD + (int64_t)(m_arBytesPerInputByte[(int)enInputFormat] * ESTIMATE_MARGIN * max<int64_t>(iInputSize, 0));
+}
+
+void _memory_estimator::calibrate(enumInputFormat enInputFormat, int64_t iInputSize, int64_t iMeasuredMemory)
+{
+	if ((iInputSize <= 0) || (iMeasuredMemory <= MEMORY_OVERHEAD))
+	{
+		return;
+	}
+
+	double dBytesPerInputByte = (double)(iMeasuredMemory - MEMORY_OVERHEAD) / (double)iInputSize;
+
+	lock_guard<mutex> lock(m_mtx);
+
+	double& dCurrent = m_arBytesPerInputByte[(int)enInputFormat];
+	dCurrent = m_arSamplesCount[(int)enInputFormat] == 0 ?
+		dBytesPerInputByte :
+		(CALIBRATION_WEIGHT * dBytesPerInputByte) + ((1. - CALIBRATION_WEIGHT) * dCurrent);
+
+	m_arSamplesCount[(int)enInputFormat]++;
+}
+
+double _memory_estimator::getBytesPerInputByte(enumInputFormat enInputFormat)
+{
+	lock_guard<mutex> lock(m_mtx);
+
+	return m_arBytesPerInputByte[(int)enInputFormat];
+}
+
+/*static*/ enumInputFormat _memory_estimator::getInputFormat(const wstring& strInputFile)
+{
+	size_t iExtension = strInputFile.find_last_of(L'.');
+	if (iExtension == wstring::npos)
+	{
+		return enumInputFormat::CityGML;
+	}
+
+	wstring strExtension = strInputFile.substr(iExtension);
+	transform(strExtension.begin(), strExtension.end(), strExtension.begin(), ::towlower);
+
+	return (strExtension == L".json") || (strExtension == L".cityjson") ? enumInputFormat::CityJSON : enumInputFormat::CityGML;
+}
+
+// ************************************************************************************************
+/*static*/ _conversion_server* _conversion_server::s_pServer = nullptr;
+/*static*/ mutex _conversion_server::s_mtxLog;
+
+_conversion_server::_conversion_server(const wstring& strRootFolder, int iWorkersCount, size_t iQueueCapacity, int64_t iMemoryBudget, int iInputFD, int iOutputFD)
+	: m_strRootFolder(strRootFolder)
+	, m_iWorkersCount(max(iWorkersCount, 1))
+	, m_iQueueCapacity(max<size_t>(iQueueCapacity, 1))
+	, m_iMemoryBudget(max<int64_t>(iMemoryBudget, 0))
+	, m_iInputFD(iInputFD)
+	, m_pOutputStream(new _fd_output_stream(iOutputFD))
+	, m_mtxOutput()
+	, m_pEnvironment(nullptr)
+	, m_mtx()
+	, m_cvJobs()
+	, m_cvSpace()
+	, m_dqJobs()
+	, m_vecWorkers()
+	, m_bStopping(false)
+	, m_memoryEstimator()
+	, m_iReservedMemory(0)
+	, m_iJobsReceived(0)
+	, m_iJobsSucceeded(0)
+	, m_iJobsFailed(0)
+	, m_iBusyWorkers(0)
+	, m_iJobsStarted(0)
+	, m_iMaxQueueDepth(0)
+	, m_vecLatencies()
+	, m_iNextLatency(0)
+{
+	assert(s_pServer == nullptr);
+	s_pServer = this;
+
+	m_vecLatencies.reserve(LATENCIES_COUNT);
+}
+
+/*virtual*/ _conversion_server::~_conversion_server()
+{
+	assert(m_vecWorkers.empty());
+	assert(m_dqJobs.empty());
+
+	delete m_pOutputStream;
+
+	s_pServer = nullptr;
+}
+
+int _conversion_server::run()
+{
+	auto tpStart = chrono::steady_clock::now();
+
+	bool bCreated = false;
+	m_pEnvironment = _conversion_environment::acquire(m_strRootFolder, logCallback, bCreated);
+	assert(m_pEnvironment != nullptr);
+
+	for (auto& prMessage : m_pEnvironment->getSettingsProvider()->getLoadMessages())
+	{
+		logCallback(prMessage.first, prMessage.second.c_str());
+	}
+
+	if (!m_pOutputStream->begin())
+	{
+		_conversion_environment::release(m_pEnvironment);
+		m_pEnvironment = nullptr;
+
+		return 1;
+	}
+
+	writeLine(_string::format(
+		"{\"event\": \"ready\", \"workers\": %d, \"queue_capacity\": %d, \"memory_budget_mb\": %.1f, \"startup_ms\": %.3f, \"settings_ms\": %.3f}",
+		m_iWorkersCount,
+		(int)m_iQueueCapacity,
+		m_iMemoryBudget / 1048576.,
+		getElapsed(tpStart, chrono::steady_clock::now()),
+		m_pEnvironment->getLoadTime()));
+
+	for (int iWorker = 0; iWorker < m_iWorkersCount; iWorker++)
+	{
+		m_vecWorkers.push_back(new thread(&_conversion_server::work, this));
+	}
+
+	string strBuffer;
+	string strLine;
+	while (readLine(strLine, strBuffer))
+	{
+		if (strLine.find_first_not_of(" \t\r") == string::npos)
+		{
+			continue;
+		}
+
+		onRequest(strLine);
+
+		// "shutdown"
+		lock_guard<mutex> lock(m_mtx);
+		if (m_bStopping)
+		{
+			break;
+		}
+	} // while (readLine(...
+
+	// Drain
+	{
+		lock_guard<mutex> lock(m_mtx);
+		m_bStopping = true;
+	}
+	m_cvJobs.notify_all();
+
+	for (auto pWorker : m_vecWorkers)
+	{
+		pWorker->join();
+		delete pWorker;
+	}
+	m_vecWorkers.clear();
+
+	writeLine(getStats());
+
+	m_pOutputStream->end();
+
+	_conversion_environment::release(m_pEnvironment);
+	m_pEnvironment = nullptr;
+
+	return m_pOutputStream->isFailed() ? 1 : 0;
+}
+
+void _conversion_server::work()
+{
+	while (true)
+	{
+		_conversion_job* pJob = nullptr;
+
+		{
+			unique_lock<mutex> lock(m_mtx);
+			m_cvJobs.wait(lock, [this] { return canStart() || (m_dqJobs.empty() && m_bStopping); });
+
+			if (m_dqJobs.empty())
+			{
+				break;
+			}
+
+			pJob = m_dqJobs.front();
+			m_dqJobs.pop_front();
+
+			m_iBusyWorkers++;
+			m_iJobsStarted++;
+			m_iReservedMemory += pJob->m_iEstimatedMemory;
+		}
+		m_cvSpace.notify_one();
+
+		execute(pJob);
+
+		{
+			lock_guard<mutex> lock(m_mtx);
+			m_iBusyWorkers--;
+			m_iReservedMemory -= pJob->m_iEstimatedMemory;
+		}
+
+		// The released memory can start several jobs
+		m_cvJobs.notify_all();
+
+		delete pJob;
+	} // while (true)
+}
+
+void _conversion_server::execute(_conversion_job* pJob)
+{
+	assert(pJob != nullptr);
+
+	auto tpStart = chrono::steady_clock::now();
+
+	// The rates are calibrated by the jobs that no other job overlaps
+	bool bAlone = false;
+	int64_t iJobsStarted = 0;
+	{
+		lock_guard<mutex> lock(m_mtx);
+
+		bAlone = m_iBusyWorkers == 1;
+		iJobsStarted = m_iJobsStarted;
+	}
+
+	int64_t iStartRSS = _allocations::getCurrentRSS();
+	int64_t iStartPeakRSS = _allocations::getPeakRSS();
+
+	int64_t iMeasuredMemory = 0;
+	double dImportTime = 0.;
+	double dExportTime = 0.;
+	{
+		// The exporter and its chunks/threads log in the context of the job
+		_log_context_scope logContext(pJob);
+
+		_gml2ifc_exporter exporter(m_strRootFolder, logCallback, nullptr);
+		exporter.getMetrics()->setAllocations(true);
+
+		exporter.importGML(pJob->m_strInputFile);
+
+		auto tpImport = chrono::steady_clock::now();
+		dImportTime = getElapsed(tpStart, tpImport);
+
+		exporter.exportAsIFC(!pJob->m_strTargetLODs.empty() ? pJob->m_strTargetLODs.c_str() : nullptr, pJob->m_strOutputFile);
+
+		dExportTime = getElapsed(tpImport, chrono::steady_clock::now());
+
+		// The high-water mark of the process if the job raised it, otherwise the RSS sampled at the end
+		// of the phases; includes the growth caused by the concurrent jobs (not calibrated)
+		int64_t iPeakRSS = _allocations::getPeakRSS();
+		if (iPeakRSS <= iStartPeakRSS)
+		{
+			iPeakRSS = exporter.getMetrics()->getPhaseAllocations()->getSampledRSS();
+		}
+
+		iMeasuredMemory = max<int64_t>(iPeakRSS - iStartRSS, 0);
+	}
+
+	{
+		lock_guard<mutex> lock(m_mtx);
+
+		bAlone = bAlone && (m_iBusyWorkers == 1) && (m_iJobsStarted == iJobsStarted);
+	}
+
+	auto tpEnd = chrono::steady_clock::now();
+
+	// An incomplete file is removed
+	int64_t iOutputSize = _mapped_file::getFileSize(pJob->m_strOutputFile);
+	bool bSucceeded = (pJob->m_iErrorsCount == 0) && (iOutputSize > 0);
+
+	if (bSucceeded && bAlone)
+	{
+		m_memoryEstimator.calibrate(pJob->m_enInputFormat, pJob->m_iInputSize, iMeasuredMemory);
+	}
+
+	double dQueueTime = getElapsed(pJob->m_tpQueued, tpStart);
+	double dTotalTime = getElapsed(pJob->m_tpQueued, tpEnd);
+
+	{
+		lock_guard<mutex> lock(m_mtx);
+
+		if (bSucceeded)
+		{
+			m_iJobsSucceeded++;
+		}
+		else
+		{
+			m_iJobsFailed++;
+		}
+
+		if (m_vecLatencies.size() < LATENCIES_COUNT)
+		{
+			m_vecLatencies.push_back(dTotalTime);
+		}
+		else
+		{
+			m_vecLatencies[m_iNextLatency] = dTotalTime;
+		}
+		m_iNextLatency = (m_iNextLatency + 1) % LATENCIES_COUNT;
+	}
+
+	writeLine(_string::format(
+		"{\"id\": \"%s\", \"status\": \"%s\", \"output\": \"%s\", \"bytes\": %lld, \"queue_ms\": %.3f, \"import_ms\": %.3f, \"export_ms\": %.3f, \"total_ms\": %.3f, \"estimated_mb\": %.1f, \"measured_mb\": %.1f, \"warnings\": %d, \"errors\": %d, \"message\": \"%s\"}",
+		escape(pJob->m_strId).c_str(),
+		bSucceeded ? "ok" : "failed",
+		escape(pJob->m_strOutputFileUTF8).c_str(),
+		(long long)max<int64_t>(iOutputSize, 0),
+		dQueueTime,
+		dImportTime,
+		dExportTime,
+		dTotalTime,
+		pJob->m_iEstimatedMemory / 1048576.,
+		iMeasuredMemory / 1048576.,
+		pJob->m_iWarningsCount,
+		pJob->m_iErrorsCount,
+		escape(!bSucceeded && pJob->m_strLastError.empty() ? "No output." : pJob->m_strLastError).c_str()));
+}
+
+void _conversion_server::onRequest(const string& strLine)
+{
+	map<string, string> mapValues;
+	if (!parseObject(strLine, mapValues))
+	{
+		writeLine("{\"status\": \"rejected\", \"message\": \"Invalid JSON object.\"}");
+
+		return;
+	}
+
+	auto itCommand = mapValues.find("command");
+	if (itCommand != mapValues.end())
+	{
+		if (itCommand->second == "stats")
+		{
+			writeLine(getStats());
+		}
+		else if (itCommand->second == "shutdown")
+		{
+			lock_guard<mutex> lock(m_mtx);
+			m_bStopping = true;
+		}
+		else
+		{
+			writeLine(_string::format("{\"status\": \"rejected\", \"message\": \"Unknown command: '%s'.\"}", escape(itCommand->second).c_str()));
+		}
+
+		return;
+	}
+
+	auto pJob = new _conversion_job();
+	pJob->m_strId = mapValues["id"];
+	pJob->m_strInputFile = utf8_to_wstring(mapValues["input"].c_str());
+	pJob->m_strOutputFileUTF8 = mapValues["output"];
+	pJob->m_strOutputFile = utf8_to_wstring(pJob->m_strOutputFileUTF8.c_str());
+	pJob->m_strTargetLODs = mapValues["lods"];
+	pJob->m_enInputFormat = _memory_estimator::getInputFormat(pJob->m_strInputFile);
+	pJob->m_iInputSize = max<int64_t>(_mapped_file::getFileSize(pJob->m_strInputFile), 0);
+	pJob->m_iEstimatedMemory = m_memoryEstimator.estimate(pJob->m_enInputFormat, pJob->m_iInputSize);
+
+	if (pJob->m_strInputFile.empty() || pJob->m_strOutputFile.empty())
+	{
+		writeLine(_string::format("{\"id\": \"%s\", \"status\": \"rejected\", \"message\": \"'input' and 'output' are required.\"}", escape(pJob->m_strId).c_str()));
+		delete pJob;
+
+		return;
+	}
+
+	// Backpressure: the input is not read while the queue is full
+	unique_lock<mutex> lock(m_mtx);
+	m_cvSpace.wait(lock, [this] { return m_dqJobs.size() < m_iQueueCapacity; });
+
+	pJob->m_tpQueued = chrono::steady_clock::now();
+
+	// Largest first - no long tail; FIFO for the same estimate
+	auto itJob = find_if(m_dqJobs.begin(), m_dqJobs.end(), [pJob](const _conversion_job* pQueuedJob)
+		{
+			return pQueuedJob->m_iEstimatedMemory < pJob->m_iEstimatedMemory;
+		});
+	m_dqJobs.insert(itJob, pJob);
+
+	m_iJobsReceived++;
+	m_iMaxQueueDepth = max(m_iMaxQueueDepth, m_dqJobs.size());
+
+	lock.unlock();
+	m_cvJobs.notify_one();
+}
+
+bool _conversion_server::readLine(string& strLine, string& strBuffer)
+{
+	while (true)
+	{
+		size_t iEnd = strBuffer.find('\n');
+		if (iEnd != string::npos)
+		{
+			strLine = strBuffer.substr(0, iEnd);
+			strBuffer.erase(0, iEnd + 1);
+
+			return true;
+		}
+
+		char szData[4096];
+#ifdef _WINDOWS
+		int iResult = ::_read(m_iInputFD, szData, sizeof(szData));
+#else
+		ssize_t iResult = ::read(m_iInputFD, szData, sizeof(szData));
+#endif
+		if (iResult < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return false;
+		}
+
+		if (iResult == 0)
+		{
+			// The last line without '\n'
+			strLine = strBuffer;
+			strBuffer.clear();
+
+			return !strLine.empty();
+		}
+
+		strBuffer.append(szData, (size_t)iResult);
+	} // while (true)
+}
+
+void _conversion_server::writeLine(const string& strLine)
+{
+	lock_guard<mutex> lock(m_mtxOutput);
+
+	string strData = strLine;
+	strData += "\n";
+
+	m_pOutputStream->append((const unsigned char*)strData.c_str(), (int64_t)strData.size());
+}
+
+string _conversion_server::getStats()
+{
+	lock_guard<mutex> lock(m_mtx);
+
+	vector<double> vecLatencies = m_vecLatencies;
+	sort(vecLatencies.begin(), vecLatencies.end());
+
+	auto getPercentile = [&vecLatencies](double dPercentile)
+	{
+		if (vecLatencies.empty())
+		{
+			return 0.;
+		}
+
+		size_t iIndex = (size_t)(dPercentile * (vecLatencies.size() - 1) + 0.5);
+
+		return vecLatencies[min(iIndex, vecLatencies.size() - 1)];
+	};
+
+	return _string::format(
+		"{\"event\": \"stats\", \"received\": %lld, \"succeeded\": %lld, \"failed\": %lld, \"queue_depth\": %d, \"max_queue_depth\": %d, \"workers\": %d, \"busy\": %d, \"memory_budget_mb\": %.1f, \"reserved_mb\": %.1f, \"citygml_bytes_per_byte\": %.2f, \"cityjson_bytes_per_byte\": %.2f, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}",
+		(long long)m_iJobsReceived,
+		(long long)m_iJobsSucceeded,
+		(long long)m_iJobsFailed,
+		(int)m_dqJobs.size(),
+		(int)m_iMaxQueueDepth,
+		m_iWorkersCount,
+		m_iBusyWorkers,
+		m_iMemoryBudget / 1048576.,
+		m_iReservedMemory / 1048576.,
+		m_memoryEstimator.getBytesPerInputByte(enumInputFormat::CityGML),
+		m_memoryEstimator.getBytesPerInputByte(enumInputFormat::CityJSON),
+		getPercentile(0.50),
+		getPercentile(0.95),
+		getPercentile(0.99),
+		!vecLatencies.empty() ? vecLatencies.back() : 0.);
+}
+
+// Under m_mtx
+bool _conversion_server::canStart() const
+{
+	if (m_dqJobs.empty())
+	{
+		return false;
+	}
+
+	if ((m_iMemoryBudget == 0) || (m_iReservedMemory == 0))
+	{
+		return true;
+	}
+
+	return m_iReservedMemory + m_dqJobs.front()->m_iEstimatedMemory <= m_iMemoryBudget;
+}
+
+// A flat object; the values are strings, numbers or literals (as text)
+/*static*/ bool _conversion_server::parseObject(const string& strLine, map<string, string>& mapValues)
+{
+	size_t iPosition = 0;
+
+	auto skipSpaces = [&]()
+	{
+		while ((iPosition < strLine.size()) && isspace((unsigned char)strLine[iPosition]))
+		{
+			iPosition++;
+		}
+	};
+
+	auto parseString = [&](string& strValue)
+	{
+		assert(strLine[iPosition] == '"');
+		iPosition++;
+
+		while (iPosition < strLine.size())
+		{
+			char chCurrent = strLine[iPosition++];
+			if (chCurrent == '"')
+			{
+				return true;
+			}
+
+			if (chCurrent != '\\')
+			{
+				strValue += chCurrent;
+
+				continue;
+			}
+
+			if (iPosition >= strLine.size())
+			{
+				return false;
+			}
+
+			chCurrent = strLine[iPosition++];
+			switch (chCurrent)
+			{
+				case 'b': strValue += '\b'; break;
+				case 'f': strValue += '\f'; break;
+				case 'n': strValue += '\n'; break;
+				case 'r': strValue += '\r'; break;
+				case 't': strValue += '\t'; break;
+				case 'u':
+				{
+					if (iPosition + 4 > strLine.size())
+					{
+						return false;
+					}
+
+					uint32_t iCodePoint = (uint32_t)strtoul(strLine.substr(iPosition, 4).c_str(), nullptr, 16);
+					iPosition += 4;
+
+					// Surrogate pair
+					if ((iCodePoint >= 0xD800) && (iCodePoint <= 0xDBFF) &&
+						(iPosition + 6 <= strLine.size()) && (strLine[iPosition] == '\\') && (strLine[iPosition + 1] == 'u'))
+					{
+						uint32_t iLow = (uint32_t)strtoul(strLine.substr(iPosition + 2, 4).c_str(), nullptr, 16);
+						if ((iLow >= 0xDC00) && (iLow <= 0xDFFF))
+						{
+							iCodePoint = 0x10000 + ((iCodePoint - 0xD800) << 10) + (iLow - 0xDC00);
+							iPosition += 6;
+						}
+					}
+
+					if (iCodePoint < 0x80)
+					{
+						strValue += (char)iCodePoint;
+					}
+					else if (iCodePoint < 0x800)
+					{
+						strValue += (char)(0xC0 | (iCodePoint >> 6));
+						strValue += (char)(0x80 | (iCodePoint & 0x3F));
+					}
+					else if (iCodePoint < 0x10000)
+					{
+						strValue += (char)(0xE0 | (iCodePoint >> 12));
+						strValue += (char)(0x80 | ((iCodePoint >> 6) & 0x3F));
+						strValue += (char)(0x80 | (iCodePoint & 0x3F));
+					}
+					else
+					{
+						strValue += (char)(0xF0 | (iCodePoint >> 18));
+						strValue += (char)(0x80 | ((iCodePoint >> 12) & 0x3F));
+						strValue += (char)(0x80 | ((iCodePoint >> 6) & 0x3F));
+						strValue += (char)(0x80 | (iCodePoint & 0x3F));
+					}
+				}
+				break;
+
+				default:
+					strValue += chCurrent; // " \ /
+			} // switch (chCurrent)
+		} // while (iPosition < ...
+
+		return false;
+	};
+
+	skipSpaces();
+	if ((iPosition >= strLine.size()) || (strLine[iPosition++] != '{'))
+	{
+		return false;
+	}
+
+	skipSpaces();
+	if ((iPosition < strLine.size()) && (strLine[iPosition] == '}'))
+	{
+		return true;
+	}
+
+	while (iPosition < strLine.size())
+	{
+		skipSpaces();
+
+		string strKey;
+		if ((iPosition >= strLine.size()) || (strLine[iPosition] != '"') || !parseString(strKey))
+		{
+			return false;
+		}
+
+		skipSpaces();
+		if ((iPosition >= strLine.size()) || (strLine[iPosition++] != ':'))
+		{
+			return false;
+		}
+
+		skipSpaces();
+		if (iPosition >= strLine.size())
+		{
+			return false;
+		}
+
+		string strValue;
+		if (strLine[iPosition] == '"')
+		{
+			if (!parseString(strValue))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			size_t iEnd = strLine.find_first_of(",}", iPosition);
+			if (iEnd == string::npos)
+			{
+				return false;
+			}
+
+			strValue = strLine.substr(iPosition, iEnd - iPosition);
+			strValue.erase(strValue.find_last_not_of(" \t\r") + 1);
+
+			iPosition = iEnd;
+		}
+
+		mapValues[strKey] = strValue;
+
+		skipSpaces();
+		if (iPosition >= strLine.size())
+		{
+			return false;
+		}
+
+		char chSeparator = strLine[iPosition++];
+		if (chSeparator == '}')
+		{
+			return true;
+		}
+
+		if (chSeparator != ',')
+		{
+			return false;
+		}
+	} // while (iPosition < ...
+
+	return false;
+}
+
+/*static*/ string _conversion_server::escape(const string& strValue)
+{
+	string strEscaped;
+	strEscaped.reserve(strValue.size());
+
+	for (unsigned char chCurrent : strValue)
+	{
+		switch (chCurrent)
+		{
+			case '"': strEscaped += "\\\""; break;
+			case '\\': strEscaped += "\\\\"; break;
+			case '\n': strEscaped += "\\n"; break;
+			case '\r': strEscaped += "\\r"; break;
+			case '\t': strEscaped += "\\t"; break;
+			default:
+			{
+				if (chCurrent < 0x20)
+				{
+					strEscaped += _string::format("\\u%04x", (int)chCurrent);
+				}
+				else
+				{
+					strEscaped += (char)chCurrent;
+				}
+			}
+		} // switch (chCurrent)
+	} // for (unsigned char chCurrent ...
+
+	return strEscaped;
+}
+
+// stdout is reserved for the results; the events of a job are counted (see _log_context_scope)
+/*static*/ void STDCALL _conversion_server::logCallback(enumLogEvent enLogEvent, const char* szEvent)
+{
+	const char* szType = "Information";
+
+	auto pJob = (_conversion_job*)_log_pipeline::getCurrentContext();
+	if (pJob != nullptr)
+	{
+		lock_guard<mutex> lock(s_mtxLog);
+
+		if (enLogEvent == enumLogEvent::warning)
+		{
+			pJob->m_iWarningsCount++;
+			szType = "Warning";
+		}
+		else if (enLogEvent == enumLogEvent::error)
+		{
+			pJob->m_iErrorsCount++;
+			pJob->m_strLastError = szEvent != nullptr ? szEvent : "";
+			szType = "Error";
+		}
+
+		fprintf(stderr, "[%s] %s: %s\n", pJob->m_strId.c_str(), szType, szEvent != nullptr ? szEvent : "");
+	}
+	else
+	{
+		if (enLogEvent == enumLogEvent::warning)
+		{
+			szType = "Warning";
+		}
+		else if (enLogEvent == enumLogEvent::error)
+		{
+			szType = "Error";
+		}
+
+		fprintf(stderr, "%s: %s\n", szType, szEvent != nullptr ? szEvent : "");
+	}
+}
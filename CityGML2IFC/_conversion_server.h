@@ -0,0 +1,165 @@
+#pragma once
+
+#include "_gml2ifc.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+using namespace std;
+
+// ************************************************************************************************
+enum class enumInputFormat : int
+{
+	CityGML = 0,
+	CityJSON,
+	count,
+};
+
+// ************************************************************************************************
+// Conversion memory ~ OWL model + SDAI model ~ input size; a fixed overhead + bytes per input byte
+// by format, calibrated with the peak RSS growth of the jobs that ran alone (moving average), i.e. the
+// engine's heap included; a job within the overhead doesn't tell the rate
+class _memory_estimator
+{
+
+private: // Members
+
+	mutex m_mtx;
+	double m_arBytesPerInputByte[(int)enumInputFormat::count];
+	int64_t m_arSamplesCount[(int)enumInputFormat::count];
+
+public: // Methods
+
+	_memory_estimator();
+	virtual ~_memory_estimator();
+
+	int64_t estimate(enumInputFormat enInputFormat, int64_t iInputSize);
+	void calibrate(enumInputFormat enInputFormat, int64_t iInputSize, int64_t iMeasuredMemory);
+
+	double getBytesPerInputByte(enumInputFormat enInputFormat);
+	static enumInputFormat getInputFormat(const wstring& strInputFile);
+};
+
+// ************************************************************************************************
+class _conversion_job
+{
+
+public: // Members
+
+	string m_strId;
+	wstring m_strInputFile;
+	wstring m_strOutputFile;
+	string m_strOutputFileUTF8;
+	string m_strTargetLODs;
+	chrono::steady_clock::time_point m_tpQueued;
+
+	// Memory
+	enumInputFormat m_enInputFormat;
+	int64_t m_iInputSize;
+	int64_t m_iEstimatedMemory;
+
+	// Log
+	int m_iWarningsCount;
+	int m_iErrorsCount;
+	string m_strLastError;
+
+public: // Methods
+
+	_conversion_job()
+		: m_strId()
+		, m_strInputFile()
+		, m_strOutputFile()
+		, m_strOutputFileUTF8()
+		, m_strTargetLODs()
+		, m_tpQueued()
+		, m_enInputFormat(enumInputFormat::CityGML)
+		, m_iInputSize(0)
+		, m_iEstimatedMemory(0)
+		, m_iWarningsCount(0)
+		, m_iErrorsCount(0)
+		, m_strLastError()
+	{}
+
+	virtual ~_conversion_job()
+	{}
+};
+
+// ************************************************************************************************
+// Long-running conversion service: newline-delimited JSON jobs are read from a descriptor (stdin)
+// and a JSON line per job is written to another one (stdout); the settings and the GIS options stay
+// loaded (_conversion_environment) and the jobs run on a bounded pool of workers
+//	{"id": "1", "input": "/tiles/a.gml", "output": "/out/a.ifc", "lods": "HIGHEST_LOD"}
+//	{"command": "stats"}
+//	{"command": "shutdown"}
+// With a memory budget a job is started only if its estimate fits next to the running ones (a job
+// larger than the budget runs alone); the largest queued job goes first and is not bypassed.
+// The events of a job are told apart by the log context (the job, see _log_context_scope) on any
+// thread of its conversion; the log callback has no other context, i.e. a process runs a single server.
+class _conversion_server
+{
+
+private: // Members
+
+	wstring m_strRootFolder;
+	int m_iWorkersCount;
+	size_t m_iQueueCapacity;
+	int64_t m_iMemoryBudget; // bytes; 0 - unlimited
+	int m_iInputFD;
+	_fd_output_stream* m_pOutputStream;
+	mutex m_mtxOutput;
+
+	// Keeps the settings loaded between the jobs
+	_conversion_environment* m_pEnvironment;
+
+	// Queue
+	mutex m_mtx;
+	condition_variable m_cvJobs;
+	condition_variable m_cvSpace;
+	deque<_conversion_job*> m_dqJobs;
+	vector<thread*> m_vecWorkers;
+	bool m_bStopping;
+
+	// Memory
+	_memory_estimator m_memoryEstimator;
+	int64_t m_iReservedMemory; // Estimates of the running jobs
+
+	// Stats
+	int64_t m_iJobsReceived;
+	int64_t m_iJobsSucceeded;
+	int64_t m_iJobsFailed;
+	int m_iBusyWorkers;
+	int64_t m_iJobsStarted;
+	size_t m_iMaxQueueDepth;
+	vector<double> m_vecLatencies; // ms; the last LATENCIES_COUNT jobs, a ring
+	size_t m_iNextLatency;
+
+	static _conversion_server* s_pServer;
+	static mutex s_mtxLog; // The counters of the jobs
+
+public: // Methods
+
+	_conversion_server(const wstring& strRootFolder, int iWorkersCount, size_t iQueueCapacity, int64_t iMemoryBudget, int iInputFD, int iOutputFD);
+	virtual ~_conversion_server();
+
+	// Returns at the end of the input or on "shutdown", after the queued jobs are done
+	int run();
+
+private: // Methods
+
+	void work();
+	void execute(_conversion_job* pJob);
+	void onRequest(const string& strLine);
+	bool readLine(string& strLine, string& strBuffer);
+	void writeLine(const string& strLine);
+	string getStats();
+	bool canStart() const;
+
+	static bool parseObject(const string& strLine, map<string, string>& mapValues);
+	static string escape(const string& strValue);
+	static void STDCALL logCallback(enumLogEvent enLogEvent, const char* szEvent);
+};
@@ -0,0 +1,218 @@
+#include "pch.h"
+#include "_geometry_buffer.h"
+
+#include <cassert>
+
+// ************************************************************************************************
+_geometry_buffer::_geometry_buffer()
+	: m_vecGeometries()
+	, m_vecChildren()
+	, m_vecVertices()
+	, m_vecRingIndices()
+	, m_vecRingOffsets()
+	, m_vecFaceOffsets()
+	, m_vecPendingIndices()
+	, m_vecPendingFaces()
+	, m_vecMaterials()
+	, m_vecMatrices()
+	, m_vecRoots()
+	, m_vecRootOffsets()
+	, m_mapMappedItems()
+	, m_mapMaterials()
+	, m_iOwlNodesCount(0)
+{
+}
+
+/*virtual*/ _geometry_buffer::~_geometry_buffer()
+{
+}
+
+void _geometry_buffer::clear()
+{
+	m_vecGeometries.clear();
+	m_vecChildren.clear();
+	m_vecVertices.clear();
+	m_vecRingIndices.clear();
+	m_vecRingOffsets.clear();
+	m_vecFaceOffsets.clear();
+	m_vecPendingIndices.clear();
+	m_vecPendingFaces.clear();
+	m_vecMaterials.clear();
+	m_vecMatrices.clear();
+	m_vecRoots.clear();
+	m_vecRootOffsets.clear();
+	m_mapMappedItems.clear();
+	m_mapMaterials.clear();
+	m_iOwlNodesCount = 0;
+}
+
+int64_t _geometry_buffer::addGeometry(enumGeometry enGeometry, OwlInstance iInstance)
+{
+	m_vecGeometries.push_back(_geometry(enGeometry, iInstance));
+
+	return (int64_t)m_vecGeometries.size() - 1;
+}
+
+int64_t _geometry_buffer::addVertices(const double* pdValues, int64_t iValuesCount)
+{
+	assert((pdValues != nullptr) || (iValuesCount == 0));
+	assert((iValuesCount % 3) == 0);
+
+	int64_t iFirstVertex = getVerticesCount();
+
+	m_vecVertices.insert(m_vecVertices.end(), pdValues, pdValues + iValuesCount);
+
+	return iFirstVertex;
+}
+
+void _geometry_buffer::addFaces(int64_t iGeometry, const int64_t* piIndices, int64_t iIndicesCount, int64_t iFirstVertex)
+{
+	assert((iGeometry >= 0) && (iGeometry < getGeometriesCount()));
+	assert((piIndices != nullptr) || (iIndicesCount == 0));
+
+	m_vecPendingFaces.push_back(iGeometry);
+	m_vecPendingFaces.push_back((int64_t)m_vecPendingIndices.size());
+	m_vecPendingFaces.push_back(iIndicesCount);
+	m_vecPendingFaces.push_back(iFirstVertex);
+
+	m_vecPendingIndices.insert(m_vecPendingIndices.end(), piIndices, piIndices + iIndicesCount);
+}
+
+// The faces in the order of addFaces()
+void _geometry_buffer::buildFaces()
+{
+	for (size_t iPendingFaces = 0; iPendingFaces < m_vecPendingFaces.size(); iPendingFaces += 4)
+	{
+		auto& geometry = m_vecGeometries[m_vecPendingFaces[iPendingFaces]];
+		const int64_t* piIndices = m_vecPendingIndices.data() + m_vecPendingFaces[iPendingFaces + 1];
+		int64_t iIndicesCount = m_vecPendingFaces[iPendingFaces + 2];
+		int64_t iFirstVertex = m_vecPendingFaces[iPendingFaces + 3];
+
+		int64_t iFirstFace = getFacesCount();
+
+		// -1 - Outer Polygon; -2 - Inner Polygon of the last Outer Polygon
+		int64_t iFirstIndex = 0;
+		for (int64_t iIndex = 0; iIndex < iIndicesCount; iIndex++)
+		{
+			if (piIndices[iIndex] >= 0)
+			{
+				continue;
+			}
+
+			assert((piIndices[iIndex] == -1) || (piIndices[iIndex] == -2));
+			assert((piIndices[iIndex] == -1) || (getFacesCount() > iFirstFace));
+
+			addRing(
+				piIndices + iFirstIndex,
+				iIndex - iFirstIndex,
+				iFirstVertex,
+				(piIndices[iIndex] == -1) || (getFacesCount() == iFirstFace));
+
+			iFirstIndex = iIndex + 1;
+		} // for (int64_t iIndex = ...
+
+		assert(iFirstIndex == iIndicesCount);
+		assert(getFacesCount() > iFirstFace);
+
+		geometry.m_iFirst = iFirstFace;
+		geometry.m_iCount = getFacesCount() - iFirstFace;
+	} // for (size_t iPendingFaces = ...
+
+	m_vecPendingIndices.clear();
+	m_vecPendingFaces.clear();
+}
+
+void _geometry_buffer::addRing(const int64_t* piIndices, int64_t iIndicesCount, int64_t iFirstVertex, bool bOuter)
+{
+	assert(piIndices != nullptr);
+	assert(bOuter || !m_vecFaceOffsets.empty());
+
+	if (bOuter || m_vecFaceOffsets.empty())
+	{
+		m_vecFaceOffsets.push_back((int64_t)m_vecRingOffsets.size());
+	}
+
+	m_vecRingOffsets.push_back((int64_t)m_vecRingIndices.size());
+
+	for (int64_t iIndex = 0; iIndex < iIndicesCount; iIndex++)
+	{
+		m_vecRingIndices.push_back(iFirstVertex + piIndices[iIndex]);
+	}
+}
+
+void _geometry_buffer::addChildren(int64_t iGeometry, const vector<int64_t>& vecChildren)
+{
+	auto& geometry = m_vecGeometries[iGeometry];
+	assert(geometry.m_enGeometry == enumGeometry::MappedItem);
+
+	geometry.m_iFirst = (int64_t)m_vecChildren.size();
+	geometry.m_iCount = (int64_t)vecChildren.size();
+
+	m_vecChildren.insert(m_vecChildren.end(), vecChildren.begin(), vecChildren.end());
+}
+
+void _geometry_buffer::addRoots(const vector<int64_t>& vecRoots)
+{
+	m_vecRootOffsets.push_back((int64_t)m_vecRoots.size());
+
+	m_vecRoots.insert(m_vecRoots.end(), vecRoots.begin(), vecRoots.end());
+}
+
+int64_t _geometry_buffer::addMaterial(OwlInstance iMaterialInstance, const _geometry_material& material)
+{
+	assert(m_mapMaterials.find(iMaterialInstance) == m_mapMaterials.end());
+
+	m_vecMaterials.push_back(material);
+
+	int64_t iMaterial = (int64_t)m_vecMaterials.size() - 1;
+	m_mapMaterials[iMaterialInstance] = iMaterial;
+
+	return iMaterial;
+}
+
+int64_t _geometry_buffer::addMatrix(const double* pdValues)
+{
+	assert(pdValues != nullptr);
+
+	m_vecMatrices.insert(m_vecMatrices.end(), pdValues, pdValues + 12);
+
+	return (int64_t)m_vecMatrices.size() / 12 - 1;
+}
+
+int64_t _geometry_buffer::findMappedItem(OwlInstance iMappedGeometryInstance) const
+{
+	auto itMappedItem = m_mapMappedItems.find(iMappedGeometryInstance);
+
+	return itMappedItem != m_mapMappedItems.end() ? itMappedItem->second : -1;
+}
+
+int64_t _geometry_buffer::findMaterial(OwlInstance iMaterialInstance) const
+{
+	auto itMaterial = m_mapMaterials.find(iMaterialInstance);
+
+	return itMaterial != m_mapMaterials.end() ? itMaterial->second : -1;
+}
+
+void _geometry_buffer::getFaceRings(int64_t iFace, int64_t& iFirstRing, int64_t& iEndRing) const
+{
+	assert((iFace >= 0) && (iFace < getFacesCount()));
+
+	iFirstRing = m_vecFaceOffsets[iFace];
+	iEndRing = iFace + 1 < getFacesCount() ? m_vecFaceOffsets[iFace + 1] : (int64_t)m_vecRingOffsets.size();
+}
+
+void _geometry_buffer::getRingIndices(int64_t iRing, int64_t& iFirstIndex, int64_t& iEndIndex) const
+{
+	assert((iRing >= 0) && (iRing < (int64_t)m_vecRingOffsets.size()));
+
+	iFirstIndex = m_vecRingOffsets[iRing];
+	iEndIndex = iRing + 1 < (int64_t)m_vecRingOffsets.size() ? m_vecRingOffsets[iRing + 1] : (int64_t)m_vecRingIndices.size();
+}
+
+void _geometry_buffer::getRoots(int64_t iElementGeometry, int64_t& iFirstRoot, int64_t& iEndRoot) const
+{
+	assert((iElementGeometry >= 0) && (iElementGeometry < getRootsCount()));
+
+	iFirstRoot = m_vecRootOffsets[iElementGeometry];
+	iEndRoot = iElementGeometry + 1 < getRootsCount() ? m_vecRootOffsets[iElementGeometry + 1] : (int64_t)m_vecRoots.size();
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "../include/engine.h"
+
+#include <vector>
+#include <map>
+using namespace std;
+
+// ************************************************************************************************
+enum class enumGeometry : int
+{
+	BoundaryRepresentation = 0,
+	PolyLine,
+	MappedItem,
+};
+
+// ************************************************************************************************
+enum class enumGeometryMaterial : int
+{
+	Color = 0,
+	Default, // "Default Material"
+	Texture, // Not supported; the default material is used
+};
+
+// ************************************************************************************************
+// A material read from the OWL model; the overridden/default materials ($MATERIAL) are applied on export
+class _geometry_material
+{
+
+public: // Members
+
+	enumGeometryMaterial m_enMaterial;
+	double m_dR;
+	double m_dG;
+	double m_dB;
+	double m_dTransparency;
+
+public: // Methods
+
+	_geometry_material()
+		: m_enMaterial(enumGeometryMaterial::Default)
+		, m_dR(0.)
+		, m_dG(0.)
+		, m_dB(0.)
+		, m_dTransparency(0.)
+	{}
+
+	virtual ~_geometry_material()
+	{}
+};
+
+// ************************************************************************************************
+// A geometry read from the OWL model; the ranges index the arrays of _geometry_buffer
+class _geometry
+{
+
+public: // Members
+
+	enumGeometry m_enGeometry;
+	OwlInstance m_iInstance; // Id; MappedItem - Mapped geometry (the SDAI instances are shared)
+
+	// BoundaryRepresentation - Faces; PolyLine - Vertices; MappedItem - Children
+	int64_t m_iFirst;
+	int64_t m_iCount;
+
+	int64_t m_iMaterial; // BoundaryRepresentation
+	int64_t m_iMatrix; // MappedItem - Reference Point; the Transformation follows
+
+public: // Methods
+
+	_geometry(enumGeometry enGeometry, OwlInstance iInstance)
+		: m_enGeometry(enGeometry)
+		, m_iInstance(iInstance)
+		, m_iFirst(0)
+		, m_iCount(0)
+		, m_iMaterial(-1)
+		, m_iMatrix(-1)
+	{}
+
+	virtual ~_geometry()
+	{}
+};
+
+// ************************************************************************************************
+// The geometry of a Building/Feature copied from the OWL model; the SDAI instances are created from
+// it on the exporter's thread in a fixed order. Reading is in two steps: the engine data is copied
+// (addVertices(), addFaces(), ... - the engine access is serialized by the caller), buildFaces()
+// assembles the faces without the engine, i.e. on a worker thread.
+// Structure of arrays; a face is an outer ring followed by the inner ones.
+class _geometry_buffer
+{
+	friend class _city_model_cache; // Serialization
+
+private: // Members
+
+	// Geometries
+	vector<_geometry> m_vecGeometries;
+	vector<int64_t> m_vecChildren; // MappedItem : Geometries
+
+	// Faces
+	vector<double> m_vecVertices; // X, Y, Z
+	vector<int64_t> m_vecRingIndices; // Vertex
+	vector<int64_t> m_vecRingOffsets; // Ring : First index
+	vector<int64_t> m_vecFaceOffsets; // Face : First ring (outer)
+
+	// addFaces(); the indices as read (-1 - Outer Polygon, -2 - Inner Polygon), see buildFaces()
+	vector<int64_t> m_vecPendingIndices;
+	vector<int64_t> m_vecPendingFaces; // Geometry, First index, Indices count, First vertex
+
+	// Styles & Transformations
+	vector<_geometry_material> m_vecMaterials;
+	vector<double> m_vecMatrices; // 12 values per matrix (3 x 3 + origin)
+
+	// Element Geometry (in the reading order) : Geometries
+	vector<int64_t> m_vecRoots;
+	vector<int64_t> m_vecRootOffsets; // Element Geometry : First root
+
+	// Read once per buffer
+	map<OwlInstance, int64_t> m_mapMappedItems; // Mapped geometry : MappedItem
+	map<OwlInstance, int64_t> m_mapMaterials; // Material : Index
+
+	// Metrics
+	int64_t m_iOwlNodesCount;
+
+public: // Methods
+
+	_geometry_buffer();
+	virtual ~_geometry_buffer();
+
+	void clear(); // Keeps the capacity
+
+	// Reading
+	int64_t addGeometry(enumGeometry enGeometry, OwlInstance iInstance);
+	int64_t addVertices(const double* pdValues, int64_t iValuesCount); // First vertex
+	void addFaces(int64_t iGeometry, const int64_t* piIndices, int64_t iIndicesCount, int64_t iFirstVertex);
+	void buildFaces(); // No engine calls
+	void addChildren(int64_t iGeometry, const vector<int64_t>& vecChildren);
+	void addRoots(const vector<int64_t>& vecRoots);
+	int64_t addMaterial(OwlInstance iMaterialInstance, const _geometry_material& material);
+	int64_t addMatrix(const double* pdValues); // 12 values
+	void onOwlNode() { m_iOwlNodesCount++; }
+
+	// Geometries
+	_geometry& getGeometry(int64_t iGeometry) { return m_vecGeometries[iGeometry]; }
+	const _geometry& getGeometry(int64_t iGeometry) const { return m_vecGeometries[iGeometry]; }
+	int64_t getGeometriesCount() const { return (int64_t)m_vecGeometries.size(); }
+	int64_t getChild(int64_t iChild) const { return m_vecChildren[iChild]; }
+	int64_t findMappedItem(OwlInstance iMappedGeometryInstance) const; // -1 - not read
+	void setMappedItem(OwlInstance iMappedGeometryInstance, int64_t iGeometry) { m_mapMappedItems[iMappedGeometryInstance] = iGeometry; }
+	int64_t findMaterial(OwlInstance iMaterialInstance) const; // -1 - not read
+
+	// Styles & Transformations
+	const _geometry_material& getMaterial(int64_t iMaterial) const { return m_vecMaterials[iMaterial]; }
+	const double* getMatrix(int64_t iMatrix) const { return &m_vecMatrices[iMatrix * 12]; }
+
+	// Faces
+	const double* getVertex(int64_t iVertex) const { return &m_vecVertices[iVertex * 3]; }
+	int64_t getVerticesCount() const { return (int64_t)m_vecVertices.size() / 3; }
+	int64_t getFacesCount() const { return (int64_t)m_vecFaceOffsets.size(); }
+	void getFaceRings(int64_t iFace, int64_t& iFirstRing, int64_t& iEndRing) const;
+	void getRingIndices(int64_t iRing, int64_t& iFirstIndex, int64_t& iEndIndex) const;
+	int64_t getRingIndex(int64_t iIndex) const { return m_vecRingIndices[iIndex]; }
+
+	// Element Geometry
+	int64_t getRootsCount() const { return (int64_t)m_vecRootOffsets.size(); }
+	void getRoots(int64_t iElementGeometry, int64_t& iFirstRoot, int64_t& iEndRoot) const;
+	int64_t getRoot(int64_t iRoot) const { return m_vecRoots[iRoot]; }
+
+	// Metrics
+	int64_t getOwlNodesCount() const { return m_iOwlNodesCount; }
+
+private: // Methods
+
+	void addRing(const int64_t* piIndices, int64_t iIndicesCount, int64_t iFirstVertex, bool bOuter);
+};
@@ -1,38 +1,153 @@
 #include "pch.h"
 #include "_gml2ifc.h"
+#include "_gml_splitter.h"
 
 #include <float.h>
+#include <typeinfo>
 #include <locale>
 #include <codecvt>
 #include <cassert>
+#include <cwctype>
+#include <memory>
 
 // ************************************************************************************************
-_settings_provider::_settings_provider(_gml2ifc_exporter* pSite, const wstring& strSettingsFile)
-	: m_pSite(pSite)
-	, m_mapDefaultMaterials()
-	, m_mapOverriddenMaterials()
-{
-	assert(pSite != nullptr);
+// Engine calls accounting (see _engine_calls); counts and times the calls per calling method when
+// '$METRICS $ENGINE_CALLS ON' is set and counts the IFC entities produced per Building/Feature
+#define GetObjectProperty(...) _engine_calls::call(enumEngineCall::GetObjectProperty, __FUNCTION__, [&]() { return GetObjectProperty(__VA_ARGS__); })
+#define GetDatatypeProperty(...) _engine_calls::call(enumEngineCall::GetDatatypeProperty, __FUNCTION__, [&]() { return GetDatatypeProperty(__VA_ARGS__); })
+#define GetBoundingBox(...) _engine_calls::call(enumEngineCall::GetBoundingBox, __FUNCTION__, [&]() { return GetBoundingBox(__VA_ARGS__); })
+#define GetNameOfProperty(...) _engine_calls::call(enumEngineCall::GetNameOfProperty, __FUNCTION__, [&]() { return GetNameOfProperty(__VA_ARGS__); })
+#define SetCharacterSerialization(...) _engine_calls::call(enumEngineCall::SetCharacterSerialization, __FUNCTION__, [&]() { return SetCharacterSerialization(__VA_ARGS__); })
+#define sdaiCreateInstanceBN(...) _engine_calls::call(enumEngineCall::sdaiCreateInstanceBN, __FUNCTION__, [&]() { return _metrics::onIfcEntity(sdaiCreateInstanceBN(__VA_ARGS__)); })
+#define sdaiPutAttrBN(...) _engine_calls::call(enumEngineCall::sdaiPutAttrBN, __FUNCTION__, [&]() { return sdaiPutAttrBN(__VA_ARGS__); })
+#define sdaiAppend(...) _engine_calls::call(enumEngineCall::sdaiAppend, __FUNCTION__, [&]() { return sdaiAppend(__VA_ARGS__); })
+
+// ************************************************************************************************
+// Progress callback rate
+#define PROGRESS_INTERVAL 100 // ms
 
+// ************************************************************************************************
+_settings_provider::_settings_provider(const wstring& strSettingsFile)
+	: m_vecLoadMessages()
+	, m_iSettingsHash(14695981039346656037ULL)
+	, m_vecMaterials()
+	, m_vecDefaultMaterials((size_t)enumMaterialEntity::Count, -1)
+	, m_vecOverriddenMaterials((size_t)enumMaterialEntity::Count, -1)
+	, m_vecProperties()
+	, m_mapProperties()
+	, m_mtxDynamicProperties()
+	, m_dqDynamicProperties()
+	, m_mapDynamicProperties()
+	, m_enLogMinLevel(enumLogEvent::info)
+	, m_iLogRateLimit(0)
+	, m_bLogAsync(false)
+	, m_iMetricsTopObjectsCount(0)
+	, m_bMetricsEngineCalls(false)
+	, m_bMetricsAllocations(false)
+	, m_bImportMemoryMapped(false)
+	, m_iImportChunksCount(0)
+	, m_iImportChunkThreshold(256 * 1024 * 1024)
+	, m_iExportThreadsCount(0)
+	, m_bExportCache(false)
+{
 	loadSettings(strSettingsFile);
+	resolveMaterials();
 }
 
 /*virtual*/ _settings_provider::~_settings_provider()
 {
-	for (auto itMaterial : m_mapDefaultMaterials)
+}
+
+const _material* _settings_provider::getDefaultMaterial(enumMaterialEntity enEntity) const
+{
+	assert(enEntity < enumMaterialEntity::Count);
+
+	int iMaterial = m_vecDefaultMaterials[(int)enEntity];
+
+	return iMaterial != -1 ? &m_vecMaterials[iMaterial] : nullptr;
+}
+
+const _material* _settings_provider::getOverriddenMaterial(enumMaterialEntity enEntity) const
+{
+	assert(enEntity < enumMaterialEntity::Count);
+
+	int iMaterial = m_vecOverriddenMaterials[(int)enEntity];
+
+	return iMaterial != -1 ? &m_vecMaterials[iMaterial] : nullptr;
+}
+
+const _property* _settings_provider::getProperty(const string& strName)
+{
+	assert(!strName.empty());
+
+	auto itProperty = m_mapProperties.find(strName);
+	if (itProperty != m_mapProperties.end())
+	{
+		return &m_vecProperties[itProperty->second];
+	}
+
+	lock_guard<mutex> lock(m_mtxDynamicProperties);
+
+	itProperty = m_mapDynamicProperties.find(strName);
+	if (itProperty != m_mapDynamicProperties.end())
 	{
-		delete itMaterial.second;
+		return &m_dqDynamicProperties[itProperty->second - (int)m_vecProperties.size()];
 	}
 
-	for (auto itMaterial : m_mapOverriddenMaterials)
+	// deque - the references to the properties are stable
+	int iId = (int)(m_vecProperties.size() + m_dqDynamicProperties.size());
+	m_dqDynamicProperties.push_back(_property(iId, "", "set_BsAttributes&Properties", strName, strName));
+	m_mapDynamicProperties[strName] = iId;
+
+	return &m_dqDynamicProperties.back();
+}
+
+void _settings_provider::resolveMaterials()
+{
+	// $OVERRIDE, $DEFAULT, $DEFAULT $ALL
+	int iAllMaterial = m_vecDefaultMaterials[(int)enumMaterialEntity::All];
+
+	for (int iEntity = 0; iEntity < (int)enumMaterialEntity::Count; iEntity++)
 	{
-		delete itMaterial.second;
+		if (m_vecOverriddenMaterials[iEntity] != -1)
+		{
+			m_vecDefaultMaterials[iEntity] = m_vecOverriddenMaterials[iEntity];
+		}
+		else if (m_vecDefaultMaterials[iEntity] == -1)
+		{
+			m_vecDefaultMaterials[iEntity] = iAllMaterial;
+		}
 	}
+}
 
-	for (auto itProperty : m_mapProperties)
+/*static*/ bool _settings_provider::getMaterialEntity(const string& strEntity, enumMaterialEntity& enEntity)
+{
+	if (strEntity == "$WALL")
+	{
+		enEntity = enumMaterialEntity::Wall;
+	}
+	else if (strEntity == "$ROOF")
+	{
+		enEntity = enumMaterialEntity::Roof;
+	}
+	else if (strEntity == "$DOOR")
 	{
-		delete itProperty.second;
+		enEntity = enumMaterialEntity::Door;
 	}
+	else if (strEntity == "$WINDOW")
+	{
+		enEntity = enumMaterialEntity::Window;
+	}
+	else if (strEntity == "$ALL")
+	{
+		enEntity = enumMaterialEntity::All;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
 }
 
 void _settings_provider::loadSettings(const wstring& strSettingsFile)
@@ -60,6 +175,13 @@ void _settings_provider::loadSettings(const wstring& strSettingsFile)
 			continue;
 		}
 
+		for (auto ch : strLine)
+		{
+			m_iSettingsHash = (m_iSettingsHash ^ (unsigned char)ch) * 1099511628211ULL;
+		}
+
+		m_iSettingsHash = (m_iSettingsHash ^ '\n') * 1099511628211ULL;
+
 		string strSetting;
 		ssLine >> strSetting;
 		_string::trim(strSetting);
@@ -73,7 +195,7 @@ void _settings_provider::loadSettings(const wstring& strSettingsFile)
 
 			if (strValue != "1.0")
 			{
-				getSite()->logErr("Unknown version.");
+				logErr("Unknown version.");
 
 				return;
 			}
@@ -99,7 +221,7 @@ void _settings_provider::loadSettings(const wstring& strSettingsFile)
 
 				if (strEntity.empty() || strValue.empty())
 				{
-					getSite()->logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+					logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
 
 					return;
 				}
@@ -109,26 +231,35 @@ void _settings_provider::loadSettings(const wstring& strSettingsFile)
 
 				if (vecRGBA.size() != 4)
 				{
-					getSite()->logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+					logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
 
 					return;
 				}
 
 				_string::toUpper(strEntity);
 
-				auto& mapMaterials = (strType == "$DEFAULT") ? m_mapDefaultMaterials : m_mapOverriddenMaterials;
-				if (mapMaterials.find(strEntity) != mapMaterials.end())
+				enumMaterialEntity enEntity = enumMaterialEntity::All;
+				if (!getMaterialEntity(strEntity, enEntity))
+				{
+					logWarn(_string::format("Unknown material entity: '%s'", strEntity.c_str()).c_str());
+
+					continue;
+				}
+
+				auto& vecMaterials = (strType == "$DEFAULT") ? m_vecDefaultMaterials : m_vecOverriddenMaterials;
+				if (vecMaterials[(int)enEntity] != -1)
 				{
 					assert(false);
 
 					continue;
 				}
 
-				mapMaterials[strEntity] = new _material(vecRGBA);
+				vecMaterials[(int)enEntity] = (int)m_vecMaterials.size();
+				m_vecMaterials.push_back(_material(vecRGBA));
 			} // $DEFAULT, $OVERRIDE
 			else
 			{
-				getSite()->logErr("Unknown material type.");
+				logErr("Unknown material type.");
 
 				return;
 			}
@@ -155,164 +286,485 @@ void _settings_provider::loadSettings(const wstring& strSettingsFile)
 
 			if (strType.empty() || strPropertySet.empty() || strName.empty() || strOverrideName.empty())
 			{
-				getSite()->logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+				logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
 
 				return;
 			}
 
 			if (m_mapProperties.find(strName) != m_mapProperties.end())
 			{
-				getSite()->logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+				logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
 
 				return;
 			}
 
-			m_mapProperties[strName] = new _property(strType, strPropertySet, strName, strOverrideName);
+			m_mapProperties[strName] = (int)m_vecProperties.size();
+			m_vecProperties.push_back(_property((int)m_vecProperties.size(), strType, strPropertySet, strName, strOverrideName));
 
 			continue;
 		} // $PROPERTY
+		else if (strSetting == "$LOG")
+		{
+			string strType;
+			ssLine >> strType;
+			_string::trim(strType);
+
+			string strValue;
+			ssLine >> strValue;
+			_string::trim(strValue);
+
+			if (strType.empty() || strValue.empty())
+			{
+				logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+
+				return;
+			}
+
+			if (strType == "$LEVEL")
+			{
+				if (strValue == "INFO")
+				{
+					m_enLogMinLevel = enumLogEvent::info;
+				}
+				else if (strValue == "WARNING")
+				{
+					m_enLogMinLevel = enumLogEvent::warning;
+				}
+				else if (strValue == "ERROR")
+				{
+					m_enLogMinLevel = enumLogEvent::error;
+				}
+				else
+				{
+					logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+
+					return;
+				}
+			}
+			else if (strType == "$RATE_LIMIT")
+			{
+				m_iLogRateLimit = atoi(strValue.c_str());
+			}
+			else if (strType == "$ASYNC")
+			{
+				m_bLogAsync = strValue == "ON";
+			}
+			else
+			{
+				logErr("Unknown log type.");
+
+				return;
+			}
+
+			continue;
+		} // $LOG
+		else if (strSetting == "$METRICS")
+		{
+			string strType;
+			ssLine >> strType;
+			_string::trim(strType);
+
+			string strValue;
+			ssLine >> strValue;
+			_string::trim(strValue);
+
+			if (strType.empty() || strValue.empty())
+			{
+				logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+
+				return;
+			}
+
+			if (strType == "$OBJECTS")
+			{
+				m_iMetricsTopObjectsCount = atoi(strValue.c_str());
+			}
+			else if (strType == "$ENGINE_CALLS")
+			{
+				m_bMetricsEngineCalls = strValue == "ON";
+			}
+			else if (strType == "$ALLOCATIONS")
+			{
+				m_bMetricsAllocations = strValue == "ON";
+			}
+			else
+			{
+				logErr("Unknown metrics type.");
+
+				return;
+			}
+
+			continue;
+		} // $METRICS
+		else if (strSetting == "$IMPORT")
+		{
+			string strType;
+			ssLine >> strType;
+			_string::trim(strType);
+
+			string strValue;
+			ssLine >> strValue;
+			_string::trim(strValue);
+
+			if (strType.empty() || strValue.empty())
+			{
+				logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+
+				return;
+			}
+
+			if (strType == "$MMAP")
+			{
+				m_bImportMemoryMapped = strValue == "ON";
+			}
+			else if (strType == "$CHUNKS")
+			{
+				m_iImportChunksCount = strValue == "AUTO" ? (int)thread::hardware_concurrency() : atoi(strValue.c_str());
+				m_iImportChunksCount = m_iImportChunksCount > 1 ? m_iImportChunksCount : 0;
+			}
+			else if (strType == "$CHUNK_THRESHOLD")
+			{
+				m_iImportChunkThreshold = (int64_t)atoi(strValue.c_str()) * 1024 * 1024;
+			}
+			else
+			{
+				logErr("Unknown import type.");
+
+				return;
+			}
+
+			continue;
+		} // $IMPORT
+		else if (strSetting == "$EXPORT")
+		{
+			string strType;
+			ssLine >> strType;
+			_string::trim(strType);
+
+			string strValue;
+			ssLine >> strValue;
+			_string::trim(strValue);
+
+			if (strType.empty() || strValue.empty())
+			{
+				logErr(_string::format("Invalid format: '%s'", strLine.c_str()).c_str());
+
+				return;
+			}
+
+			if (strType == "$THREADS")
+			{
+				m_iExportThreadsCount = strValue == "AUTO" ? (int)thread::hardware_concurrency() : atoi(strValue.c_str());
+				m_iExportThreadsCount = m_iExportThreadsCount > 1 ? m_iExportThreadsCount : 0;
+			}
+			else if (strType == "$CACHE")
+			{
+				m_bExportCache = strValue == "ON";
+			}
+			else
+			{
+				logErr("Unknown export type.");
+
+				return;
+			}
+
+			continue;
+		} // $EXPORT
 		
-		getSite()->logErr("Unknown setting.");
+		logErr("Unknown setting.");
 
 		return;
 	} // while (getline(streamSettings, strLine)) 
 }
 
 // ************************************************************************************************
-_gml2ifc_exporter::_gml2ifc_exporter(
-		const wstring& strRootFolder,
-		_log_callback pLogCallback,
-		CSRSTransformer* pSRSTransformer)
+/*static*/ mutex _conversion_environment::s_mtx;
+/*static*/ map<wstring, _conversion_environment*> _conversion_environment::s_mapEnvironments;
+/*static*/ const _conversion_environment* _conversion_environment::s_pGISOptionsEnvironment = nullptr;
+/*static*/ _log_callback _conversion_environment::s_pGISOptionsLogCallback = nullptr;
+
+_conversion_environment::_conversion_environment(const wstring& strRootFolder)
 	: m_strRootFolder(strRootFolder)
 	, m_pSettingsProvider(nullptr)
-	, m_pLogCallback(pLogCallback)
-	, m_pSRSTransformer(pSRSTransformer)
-	, m_iOwlModel(0)
-	, m_iOwlRootInstance(0)
-	, m_setLODs()
+	, m_iReferencesCount(0)
+	, m_dLoadTime(0.)
 {
 	assert(!m_strRootFolder.empty());
-	assert(m_pLogCallback != nullptr);
+
+	auto tpStart = chrono::steady_clock::now();
 
 	wstring strSettingsFile = m_strRootFolder;
 	strSettingsFile += L"CityGML2IFC.settings";
-	m_pSettingsProvider = new _settings_provider(this, strSettingsFile);
+	m_pSettingsProvider = new _settings_provider(strSettingsFile);
 
-	SetGISOptionsW(strRootFolder.c_str(), true, (void *)m_pLogCallback);
+	m_dLoadTime = chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count();
 }
 
-/*virtual*/ _gml2ifc_exporter::~_gml2ifc_exporter()
+/*virtual*/ _conversion_environment::~_conversion_environment()
 {
-	delete m_pSettingsProvider;
+	assert(m_iReferencesCount == 0);
 
-	if (m_iOwlModel != 0)
-	{
-		CloseModel(m_iOwlModel);
-		m_iOwlModel = 0;
-	}
+	delete m_pSettingsProvider;
 }
 
-int _gml2ifc_exporter::retrieveSRSData(const wstring& strInputFile)
+/*static*/ _conversion_environment* _conversion_environment::acquire(const wstring& strRootFolder, _log_callback pLogCallback, bool& bCreated)
 {
-	assert(!strInputFile.empty());
+	assert(!strRootFolder.empty());
 
-	/* Import */
-	if (m_iOwlModel != 0)
-	{
-		CloseModel(m_iOwlModel);
-		m_iOwlModel = 0;
-	}
+	lock_guard<mutex> lock(s_mtx);
 
-	m_iOwlModel = CreateModel();
-	assert(m_iOwlModel != 0);
+	bCreated = false;
 
-	setFormatSettings(m_iOwlModel);
+	_conversion_environment* pEnvironment = nullptr;
 
-	m_iOwlRootInstance = ImportGISModelW(m_iOwlModel, strInputFile.c_str());
-	if (m_iOwlRootInstance != 0)
+	auto itEnvironment = s_mapEnvironments.find(strRootFolder);
+	if (itEnvironment != s_mapEnvironments.end())
 	{
-		return retrieveSRSDataCore(m_iOwlRootInstance);
+		pEnvironment = itEnvironment->second;
 	}
 	else
 	{
-		logErr("Not supported format.");
+		pEnvironment = new _conversion_environment(strRootFolder);
+		s_mapEnvironments[strRootFolder] = pEnvironment;
+
+		bCreated = true;
 	}
 
-	return 0;
+	pEnvironment->m_iReferencesCount++;
+	pEnvironment->applyGISOptions(pLogCallback);
+
+	return pEnvironment;
 }
 
-int _gml2ifc_exporter::retrieveSRSData(unsigned char* szData, size_t iSize)
+/*static*/ void _conversion_environment::release(_conversion_environment* pEnvironment)
 {
-	assert(szData != nullptr);
-	assert(iSize > 0);
+	assert(pEnvironment != nullptr);
 
-	/* Import */
-	if (m_iOwlModel != 0)
+	lock_guard<mutex> lock(s_mtx);
+
+	assert(pEnvironment->m_iReferencesCount > 0);
+	if (--pEnvironment->m_iReferencesCount > 0)
 	{
-		CloseModel(m_iOwlModel);
-		m_iOwlModel = 0;
+		return;
 	}
 
-	m_iOwlModel = CreateModel();
-	assert(m_iOwlModel != 0);
-
-	setFormatSettings(m_iOwlModel);
+	s_mapEnvironments.erase(pEnvironment->getRootFolder());
 
-	OwlInstance iRootInstance = ImportGISModelA(m_iOwlModel, szData, iSize);
-	if (iRootInstance != 0)
-	{ 
-		return retrieveSRSDataCore(iRootInstance);
+	if (s_pGISOptionsEnvironment == pEnvironment)
+	{
+		s_pGISOptionsEnvironment = nullptr;
+		s_pGISOptionsLogCallback = nullptr;
 	}
-	else
+
+	delete pEnvironment;
+}
+
+void _conversion_environment::applyGISOptions(_log_callback pLogCallback)
+{
+	// Called under s_mtx; the engine keeps the options of the last call
+	if ((s_pGISOptionsEnvironment == this) && (s_pGISOptionsLogCallback == pLogCallback))
 	{
-		logErr("Not supported format.");
+		return;
 	}
 
-	return 0;
+	SetGISOptionsW(m_strRootFolder.c_str(), true, (void*)pLogCallback);
+
+	s_pGISOptionsEnvironment = this;
+	s_pGISOptionsLogCallback = pLogCallback;
 }
 
-void _gml2ifc_exporter::importGML(const wstring& strInputFile)
+// ************************************************************************************************
+_gml2ifc_exporter::_gml2ifc_exporter(
+		const wstring& strRootFolder,
+		_log_callback pLogCallback,
+		CSRSTransformer* pSRSTransformer)
+	: m_strRootFolder(strRootFolder)
+	, m_pEnvironment(nullptr)
+	, m_pSettingsProvider(nullptr)
+	, m_pMetrics(nullptr)
+	, m_pLogCallback(pLogCallback)
+	, m_pLogPipeline(nullptr)
+	, m_pProgressCallback(nullptr)
+	, m_pCancellationToken(nullptr)
+	, m_enProgressPhase(enumPhase::count)
+	, m_tpProgress()
+	, m_pSRSTransformer(pSRSTransformer)
+	, m_iOwlModel(0)
+	, m_iOwlRootInstance(0)
+	, m_pExporter(nullptr)
+	, m_iTransformationsCount(0)
+	, m_bMemoryMappedImport(false)
+	, m_setLODs()
+	, m_pCityModelCache(nullptr)
+	, m_bCachedImport(false)
 {
-	assert(!strInputFile.empty());
+	assert(!m_strRootFolder.empty());
+	assert(m_pLogCallback != nullptr);
 
-	logInfo("Importing...");
+	m_pLogPipeline = new _log_pipeline(m_pLogCallback);
 
-	if (m_iOwlModel != 0)
+	auto tpStart = chrono::steady_clock::now();
+
+	bool bCreated = false;
+	m_pEnvironment = _conversion_environment::acquire(m_strRootFolder, m_pLogCallback, bCreated);
+	m_pSettingsProvider = m_pEnvironment->getSettingsProvider();
+
+	double dStartupTime = chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count();
+
+	for (const auto& itMessage : m_pSettingsProvider->getLoadMessages())
 	{
-		CloseModel(m_iOwlModel);
-		m_iOwlModel = 0;
+		logWrite(itMessage.first, itMessage.second);
 	}
 
-	m_setLODs.clear();
+	m_pLogPipeline->setMinLevel(m_pSettingsProvider->getLogMinLevel());
+	m_pLogPipeline->setRateLimit(m_pSettingsProvider->getLogRateLimit());
+	m_pLogPipeline->setAsync(m_pSettingsProvider->getLogAsync());
 
-	m_iOwlModel = CreateModel();
-	assert(m_iOwlModel != 0);
+	m_pMetrics = new _metrics();
+	m_pMetrics->setTopObjectsCount(m_pSettingsProvider->getMetricsTopObjectsCount());
+	m_pMetrics->setEngineCalls(m_pSettingsProvider->getMetricsEngineCalls());
+	m_pMetrics->setAllocations(m_pSettingsProvider->getMetricsAllocations());
 
-	setFormatSettings(m_iOwlModel);
+	m_bMemoryMappedImport = m_pSettingsProvider->getImportMemoryMapped();
 
-	m_iOwlRootInstance = ImportGISModelW(m_iOwlModel, strInputFile.c_str());
-	if (m_iOwlRootInstance == 0)
+	// Cold vs. warm start
+	if (m_pMetrics->isEnabled())
 	{
-		logErr("Not supported format.");
+		logInfo(_string::format("Startup (%s): %.3f ms, Settings: %.3f ms",
+			bCreated ? "cold" : "warm",
+			dStartupTime,
+			m_pEnvironment->getLoadTime()));
 	}
+}
 
-	if (IsGML(m_iOwlModel))
-	{
-		_gml_exporter exporter(this);
-		exporter.retrieveLODs(m_setLODs);
-	}
-	else if (IsCityGML(m_iOwlModel))
-	{
-		_citygml_exporter exporter(this);
-		exporter.retrieveLODs(m_setLODs);
-	}
-	else if (IsCityJSON(m_iOwlModel))
+// The models first; the metrics, the log and the settings, which they can use, last
+/*virtual*/ _gml2ifc_exporter::~_gml2ifc_exporter()
+{
+	deleteChunks();
+	deleteExporter();
+	deleteCityModelCache();
+
+	if (m_iOwlModel != 0)
 	{
-		_cityjson_exporter exporter(this);
-		exporter.retrieveLODs(m_setLODs);
+		CloseModel(m_iOwlModel);
+		m_iOwlModel = 0;
 	}
 
-	logInfo("Done.");
+	delete m_pMetrics;
+	delete m_pLogPipeline;
+
+	_conversion_environment::release(m_pEnvironment);
+}
+
+int _gml2ifc_exporter::retrieveSRSData(const wstring& strInputFile)
+{
+	assert(!strInputFile.empty());
+
+	importGML(strInputFile);
+
+	return m_iTransformationsCount;
+}
+
+int _gml2ifc_exporter::retrieveSRSData(unsigned char* szData, size_t iSize)
+{
+	assert(szData != nullptr);
+	assert(iSize > 0);
+
+	importGML(szData, iSize);
+
+	return m_iTransformationsCount;
+}
+
+void _gml2ifc_exporter::importGML(const wstring& strInputFile)
+{
+	assert(!strInputFile.empty());
+
+	importFile(strInputFile, true);
+}
+
+// bCachedImport - the input is not imported if the cache has city models of it ('$EXPORT $CACHE');
+// false - the cache is kept, see importOnCacheMiss()
+void _gml2ifc_exporter::importFile(const wstring& strInputFile, bool bCachedImport)
+{
+	assert(!strInputFile.empty());
+
+	importCore([&]()
+		{
+			// '$EXPORT $CACHE'
+			if (bCachedImport)
+			{
+				deleteCityModelCache();
+
+				if (m_pSettingsProvider->getExportCache())
+				{
+					auto tpHash = chrono::steady_clock::now();
+
+					m_pCityModelCache = new _city_model_cache(strInputFile,
+						_city_model_cache::getSettingsKey(m_pSettingsProvider->getSettingsHash(), GML2IFC_VERSION));
+					if (m_pCityModelCache->open())
+					{
+						logInfo(_string::format("City Model Cache: %s, Hash: %.1f ms",
+							m_pCityModelCache->hasCityModel() ? "found" : "not found",
+							chrono::duration<double, milli>(chrono::steady_clock::now() - tpHash).count()));
+					}
+					else
+					{
+						logWarn("City Model Cache: the input file can't be memory-mapped; the cache is disabled.");
+
+						deleteCityModelCache();
+					}
+				} // if (m_pSettingsProvider->getExportCache())
+			} // if (bCachedImport)
+
+			auto tpStart = chrono::steady_clock::now();
+
+			bool bCached = false;
+			if (bCachedImport && (m_pCityModelCache != nullptr) && m_pCityModelCache->hasCityModel())
+			{
+				bCached = importCachedModel();
+			}
+
+			bool bChunked = false;
+			bool bChunksFailed = false;
+			if (!bCached && (m_pSettingsProvider->getImportChunksCount() > 1))
+			{
+				bChunked = importChunks(strInputFile, m_pSettingsProvider->getImportChunksCount(), bChunksFailed);
+			}
+
+			bool bMemoryMapped = false;
+			if (!bCached && !bChunked && m_bMemoryMappedImport)
+			{
+				_mapped_file mappedFile(strInputFile);
+				if (mappedFile.open())
+				{
+					bMemoryMapped = true;
+
+					m_iOwlRootInstance = ImportGISModelA(m_iOwlModel, mappedFile.getData(), mappedFile.getSize());
+				}
+				else
+				{
+					logWarn("The input file can't be memory-mapped.");
+				}
+			} // if (m_bMemoryMappedImport)
+
+			if (!bCached && !bChunked && !bMemoryMapped)
+			{
+				m_iOwlRootInstance = ImportGISModelW(m_iOwlModel, strInputFile.c_str());
+			}
+
+			// The measurement of the import paths ('$IMPORT $MMAP', '$IMPORT $CHUNKS'): the same input
+			// is imported with each setting, cold (the first run after the file is written) and warm
+			double dImportTime = chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count();
+			double dInputSize = (double)max<int64_t>(_mapped_file::getFileSize(strInputFile), 0) / 1048576.;
+
+			logInfo(_string::format("Import (%s): %.1f ms, %.1f MB, %.1f MB/s",
+				bCached ? "cached" : bChunked ? "chunked" : bMemoryMapped ? "memory-mapped" : "file",
+				dImportTime,
+				dInputSize,
+				dImportTime > 0. ? dInputSize * 1000. / dImportTime : 0.));
+
+			return !bChunksFailed;
+		});
 }
 
 void _gml2ifc_exporter::importGML(unsigned char* szData, size_t iSize)
@@ -320,4837 +772,5962 @@ void _gml2ifc_exporter::importGML(unsigned char* szData, size_t iSize)
 	assert(szData != nullptr);
 	assert(iSize > 0);
 
+	deleteCityModelCache();
+
+	importCore([&]()
+		{
+			m_iOwlRootInstance = ImportGISModelA(m_iOwlModel, szData, iSize);
+
+			return true;
+		});
+}
+
+void _gml2ifc_exporter::importGML(_input_stream* pInputStream)
+{
+	assert(pInputStream != nullptr);
+
+	deleteCityModelCache();
+
+	importCore([&]()
+		{
+			m_iOwlRootInstance = pInputStream->import(m_iOwlModel);
+			if (pInputStream->isFailed())
+			{
+				logErr(_string::format("Failed to read '%s' (%lld bytes read).",
+					pInputStream->getName().c_str(),
+					pInputStream->getBytesRead()));
+
+				return false;
+			}
+
+			return true;
+		});
+}
+
+// The steps shared by the imports; fnImport imports the input into m_iOwlModel (m_iOwlRootInstance);
+// false - the input can't be read, the partial model is closed, i.e. nothing is exported
+void _gml2ifc_exporter::importCore(const function<bool()>& fnImport)
+{
 	logInfo("Importing...");
 
+	_metrics_scope metrics(m_pMetrics);
+	m_pMetrics->resetAllocations(enumPhase::Import);
+	_phase_scope phase(enumPhase::Import);
+
+	reportProgress(enumPhase::Import, 0, 1);
+
+	deleteChunks();
+	deleteExporter();
+
 	if (m_iOwlModel != 0)
 	{
 		CloseModel(m_iOwlModel);
 		m_iOwlModel = 0;
 	}
 
+	m_iOwlRootInstance = 0;
 	m_setLODs.clear();
+	m_iTransformationsCount = 0;
+	m_bCachedImport = false;
 
 	m_iOwlModel = CreateModel();
 	assert(m_iOwlModel != 0);
 
 	setFormatSettings(m_iOwlModel);
 
-	m_iOwlRootInstance = ImportGISModelA(m_iOwlModel, szData, iSize);
-	if (m_iOwlRootInstance == 0)
+	if (!fnImport())
+	{
+		deleteChunks();
+
+		CloseModel(m_iOwlModel);
+		m_iOwlModel = 0;
+		m_iOwlRootInstance = 0;
+	}
+	else if (m_iOwlRootInstance == 0)
 	{
 		logErr("Not supported format.");
 	}
 
-	if (IsCityJSON(m_iOwlModel))
+	createExporter();
+
+	// The LODs of the input; see importCachedModel()
+	if ((m_pExporter != nullptr) && !m_bCachedImport)
 	{
-		_cityjson_exporter exporter(this);
-		exporter.retrieveLODs(m_setLODs);
-	}
+		m_pExporter->retrieveLODs(m_setLODs);
+
+		for (auto pChunk : m_vecChunks)
+		{
+			if ((pChunk->m_pExporter == nullptr) || (typeid(*pChunk->m_pExporter) != typeid(*m_pExporter)))
+			{
+				logErr("Chunked import: a chunk of a different format.");
+
+				continue;
+			}
+
+			m_setLODs.insert(pChunk->m_setLODs.begin(), pChunk->m_setLODs.end());
+		}
+
+		if (m_pCityModelCache != nullptr)
+		{
+			m_pCityModelCache->setModelData(getFormat(m_iOwlModel), m_setLODs);
+		}
+	} // if ((m_pExporter != nullptr) && !m_bCachedImport)
+
+	retrieveSRSDataOnImport();
+
+	reportProgress(enumPhase::Import, 1, 1);
 
 	logInfo("Done.");
+
+	flushLog();
 }
 
 void _gml2ifc_exporter::exportAsIFC(const char* szTargetLODs, const wstring& strOuputFile)
 {
 	assert(!strOuputFile.empty());
 
-	assert(m_iOwlModel != 0);
-	assert(m_iOwlRootInstance != 0);
-
-	logInfo("Exporting...");
-
-	if (IsGML(m_iOwlModel))
-	{
-		_gml_exporter exporter(this);
-		exporter.execute(m_iOwlRootInstance, szTargetLODs, strOuputFile);
-	}
-	else if (IsCityGML(m_iOwlModel))
-	{
-		_citygml_exporter exporter(this);
-		exporter.execute(m_iOwlRootInstance, szTargetLODs, strOuputFile);
-	}
-	else if (IsCityJSON(m_iOwlModel))
+	_file_output_stream fileOutputStream(strOuputFile);
+	if (isIfcZIP(strOuputFile))
 	{
-		_cityjson_exporter exporter(this);
-		exporter.execute(m_iOwlRootInstance, szTargetLODs, strOuputFile);
+		_zip_output_stream zipOutputStream(&fileOutputStream, getIfcZIPEntryName(strOuputFile));
+		exportAsIFC(szTargetLODs, &zipOutputStream);
 	}
 	else
 	{
-		logErr("Not supported format.");
+		exportAsIFC(szTargetLODs, &fileOutputStream);
 	}
-
-	logInfo("Done.");
 }
 
-void _gml2ifc_exporter::execute(const wstring& strInputFile, const wstring& strOuputFile)
+void _gml2ifc_exporter::exportAsIFC(const char* szTargetLODs, _output_stream* pOutputStream)
 {
-	assert(!strInputFile.empty());
-	assert(!strOuputFile.empty());
+	assert(pOutputStream != nullptr);
 
-	importGML(strInputFile);
+	exportAsIFC(vector<pair<string, _output_stream*>>{ { szTargetLODs != nullptr ? szTargetLODs : "", pOutputStream } });
+}
 
-	if (m_iOwlRootInstance != 0)
+unsigned char* _gml2ifc_exporter::exportAsIFC(const char* szTargetLODs, size_t& iOutputSize, bool bIfcZIP/* = false*/)
+{
+	iOutputSize = 0;
+
+	_memory_output_stream outputStream;
+	if (bIfcZIP)
 	{
-		executeCore(m_iOwlRootInstance, strOuputFile);
+		_zip_output_stream zipOutputStream(&outputStream, "model.ifc");
+		exportAsIFC(szTargetLODs, &zipOutputStream);
 	}
 	else
 	{
-		logErr("Not supported format.");
+		exportAsIFC(szTargetLODs, &outputStream);
+	}
+
+	if (outputStream.isFailed())
+	{
+		return nullptr;
 	}
+
+	return outputStream.detach(iOutputSize);
 }
 
-void _gml2ifc_exporter::execute(unsigned char* szData, size_t iSize, const wstring& strOuputFile)
+void _gml2ifc_exporter::exportAsIFC(const vector<pair<string, wstring>>& vecTargets)
 {
-	assert(szData != nullptr);
-	assert(iSize > 0);
-	assert(!strOuputFile.empty());
+	assert(!vecTargets.empty());
 
-	importGML(szData, iSize);
+	// The ZIP streams are closed before their files (see ~_zip_output_stream())
+	vector<unique_ptr<_file_output_stream>> vecFileOutputStreams;
+	vector<unique_ptr<_zip_output_stream>> vecZIPOutputStreams;
 
-	if (m_iOwlRootInstance != 0)
+	vector<pair<string, _output_stream*>> vecOutputStreams;
+	for (const auto& itTarget : vecTargets)
 	{
-		executeCore(m_iOwlRootInstance, strOuputFile);
-	}
-	else
-	{
-		logErr("Not supported format.");
-	}
+		assert(!itTarget.second.empty());
+
+		vecFileOutputStreams.push_back(unique_ptr<_file_output_stream>(new _file_output_stream(itTarget.second)));
+		if (isIfcZIP(itTarget.second))
+		{
+			vecZIPOutputStreams.push_back(unique_ptr<_zip_output_stream>(
+				new _zip_output_stream(vecFileOutputStreams.back().get(), getIfcZIPEntryName(itTarget.second))));
+
+			vecOutputStreams.push_back({ itTarget.first, vecZIPOutputStreams.back().get() });
+		}
+		else
+		{
+			vecOutputStreams.push_back({ itTarget.first, vecFileOutputStreams.back().get() });
+		}
+	} // for (const auto& itTarget : ...
+
+	exportAsIFC(vecOutputStreams);
 }
 
-_material* _gml2ifc_exporter::getDefaultMaterial(const string& strEntity)
+// The city model is read once for all LODs; the LOD selection of a target is applied on emission
+void _gml2ifc_exporter::exportAsIFC(const vector<pair<string, _output_stream*>>& vecTargets)
 {
-	assert(!strEntity.empty());
+	assert(!vecTargets.empty());
+
+	importOnCacheMiss();
 
-	auto pOverriddenMaterial = getOverriddenMaterial(strEntity);
-	if (pOverriddenMaterial != nullptr)
+	// Not imported, not supported or failed (see importCore())
+	if (m_iOwlRootInstance == 0)
 	{
-		return pOverriddenMaterial;
+		logErr("Nothing to export.");
+
+		flushLog();
+
+		return;
 	}
 
-	const auto& mapDefaultMaterials = m_pSettingsProvider->getDefaultMaterials();
+	logInfo("Exporting...");
+
+	_metrics_scope metrics(m_pMetrics);
+	m_pMetrics->reset();
 
-	auto itDefaultMaterial = mapDefaultMaterials.find(strEntity);
-	if (itDefaultMaterial != mapDefaultMaterials.end())
+	if (m_pExporter != nullptr)
 	{
-		return itDefaultMaterial->second;
+		m_pExporter->execute(m_iOwlRootInstance, vecTargets);
+	}
+	else
+	{
+		logErr("Not supported format.");
 	}
 
-	itDefaultMaterial = mapDefaultMaterials.find("$ALL");
-	if (itDefaultMaterial != mapDefaultMaterials.end())
+	if (isCancelled())
 	{
-		return itDefaultMaterial->second;
+		logWarn("Cancelled.");
+	}
+	else
+	{
+		logInfo("Done.");
 	}
 
-	return nullptr;
+	flushLog();
 }
 
-_material* _gml2ifc_exporter::getOverriddenMaterial(const string& strEntity)
+// Caller's buffer; converted once - the IFC is written into the buffer directly
+// false - the buffer is too small (iOutputSize - the size needed) or the export failed (iOutputSize - 0)
+bool _gml2ifc_exporter::exportAsIFC(const char* szTargetLODs, unsigned char* szBuffer, size_t iBufferSize, size_t& iOutputSize, bool bIfcZIP/* = false*/)
 {
-	assert(!strEntity.empty());
+	assert(szBuffer != nullptr);
+	assert(iBufferSize > 0);
 
-	const auto& mapOverriddenMaterials = m_pSettingsProvider->getOverriddenMaterials();
+	iOutputSize = 0;
 
-	const auto& itOverriddenMaterial = mapOverriddenMaterials.find(strEntity);
-	if (itOverriddenMaterial != mapOverriddenMaterials.end())
+	_memory_output_stream outputStream(szBuffer, iBufferSize);
+	if (bIfcZIP)
 	{
-		return itOverriddenMaterial->second;
+		_zip_output_stream zipOutputStream(&outputStream, "model.ifc");
+		exportAsIFC(szTargetLODs, &zipOutputStream);
+	}
+	else
+	{
+		exportAsIFC(szTargetLODs, &outputStream);
 	}
 
-	return nullptr;
-}
+	if (outputStream.isOverflow())
+	{
+		iOutputSize = (size_t)outputStream.getBytesWritten();
 
-_property* _gml2ifc_exporter::getProperty(const string& strName)
-{
-	return m_pSettingsProvider->getProperty(strName, true);
+		return false;
+	}
+
+	if (outputStream.isFailed())
+	{
+		return false;
+	}
+
+	iOutputSize = outputStream.getSize();
+
+	return true;
 }
 
-string _gml2ifc_exporter::getPropertyName(const string& strName)
+// The IFC model is built and serialized as for exportAsIFC(); a caller that needs the IFC as well
+// should pass a buffer large enough (see exportAsIFC(szBuffer)) instead of calling this first
+int64_t _gml2ifc_exporter::getIFCSize(const char* szTargetLODs)
 {
-	assert(!strName.empty());
+	_size_output_stream outputStream;
+	exportAsIFC(szTargetLODs, &outputStream);
 
-	auto pProperty = m_pSettingsProvider->getProperty(strName, true);
-	assert(pProperty != nullptr);
-	
-	return pProperty->getOverrideName();
+	return outputStream.getBytesWritten();
 }
 
-string _gml2ifc_exporter::getPropertySet(const string& strName) const
+void _gml2ifc_exporter::execute(const wstring& strInputFile, const wstring& strOuputFile)
 {
-	auto pProperty = m_pSettingsProvider->getProperty(strName, true);
-	assert(pProperty != nullptr);
+	assert(!strInputFile.empty());
+	assert(!strOuputFile.empty());
 
-	return pProperty->getPropertySet();
+	_file_output_stream fileOutputStream(strOuputFile);
+	if (isIfcZIP(strOuputFile))
+	{
+		_zip_output_stream zipOutputStream(&fileOutputStream, getIfcZIPEntryName(strOuputFile));
+		execute(strInputFile, &zipOutputStream);
+	}
+	else
+	{
+		execute(strInputFile, &fileOutputStream);
+	}
 }
 
-/*static*/ string _gml2ifc_exporter::dateTimeStamp()
+void _gml2ifc_exporter::execute(const wstring& strInputFile, _output_stream* pOutputStream)
 {
-	auto timePointNow = chrono::system_clock::now();
-	auto timeNow = chrono::system_clock::to_time_t(timePointNow);
-	auto timeNowMS = chrono::duration_cast<chrono::milliseconds>(timePointNow.time_since_epoch()) % 1000;
+	assert(!strInputFile.empty());
+	assert(pOutputStream != nullptr);
 
-	stringstream ss;
-	ss << put_time(localtime(&timeNow), "%Y-%m-%d %H:%M:%S.");
-	ss << setfill('0') << setw(3) << timeNowMS.count();
+	importGML(strInputFile);
 
-	return ss.str();
-}
+	if (!isCancelled())
+	{
+		importOnCacheMiss();
+	}
 
-bool _gml2ifc_exporter::toWGS84Async(int iCRS, float fX, float fY, float fZ)
-{
-	if (m_pSRSTransformer != nullptr)
+	if (isCancelled())
 	{
-		m_pSRSTransformer->toWGS84Async(iCRS, fX, fY, fZ);
+		logWarn("Cancelled.");
 
-		return true;
+		flushLog();
+
+		return;
 	}
 
-	return false;
+	if (m_iOwlRootInstance != 0)
+	{
+		executeCore(m_iOwlRootInstance, pOutputStream);
+	}
+	else
+	{
+		logErr("Not supported format.");
+	}
 }
 
-bool _gml2ifc_exporter::getWGS84(int iCRS, float fX, float fY, float fZ, string& strCoordinates)
+void _gml2ifc_exporter::execute(unsigned char* szData, size_t iSize, const wstring& strOuputFile)
 {
-	strCoordinates = "";
+	assert(szData != nullptr);
+	assert(iSize > 0);
+	assert(!strOuputFile.empty());
 
-	if (m_pSRSTransformer != nullptr)
+	_file_output_stream fileOutputStream(strOuputFile);
+	if (isIfcZIP(strOuputFile))
 	{
-		const char* szCoordinates = m_pSRSTransformer->getWGS84(iCRS, fX, fY, fZ);
-		strCoordinates = szCoordinates != nullptr ? szCoordinates : "";
-
-		return !strCoordinates.empty();
+		_zip_output_stream zipOutputStream(&fileOutputStream, getIfcZIPEntryName(strOuputFile));
+		execute(szData, iSize, &zipOutputStream);
+	}
+	else
+	{
+		execute(szData, iSize, &fileOutputStream);
 	}
-
-	return false;
 }
 
-/*static*/ string _gml2ifc_exporter::addDateTimeStamp(const string& strInput)
+void _gml2ifc_exporter::execute(unsigned char* szData, size_t iSize, _output_stream* pOutputStream)
 {
-	string strInputCopy = dateTimeStamp();
-	strInputCopy += ": ";
-	strInputCopy += strInput;
-
-	return strInputCopy;
-}
-
-void _gml2ifc_exporter::logWrite(enumLogEvent enLogEvent, const string& strEvent)
-{
-	(*m_pLogCallback)(enLogEvent, addDateTimeStamp(strEvent).c_str());
-}
+	assert(szData != nullptr);
+	assert(iSize > 0);
+	assert(pOutputStream != nullptr);
 
-void _gml2ifc_exporter::setFormatSettings(OwlModel iOwlModel)
-{
-	string strSettings = "111111000000001111000001110001";
+	importGML(szData, iSize);
 
-	bitset<64> bitSettings(strSettings);
-	int64_t iSettings = bitSettings.to_ulong();
+	if (isCancelled())
+	{
+		logWarn("Cancelled.");
 
-	string strMask = "11111111111111111111011101110111";
-	bitset<64> bitMask(strMask);
-	int64_t iMask = bitMask.to_ulong();
+		flushLog();
 
-	SetFormat(iOwlModel, (int64_t)iSettings, (int64_t)iMask);
+		return;
+	}
 
-	SetBehavior(iOwlModel, 2048 + 4096, 2048 + 4096);
+	if (m_iOwlRootInstance != 0)
+	{
+		executeCore(m_iOwlRootInstance, pOutputStream);
+	}
+	else
+	{
+		logErr("Not supported format.");
+	}
 }
 
-void _gml2ifc_exporter::executeCore(OwlInstance iRootInstance, const wstring& strOuputFile)
+unsigned char* _gml2ifc_exporter::execute(unsigned char* szData, size_t iSize, size_t& iOutputSize, bool bIfcZIP/* = false*/)
 {
-	assert(iRootInstance != 0);
-	assert(!strOuputFile.empty());
+	assert(szData != nullptr);
+	assert(iSize > 0);
 
-	logInfo("Exporting...");
+	iOutputSize = 0;
 
-	if (IsGML(m_iOwlModel))
+	_memory_output_stream outputStream;
+	if (bIfcZIP)
 	{
-		_gml_exporter exporter(this);
-		exporter.execute(iRootInstance, nullptr, strOuputFile);
+		_zip_output_stream zipOutputStream(&outputStream, "model.ifc");
+		execute(szData, iSize, &zipOutputStream);
 	}
-	else if (IsCityGML(m_iOwlModel))
-	{
-		_citygml_exporter exporter(this);
-		exporter.execute(iRootInstance, nullptr, strOuputFile);
-	}
-	else if (IsCityJSON(m_iOwlModel))
+	else
 	{
-		_cityjson_exporter exporter(this);
-		exporter.execute(iRootInstance, nullptr, strOuputFile);
+		execute(szData, iSize, &outputStream);
 	}
-	else
+
+	if (outputStream.isFailed())
 	{
-		logErr("Not supported format.");
+		return nullptr;
 	}
 
-	logInfo("Done.");
+	return outputStream.detach(iOutputSize);
 }
 
-int _gml2ifc_exporter::retrieveSRSDataCore(OwlInstance iRootInstance)
+void _gml2ifc_exporter::execute(_input_stream* pInputStream, _output_stream* pOutputStream)
 {
-	assert(iRootInstance != 0);
+	assert(pInputStream != nullptr);
+	assert(pOutputStream != nullptr);
 
-	logInfo("Retrieving SRS Data...");
-
-	int iTransformationsCount = 0;
+	importGML(pInputStream);
 
-	if (IsGML(m_iOwlModel))
+	if (isCancelled())
 	{
-		_gml_exporter exporter(this);
-		iTransformationsCount = exporter.retrieveSRSData(iRootInstance);
+		logWarn("Cancelled.");
 
-		logInfo("Done.");
-	}
-	else if (IsCityGML(m_iOwlModel))
-	{
-		_citygml_exporter exporter(this);
-		iTransformationsCount = exporter.retrieveSRSData(iRootInstance);
+		flushLog();
 
-		logInfo("Done.");
+		return;
 	}
-	else if (IsCityJSON(m_iOwlModel))
-	{
-		_cityjson_exporter exporter(this);
-		iTransformationsCount = exporter.retrieveSRSData(iRootInstance);
 
-		logInfo("Done.");
+	if (m_iOwlRootInstance != 0)
+	{
+		executeCore(m_iOwlRootInstance, pOutputStream);
 	}
 	else
 	{
 		logErr("Not supported format.");
 	}
-
-	return iTransformationsCount;
 }
 
-// ************************************************************************************************
-_exporter_base::_exporter_base(_gml2ifc_exporter* pSite)
-	: m_pSite(pSite)
-	, m_iTagProperty(0)
-	, m_iSdaiModel(0)
-	, m_iPersonInstance(0)
-	, m_iOrganizationInstance(0)
-	, m_iPersonAndOrganizationInstance(0)	
-	, m_iApplicationInstance(0)
-	, m_iOwnerHistoryInstance(0)
-	, m_iDimensionalExponentsInstance(0)
-	, m_iConversionBasedUnitInstance(0)
-	, m_iUnitAssignmentInstance(0)
-	, m_iLengthUnitInstance(0)
-	, m_iAreaUnitInstance(0)
-	, m_iWorldCoordinateSystemInstance(0)
-	, m_iProjectInstance(0)
-	, m_iSiteInstance(0) 
-	, m_iSiteInstancePlacement(0) 
-	, m_iGeometricRepresentationContextInstance(0)
-	, m_setTargetLODs()
-	, m_bHighestLOD(false)
+const _material* _gml2ifc_exporter::getDefaultMaterial(enumMaterialEntity enEntity) const
 {
-	assert(m_pSite != nullptr);
-
-	m_iTagProperty = GetPropertyByName(getSite()->getOwlModel(), "tag");
-	assert(m_iTagProperty);
+	return m_pSettingsProvider->getDefaultMaterial(enEntity);
 }
 
-/*virtual*/ _exporter_base::~_exporter_base()
+const _material* _gml2ifc_exporter::getOverriddenMaterial(enumMaterialEntity enEntity) const
 {
-	if (m_iSdaiModel != 0)
-	{
-		sdaiCloseModel(m_iSdaiModel);
-		m_iSdaiModel = 0;
-	}
+	return m_pSettingsProvider->getOverriddenMaterial(enEntity);
 }
 
-void _exporter_base::execute(OwlInstance iRootInstance, const char* szTargetLODs, const wstring& strOuputFile)
+const _property* _gml2ifc_exporter::getProperty(const string& strName)
 {
-	// LODs
-	m_setTargetLODs.clear();
-	m_bHighestLOD = false;
-	if (szTargetLODs != nullptr)
-	{
-		string strTargetLODs = szTargetLODs;
-		_string::trim(strTargetLODs);
-
-		if (!strTargetLODs.empty())
-		{
-			m_bHighestLOD = strTargetLODs == "HIGHEST_LOD";
-			if (!m_bHighestLOD)
-			{
-				vector<string> vecLODs;
-				_string::split(strTargetLODs, ";", vecLODs);
-
-				if (!vecLODs.empty())
-				{
-					for (auto strLOD : vecLODs)
-					{
-						m_setTargetLODs.insert(strLOD);
-					}
-				}
-			}		
-		}		
-	}
-
-	preProcessing();
+	return m_pSettingsProvider->getProperty(strName);
+}
 
-	executeCore(iRootInstance, strOuputFile);
+const string& _gml2ifc_exporter::getPropertyName(const string& strName)
+{
+	assert(!strName.empty());
 
-	postProcessing();
+	auto pProperty = m_pSettingsProvider->getProperty(strName);
+	assert(pProperty != nullptr);
+	
+	return pProperty->getOverrideName();
 }
 
-SdaiInstance _exporter_base::getPersonInstance()
+const string& _gml2ifc_exporter::getPropertySet(const string& strName)
 {
-	if (m_iPersonInstance == 0) 
-	{
-		m_iPersonInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPerson");
-		assert(m_iPersonInstance != 0);
+	auto pProperty = m_pSettingsProvider->getProperty(strName);
+	assert(pProperty != nullptr);
 
-		sdaiPutAttrBN(m_iPersonInstance, "GivenName", sdaiSTRING, "Peter");
-		sdaiPutAttrBN(m_iPersonInstance, "FamilyName", sdaiSTRING, "Bonsma");
-	}
+	return pProperty->getPropertySet();
+}
 
-	return m_iPersonInstance;
+int _gml2ifc_exporter::getExportThreadsCount() const
+{
+	return m_pSettingsProvider->getExportThreadsCount();
 }
 
-SdaiInstance _exporter_base::getOrganizationInstance()
+/*static*/ string _gml2ifc_exporter::dateTimeStamp()
 {
-	if (m_iOrganizationInstance == 0) 
-	{
-		m_iOrganizationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcOrganization");
-		assert(m_iOrganizationInstance != 0);
+	auto timePointNow = chrono::system_clock::now();
+	auto timeNow = chrono::system_clock::to_time_t(timePointNow);
+	auto timeNowMS = chrono::duration_cast<chrono::milliseconds>(timePointNow.time_since_epoch()) % 1000;
 
-		sdaiPutAttrBN(m_iOrganizationInstance, "Name", sdaiSTRING, "RDF");
-		sdaiPutAttrBN(m_iOrganizationInstance, "Description", sdaiSTRING, "RDF Ltd.");
-	}	
+	stringstream ss;
+	ss << put_time(localtime(&timeNow), "%Y-%m-%d %H:%M:%S.");
+	ss << setfill('0') << setw(3) << timeNowMS.count();
 
-	return m_iOrganizationInstance;
+	return ss.str();
 }
 
-SdaiInstance _exporter_base::getPersonAndOrganizationInstance()
+bool _gml2ifc_exporter::toWGS84Async(int iCRS, float fX, float fY, float fZ)
 {
-	if (m_iPersonAndOrganizationInstance == 0) 
+	if (m_pSRSTransformer != nullptr)
 	{
-		m_iPersonAndOrganizationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPersonAndOrganization");
-		assert(m_iPersonAndOrganizationInstance != 0);
+		m_pSRSTransformer->toWGS84Async(iCRS, fX, fY, fZ);
 
-		sdaiPutAttrBN(m_iPersonAndOrganizationInstance, "ThePerson", sdaiINSTANCE, (void*)getPersonInstance());
-		sdaiPutAttrBN(m_iPersonAndOrganizationInstance, "TheOrganization", sdaiINSTANCE, (void*)getOrganizationInstance());
+		return true;
 	}
 
-	return m_iPersonAndOrganizationInstance;
+	return false;
 }
 
-SdaiInstance _exporter_base::getApplicationInstance()
+bool _gml2ifc_exporter::getWGS84(int iCRS, float fX, float fY, float fZ, string& strCoordinates)
 {
-	if (m_iApplicationInstance == 0)
+	strCoordinates = "";
+
+	if (m_pSRSTransformer != nullptr)
 	{
-		m_iApplicationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcApplication");
-		assert(m_iApplicationInstance != 0);
+		const char* szCoordinates = m_pSRSTransformer->getWGS84(iCRS, fX, fY, fZ);
+		strCoordinates = szCoordinates != nullptr ? szCoordinates : "";
+	}
 
-		sdaiPutAttrBN(m_iApplicationInstance, "ApplicationDeveloper", sdaiINSTANCE, (void*)getOrganizationInstance());
-		sdaiPutAttrBN(m_iApplicationInstance, "Version", sdaiSTRING, "0.10"); //#tbd
-		sdaiPutAttrBN(m_iApplicationInstance, "ApplicationFullName", sdaiSTRING, "Test Application"); //#tbd
-		sdaiPutAttrBN(m_iApplicationInstance, "ApplicationIdentifier", sdaiSTRING, "TA 1001"); //#tbd
+	// '$EXPORT $CACHE': the transformations are saved with the city models
+	if (m_pCityModelCache != nullptr)
+	{
+		if (!strCoordinates.empty())
+		{
+			m_pCityModelCache->setWGS84(iCRS, fX, fY, fZ, strCoordinates);
+		}
+		else
+		{
+			m_pCityModelCache->getWGS84(iCRS, fX, fY, fZ, strCoordinates);
+		}
 	}
 
-	return m_iApplicationInstance;
+	return !strCoordinates.empty();
 }
 
-SdaiInstance _exporter_base::getOwnerHistoryInstance()
+/*static*/ string _gml2ifc_exporter::addDateTimeStamp(const string& strInput)
 {
-	if (m_iOwnerHistoryInstance == 0)
-	{
-		int64_t iTimeStamp = time(0);
-
-		m_iOwnerHistoryInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcOwnerHistory");
-		assert(m_iOwnerHistoryInstance != 0);
-
-		sdaiPutAttrBN(m_iOwnerHistoryInstance, "OwningUser", sdaiINSTANCE, (void*)getPersonAndOrganizationInstance());
-		sdaiPutAttrBN(m_iOwnerHistoryInstance, "OwningApplication", sdaiINSTANCE, (void*)getApplicationInstance());
-		sdaiPutAttrBN(m_iOwnerHistoryInstance, "ChangeAction", sdaiENUM, "ADDED");
-		sdaiPutAttrBN(m_iOwnerHistoryInstance, "CreationDate", sdaiINTEGER, &iTimeStamp);
-		sdaiPutAttrBN(m_iOwnerHistoryInstance, "LastModifiedDate", sdaiINTEGER, &iTimeStamp);
-	}
+	string strInputCopy = dateTimeStamp();
+	strInputCopy += ": ";
+	strInputCopy += strInput;
 
-	return m_iOwnerHistoryInstance;
+	return strInputCopy;
 }
 
-SdaiInstance _exporter_base::getDimensionalExponentsInstance()
+void _gml2ifc_exporter::reportProgress(enumPhase enPhase, int64_t iDone, int64_t iTotal)
 {
-	if (m_iDimensionalExponentsInstance == 0)
+	if (m_pProgressCallback == nullptr)
 	{
-		int_t LengthExponent = 0,
-			MassExponent = 0,
-			TimeExponent = 0,
-			ElectricCurrentExponent = 0,
-			ThermodynamicTemperatureExponent = 0,
-			AmountOfSubstanceExponent = 0,
-			LuminousIntensityExponent = 0;
-
-		m_iDimensionalExponentsInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcDimensionalExponents");
-		assert(m_iDimensionalExponentsInstance != 0);
+		return;
+	}
 
-		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "LengthExponent", sdaiINTEGER, &LengthExponent);
-		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "MassExponent", sdaiINTEGER, &MassExponent);
-		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "TimeExponent", sdaiINTEGER, &TimeExponent);
-		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "ElectricCurrentExponent", sdaiINTEGER, &ElectricCurrentExponent);
-		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "ThermodynamicTemperatureExponent", sdaiINTEGER, &ThermodynamicTemperatureExponent);
-		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "AmountOfSubstanceExponent", sdaiINTEGER, &AmountOfSubstanceExponent);
-		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "LuminousIntensityExponent", sdaiINTEGER, &LuminousIntensityExponent);
+	// At most once per PROGRESS_INTERVAL; the first and the last step of a phase are always reported
+	auto tpNow = chrono::steady_clock::now();
+	if ((enPhase == m_enProgressPhase) && (iDone > 0) && (iDone < iTotal) &&
+		((tpNow - m_tpProgress) < chrono::milliseconds(PROGRESS_INTERVAL)))
+	{
+		return;
 	}
 
-	return m_iDimensionalExponentsInstance;
+	m_enProgressPhase = enPhase;
+	m_tpProgress = tpNow;
+
+	(*m_pProgressCallback)(enPhase, iDone, iTotal);
 }
 
-SdaiInstance _exporter_base::getConversionBasedUnitInstance()
+void _gml2ifc_exporter::logWrite(enumLogEvent enLogEvent, const string& strEvent, const char* szKey/* = nullptr*/)
 {
-	if (m_iConversionBasedUnitInstance == 0)
-	{
-		m_iConversionBasedUnitInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcConversionBasedUnit");
-		assert(m_iConversionBasedUnitInstance != 0);
-
-		sdaiPutAttrBN(m_iConversionBasedUnitInstance, "Dimensions", sdaiINSTANCE, (void*)getDimensionalExponentsInstance());
-		sdaiPutAttrBN(m_iConversionBasedUnitInstance, "UnitType", sdaiENUM, "PLANEANGLEUNIT");
-		sdaiPutAttrBN(m_iConversionBasedUnitInstance, "Name", sdaiSTRING, "DEGREE");
-		sdaiPutAttrBN(m_iConversionBasedUnitInstance, "ConversionFactor", sdaiINSTANCE, (void*)buildMeasureWithUnitInstance());
-	}
-
-	return m_iConversionBasedUnitInstance;
+	m_pLogPipeline->write(enLogEvent, strEvent, szKey);
 }
 
-SdaiInstance _exporter_base::getUnitAssignmentInstance()
+void _gml2ifc_exporter::setFormatSettings(OwlModel iOwlModel)
 {
-	if (m_iUnitAssignmentInstance == 0)
-	{
-		m_iUnitAssignmentInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcUnitAssignment");
-		assert(m_iUnitAssignmentInstance != 0);
+	string strSettings = "111111000000001111000001110001";
 
-		SdaiAggr pUnits = sdaiCreateAggrBN(m_iUnitAssignmentInstance, "Units");
-		assert(pUnits != nullptr);
+	bitset<64> bitSettings(strSettings);
+	int64_t iSettings = bitSettings.to_ulong();
 
-		m_iLengthUnitInstance = buildSIUnitInstance("LENGTHUNIT", nullptr, "METRE");
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)m_iLengthUnitInstance);
-
-		m_iAreaUnitInstance = buildSIUnitInstance("AREAUNIT", nullptr, "SQUARE_METRE");
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)m_iAreaUnitInstance);
+	string strMask = "11111111111111111111011101110111";
+	bitset<64> bitMask(strMask);
+	int64_t iMask = bitMask.to_ulong();
 
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("VOLUMEUNIT", nullptr, "CUBIC_METRE"));
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)getConversionBasedUnitInstance());
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("SOLIDANGLEUNIT", nullptr, "STERADIAN"));
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("MASSUNIT", nullptr, "GRAM"));
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("TIMEUNIT", nullptr, "SECOND"));
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("THERMODYNAMICTEMPERATUREUNIT", nullptr, "DEGREE_CELSIUS"));
-		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("LUMINOUSINTENSITYUNIT", nullptr, "LUMEN"));
-	}
+	SetFormat(iOwlModel, (int64_t)iSettings, (int64_t)iMask);
 
-	return m_iUnitAssignmentInstance;
+	SetBehavior(iOwlModel, 2048 + 4096, 2048 + 4096);
 }
 
-SdaiInstance _exporter_base::getWorldCoordinateSystemInstance()
+void _gml2ifc_exporter::executeCore(OwlInstance iRootInstance, _output_stream* pOutputStream)
 {
-	if (m_iWorldCoordinateSystemInstance == 0)
-	{
-		m_iWorldCoordinateSystemInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcAxis2Placement3D");
-		assert(m_iWorldCoordinateSystemInstance != 0);
+	assert(iRootInstance != 0);
+	assert(pOutputStream != nullptr);
 
-		sdaiPutAttrBN(m_iWorldCoordinateSystemInstance, "Location", sdaiINSTANCE, (void*)buildCartesianPointInstance(0., 0., 0.));
-	}	
+	logInfo("Exporting...");
 
-	return m_iWorldCoordinateSystemInstance;
-}
+	_metrics_scope metrics(m_pMetrics);
+	m_pMetrics->reset();
 
-SdaiInstance _exporter_base::getProjectInstance()
-{
-	if (m_iProjectInstance == 0) 
+	if (m_pExporter != nullptr)
 	{
-		m_iProjectInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcProject");
-		assert(m_iProjectInstance != 0);
-
-		sdaiPutAttrBN(m_iProjectInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-		sdaiPutAttrBN(m_iProjectInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-		sdaiPutAttrBN(m_iProjectInstance, "Name", sdaiSTRING, "Default Project"); //#tbd
-		sdaiPutAttrBN(m_iProjectInstance, "Description", sdaiSTRING, "Description of Default Project"); //#tbd
-		sdaiPutAttrBN(m_iProjectInstance, "UnitsInContext", sdaiINSTANCE, (void*)getUnitAssignmentInstance());
-
-		SdaiAggr pRepresentationContexts = sdaiCreateAggrBN(m_iProjectInstance, "RepresentationContexts");
-		assert(pRepresentationContexts != nullptr);
+		m_pExporter->execute(iRootInstance, nullptr, pOutputStream);
+	}
+	else
+	{
+		logErr("Not supported format.");
+	}
 
-		sdaiAppend(pRepresentationContexts, sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+	if (isCancelled())
+	{
+		logWarn("Cancelled.");
+	}
+	else
+	{
+		logInfo("Done.");
 	}
 
-	return m_iProjectInstance;
+	flushLog();
 }
 
-SdaiInstance _exporter_base::getSiteInstance(SdaiInstance& iSiteInstancePlacement)
+/*static*/ bool _gml2ifc_exporter::isIfcZIP(const wstring& strOuputFile)
 {
-	if (m_iSiteInstance == 0)
+	const wstring strExtension = L".ifczip";
+	if (strOuputFile.size() <= strExtension.size())
 	{
-		assert(m_iSiteInstancePlacement == 0);
-
-		OwlInstance iRootInstance = getSite()->getOwlRootInstance();
-		assert(iRootInstance != 0);
-
-		OwlClass iInstanceClass = GetInstanceClass(iRootInstance);
-		assert(iInstanceClass != 0);
-
-		char* szClassName = nullptr;
-		GetNameOfClass(iInstanceClass, &szClassName);
-		assert(szClassName != nullptr);
+		return false;
+	}
 
-		_matrix mtxSite;
-		onPreCreateSite(&mtxSite);
+	wstring strOuputFileExtension = strOuputFile.substr(strOuputFile.size() - strExtension.size());
+	transform(strOuputFileExtension.begin(), strOuputFileExtension.end(), strOuputFileExtension.begin(), ::towlower);
 
-		m_iSiteInstancePlacement = 0;
-		m_iSiteInstance = buildSiteInstance(
-			szClassName,
-			szClassName,
-			&mtxSite,
-			m_iSiteInstancePlacement);
-		assert(m_iSiteInstance != 0);
-		assert(m_iSiteInstancePlacement != 0);
+	return strOuputFileExtension == strExtension;
+}
 
-		onPostCreateSite(m_iSiteInstance);
-	} // if (m_iSiteInstance == 0)
+/*static*/ string _gml2ifc_exporter::getIfcZIPEntryName(const wstring& strOuputFile)
+{
+	// <name>.ifcZIP => <name>.ifc
+	size_t iNameStart = strOuputFile.find_last_of(L"\\/");
+	iNameStart = iNameStart != wstring::npos ? iNameStart + 1 : 0;
 
-	iSiteInstancePlacement = m_iSiteInstancePlacement;
+	wstring strEntryName = strOuputFile.substr(iNameStart, strOuputFile.size() - iNameStart - 3);
 
-	return m_iSiteInstance;
+	return (LPCSTR)CW2A(strEntryName.c_str());
 }
 
-SdaiInstance _exporter_base::getGeometricRepresentationContextInstance()
+// Large GML files: the members are split in chunks imported in parallel - the first one into this
+// model, the others into the chunk exporters; the chunks are exported into a single IFC model
+// bFailed - a chunk can't be read
+bool _gml2ifc_exporter::importChunks(const wstring& strInputFile, int iChunksCount, bool& bFailed)
 {
-	if (m_iGeometricRepresentationContextInstance == 0)
+	assert(!strInputFile.empty());
+	assert(iChunksCount > 1);
+	assert(m_vecChunks.empty());
+
+	bFailed = false;
+
+	_mapped_file mappedFile(strInputFile);
+	if (!mappedFile.open())
 	{
-		double dPrecision = 0.00001;
-		int_t iCoordinateSpaceDimension = 3;
+		logWarn("The input file can't be memory-mapped; chunked import is disabled.");
 
-		m_iGeometricRepresentationContextInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcGeometricRepresentationContext");
-		assert(m_iGeometricRepresentationContextInstance != 0);
+		return false;
+	}
 
-		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "ContextType", sdaiSTRING, "Model");
-		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "CoordinateSpaceDimension", sdaiINTEGER, &iCoordinateSpaceDimension);
-		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "Precision", sdaiREAL, &dPrecision);
-		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "WorldCoordinateSystem", sdaiINSTANCE, (void*)getWorldCoordinateSystemInstance());
-		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "TrueNorth", sdaiINSTANCE, (void*)buildDirectionInstance2D(0., 1.));
+	if ((int64_t)mappedFile.getSize() < m_pSettingsProvider->getImportChunkThreshold())
+	{
+		return false;
 	}
 
-	return m_iGeometricRepresentationContextInstance;
-}
+	auto tpStart = chrono::steady_clock::now();
 
-void _exporter_base::createIfcModel(const wchar_t* szSchemaName)
-{
-	assert(szSchemaName != nullptr);
+	_gml_splitter splitter(mappedFile.getData(), mappedFile.getSize());
 
-	if (m_iSdaiModel != 0)
+	vector<_chunk_input_stream*> vecChunkStreams;
+	if (!splitter.split(iChunksCount, vecChunkStreams))
 	{
-		sdaiCloseModel(m_iSdaiModel);
-		m_iSdaiModel = 0;
-	}	
+		logInfo(_string::format("Chunked import is not possible: %s", splitter.getError().c_str()));
 
-	m_iSdaiModel = sdaiCreateModelBNUnicode(1, NULL, szSchemaName);
-	assert(m_iSdaiModel != 0);
+		return false;
+	}
 
-	//#tbd
-	char    description[512], timeStamp[512];
-	time_t  t;
-	struct tm* tInfo;
+	logInfo(_string::format("Split: %d members, %d chunks, %.1f ms",
+		(int)splitter.getMembersCount(),
+		(int)vecChunkStreams.size(),
+		chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count()));
 
-	time(&t);
-	tInfo = localtime(&t);
+	for (size_t iChunk = 1; iChunk < vecChunkStreams.size(); iChunk++)
+	{
+		auto pChunk = new _gml2ifc_exporter(m_strRootFolder, m_pLogCallback, nullptr);
+		pChunk->setProgressCallback(m_pProgressCallback);
+		pChunk->setCancellationToken(m_pCancellationToken);
 
-	//#tbd
-	if (true)//view == COORDINATIONVIEW) {
-		//if (m_Quantities.GetCheck()) {
-		memcpy(description, "ViewDefinition [CoordinationView, QuantityTakeOffAddOnView]", sizeof("ViewDefinition [CoordinationView, QuantityTakeOffAddOnView]"));
-	//}
-	/*else {
-		memcpy(description, "ViewDefinition [CoordinationView]", sizeof("ViewDefinition [CoordinationView]"));
-	}*/
-	/*}
-	else {
-		ASSERT(view == PRESENTATIONVIEW);
-		if (m_Quantities.GetCheck()) {
-			memcpy(description, "ViewDefinition [PresentationView, QuantityTakeOffAddOnView]", sizeof("ViewDefinition [PresentationView, QuantityTakeOffAddOnView]"));
-		}
-		else {
-			memcpy(description, "ViewDefinition [PresentationView]", sizeof("ViewDefinition [PresentationView]"));
+		// "Importing...", "Done.", ... once
+		if ((int)pChunk->m_pLogPipeline->getMinLevel() < (int)enumLogEvent::warning)
+		{
+			pChunk->m_pLogPipeline->setMinLevel(enumLogEvent::warning);
 		}
-	}*/
 
-	sprintf(&timeStamp[0], "%d", 1900 + tInfo->tm_year);
-	sprintf(&timeStamp[4], "%d", 100 + 1 + tInfo->tm_mon);
-	sprintf(&timeStamp[7], "%d", 100 + tInfo->tm_mday);
-	timeStamp[4] = '-';
-	timeStamp[7] = '-';
-	sprintf(&timeStamp[10], "%d", 100 + tInfo->tm_hour);
-	sprintf(&timeStamp[13], "%d", 100 + tInfo->tm_min);
-	sprintf(&timeStamp[16], "%d", 100 + tInfo->tm_sec);
-	timeStamp[10] = 'T';
-	timeStamp[13] = ':';
-	timeStamp[16] = ':';
-	timeStamp[19] = 0;
+		m_vecChunks.push_back(pChunk);
+	} // for (size_t iChunk = ...
 
-	SetSPFFHeader(
-		m_iSdaiModel,
-		(const char*)description,           //  description //#tbd
-		"2;1",                              //  implementationLevel //#tbd
-		(const char*)nullptr,	            //  name //#tbd
-		(const char*)&timeStamp[0],         //  timeStamp //#tbd
-		"Architect",                        //  author //#tbd
-		"Building Designer Office",         //  organization //#tbd
-		"IFC Engine DLL version 1.03 beta", //  preprocessorVersion //#tbd
-		"IFC Engine DLL version 1.03 beta", //  originatingSystem //#tbd
-		"The authorising person",           //  authorization //#tbd
-#ifdef _WINDOWS
-		CW2A(szSchemaName)                  //  fileSchema //#tbd
-#else
-#ifdef __EMSCRIPTEN__
-		(LPCSTR)CW2A(szSchemaName)                  //  fileSchema //#tbd
-#else
-#error NOT IMPLEMENTED!
-#endif
-#endif		
-	);
-}
+#ifndef _GML2IFC_NO_THREADS
+	vector<thread*> vecThreads;
+	for (size_t iChunk = 1; iChunk < vecChunkStreams.size(); iChunk++)
+	{
+		auto pChunk = m_vecChunks[iChunk - 1];
+		auto pChunkStream = vecChunkStreams[iChunk];
 
-void _exporter_base::saveIfcFile(const wchar_t* szFileName)
-{
-	assert(szFileName != nullptr);
-	assert(m_iSdaiModel != 0);
+		vecThreads.push_back(new thread([this, pChunk, pChunkStream]()
+			{
+				_log_context_scope logContext(getLogContext());
+				_metrics_scope metrics(m_pMetrics, enumPhase::Import);
 
-	sdaiSaveModelBNUnicode(m_iSdaiModel, szFileName);
-}
+				pChunk->importGML(pChunkStream);
+			}));
+	}
+#endif
 
-SdaiInstance _exporter_base::buildSIUnitInstance(const char* szUnitType, const char* szPrefix, const char* szName)
-{
-	assert(szUnitType != nullptr);
-	assert(szName != nullptr);
+	m_iOwlRootInstance = vecChunkStreams[0]->import(m_iOwlModel);
+	if (vecChunkStreams[0]->isFailed())
+	{
+		logErr(_string::format("Failed to read '%s'.", vecChunkStreams[0]->getName().c_str()));
 
-	SdaiInstance iSIUnitInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcSIUnit");
-	assert(iSIUnitInstance != 0);
+		bFailed = true;
+	}
 
-	sdaiPutAttrBN(iSIUnitInstance, "Dimensions", sdaiINTEGER, (void*)nullptr);
-	sdaiPutAttrBN(iSIUnitInstance, "UnitType", sdaiENUM, szUnitType);
-	if (szPrefix != nullptr) 
+#ifndef _GML2IFC_NO_THREADS
+	for (auto pThread : vecThreads)
 	{
-		sdaiPutAttrBN(iSIUnitInstance, "Prefix", sdaiENUM, szPrefix);
+		pThread->join();
+		delete pThread;
 	}
-	sdaiPutAttrBN(iSIUnitInstance, "Name", sdaiENUM, szName);
+#else
+	for (size_t iChunk = 1; iChunk < vecChunkStreams.size(); iChunk++)
+	{
+		m_vecChunks[iChunk - 1]->importGML(vecChunkStreams[iChunk]);
+	}
+#endif
 
-	return iSIUnitInstance;
-}
+	for (auto pChunkStream : vecChunkStreams)
+	{
+		delete pChunkStream;
+	}
 
-SdaiInstance _exporter_base::buildMeasureWithUnitInstance()
-{
-	double	dValueComponent = 0.01745; //#tbd
-	SdaiADB pValueComponentADB = sdaiCreateADB(sdaiREAL, &dValueComponent);
-	assert(pValueComponentADB != nullptr);
+	// See importCore()
+	for (auto pChunk : m_vecChunks)
+	{
+		if (pChunk->getOwlRootInstance() == 0)
+		{
+			bFailed = true;
+		}
+	}
 
-	SdaiInstance iMeasureWithUnitInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMeasureWithUnit");
-	assert(iMeasureWithUnitInstance != 0);	
+	// The SRS transformations of the chunks are requested on this thread, as for this model
+	// (see retrieveSRSDataOnImport()); CSRSTransformer is not called by the import threads
+	if (!bFailed && (m_pSRSTransformer != nullptr))
+	{
+		for (auto pChunk : m_vecChunks)
+		{
+			pChunk->m_pSRSTransformer = m_pSRSTransformer;
+			pChunk->retrieveSRSDataOnImport();
+		}
+	}
 
-	sdaiPutADBTypePath(pValueComponentADB, 1, "IFCREAL");
-	sdaiPutAttrBN(iMeasureWithUnitInstance, "ValueComponent", sdaiADB, (void*)pValueComponentADB);
-	sdaiPutAttrBN(iMeasureWithUnitInstance, "UnitComponent", sdaiINSTANCE, (void*)buildSIUnitInstance("PLANEANGLEUNIT", NULL, "RADIAN"));
-	
-	return iMeasureWithUnitInstance;
+	return true;
 }
 
-SdaiInstance _exporter_base::buildDirectionInstance2D(double dX, double dY)
+void _gml2ifc_exporter::deleteChunks()
 {
-	SdaiInstance iDirectionInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcDirection");
-	assert(iDirectionInstance != 0);
-
-	SdaiAggr pDirectionRatios = sdaiCreateAggrBN(iDirectionInstance, "DirectionRatios");
-	assert(pDirectionRatios != nullptr);
-
-	sdaiAppend(pDirectionRatios, sdaiREAL, &dX);
-	sdaiAppend(pDirectionRatios, sdaiREAL, &dY);
-
-	return iDirectionInstance;
+	for (auto pChunk : m_vecChunks)
+	{
+		delete pChunk;
+	}
+	m_vecChunks.clear();
 }
 
-SdaiInstance _exporter_base::buildDirectionInstance3D(double dX, double dY, double dZ)
+void _gml2ifc_exporter::createExporter()
 {
-	SdaiInstance iDirectionInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcDirection");
-	assert(iDirectionInstance != 0);
+	assert(m_pExporter == nullptr);
 
-	SdaiAggr pDirectionRatios = sdaiCreateAggrBN(iDirectionInstance, "DirectionRatios");
-	assert(pDirectionRatios != nullptr);
+	if (m_iOwlRootInstance == 0)
+	{
+		return;
+	}
 
-	sdaiAppend(pDirectionRatios, sdaiREAL, &dX);
-	sdaiAppend(pDirectionRatios, sdaiREAL, &dY);
-	sdaiAppend(pDirectionRatios, sdaiREAL, &dZ);
+	if (IsGML(m_iOwlModel))
+	{
+		m_pExporter = new _gml_exporter(this);
+	}
+	else if (IsCityGML(m_iOwlModel))
+	{
+		m_pExporter = new _citygml_exporter(this);
+	}
+	else if (IsCityJSON(m_iOwlModel))
+	{
+		m_pExporter = new _cityjson_exporter(this);
+	}
+}
 
-	return iDirectionInstance;
+void _gml2ifc_exporter::deleteExporter()
+{
+	delete m_pExporter;
+	m_pExporter = nullptr;
 }
 
-SdaiInstance _exporter_base::buildCartesianPointInstance(double dX, double dY, double dZ)
+// '$EXPORT $CACHE': an empty model of the same format is imported instead of the input - the exporter
+// needs the OWL classes only, the city models are loaded from the cache (see _citygml_exporter::loadCityModel())
+bool _gml2ifc_exporter::importCachedModel()
 {
-	SdaiInstance iCartesianPointInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcCartesianPoint");
-	assert(iCartesianPointInstance != 0);
+	assert(m_pCityModelCache != nullptr);
+	assert(m_iOwlModel != 0);
 
-	SdaiAggr pCoordinates = sdaiCreateAggrBN(iCartesianPointInstance, "Coordinates");
-	assert(pCoordinates != nullptr);
+	string strModel;
+	switch (m_pCityModelCache->getFormat())
+	{
+		case enumCityModelFormat::GML:
+		{
+			strModel = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+				"<gml:FeatureCollection xmlns:gml=\"http://www.opengis.net/gml\"></gml:FeatureCollection>";
+		}
+		break;
 
-	sdaiAppend(pCoordinates, sdaiREAL, &dX);
-	sdaiAppend(pCoordinates, sdaiREAL, &dY);
-	sdaiAppend(pCoordinates, sdaiREAL, &dZ);
+		case enumCityModelFormat::CityGML:
+		{
+			strModel = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+				"<core:CityModel xmlns:core=\"http://www.opengis.net/citygml/2.0\" xmlns:gml=\"http://www.opengis.net/gml\"></core:CityModel>";
+		}
+		break;
 
-	return iCartesianPointInstance;
-}
+		case enumCityModelFormat::CityJSON:
+		{
+			strModel = "{\"type\": \"CityJSON\", \"version\": \"1.1\", "
+				"\"transform\": {\"scale\": [1.0, 1.0, 1.0], \"translate\": [0.0, 0.0, 0.0]}, "
+				"\"CityObjects\": {}, \"vertices\": []}";
+		}
+		break;
 
-SdaiInstance _exporter_base::buildSiteInstance(
-	const char* szName,
-	const char* szDescription,
-	_matrix* pMatrix, 
-	SdaiInstance& iSiteInstancePlacement)
-{
-	assert(pMatrix != nullptr);
+		default:
+		{
+			return false;
+		}
+	} // switch (m_pCityModelCache->getFormat())
 
-	SdaiInstance iSiteInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcSite");
-	assert(iSiteInstance != 0);
+	m_iOwlRootInstance = ImportGISModelA(m_iOwlModel, (const unsigned char*)strModel.c_str(), strModel.size());
+	if ((m_iOwlRootInstance == 0) || (getFormat(m_iOwlModel) != m_pCityModelCache->getFormat()))
+	{
+		logWarn("City Model Cache: the format can't be restored; the input is imported.");
 
-	sdaiPutAttrBN(iSiteInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iSiteInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iSiteInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iSiteInstance, "Description", sdaiSTRING, szDescription);
+		CloseModel(m_iOwlModel);
 
-	iSiteInstancePlacement = buildLocalPlacementInstance(pMatrix, 0);
-	assert(iSiteInstancePlacement != 0);
+		m_iOwlModel = CreateModel();
+		assert(m_iOwlModel != 0);
 
-	sdaiPutAttrBN(iSiteInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iSiteInstancePlacement);
-	sdaiPutAttrBN(iSiteInstance, "CompositionType", sdaiENUM, "ELEMENT");
+		setFormatSettings(m_iOwlModel);
 
-	return iSiteInstance;
+		m_iOwlRootInstance = 0;
+
+		return false;
+	}
+
+	m_setLODs = m_pCityModelCache->getLODs();
+	m_bCachedImport = true;
+
+	return true;
 }
 
-SdaiInstance _exporter_base::buildLocalPlacementInstance(_matrix* pMatrix, SdaiInstance iPlacementRelativeTo)
+// '$EXPORT $CACHE': the city model (all LODs) is not cached - the input is imported
+void _gml2ifc_exporter::importOnCacheMiss()
 {
-	SdaiInstance iLocalPlacementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcLocalPlacement");
-	assert(iLocalPlacementInstance != 0);
+	if (!m_bCachedImport)
+	{
+		return;
+	}
 
-	if (iPlacementRelativeTo != 0) 
+	assert(m_pCityModelCache != nullptr);
+
+	if (m_pCityModelCache->hasCityModel())
 	{
-		sdaiPutAttrBN(iLocalPlacementInstance, "PlacementRelTo", sdaiINSTANCE, (void*)iPlacementRelativeTo);
+		return;
 	}
-	sdaiPutAttrBN(iLocalPlacementInstance, "RelativePlacement", sdaiINSTANCE, (void*)buildAxis2Placement3DInstance(pMatrix));
 
-	return iLocalPlacementInstance;
+	logInfo("City Model Cache: the city model is not cached.");
+
+	importFile(m_pCityModelCache->getInputFile(), false);
 }
 
-SdaiInstance _exporter_base::buildAxis2Placement3DInstance(_matrix* pMatrix)
+void _gml2ifc_exporter::deleteCityModelCache()
 {
-	SdaiInstance iAxis2Placement3DInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcAxis2Placement3D");
-	assert(iAxis2Placement3DInstance != 0);
+	delete m_pCityModelCache;
+	m_pCityModelCache = nullptr;
 
-	sdaiPutAttrBN(iAxis2Placement3DInstance, "Location", sdaiINSTANCE, (void*)buildCartesianPointInstance(pMatrix->_41, pMatrix->_42, pMatrix->_43));
-	sdaiPutAttrBN(iAxis2Placement3DInstance, "Axis", sdaiINSTANCE, (void*)buildDirectionInstance3D(pMatrix->_31, pMatrix->_32, pMatrix->_33));
-	sdaiPutAttrBN(iAxis2Placement3DInstance, "RefDirection", sdaiINSTANCE, (void*)buildDirectionInstance3D(pMatrix->_11, pMatrix->_12, pMatrix->_13));
-
-	return iAxis2Placement3DInstance;
+	m_bCachedImport = false;
 }
 
-SdaiInstance _exporter_base::buildBuildingInstance(
-	const char* szName,
-	const char* szDescription,
-	_matrix* pMatrix,
-	SdaiInstance iPlacementRelativeTo,
-	SdaiInstance& iBuildingInstancePlacement)
+// See createExporter()
+/*static*/ enumCityModelFormat _gml2ifc_exporter::getFormat(OwlModel iOwlModel)
 {
-	assert(pMatrix != nullptr);
-	assert(iPlacementRelativeTo != 0);
+	assert(iOwlModel != 0);
 
-	SdaiInstance iBuildingInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcBuilding");
-	assert(iBuildingInstance != 0);
+	if (IsGML(iOwlModel))
+	{
+		return enumCityModelFormat::GML;
+	}
 
-	sdaiPutAttrBN(iBuildingInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iBuildingInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iBuildingInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iBuildingInstance, "Description", sdaiSTRING, szDescription);
+	if (IsCityGML(iOwlModel))
+	{
+		return enumCityModelFormat::CityGML;
+	}
 
-	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
-	assert(iBuildingInstancePlacement != 0);
+	if (IsCityJSON(iOwlModel))
+	{
+		return enumCityModelFormat::CityJSON;
+	}
 
-	sdaiPutAttrBN(iBuildingInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
-	sdaiPutAttrBN(iBuildingInstance, "CompositionType", sdaiENUM, "ELEMENT");
-	//sdaiPutAttrBN(iBuildingInstance, "BuildingAddress", sdaiINSTANCE, (void*)buildPostalAddress()); //#tbd
+	return enumCityModelFormat::Unknown;
+}
 
-	return iBuildingInstance;
+void _gml2ifc_exporter::retrieveSRSDataOnImport()
+{
+	if ((m_pSRSTransformer == nullptr) || (m_iOwlRootInstance == 0))
+	{
+		return;
+	}
+
+	// The transformations run while the caller prepares the export
+	m_iTransformationsCount = retrieveSRSDataCore(m_iOwlRootInstance);
+
+	// Chunked import; see importChunks()
+	for (auto pChunk : m_vecChunks)
+	{
+		m_iTransformationsCount += pChunk->m_iTransformationsCount;
+	}
 }
 
-SdaiInstance _exporter_base::buildFeatureInstance(
-	const char* szName,
-	const char* szDescription,
-	_matrix* pMatrix,
-	SdaiInstance iPlacementRelativeTo,
-	SdaiInstance& iBuildingInstancePlacement,
-	const vector<SdaiInstance>& vecRepresentations)
+int _gml2ifc_exporter::retrieveSRSDataCore(OwlInstance iRootInstance)
 {
-	assert(szName != nullptr);
-	assert(szDescription != nullptr);
-	assert(pMatrix != nullptr);
-	assert(iPlacementRelativeTo != 0);
-	assert(!vecRepresentations.empty());
+	assert(iRootInstance != 0);
 
-	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcBuildingElementProxy");
-	assert(iBuildingElementInstance != 0);
+	logInfo("Retrieving SRS Data...");
 
-	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
+	int iTransformationsCount = 0;
 
-	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
-	assert(iBuildingInstancePlacement != 0);
+	if (m_pExporter != nullptr)
+	{
+		_string_table_scope stringTableScope(m_pExporter->getStringTable());
 
-	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
-	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
+		iTransformationsCount = m_pExporter->retrieveSRSData(iRootInstance);
 
-	return iBuildingElementInstance;
-}
+		logInfo("Done.");
+	}
+	else
+	{
+		logErr("Not supported format.");
+	}
 
-SdaiInstance _exporter_base::buildTransportElementInstance(
-	const char* szName,
-	const char* szDescription,
-	_matrix* pMatrix,
-	SdaiInstance iPlacementRelativeTo,
-	SdaiInstance& iBuildingInstancePlacement,
-	const vector<SdaiInstance>& vecRepresentations)
-{
-	assert(szName != nullptr);
-	assert(szDescription != nullptr);
-	assert(pMatrix != nullptr);
-	assert(iPlacementRelativeTo != 0);
-	assert(!vecRepresentations.empty());
+	flushLog();
 
-	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcTransportElement");
-	assert(iBuildingElementInstance != 0);
+	return iTransformationsCount;
+}
 
-	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
+// ************************************************************************************************
+// Empty value
+static const string EMPTY_STRING;
 
-	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
-	assert(iBuildingInstancePlacement != 0);
+// ************************************************************************************************
+_string_table::_string_table(OwlModel iOwlModel)
+	: m_iOwlModel(iOwlModel)
+	, m_iTagProperty(0)
+	, m_iScopesCount(0)
+	, m_mtx()
+	, m_dqStrings()
+	, m_mapIds()
+	, m_mapValues()
+	, m_mapTags()
+	, m_mapClassNames()
+	, m_strKey()
+{
+	assert(m_iOwlModel != 0);
 
-	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
-	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
+	m_iTagProperty = GetPropertyByName(m_iOwlModel, "tag");
+	assert(m_iTagProperty != 0);
+}
 
-	return iBuildingElementInstance;
+/*virtual*/ _string_table::~_string_table()
+{
+	assert(m_iScopesCount == 0);
 }
 
-SdaiInstance _exporter_base::buildFurnitureObjectInstance(
-	const char* szName,
-	const char* szDescription,
-	_matrix* pMatrix,
-	SdaiInstance iPlacementRelativeTo,
-	SdaiInstance& iBuildingInstancePlacement,
-	const vector<SdaiInstance>& vecRepresentations)
+void _string_table::beginScope()
 {
-	assert(szName != nullptr);
-	assert(szDescription != nullptr);
-	assert(pMatrix != nullptr);
-	assert(iPlacementRelativeTo != 0);
-	assert(!vecRepresentations.empty());
+	if (m_iScopesCount++ == 0)
+	{
+		SetCharacterSerialization(m_iOwlModel, 0, 0, false);
+	}
+}
 
-	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcFurnishingElement");
-	assert(iBuildingElementInstance != 0);
+void _string_table::endScope()
+{
+	assert(m_iScopesCount > 0);
 
-	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
+	if (--m_iScopesCount == 0)
+	{
+		SetCharacterSerialization(m_iOwlModel, 0, 0, true);
+	}
+}
 
-	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
-	assert(iBuildingInstancePlacement != 0);
+const string* _string_table::getValue(OwlInstance iInstance, RdfProperty iProperty)
+{
+	assert(iInstance != 0);
+	assert(iProperty != 0);
 
-	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
-	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
+	lock_guard<mutex> lock(m_mtx);
 
-	return iBuildingElementInstance;
+	int iId = readValue(iInstance, iProperty);
+
+	return iId != -1 ? &m_dqStrings[iId] : nullptr;
 }
 
-SdaiInstance _exporter_base::buildGeographicElementInstance(
-	const char* szName,
-	const char* szDescription,
-	_matrix* pMatrix,
-	SdaiInstance iPlacementRelativeTo,
-	SdaiInstance& iBuildingInstancePlacement,
-	const vector<SdaiInstance>& vecRepresentations)
+int _string_table::getTagId(OwlInstance iInstance)
 {
-	assert(szName != nullptr);
-	assert(szDescription != nullptr);
-	assert(pMatrix != nullptr);
-	assert(iPlacementRelativeTo != 0);
-	assert(!vecRepresentations.empty());
-
-	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcGeographicElement");
-	assert(iBuildingElementInstance != 0);
+	assert(iInstance != 0);
 
-	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
+	lock_guard<mutex> lock(m_mtx);
 
-	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
-	assert(iBuildingInstancePlacement != 0);
+	auto itTag = m_mapTags.find(iInstance);
+	if (itTag != m_mapTags.end())
+	{
+		return itTag->second;
+	}
 
-	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
-	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
+	int iId = readValue(iInstance, m_iTagProperty);
+	m_mapTags[iInstance] = iId;
 
-	return iBuildingElementInstance;
+	return iId;
 }
 
-SdaiInstance _exporter_base::buildBuildingStoreyInstance(_matrix* pMatrix, SdaiInstance iPlacementRelativeTo, SdaiInstance& iBuildingStoreyInstancePlacement)
+int _string_table::getClassNameId(OwlClass iClass)
 {
-	assert(pMatrix != nullptr);
-	assert(iPlacementRelativeTo != 0);
-
-	SdaiInstance iBuildingStoreyInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcBuildingStorey");
-	assert(iBuildingStoreyInstance != 0);
+	assert(iClass != 0);
 
-	sdaiPutAttrBN(iBuildingStoreyInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iBuildingStoreyInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iBuildingStoreyInstance, "Name", sdaiSTRING, "Default Building Storey"); //#tbd
-	sdaiPutAttrBN(iBuildingStoreyInstance, "Description", sdaiSTRING, "Description of Default Building Storey"); //#tbd
+	lock_guard<mutex> lock(m_mtx);
 
-	iBuildingStoreyInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
-	assert(iBuildingStoreyInstancePlacement != 0);
+	auto itClassName = m_mapClassNames.find(iClass);
+	if (itClassName != m_mapClassNames.end())
+	{
+		return itClassName->second;
+	}
 
-	sdaiPutAttrBN(iBuildingStoreyInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingStoreyInstancePlacement);
-	sdaiPutAttrBN(iBuildingStoreyInstance, "CompositionType", sdaiENUM, "ELEMENT");
+	char* szClassName = nullptr;
+	GetNameOfClass(iClass, &szClassName);
+	assert(szClassName != nullptr);
 
-	double dElevation = 0;
-	sdaiPutAttrBN(iBuildingStoreyInstance, "Elevation", sdaiREAL, &dElevation);
+	int iId = intern(szClassName != nullptr ? szClassName : "");
+	m_mapClassNames[iClass] = iId;
 
-	return iBuildingStoreyInstance;
+	return iId;
 }
 
-SdaiInstance _exporter_base::buildProductDefinitionShapeInstance(const vector<SdaiInstance>& vecRepresentations)
+int _string_table::getId(const string& strValue)
 {
-	assert(!vecRepresentations.empty());
-
-	SdaiInstance iProductDefinitionShapeInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcProductDefinitionShape");
-	assert(iProductDefinitionShapeInstance != 0);
+	lock_guard<mutex> lock(m_mtx);
 
-	SdaiAggr pRepresentations = sdaiCreateAggrBN(iProductDefinitionShapeInstance, "Representations");
-	assert(pRepresentations != nullptr);
+	return intern(strValue);
+}
 
-	for (auto iRepresentation : vecRepresentations)
+const string& _string_table::getString(int iId)
+{
+	if (iId == -1)
 	{
-		sdaiAppend(pRepresentations, sdaiINSTANCE, (void*)iRepresentation);
+		return EMPTY_STRING;
 	}
 
-	return iProductDefinitionShapeInstance;
-}
-
-SdaiInstance _exporter_base::buildRelAggregatesInstance(
-	const char* szName, 
-	const char* szDescription, 
-	SdaiInstance iRelatingObjectInstance, 
-	const vector<SdaiInstance>& vecRelatedObjects)
-{
-	assert(iRelatingObjectInstance != 0);
-	assert(!vecRelatedObjects.empty());
-
-	SdaiInstance iRelAggregatesInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelAggregates");
-	assert(iRelAggregatesInstance != 0);
+	lock_guard<mutex> lock(m_mtx);
 
-	sdaiPutAttrBN(iRelAggregatesInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iRelAggregatesInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iRelAggregatesInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iRelAggregatesInstance, "Description", sdaiSTRING, szDescription);
-	sdaiPutAttrBN(iRelAggregatesInstance, "RelatingObject", sdaiINSTANCE, (void*)iRelatingObjectInstance);
+	assert((iId >= 0) && (iId < (int)m_dqStrings.size()));
 
-	SdaiAggr pRelatedObjects = sdaiCreateAggrBN(iRelAggregatesInstance, "RelatedObjects");
-	assert(pRelatedObjects != nullptr);
+	return m_dqStrings[iId];
+}
 
-	for (auto iRelatedObject : vecRelatedObjects)
+int _string_table::readValue(OwlInstance iInstance, RdfProperty iProperty)
+{
+	// Outside of a scope
+	if (m_iScopesCount == 0)
 	{
-		sdaiAppend(pRelatedObjects, sdaiINSTANCE, (void*)iRelatedObject);
+		SetCharacterSerialization(m_iOwlModel, 0, 0, false);
 	}
 
-	return iRelAggregatesInstance;
-}
+	wchar_t** szValue = nullptr;
+	int64_t iValuesCount = 0;
+	GetDatatypeProperty(
+		iInstance,
+		iProperty,
+		(void**)&szValue,
+		&iValuesCount);
 
-SdaiInstance _exporter_base::buildRelNestsInstance(
-	const char* szName,
-	const char* szDescription,
-	SdaiInstance iRelatingObjectInstance,
-	const vector<SdaiInstance>& vecRelatedObjects)
-{
-	assert(iRelatingObjectInstance != 0);
-	assert(!vecRelatedObjects.empty());
+	if (m_iScopesCount == 0)
+	{
+		SetCharacterSerialization(m_iOwlModel, 0, 0, true);
+	}
 
-	SdaiInstance iIfcRelNestsInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelNests");
-	assert(iIfcRelNestsInstance != 0);
+	if ((iValuesCount == 0) || (szValue == nullptr) || (szValue[0] == nullptr))
+	{
+		return -1;
+	}
 
-	sdaiPutAttrBN(iIfcRelNestsInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iIfcRelNestsInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iIfcRelNestsInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iIfcRelNestsInstance, "Description", sdaiSTRING, szDescription);
-	sdaiPutAttrBN(iIfcRelNestsInstance, "RelatingObject", sdaiINSTANCE, (void*)iRelatingObjectInstance);
+	assert(iValuesCount == 1);
 
-	SdaiAggr pRelatedObjects = sdaiCreateAggrBN(iIfcRelNestsInstance, "RelatedObjects");
-	assert(pRelatedObjects != nullptr);
+	// The buffer keeps its capacity; no allocation for the lookup
+	m_strKey.assign(szValue[0]);
 
-	for (auto iRelatedObject : vecRelatedObjects)
+	auto itValue = m_mapValues.find(m_strKey);
+	if (itValue != m_mapValues.end())
 	{
-		sdaiAppend(pRelatedObjects, sdaiINSTANCE, (void*)iRelatedObject);
+		return itValue->second;
 	}
 
-	return iIfcRelNestsInstance;
-}
-
-SdaiInstance _exporter_base::buildRelContainedInSpatialStructureInstance(
-	const char* szName,
-	const char* szDescription,
-	SdaiInstance iRelatingStructureInstance,
-	const vector<SdaiInstance>& vecRelatedElements)
-{
-	assert(iRelatingStructureInstance != 0);
-	assert(!vecRelatedElements.empty());
-
-	SdaiInstance iRelContainedInSpatialStructureInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelContainedInSpatialStructure");
-	assert(iRelContainedInSpatialStructureInstance != 0);
+	string strValue;
+	toUTF8(m_strKey.data(), m_strKey.size(), strValue);
 
-	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "Description", sdaiSTRING, szDescription);
-	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "RelatingStructure", sdaiINSTANCE, (void*)iRelatingStructureInstance);
+	int iId = intern(strValue);
+	m_mapValues[m_strKey] = iId;
 
-	SdaiAggr pRelatedElements = sdaiCreateAggrBN(iRelContainedInSpatialStructureInstance, "RelatedElements");
-	assert(pRelatedElements != nullptr);
+	return iId;
+}
 
-	for (auto iRelatedElement : vecRelatedElements)
+int _string_table::intern(const string& strValue)
+{
+	auto itId = m_mapIds.find(strValue);
+	if (itId != m_mapIds.end())
 	{
-		sdaiAppend(pRelatedElements, sdaiINSTANCE, (void*)iRelatedElement);
+		return itId->second;
 	}
 
-	return iRelContainedInSpatialStructureInstance;
+	// deque - the references to the strings are stable
+	int iId = (int)m_dqStrings.size();
+	m_dqStrings.push_back(strValue);
+	m_mapIds[strValue] = iId;
+
+	return iId;
 }
 
-SdaiInstance _exporter_base::buildBuildingElementInstance(
-	const char* szEntity,
-	const char* szName,
-	const char* szDescription,
-	_matrix* pMatrix,
-	SdaiInstance iPlacementRelativeTo,
-	SdaiInstance& iBuildingElementInstancePlacement,
-	const vector<SdaiInstance>& vecRepresentations)
+/*static*/ void _string_table::toUTF8(const wchar_t* szValue, size_t iLength, string& strValue)
 {
-	assert(szEntity != nullptr);
-	assert(szName != nullptr);
-	assert(szDescription != nullptr);
-	assert(pMatrix != nullptr);
-	assert(iPlacementRelativeTo != 0);
-	assert(!vecRepresentations.empty());
+	assert(szValue != nullptr);
 
-	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, szEntity);
-	assert(iBuildingElementInstance != 0);
+	strValue.clear();
+	strValue.reserve(iLength);
 
-	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
+	for (size_t iIndex = 0; iIndex < iLength; iIndex++)
+	{
+		uint32_t iCodePoint = (uint32_t)szValue[iIndex];
 
-	iBuildingElementInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
-	assert(iBuildingElementInstancePlacement != 0);
+#ifdef _WINDOWS
+		// UTF-16
+		if ((iCodePoint >= 0xD800) && (iCodePoint <= 0xDBFF) &&
+			((iIndex + 1) < iLength) &&
+			((uint32_t)szValue[iIndex + 1] >= 0xDC00) && ((uint32_t)szValue[iIndex + 1] <= 0xDFFF))
+		{
+			iCodePoint = 0x10000 + ((iCodePoint - 0xD800) << 10) + ((uint32_t)szValue[iIndex + 1] - 0xDC00);
+			iIndex++;
+		}
+#endif // _WINDOWS
 
-	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingElementInstancePlacement);
-	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
+		// Unpaired surrogate/out of range
+		if (((iCodePoint >= 0xD800) && (iCodePoint <= 0xDFFF)) || (iCodePoint > 0x10FFFF))
+		{
+			iCodePoint = 0xFFFD;
+		}
 
-	return iBuildingElementInstance;
+		if (iCodePoint < 0x80)
+		{
+			strValue += (char)iCodePoint;
+		}
+		else if (iCodePoint < 0x800)
+		{
+			strValue += (char)(0xC0 | (iCodePoint >> 6));
+			strValue += (char)(0x80 | (iCodePoint & 0x3F));
+		}
+		else if (iCodePoint < 0x10000)
+		{
+			strValue += (char)(0xE0 | (iCodePoint >> 12));
+			strValue += (char)(0x80 | ((iCodePoint >> 6) & 0x3F));
+			strValue += (char)(0x80 | (iCodePoint & 0x3F));
+		}
+		else
+		{
+			strValue += (char)(0xF0 | (iCodePoint >> 18));
+			strValue += (char)(0x80 | ((iCodePoint >> 12) & 0x3F));
+			strValue += (char)(0x80 | ((iCodePoint >> 6) & 0x3F));
+			strValue += (char)(0x80 | (iCodePoint & 0x3F));
+		}
+	} // for (size_t iIndex = ...
 }
 
-SdaiInstance _exporter_base::buildRepresentationMap(_matrix* pMatrix, const vector<SdaiInstance>& vecMappedRepresentations)
+// ************************************************************************************************
+_exporter_base::_exporter_base(_gml2ifc_exporter* pSite)
+	: m_pSite(pSite)
+	, m_pStringTable(nullptr)
+	, m_iDefaultMaterialId(-1)
+	, m_iSdaiModel(0)
+	, m_iPersonInstance(0)
+	, m_iOrganizationInstance(0)
+	, m_iPersonAndOrganizationInstance(0)	
+	, m_iApplicationInstance(0)
+	, m_iOwnerHistoryInstance(0)
+	, m_iDimensionalExponentsInstance(0)
+	, m_iConversionBasedUnitInstance(0)
+	, m_iUnitAssignmentInstance(0)
+	, m_iLengthUnitInstance(0)
+	, m_iAreaUnitInstance(0)
+	, m_iWorldCoordinateSystemInstance(0)
+	, m_iProjectInstance(0)
+	, m_iSiteInstance(0) 
+	, m_iSiteInstancePlacement(0) 
+	, m_iGeometricRepresentationContextInstance(0)
+	, m_mapRepresentationSubContexts()
+	, m_iRepresentationContextInstance(0)
+	, m_setTargetLODs()
+	, m_bHighestLOD(false)
+	, m_bAllLODs(false)
 {
-	SdaiInstance iRepresentationMapInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRepresentationMap");
-	assert(iRepresentationMapInstance != 0);
-
-	sdaiPutAttrBN(iRepresentationMapInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iRepresentationMapInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iRepresentationMapInstance, "MappingOrigin", sdaiINSTANCE, (void*)buildAxis2Placement3DInstance(pMatrix));
-
-	SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcShapeRepresentation");
-	assert(iShapeRepresentationInstance != 0);
+	assert(m_pSite != nullptr);
 
-	sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
-	sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "Brep");
-	sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+	// Lives as long as the OWL model; the strings are shared by the exports
+	m_pStringTable = new _string_table(getSite()->getOwlModel());
 
-	SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
-	assert(pItems != 0);
+	m_iDefaultMaterialId = m_pStringTable->getId("Default Material");
+}
 
-	for (auto iMappedRepresentation : vecMappedRepresentations)
+/*virtual*/ _exporter_base::~_exporter_base()
+{
+	if (m_iSdaiModel != 0)
 	{
-		sdaiAppend(pItems, sdaiINSTANCE, (void*)iMappedRepresentation);
+		sdaiCloseModel(m_iSdaiModel);
+		m_iSdaiModel = 0;
 	}
 
-	sdaiPutAttrBN(iRepresentationMapInstance, "MappedRepresentation", sdaiINSTANCE, (void*)iShapeRepresentationInstance);	
-
-	return iRepresentationMapInstance;
+	delete m_pStringTable;
 }
 
-SdaiInstance _exporter_base::buildMappedItem(
-	const vector<SdaiInstance>& vecRepresentations,
-	OwlInstance iReferencePointMatrixInstance,
-	OwlInstance iTransformationMatrixInstance)
+void _exporter_base::execute(OwlInstance iRootInstance, const char* szTargetLODs, _output_stream* pOutputStream)
 {
-	assert(!vecRepresentations.empty());
-	assert(iReferencePointMatrixInstance != 0);
-	assert(iTransformationMatrixInstance != 0);
+	assert(pOutputStream != nullptr);
 
-	SdaiInstance iMappedItemInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMappedItem");
-	assert(iMappedItemInstance != 0);
+	execute(iRootInstance, vector<pair<string, _output_stream*>>{ { szTargetLODs != nullptr ? szTargetLODs : "", pOutputStream } });
+}
 
-	sdaiPutAttrBN(iMappedItemInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iMappedItemInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+// The model is read once (preProcessing(), prepareExport()); an IFC model per target
+void _exporter_base::execute(OwlInstance iRootInstance, const vector<pair<string, _output_stream*>>& vecTargets)
+{
+	assert(iRootInstance != 0);
+	assert(!vecTargets.empty());
+
+	_string_table_scope stringTableScope(m_pStringTable);
 
-	// Reference Point (Anchor)
-	double dReferencePointX = 0.;
-	double dReferencePointY = 0.;
-	double dReferencePointZ = 0.;
 	{
-		int64_t iValuesCount = 0;
-		double* pdValues = nullptr;
-		GetDatatypeProperty(
-			iReferencePointMatrixInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "coordinates"),
-			(void**)&pdValues,
-			&iValuesCount);
-		assert(iValuesCount == 12);
+		_phase_scope phase(enumPhase::PreProcessing);
 
-		dReferencePointX = pdValues[9];
-		dReferencePointY = pdValues[10];
-		dReferencePointZ = pdValues[11];
+		preProcessing();
 	}
 
-	_matrix mtxReferencePoint;
-	mtxReferencePoint._41 = dReferencePointX;
-	mtxReferencePoint._42 = dReferencePointY;
-	mtxReferencePoint._43 = dReferencePointZ;
-	sdaiPutAttrBN(iMappedItemInstance, "MappingSource", sdaiINSTANCE, (void*)buildRepresentationMap(&mtxReferencePoint, vecRepresentations));
+	{
+		_phase_scope phase(enumPhase::Export);
 
-	SdaiInstance iCartesianTransformationOperator3DInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcCartesianTransformationOperator3D");
-	assert(iCartesianTransformationOperator3DInstance != 0);	
+		prepareExport(iRootInstance);
+	}
 
-	// Transformation Matrix
+	int iTarget = 0;
+	for (const auto& itTarget : vecTargets)
 	{
-		int64_t iValuesCount = 0;
-		double* pdValues = nullptr;
-		GetDatatypeProperty(
-			iTransformationMatrixInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "coordinates"),
-			(void**)&pdValues,
-			&iValuesCount);
-		assert(iValuesCount == 12);
-
-		sdaiPutAttrBN(iCartesianTransformationOperator3DInstance, "Axis1", sdaiINSTANCE, (void*)buildDirectionInstance3D(pdValues[0], pdValues[1], pdValues[2]));
-		sdaiPutAttrBN(iCartesianTransformationOperator3DInstance, "Axis2", sdaiINSTANCE, (void*)buildDirectionInstance3D(pdValues[3], pdValues[4], pdValues[5]));
-		sdaiPutAttrBN(iCartesianTransformationOperator3DInstance, "Axis3", sdaiINSTANCE, (void*)buildDirectionInstance3D(pdValues[6], pdValues[7], pdValues[8]));
+		assert(itTarget.second != nullptr);
 
-		SdaiInstance iLocalOriginInstance = buildCartesianPointInstance(pdValues[9], pdValues[10], pdValues[11]);
-		assert(iLocalOriginInstance != 0);
+		if (m_pSite->isCancelled())
+		{
+			break;
+		}
 
-		sdaiPutAttrBN(iCartesianTransformationOperator3DInstance, "LocalOrigin", sdaiINSTANCE, (void*)iLocalOriginInstance);
-	}	
+		if (vecTargets.size() > 1)
+		{
+			m_pSite->logInfo(_string::format("Target %d/%d: '%s'", ++iTarget, (int)vecTargets.size(), itTarget.first.c_str()));
+		}
 
-	sdaiPutAttrBN(iMappedItemInstance, "MappingTarget", sdaiINSTANCE, (void*)iCartesianTransformationOperator3DInstance);
+		parseTargetLODs(itTarget.first.c_str(), m_setTargetLODs, m_bHighestLOD, m_bAllLODs);
 
-	SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcShapeRepresentation");
-	assert(iShapeRepresentationInstance != 0);
+		{
+			_phase_scope phase(enumPhase::Export);
 
-	sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
-	sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "MappedRepresentation");
-	sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+			executeCore(iRootInstance, itTarget.second);
+		}
 
-	SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
-	assert(pItems != 0);
+		{
+			_phase_scope phase(enumPhase::PostProcessing);
 
-	sdaiAppend(pItems, sdaiINSTANCE, (void*)iMappedItemInstance);
+			postProcessing();
+		}
 
-	return iShapeRepresentationInstance;
+		// The exporter outlives the export; the IFC model is saved already
+		if (m_iSdaiModel != 0)
+		{
+			sdaiCloseModel(m_iSdaiModel);
+			m_iSdaiModel = 0;
+		}
+	} // for (const auto& itTarget : ...
 }
 
-SdaiInstance _exporter_base::buildMapConversion(OwlInstance iSourceCRSInstance, OwlInstance iTargetCRSInstance)
+// The objects of a chunk go to the IFC model of the first chunk (pHost); see executeCore()
+void _exporter_base::executeChunk(OwlInstance iRootInstance, _exporter_base* pHost)
 {
-	assert(iSourceCRSInstance != 0);
-	assert(iTargetCRSInstance != 0);
-
-	SdaiInstance iMapConversionInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcMapConversion");
-	assert(iMapConversionInstance != 0);
+	assert(iRootInstance != 0);
+	assert(pHost != nullptr);
+	assert(m_iSdaiModel == 0);
 
-	sdaiPutAttrBN(iMapConversionInstance, "SourceCRS", sdaiINSTANCE, (void*)iSourceCRSInstance);
-	sdaiPutAttrBN(iMapConversionInstance, "TargetCRS", sdaiINSTANCE, (void*)iTargetCRSInstance);
+	_string_table_scope stringTableScope(m_pStringTable);
 
-	double dValue = 0.;
-	sdaiPutAttrBN(iMapConversionInstance, "Eastings", sdaiREAL, &dValue);
+	m_setTargetLODs = pHost->m_setTargetLODs;
+	m_bHighestLOD = pHost->m_bHighestLOD;
+	m_bAllLODs = pHost->m_bAllLODs;
 
-	dValue = 0.;
-	sdaiPutAttrBN(iMapConversionInstance, "Northings", sdaiREAL, &dValue);
+	copyIfcModel(pHost);
 
-	dValue = 0.;
-	sdaiPutAttrBN(iMapConversionInstance, "OrthogonalHeight", sdaiREAL, &dValue);
+	{
+		_phase_scope phase(enumPhase::PreProcessing);
 
-	dValue = 1.;
-	sdaiPutAttrBN(iMapConversionInstance, "XAxisAbscissa", sdaiREAL, &dValue);
+		preProcessing();
+	}
 
-	dValue = 0.;
-	sdaiPutAttrBN(iMapConversionInstance, "XAxisOrdinate", sdaiREAL, &dValue);
+	executeChunkCore(iRootInstance, pHost);
 
-	dValue = 1.;
-	sdaiPutAttrBN(iMapConversionInstance, "Scale", sdaiREAL, &dValue);
+	// The instances created on demand (Owner History, Site, Contexts, ...) are reused by the next chunk
+	pHost->copyIfcModel(this);
 
-	return iMapConversionInstance;
+	// Owned by the host
+	m_iSdaiModel = 0;
 }
 
-SdaiInstance _exporter_base::buildProjectedCRS(const string& strEPSG)
+/*static*/ void _exporter_base::parseTargetLODs(const char* szTargetLODs, set<string>& setTargetLODs, bool& bHighestLOD, bool& bAllLODs)
 {
-	assert(!strEPSG.empty());
-
-	SdaiInstance iProjectedCRSInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcProjectedCRS");
-	assert(iProjectedCRSInstance != 0);
+	setTargetLODs.clear();
+	bHighestLOD = false;
+	bAllLODs = false;
+	if (szTargetLODs != nullptr)
+	{
+		string strTargetLODs = szTargetLODs;
+		_string::trim(strTargetLODs);
 
-	sdaiPutAttrBN(iProjectedCRSInstance, "Name", sdaiSTRING, strEPSG.c_str());
+		if (!strTargetLODs.empty())
+		{
+			bHighestLOD = strTargetLODs == "HIGHEST_LOD";
+			bAllLODs = strTargetLODs == "ALL_LODS";
+			if (!bHighestLOD && !bAllLODs)
+			{
+				vector<string> vecLODs;
+				_string::split(strTargetLODs, ";", vecLODs);
 
-	return iProjectedCRSInstance;
+				if (!vecLODs.empty())
+				{
+					for (auto strLOD : vecLODs)
+					{
+						setTargetLODs.insert(strLOD);
+					}
+				}
+			}		
+		}		
+	}
 }
 
-string _exporter_base::getEPSGCode(const string& strSrsName)
+SdaiInstance _exporter_base::getPersonInstance()
 {
-	assert(!strSrsName.empty());
-
-	size_t iIndex = string::npos;
-
-	// srsName="urn:ogc:def:crs,crs:EPSG::31256"
-	if ((iIndex = strSrsName.find("EPSG::")) != string::npos)
+	if (m_iPersonInstance == 0) 
 	{
-		string strCode = strSrsName.substr(iIndex + 6).c_str();
+		m_iPersonInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPerson");
+		assert(m_iPersonInstance != 0);
 
-		return strCode;
+		sdaiPutAttrBN(m_iPersonInstance, "GivenName", sdaiSTRING, "Peter");
+		sdaiPutAttrBN(m_iPersonInstance, "FamilyName", sdaiSTRING, "Bonsma");
 	}
 
-	// EPSG:3763
-	if ((iIndex = strSrsName.find("EPSG:")) != string::npos)
-	{
-		string strCode = strSrsName.substr(iIndex + 5).c_str();
-
-		return strCode;
-	}
+	return m_iPersonInstance;
+}
 
-	// http://www.opengis.net/def/crs/EPSG/0/25830
-	if ((iIndex = strSrsName.find("/EPSG/0/")) != string::npos)
+SdaiInstance _exporter_base::getOrganizationInstance()
+{
+	if (m_iOrganizationInstance == 0) 
 	{
-		string strCode = strSrsName.substr(iIndex + 8).c_str();
-
-		return strCode;
-	}
+		m_iOrganizationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcOrganization");
+		assert(m_iOrganizationInstance != 0);
 
-	assert(false);
+		sdaiPutAttrBN(m_iOrganizationInstance, "Name", sdaiSTRING, "RDF");
+		sdaiPutAttrBN(m_iOrganizationInstance, "Description", sdaiSTRING, "RDF Ltd.");
+	}	
 
-	return "";
+	return m_iOrganizationInstance;
 }
 
-string _exporter_base::getEPSG(const string& strSrsName)
+SdaiInstance _exporter_base::getPersonAndOrganizationInstance()
 {
-	assert(!strSrsName.empty());
-
-	size_t iIndex = string::npos;
-
-	// srsName="urn:ogc:def:crs,crs:EPSG::31256"
-	if ((iIndex = strSrsName.find("EPSG::")) != string::npos)
+	if (m_iPersonAndOrganizationInstance == 0) 
 	{
-		string strEPSG = strSrsName.substr(iIndex).c_str();
-		iIndex = strEPSG.find("::");
-		strEPSG.replace(iIndex, 2, ":");
+		m_iPersonAndOrganizationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPersonAndOrganization");
+		assert(m_iPersonAndOrganizationInstance != 0);
 
-		return strEPSG;
+		sdaiPutAttrBN(m_iPersonAndOrganizationInstance, "ThePerson", sdaiINSTANCE, (void*)getPersonInstance());
+		sdaiPutAttrBN(m_iPersonAndOrganizationInstance, "TheOrganization", sdaiINSTANCE, (void*)getOrganizationInstance());
 	}
 
-	// EPSG:3763
-	if (strSrsName.find("EPSG:") == 0)
-	{
-		return strSrsName;
-	}
+	return m_iPersonAndOrganizationInstance;
+}
 
-	// http://www.opengis.net/def/crs/EPSG/0/25830
-	if (strSrsName.find("/EPSG/") != -1)
+SdaiInstance _exporter_base::getApplicationInstance()
+{
+	if (m_iApplicationInstance == 0)
 	{
-		iIndex = strSrsName.rfind("/");
-		string strEPSG = "EPSG:";
-		strEPSG += strSrsName.substr(iIndex + 1).c_str();
+		m_iApplicationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcApplication");
+		assert(m_iApplicationInstance != 0);
 
-		return strEPSG;
+		sdaiPutAttrBN(m_iApplicationInstance, "ApplicationDeveloper", sdaiINSTANCE, (void*)getOrganizationInstance());
+		sdaiPutAttrBN(m_iApplicationInstance, "Version", sdaiSTRING, GML2IFC_VERSION); //#tbd
+		sdaiPutAttrBN(m_iApplicationInstance, "ApplicationFullName", sdaiSTRING, "Test Application"); //#tbd
+		sdaiPutAttrBN(m_iApplicationInstance, "ApplicationIdentifier", sdaiSTRING, "TA 1001"); //#tbd
 	}
 
-	assert(false);
-
-	return "";
+	return m_iApplicationInstance;
 }
 
-void _exporter_base::createStyledItemInstance(OwlInstance iOwlInstance, SdaiInstance iSdaiInstance)
+SdaiInstance _exporter_base::getOwnerHistoryInstance()
 {
-	assert(iOwlInstance != 0);
-	assert(iSdaiInstance != 0);
+	if (m_iOwnerHistoryInstance == 0)
+	{
+		int64_t iTimeStamp = time(0);
 
-	// material
-	OwlInstance* piMaterials = nullptr;
-	int64_t iMaterialsCount = 0;
-	GetObjectProperty(
-		iOwlInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "material"),
-		&piMaterials,
-		&iMaterialsCount);
+		m_iOwnerHistoryInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcOwnerHistory");
+		assert(m_iOwnerHistoryInstance != 0);
 
-	assert(iMaterialsCount == 1);
+		sdaiPutAttrBN(m_iOwnerHistoryInstance, "OwningUser", sdaiINSTANCE, (void*)getPersonAndOrganizationInstance());
+		sdaiPutAttrBN(m_iOwnerHistoryInstance, "OwningApplication", sdaiINSTANCE, (void*)getApplicationInstance());
+		sdaiPutAttrBN(m_iOwnerHistoryInstance, "ChangeAction", sdaiENUM, "ADDED");
+		sdaiPutAttrBN(m_iOwnerHistoryInstance, "CreationDate", sdaiINTEGER, &iTimeStamp);
+		sdaiPutAttrBN(m_iOwnerHistoryInstance, "LastModifiedDate", sdaiINTEGER, &iTimeStamp);
+	}
 
-	OwlInstance iMaterialInstance = piMaterials[0];
+	return m_iOwnerHistoryInstance;
+}
 
-	if (hasObjectProperty(iMaterialInstance, "textures"))
+SdaiInstance _exporter_base::getDimensionalExponentsInstance()
+{
+	if (m_iDimensionalExponentsInstance == 0)
 	{
-		m_pSite->logWarn("Textures are not supported.");
+		int_t LengthExponent = 0,
+			MassExponent = 0,
+			TimeExponent = 0,
+			ElectricCurrentExponent = 0,
+			ThermodynamicTemperatureExponent = 0,
+			AmountOfSubstanceExponent = 0,
+			LuminousIntensityExponent = 0;
 
-		createDefaultStyledItemInstance(iSdaiInstance);
+		m_iDimensionalExponentsInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcDimensionalExponents");
+		assert(m_iDimensionalExponentsInstance != 0);
 
-		return;
+		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "LengthExponent", sdaiINTEGER, &LengthExponent);
+		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "MassExponent", sdaiINTEGER, &MassExponent);
+		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "TimeExponent", sdaiINTEGER, &TimeExponent);
+		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "ElectricCurrentExponent", sdaiINTEGER, &ElectricCurrentExponent);
+		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "ThermodynamicTemperatureExponent", sdaiINTEGER, &ThermodynamicTemperatureExponent);
+		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "AmountOfSubstanceExponent", sdaiINTEGER, &AmountOfSubstanceExponent);
+		sdaiPutAttrBN(m_iDimensionalExponentsInstance, "LuminousIntensityExponent", sdaiINTEGER, &LuminousIntensityExponent);
 	}
 
-	string strTag = getTag(iMaterialInstance);
-	if (strTag == "Default Material")
+	return m_iDimensionalExponentsInstance;
+}
+
+SdaiInstance _exporter_base::getConversionBasedUnitInstance()
+{
+	if (m_iConversionBasedUnitInstance == 0)
 	{
-		createDefaultStyledItemInstance(iSdaiInstance);
+		m_iConversionBasedUnitInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcConversionBasedUnit");
+		assert(m_iConversionBasedUnitInstance != 0);
 
-		return;
+		sdaiPutAttrBN(m_iConversionBasedUnitInstance, "Dimensions", sdaiINSTANCE, (void*)getDimensionalExponentsInstance());
+		sdaiPutAttrBN(m_iConversionBasedUnitInstance, "UnitType", sdaiENUM, "PLANEANGLEUNIT");
+		sdaiPutAttrBN(m_iConversionBasedUnitInstance, "Name", sdaiSTRING, "DEGREE");
+		sdaiPutAttrBN(m_iConversionBasedUnitInstance, "ConversionFactor", sdaiINSTANCE, (void*)buildMeasureWithUnitInstance());
 	}
 
-	if (createOverriddenStyledItemInstance(iSdaiInstance))
-	{
-		return;
-	}
+	return m_iConversionBasedUnitInstance;
+}
 
-	// color
-	OwlInstance* piInstances = nullptr;
-	int64_t iInstancesCount = 0;
-	GetObjectProperty(
-		iMaterialInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "color"),
-		&piInstances,
-		&iInstancesCount);
+SdaiInstance _exporter_base::getUnitAssignmentInstance()
+{
+	if (m_iUnitAssignmentInstance == 0)
+	{
+		m_iUnitAssignmentInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcUnitAssignment");
+		assert(m_iUnitAssignmentInstance != 0);
 
-	assert(iInstancesCount == 1);
+		SdaiAggr pUnits = sdaiCreateAggrBN(m_iUnitAssignmentInstance, "Units");
+		assert(pUnits != nullptr);
 
-	OwlInstance iColorInstance = piInstances[0];
+		m_iLengthUnitInstance = buildSIUnitInstance("LENGTHUNIT", nullptr, "METRE");
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)m_iLengthUnitInstance);
 
-	// transparency
-	double* pdValues = nullptr;
-	int64_t iValuesCount = 0;
-	GetDatatypeProperty(
-		iColorInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "transparency"),
-		(void**)&pdValues,
-		&iValuesCount);
+		m_iAreaUnitInstance = buildSIUnitInstance("AREAUNIT", nullptr, "SQUARE_METRE");
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)m_iAreaUnitInstance);
 
-	double dTransparency = 0.;
-	if (iValuesCount == 1)
-	{
-		dTransparency = 1. - pdValues[0];
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("VOLUMEUNIT", nullptr, "CUBIC_METRE"));
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)getConversionBasedUnitInstance());
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("SOLIDANGLEUNIT", nullptr, "STERADIAN"));
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("MASSUNIT", nullptr, "GRAM"));
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("TIMEUNIT", nullptr, "SECOND"));
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("THERMODYNAMICTEMPERATUREUNIT", nullptr, "DEGREE_CELSIUS"));
+		sdaiAppend(pUnits, sdaiINSTANCE, (void*)buildSIUnitInstance("LUMINOUSINTENSITYUNIT", nullptr, "LUMEN"));
 	}
 
-	// diffuse
-	piInstances = nullptr;
-	iInstancesCount = 0;
-	GetObjectProperty(
-		iColorInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "diffuse"),
-		&piInstances,
-		&iInstancesCount);
+	return m_iUnitAssignmentInstance;
+}
 
-	assert(iInstancesCount == 1);
+SdaiInstance _exporter_base::getWorldCoordinateSystemInstance()
+{
+	if (m_iWorldCoordinateSystemInstance == 0)
+	{
+		m_iWorldCoordinateSystemInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcAxis2Placement3D");
+		assert(m_iWorldCoordinateSystemInstance != 0);
 
-	OwlInstance iDiffuseColorComponentInstance = piInstances[0];
+		sdaiPutAttrBN(m_iWorldCoordinateSystemInstance, "Location", sdaiINSTANCE, (void*)buildCartesianPointInstance(0., 0., 0.));
+	}	
 
-	// R
-	double* pdRValue = nullptr;
-	iValuesCount = 0;
-	GetDatatypeProperty(
-		iDiffuseColorComponentInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "R"),
-		(void**)&pdRValue,
-		&iValuesCount);
+	return m_iWorldCoordinateSystemInstance;
+}
 
-	assert(iValuesCount == 1);
+SdaiInstance _exporter_base::getProjectInstance()
+{
+	if (m_iProjectInstance == 0) 
+	{
+		m_iProjectInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcProject");
+		assert(m_iProjectInstance != 0);
 
-	// G
-	double* pdGValue = nullptr;
-	iValuesCount = 0;
-	GetDatatypeProperty(
-		iDiffuseColorComponentInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "G"),
-		(void**)&pdGValue,
-		&iValuesCount);
-
-	assert(iValuesCount == 1);
+		sdaiPutAttrBN(m_iProjectInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+		sdaiPutAttrBN(m_iProjectInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+		sdaiPutAttrBN(m_iProjectInstance, "Name", sdaiSTRING, "Default Project"); //#tbd
+		sdaiPutAttrBN(m_iProjectInstance, "Description", sdaiSTRING, "Description of Default Project"); //#tbd
+		sdaiPutAttrBN(m_iProjectInstance, "UnitsInContext", sdaiINSTANCE, (void*)getUnitAssignmentInstance());
 
-	// B
-	double* pdBValue = nullptr;
-	iValuesCount = 0;
-	GetDatatypeProperty(
-		iDiffuseColorComponentInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "B"),
-		(void**)&pdBValue,
-		&iValuesCount);
+		SdaiAggr pRepresentationContexts = sdaiCreateAggrBN(m_iProjectInstance, "RepresentationContexts");
+		assert(pRepresentationContexts != nullptr);
 
-	assert(iValuesCount == 1);
+		sdaiAppend(pRepresentationContexts, sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+	}
 
-	createStyledItemInstance(iSdaiInstance, pdRValue[0], pdGValue[0], pdBValue[0], dTransparency);
+	return m_iProjectInstance;
 }
 
-void _exporter_base::createStyledItemInstance(SdaiInstance iSdaiInstance, double dR, double dG, double dB, double dTransparency)
+SdaiInstance _exporter_base::getSiteInstance(SdaiInstance& iSiteInstancePlacement)
 {
-	assert(iSdaiInstance != 0);
-
-	SdaiInstance iStyledItemInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcStyledItem");
-	assert(iStyledItemInstance != 0);
+	if (m_iSiteInstance == 0)
+	{
+		assert(m_iSiteInstancePlacement == 0);
 
-	sdaiPutAttrBN(iStyledItemInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iStyledItemInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+		string strName;
+		_matrix mtxSite;
+		onPreCreateSite(strName, &mtxSite);
 
-	SdaiAggr pStyles = sdaiCreateAggrBN(iStyledItemInstance, "Styles");
-	assert(pStyles != nullptr);
+		m_iSiteInstancePlacement = 0;
+		m_iSiteInstance = buildSiteInstance(
+			strName.c_str(),
+			strName.c_str(),
+			&mtxSite,
+			m_iSiteInstancePlacement);
+		assert(m_iSiteInstance != 0);
+		assert(m_iSiteInstancePlacement != 0);
 
-	SdaiInstance iPresentationStyleAssignmentInstance = buildPresentationStyleAssignmentInstance();
-	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iPresentationStyleAssignmentInstance);
+		onPostCreateSite(m_iSiteInstance);
+	} // if (m_iSiteInstance == 0)
 
-	pStyles = sdaiCreateAggrBN(iPresentationStyleAssignmentInstance, "Styles");
-	assert(pStyles != nullptr);
+	iSiteInstancePlacement = m_iSiteInstancePlacement;
 
-	SdaiInstance iSurfaceStyleInstance = buildSurfaceStyleInstance();
-	sdaiPutAttrBN(iSurfaceStyleInstance, "Side", sdaiENUM, "BOTH");
-	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iSurfaceStyleInstance);
+	return m_iSiteInstance;
+}
 
-	pStyles = sdaiCreateAggrBN(iSurfaceStyleInstance, "Styles");
-	assert(pStyles != nullptr);
+// The root class; see getSiteInstance()
+/*virtual*/ void _exporter_base::onPreCreateSite(string& strName, _matrix* /*pSiteMatrix*/)
+{
+	OwlInstance iRootInstance = getSite()->getOwlRootInstance();
+	assert(iRootInstance != 0);
 
-	SdaiInstance iSurfaceStyleRenderingInstance = buildSurfaceStyleRenderingInstance();
-	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "ReflectanceMethod", sdaiENUM, "NOTDEFINED");
-	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iSurfaceStyleRenderingInstance);
+	OwlClass iInstanceClass = GetInstanceClass(iRootInstance);
+	assert(iInstanceClass != 0);
 
-	SdaiInstance iColorRgbInstance = buildColorRgbInstance(dR, dG, dB);
-	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "SurfaceColour", sdaiINSTANCE, (void*)iColorRgbInstance);
-	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "Transparency", sdaiREAL, &dTransparency);
+	char* szClassName = nullptr;
+	GetNameOfClass(iInstanceClass, &szClassName);
+	assert(szClassName != nullptr);
 
-	sdaiPutAttrBN(iStyledItemInstance, "Item", sdaiINSTANCE, (void*)iSdaiInstance);
+	strName = szClassName;
 }
 
-void _exporter_base::createStyledItemInstance(SdaiInstance iSdaiInstance, SdaiInstance iColorRgbInstance, double dTransparency)
+SdaiInstance _exporter_base::getGeometricRepresentationContextInstance()
 {
-	assert(iSdaiInstance != 0);
-	assert(iColorRgbInstance != 0);
-
-	SdaiInstance iStyledItemInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcStyledItem");
-	assert(iStyledItemInstance != 0);
+	if (m_iGeometricRepresentationContextInstance == 0)
+	{
+		double dPrecision = 0.00001;
+		int_t iCoordinateSpaceDimension = 3;
 
-	sdaiPutAttrBN(iStyledItemInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iStyledItemInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+		m_iGeometricRepresentationContextInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcGeometricRepresentationContext");
+		assert(m_iGeometricRepresentationContextInstance != 0);
 
-	SdaiAggr pStyles = sdaiCreateAggrBN(iStyledItemInstance, "Styles");
-	assert(pStyles != nullptr);
+		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "ContextType", sdaiSTRING, "Model");
+		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "CoordinateSpaceDimension", sdaiINTEGER, &iCoordinateSpaceDimension);
+		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "Precision", sdaiREAL, &dPrecision);
+		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "WorldCoordinateSystem", sdaiINSTANCE, (void*)getWorldCoordinateSystemInstance());
+		sdaiPutAttrBN(m_iGeometricRepresentationContextInstance, "TrueNorth", sdaiINSTANCE, (void*)buildDirectionInstance2D(0., 1.));
+	}
 
-	SdaiInstance iPresentationStyleAssignmentInstance = buildPresentationStyleAssignmentInstance();
-	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iPresentationStyleAssignmentInstance);
+	return m_iGeometricRepresentationContextInstance;
+}
 
-	pStyles = sdaiCreateAggrBN(iPresentationStyleAssignmentInstance, "Styles");
-	assert(pStyles != nullptr);
+SdaiInstance _exporter_base::getRepresentationSubContextInstance(const string& strLOD)
+{
+	if (strLOD.empty())
+	{
+		return getGeometricRepresentationContextInstance();
+	}
 
-	SdaiInstance iSurfaceStyleInstance = buildSurfaceStyleInstance();
-	sdaiPutAttrBN(iSurfaceStyleInstance, "Side", sdaiENUM, "BOTH");
-	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iSurfaceStyleInstance);
+	auto itSubContext = m_mapRepresentationSubContexts.find(strLOD);
+	if (itSubContext != m_mapRepresentationSubContexts.end())
+	{
+		return itSubContext->second;
+	}
 
-	pStyles = sdaiCreateAggrBN(iSurfaceStyleInstance, "Styles");
-	assert(pStyles != nullptr);
+	SdaiInstance iSubContextInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcGeometricRepresentationSubContext");
+	assert(iSubContextInstance != 0);
 
-	SdaiInstance iSurfaceStyleRenderingInstance = buildSurfaceStyleRenderingInstance();
-	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "ReflectanceMethod", sdaiENUM, "NOTDEFINED");
-	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iSurfaceStyleRenderingInstance);
+	sdaiPutAttrBN(iSubContextInstance, "ContextIdentifier", sdaiSTRING, "Body");
+	sdaiPutAttrBN(iSubContextInstance, "ContextType", sdaiSTRING, "Model");
+	sdaiPutAttrBN(iSubContextInstance, "ParentContext", sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+	sdaiPutAttrBN(iSubContextInstance, "TargetView", sdaiENUM, "USERDEFINED");
+	sdaiPutAttrBN(iSubContextInstance, "UserDefinedTargetView", sdaiSTRING, strLOD.c_str());
 
-	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "SurfaceColour", sdaiINSTANCE, (void*)iColorRgbInstance);
-	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "Transparency", sdaiREAL, &dTransparency);
+	m_mapRepresentationSubContexts[strLOD] = iSubContextInstance;
 
-	sdaiPutAttrBN(iStyledItemInstance, "Item", sdaiINSTANCE, (void*)iSdaiInstance);
+	return iSubContextInstance;
 }
 
-SdaiInstance _exporter_base::buildPresentationStyleAssignmentInstance()
+SdaiInstance _exporter_base::getRepresentationContextInstance()
 {
-	SdaiInstance iPresentationStyleAssignmentInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPresentationStyleAssignment");
-	assert(iPresentationStyleAssignmentInstance != 0);
-
-	sdaiPutAttrBN(iPresentationStyleAssignmentInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iPresentationStyleAssignmentInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	if (m_iRepresentationContextInstance != 0)
+	{
+		return m_iRepresentationContextInstance;
+	}
 
-	return iPresentationStyleAssignmentInstance;
+	return getGeometricRepresentationContextInstance();
 }
 
-SdaiInstance _exporter_base::buildSurfaceStyleInstance()
+void _exporter_base::createIfcModel(const wchar_t* szSchemaName)
 {
-	SdaiInstance iSurfaceStyleInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcSurfaceStyle");
-	assert(iSurfaceStyleInstance != 0);
+	assert(szSchemaName != nullptr);
 
-	sdaiPutAttrBN(iSurfaceStyleInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iSurfaceStyleInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	if (m_iSdaiModel != 0)
+	{
+		sdaiCloseModel(m_iSdaiModel);
+		m_iSdaiModel = 0;
+	}	
 
-	return iSurfaceStyleInstance;
-}
+	// The exporter is reused; nothing from the previous model
+	m_iPersonInstance = 0;
+	m_iOrganizationInstance = 0;
+	m_iPersonAndOrganizationInstance = 0;
+	m_iApplicationInstance = 0;
+	m_iOwnerHistoryInstance = 0;
+	m_iDimensionalExponentsInstance = 0;
+	m_iConversionBasedUnitInstance = 0;
+	m_iUnitAssignmentInstance = 0;
+	m_iLengthUnitInstance = 0;
+	m_iAreaUnitInstance = 0;
+	m_iWorldCoordinateSystemInstance = 0;
+	m_iProjectInstance = 0;
+	m_iSiteInstance = 0;
+	m_iSiteInstancePlacement = 0;
+	m_iGeometricRepresentationContextInstance = 0;
+	m_mapRepresentationSubContexts.clear();
+	m_iRepresentationContextInstance = 0;
 
-SdaiInstance _exporter_base::buildSurfaceStyleRenderingInstance()
-{
-	SdaiInstance iSurfaceStyleRenderingInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcSurfaceStyleRendering");
-	assert(iSurfaceStyleRenderingInstance != 0);
+	m_iSdaiModel = sdaiCreateModelBNUnicode(1, NULL, szSchemaName);
+	assert(m_iSdaiModel != 0);
 
-	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	//#tbd
+	char    description[512], timeStamp[512];
+	time_t  t;
+	struct tm* tInfo;
 
-	return iSurfaceStyleRenderingInstance;
-}
+	time(&t);
+	tInfo = localtime(&t);
 
-SdaiInstance _exporter_base::buildColorRgbInstance(double dR, double dG, double dB)
-{
-	SdaiInstance iColorRgbInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcColourRgb");
-	assert(iColorRgbInstance != 0);
+	//#tbd
+	if (true)//view == COORDINATIONVIEW) {
+		//if (m_Quantities.GetCheck()) {
+		memcpy(description, "ViewDefinition [CoordinationView, QuantityTakeOffAddOnView]", sizeof("ViewDefinition [CoordinationView, QuantityTakeOffAddOnView]"));
+	//}
+	/*else {
+		memcpy(description, "ViewDefinition [CoordinationView]", sizeof("ViewDefinition [CoordinationView]"));
+	}*/
+	/*}
+	else {
+		ASSERT(view == PRESENTATIONVIEW);
+		if (m_Quantities.GetCheck()) {
+			memcpy(description, "ViewDefinition [PresentationView, QuantityTakeOffAddOnView]", sizeof("ViewDefinition [PresentationView, QuantityTakeOffAddOnView]"));
+		}
+		else {
+			memcpy(description, "ViewDefinition [PresentationView]", sizeof("ViewDefinition [PresentationView]"));
+		}
+	}*/
 
-	sdaiPutAttrBN(iColorRgbInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iColorRgbInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iColorRgbInstance, "Name", sdaiSTRING, "Color");
-	sdaiPutAttrBN(iColorRgbInstance, "Red", sdaiREAL, &dR);
-	sdaiPutAttrBN(iColorRgbInstance, "Green", sdaiREAL, &dG);
-	sdaiPutAttrBN(iColorRgbInstance, "Blue", sdaiREAL, &dB);
+	sprintf(&timeStamp[0], "%d", 1900 + tInfo->tm_year);
+	sprintf(&timeStamp[4], "%d", 100 + 1 + tInfo->tm_mon);
+	sprintf(&timeStamp[7], "%d", 100 + tInfo->tm_mday);
+	timeStamp[4] = '-';
+	timeStamp[7] = '-';
+	sprintf(&timeStamp[10], "%d", 100 + tInfo->tm_hour);
+	sprintf(&timeStamp[13], "%d", 100 + tInfo->tm_min);
+	sprintf(&timeStamp[16], "%d", 100 + tInfo->tm_sec);
+	timeStamp[10] = 'T';
+	timeStamp[13] = ':';
+	timeStamp[16] = ':';
+	timeStamp[19] = 0;
 
-	return iColorRgbInstance;
+	SetSPFFHeader(
+		m_iSdaiModel,
+		(const char*)description,           //  description //#tbd
+		"2;1",                              //  implementationLevel //#tbd
+		(const char*)nullptr,	            //  name //#tbd
+		(const char*)&timeStamp[0],         //  timeStamp //#tbd
+		"Architect",                        //  author //#tbd
+		"Building Designer Office",         //  organization //#tbd
+		"IFC Engine DLL version 1.03 beta", //  preprocessorVersion //#tbd
+		"IFC Engine DLL version 1.03 beta", //  originatingSystem //#tbd
+		"The authorising person",           //  authorization //#tbd
+#ifdef _WINDOWS
+		CW2A(szSchemaName)                  //  fileSchema //#tbd
+#else
+#ifdef __EMSCRIPTEN__
+		(LPCSTR)CW2A(szSchemaName)                  //  fileSchema //#tbd
+#else
+#error NOT IMPLEMENTED!
+#endif
+#endif		
+	);
 }
 
-SdaiInstance _exporter_base::buildPropertySet(const char* szName, SdaiAggr& pHasProperties)
+void _exporter_base::copyIfcModel(const _exporter_base* pSource)
 {
-	SdaiInstance iPropertySetInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPropertySet");
-	assert(iPropertySetInstance != 0);
+	assert(pSource != nullptr);
 
-	sdaiPutAttrBN(iPropertySetInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iPropertySetInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
-	sdaiPutAttrBN(iPropertySetInstance, "Name", sdaiSTRING, szName);
+	m_iSdaiModel = pSource->m_iSdaiModel;
+	m_iPersonInstance = pSource->m_iPersonInstance;
+	m_iOrganizationInstance = pSource->m_iOrganizationInstance;
+	m_iPersonAndOrganizationInstance = pSource->m_iPersonAndOrganizationInstance;
+	m_iApplicationInstance = pSource->m_iApplicationInstance;
+	m_iOwnerHistoryInstance = pSource->m_iOwnerHistoryInstance;
+	m_iDimensionalExponentsInstance = pSource->m_iDimensionalExponentsInstance;
+	m_iConversionBasedUnitInstance = pSource->m_iConversionBasedUnitInstance;
+	m_iUnitAssignmentInstance = pSource->m_iUnitAssignmentInstance;
+	m_iLengthUnitInstance = pSource->m_iLengthUnitInstance;
+	m_iAreaUnitInstance = pSource->m_iAreaUnitInstance;
+	m_iWorldCoordinateSystemInstance = pSource->m_iWorldCoordinateSystemInstance;
+	m_iProjectInstance = pSource->m_iProjectInstance;
+	m_iSiteInstance = pSource->m_iSiteInstance;
+	m_iSiteInstancePlacement = pSource->m_iSiteInstancePlacement;
+	m_iGeometricRepresentationContextInstance = pSource->m_iGeometricRepresentationContextInstance;
+	m_mapRepresentationSubContexts = pSource->m_mapRepresentationSubContexts;
+	m_iRepresentationContextInstance = pSource->m_iRepresentationContextInstance;
+}
 
-	pHasProperties = sdaiCreateAggrBN(iPropertySetInstance, "HasProperties");
-	assert(pHasProperties != nullptr);
+void _exporter_base::saveIfcFile(_output_stream* pOutputStream)
+{
+	assert(pOutputStream != nullptr);
+	assert(m_iSdaiModel != 0);
 
-	return iPropertySetInstance;
+	if (!pOutputStream->save(m_iSdaiModel))
+	{
+		getSite()->logErr(_string::format("Failed to write '%s' (%lld bytes written).",
+			pOutputStream->getName().c_str(),
+			pOutputStream->getBytesWritten()));
+	}
 }
 
-SdaiInstance _exporter_base::buildRelDefinesByProperties(SdaiInstance iRelatedObject, SdaiInstance iRelatingPropertyDefinition)
+SdaiInstance _exporter_base::buildSIUnitInstance(const char* szUnitType, const char* szPrefix, const char* szName)
 {
-	assert(iRelatedObject != 0);
-	assert(iRelatingPropertyDefinition != 0);
+	assert(szUnitType != nullptr);
+	assert(szName != nullptr);
 
-	SdaiInstance iRelDefinesByPropertiesInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelDefinesByProperties");
-	assert(iRelDefinesByPropertiesInstance != 0);
+	SdaiInstance iSIUnitInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcSIUnit");
+	assert(iSIUnitInstance != 0);
 
-	sdaiPutAttrBN(iRelDefinesByPropertiesInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iRelDefinesByPropertiesInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iSIUnitInstance, "Dimensions", sdaiINTEGER, (void*)nullptr);
+	sdaiPutAttrBN(iSIUnitInstance, "UnitType", sdaiENUM, szUnitType);
+	if (szPrefix != nullptr) 
+	{
+		sdaiPutAttrBN(iSIUnitInstance, "Prefix", sdaiENUM, szPrefix);
+	}
+	sdaiPutAttrBN(iSIUnitInstance, "Name", sdaiENUM, szName);
 
-	SdaiAggr pRelatedObjects = sdaiCreateAggrBN(iRelDefinesByPropertiesInstance, "RelatedObjects");
-	assert(pRelatedObjects != 0);
+	return iSIUnitInstance;
+}
 
-	sdaiAppend(pRelatedObjects, sdaiINSTANCE, (void*)iRelatedObject);
-	sdaiPutAttrBN(iRelDefinesByPropertiesInstance, "RelatingPropertyDefinition", sdaiINSTANCE, (void*)iRelatingPropertyDefinition);
+SdaiInstance _exporter_base::buildMeasureWithUnitInstance()
+{
+	double	dValueComponent = 0.01745; //#tbd
+	SdaiADB pValueComponentADB = sdaiCreateADB(sdaiREAL, &dValueComponent);
+	assert(pValueComponentADB != nullptr);
 
-	return iRelDefinesByPropertiesInstance;
+	SdaiInstance iMeasureWithUnitInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMeasureWithUnit");
+	assert(iMeasureWithUnitInstance != 0);	
+
+	sdaiPutADBTypePath(pValueComponentADB, 1, "IFCREAL");
+	sdaiPutAttrBN(iMeasureWithUnitInstance, "ValueComponent", sdaiADB, (void*)pValueComponentADB);
+	sdaiPutAttrBN(iMeasureWithUnitInstance, "UnitComponent", sdaiINSTANCE, (void*)buildSIUnitInstance("PLANEANGLEUNIT", NULL, "RADIAN"));
+	
+	return iMeasureWithUnitInstance;
 }
 
-SdaiInstance _exporter_base::buildPropertySingleValueText(
-	const char* szName,
-	const char* szDescription,
-	const char* szNominalValue,
-	const char* szTypePath)
+SdaiInstance _exporter_base::buildDirectionInstance2D(double dX, double dY)
 {
-	SdaiInstance iPropertySingleValueInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPropertySingleValue");
-	assert(iPropertySingleValueInstance != 0);
-
-	sdaiPutAttrBN(iPropertySingleValueInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iPropertySingleValueInstance, "Description", sdaiSTRING, szDescription);
+	SdaiInstance iDirectionInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcDirection");
+	assert(iDirectionInstance != 0);
 
-	SdaiADB pNominalValueADB = sdaiCreateADB(sdaiSTRING, szNominalValue);
-	assert(pNominalValueADB != nullptr);
+	SdaiAggr pDirectionRatios = sdaiCreateAggrBN(iDirectionInstance, "DirectionRatios");
+	assert(pDirectionRatios != nullptr);
 
-	sdaiPutADBTypePath(pNominalValueADB, 1, szTypePath);
-	sdaiPutAttrBN(iPropertySingleValueInstance, "NominalValue", sdaiADB, (void*)pNominalValueADB);
+	sdaiAppend(pDirectionRatios, sdaiREAL, &dX);
+	sdaiAppend(pDirectionRatios, sdaiREAL, &dY);
 
-	return iPropertySingleValueInstance;
+	return iDirectionInstance;
 }
 
-SdaiInstance _exporter_base::buildPropertySingleValueInt(
-	const char* szName,
-	const char* szDescription,
-	int64_t iNominalValue,
-	const char* szTypePath)
+SdaiInstance _exporter_base::buildDirectionInstance3D(double dX, double dY, double dZ)
 {
-	SdaiInstance iPropertySingleValueInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPropertySingleValue");
-	assert(iPropertySingleValueInstance != 0);
-
-	sdaiPutAttrBN(iPropertySingleValueInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iPropertySingleValueInstance, "Description", sdaiSTRING, szDescription);
+	SdaiInstance iDirectionInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcDirection");
+	assert(iDirectionInstance != 0);
 
-	SdaiADB pNominalValueADB = sdaiCreateADB(sdaiINTEGER, (void*)&iNominalValue);
-	assert(pNominalValueADB != nullptr);
+	SdaiAggr pDirectionRatios = sdaiCreateAggrBN(iDirectionInstance, "DirectionRatios");
+	assert(pDirectionRatios != nullptr);
 
-	sdaiPutADBTypePath(pNominalValueADB, 1, szTypePath);
-	sdaiPutAttrBN(iPropertySingleValueInstance, "NominalValue", sdaiADB, (void*)pNominalValueADB);
+	sdaiAppend(pDirectionRatios, sdaiREAL, &dX);
+	sdaiAppend(pDirectionRatios, sdaiREAL, &dY);
+	sdaiAppend(pDirectionRatios, sdaiREAL, &dZ);
 
-	return iPropertySingleValueInstance;
+	return iDirectionInstance;
 }
 
-SdaiInstance _exporter_base::buildPropertySingleValueReal(
-	const char* szName,
-	const char* szDescription,
-	double dNominalValue,
-	const char* szTypePath)
+SdaiInstance _exporter_base::buildCartesianPointInstance(double dX, double dY, double dZ)
 {
-	SdaiInstance iPropertySingleValueInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPropertySingleValue");
-	assert(iPropertySingleValueInstance != 0);
-
-	sdaiPutAttrBN(iPropertySingleValueInstance, "Name", sdaiSTRING, szName);
-	sdaiPutAttrBN(iPropertySingleValueInstance, "Description", sdaiSTRING, szDescription);
+	SdaiInstance iCartesianPointInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcCartesianPoint");
+	assert(iCartesianPointInstance != 0);
 
-	SdaiADB pNominalValueADB = sdaiCreateADB(sdaiREAL, (void*)&dNominalValue);
-	assert(pNominalValueADB != nullptr);
+	SdaiAggr pCoordinates = sdaiCreateAggrBN(iCartesianPointInstance, "Coordinates");
+	assert(pCoordinates != nullptr);
 
-	sdaiPutADBTypePath(pNominalValueADB, 1, szTypePath);
-	sdaiPutAttrBN(iPropertySingleValueInstance, "NominalValue", sdaiADB, (void*)pNominalValueADB);
+	sdaiAppend(pCoordinates, sdaiREAL, &dX);
+	sdaiAppend(pCoordinates, sdaiREAL, &dY);
+	sdaiAppend(pCoordinates, sdaiREAL, &dZ);
 
-	return iPropertySingleValueInstance;
+	return iCartesianPointInstance;
 }
 
-SdaiInstance _exporter_base::buildMaterial()
+SdaiInstance _exporter_base::buildSiteInstance(
+	const char* szName,
+	const char* szDescription,
+	_matrix* pMatrix, 
+	SdaiInstance& iSiteInstancePlacement)
 {
-	SdaiInstance iMaterialInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMaterial");
-	assert(iMaterialInstance != 0);
+	assert(pMatrix != nullptr);
 
-	sdaiPutAttrBN(iMaterialInstance, "Name", sdaiSTRING, (void*)"Material");
+	SdaiInstance iSiteInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcSite");
+	assert(iSiteInstance != 0);
 
-	return iMaterialInstance;
-}
+	sdaiPutAttrBN(iSiteInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iSiteInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iSiteInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iSiteInstance, "Description", sdaiSTRING, szDescription);
 
-SdaiInstance _exporter_base::buildMaterialLayer(double dThickness)
-{
-	SdaiInstance iMaterialLayerInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMaterialLayer");
-	assert(iMaterialLayerInstance != 0);
+	iSiteInstancePlacement = buildLocalPlacementInstance(pMatrix, 0);
+	assert(iSiteInstancePlacement != 0);
 
-	sdaiPutAttrBN(iMaterialLayerInstance, "Material", sdaiINSTANCE, (void*)buildMaterial());
-	sdaiPutAttrBN(iMaterialLayerInstance, "LayerThickness", sdaiREAL, &dThickness);
+	sdaiPutAttrBN(iSiteInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iSiteInstancePlacement);
+	sdaiPutAttrBN(iSiteInstance, "CompositionType", sdaiENUM, "ELEMENT");
 
-	return iMaterialLayerInstance;
+	return iSiteInstance;
 }
 
-SdaiInstance _exporter_base::buildMaterialLayerSet(double dThickness)
+SdaiInstance _exporter_base::buildLocalPlacementInstance(_matrix* pMatrix, SdaiInstance iPlacementRelativeTo)
 {
-	SdaiInstance iMaterialLayerSetInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMaterialLayerSet");
-	assert(iMaterialLayerSetInstance != 0);
-
-	SdaiAggr pMaterialLayers = sdaiCreateAggrBN(iMaterialLayerSetInstance, "MaterialLayers");
-	assert(pMaterialLayers != nullptr);
+	SdaiInstance iLocalPlacementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcLocalPlacement");
+	assert(iLocalPlacementInstance != 0);
 
-	sdaiAppend(pMaterialLayers, sdaiINSTANCE, (void*)buildMaterialLayer(dThickness));
+	if (iPlacementRelativeTo != 0) 
+	{
+		sdaiPutAttrBN(iLocalPlacementInstance, "PlacementRelTo", sdaiINSTANCE, (void*)iPlacementRelativeTo);
+	}
+	sdaiPutAttrBN(iLocalPlacementInstance, "RelativePlacement", sdaiINSTANCE, (void*)buildAxis2Placement3DInstance(pMatrix));
 
-	return iMaterialLayerSetInstance;
+	return iLocalPlacementInstance;
 }
 
-SdaiInstance _exporter_base::buildMaterialLayerSetUsage(double dThickness)
+SdaiInstance _exporter_base::buildAxis2Placement3DInstance(_matrix* pMatrix)
 {
-	double dOffsetFromReferenceLine = -dThickness / 2.;
-
-	SdaiInstance iMaterialLayerSetUsageInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMaterialLayerSetUsage");
-	assert(iMaterialLayerSetUsageInstance != 0);
+	SdaiInstance iAxis2Placement3DInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcAxis2Placement3D");
+	assert(iAxis2Placement3DInstance != 0);
 
-	sdaiPutAttrBN(iMaterialLayerSetUsageInstance, "ForLayerSet", sdaiINSTANCE, (void*)buildMaterialLayerSet(dThickness));
-	sdaiPutAttrBN(iMaterialLayerSetUsageInstance, "LayerSetDirection", sdaiENUM, "AXIS2");
-	sdaiPutAttrBN(iMaterialLayerSetUsageInstance, "DirectionSense", sdaiENUM, "POSITIVE");
-	sdaiPutAttrBN(iMaterialLayerSetUsageInstance, "OffsetFromReferenceLine", sdaiREAL, &dOffsetFromReferenceLine);
+	sdaiPutAttrBN(iAxis2Placement3DInstance, "Location", sdaiINSTANCE, (void*)buildCartesianPointInstance(pMatrix->_41, pMatrix->_42, pMatrix->_43));
+	sdaiPutAttrBN(iAxis2Placement3DInstance, "Axis", sdaiINSTANCE, (void*)buildDirectionInstance3D(pMatrix->_31, pMatrix->_32, pMatrix->_33));
+	sdaiPutAttrBN(iAxis2Placement3DInstance, "RefDirection", sdaiINSTANCE, (void*)buildDirectionInstance3D(pMatrix->_11, pMatrix->_12, pMatrix->_13));
 
-	return iMaterialLayerSetUsageInstance;
+	return iAxis2Placement3DInstance;
 }
 
-SdaiInstance _exporter_base::buildRelAssociatesMaterial(SdaiInstance iBuildingElementInstance, double dThickness)
+SdaiInstance _exporter_base::buildBuildingInstance(
+	const char* szName,
+	const char* szDescription,
+	_matrix* pMatrix,
+	SdaiInstance iPlacementRelativeTo,
+	SdaiInstance& iBuildingInstancePlacement)
 {
-	assert(iBuildingElementInstance != 0);
+	assert(pMatrix != nullptr);
+	assert(iPlacementRelativeTo != 0);
 
-	SdaiInstance iRelAssociatesMaterialInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelAssociatesMaterial");
-	assert(iRelAssociatesMaterialInstance != 0);
+	SdaiInstance iBuildingInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcBuilding");
+	assert(iBuildingInstance != 0);
 
-	sdaiPutAttrBN(iRelAssociatesMaterialInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
-	sdaiPutAttrBN(iRelAssociatesMaterialInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iBuildingInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iBuildingInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iBuildingInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iBuildingInstance, "Description", sdaiSTRING, szDescription);
 
-	SdaiAggr pRelatedObjects = sdaiCreateAggrBN(iRelAssociatesMaterialInstance, "RelatedObjects");
-	assert(pRelatedObjects != nullptr);
+	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
+	assert(iBuildingInstancePlacement != 0);
 
-	sdaiAppend(pRelatedObjects, sdaiINSTANCE, (void*)iBuildingElementInstance);
-	sdaiPutAttrBN(iRelAssociatesMaterialInstance, "RelatingMaterial", sdaiINSTANCE, (void*)buildMaterialLayerSetUsage(dThickness));
+	sdaiPutAttrBN(iBuildingInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
+	sdaiPutAttrBN(iBuildingInstance, "CompositionType", sdaiENUM, "ELEMENT");
+	//sdaiPutAttrBN(iBuildingInstance, "BuildingAddress", sdaiINSTANCE, (void*)buildPostalAddress()); //#tbd
 
-	return iRelAssociatesMaterialInstance;
+	return iBuildingInstance;
 }
 
-string _exporter_base::getTag(OwlInstance iInstance) const
+SdaiInstance _exporter_base::buildFeatureInstance(
+	const char* szName,
+	const char* szDescription,
+	_matrix* pMatrix,
+	SdaiInstance iPlacementRelativeTo,
+	SdaiInstance& iBuildingInstancePlacement,
+	const vector<SdaiInstance>& vecRepresentations)
 {
-	assert(iInstance != 0);
-
-	SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, false);
-
-	wchar_t** szValue = nullptr;
-	int64_t iValuesCount = 0;
-	GetDatatypeProperty(
-		iInstance,
-		m_iTagProperty,
-		(void**)&szValue, 
-		&iValuesCount);
-	assert(iValuesCount == 1);
-
-	SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, true);
+	assert(szName != nullptr);
+	assert(szDescription != nullptr);
+	assert(pMatrix != nullptr);
+	assert(iPlacementRelativeTo != 0);
+	assert(!vecRepresentations.empty());
 
-#ifdef _WINDOWS
-	auto iLength = std::char_traits<char16_t>::length((char16_t*)*szValue);
+	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcBuildingElementProxy");
+	assert(iBuildingElementInstance != 0);
 
-	u16string strValueU16;
-	strValueU16.resize(iLength);
-	memcpy((void*)strValueU16.data(), szValue[0], iLength * sizeof(char16_t));
+	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
 
-	return To_UTF8(strValueU16);
-#else
-	auto iLength = std::char_traits<wchar_t>::length((wchar_t*)*szValue);
+	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
+	assert(iBuildingInstancePlacement != 0);
 
-	u32string strValueU32;
-	strValueU32.resize(iLength);
-	memcpy((void*)strValueU32.data(), szValue[0], iLength * sizeof(wchar_t));
+	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
+	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
 
-	return To_UTF8(strValueU32);
-#endif // _WINDOWS
+	return iBuildingElementInstance;
 }
 
-void _exporter_base::getXMLElementPrefixAndName(const string& strUniqueName, string& strPrefix, string& strName) const
+SdaiInstance _exporter_base::buildTransportElementInstance(
+	const char* szName,
+	const char* szDescription,
+	_matrix* pMatrix,
+	SdaiInstance iPlacementRelativeTo,
+	SdaiInstance& iBuildingInstancePlacement,
+	const vector<SdaiInstance>& vecRepresentations)
 {
-	assert(!strUniqueName.empty() && strPrefix.empty() && strName.empty());
+	assert(szName != nullptr);
+	assert(szDescription != nullptr);
+	assert(pMatrix != nullptr);
+	assert(iPlacementRelativeTo != 0);
+	assert(!vecRepresentations.empty());
 
-	strName = strUniqueName;
+	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcTransportElement");
+	assert(iBuildingElementInstance != 0);
 
-	vector<string> vecTokens;
-	_string::tokenize(strUniqueName, ":", vecTokens);
+	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
 
-	assert(!vecTokens.empty() && (vecTokens.size() <= 2));
+	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
+	assert(iBuildingInstancePlacement != 0);
 
-	if (vecTokens.size() == 2)
-	{
-		strPrefix = vecTokens[0];
-		strName = vecTokens[1];
-	}
+	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
+	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
+
+	return iBuildingElementInstance;
 }
 
-string _exporter_base::getStringAttributeValue(OwlInstance iInstance, const string& strName) const
-{
-	assert(iInstance != 0);
-	assert(!strName.empty());
-
-	int64_t iPropertyInstance = GetInstancePropertyByIterator(iInstance, 0);
-	while (iPropertyInstance != 0)
-	{
-		char* szPropertyUniqueName = nullptr;
-		GetNameOfProperty(iPropertyInstance, &szPropertyUniqueName);
+SdaiInstance _exporter_base::buildFurnitureObjectInstance(
+	const char* szName,
+	const char* szDescription,
+	_matrix* pMatrix,
+	SdaiInstance iPlacementRelativeTo,
+	SdaiInstance& iBuildingInstancePlacement,
+	const vector<SdaiInstance>& vecRepresentations)
+{
+	assert(szName != nullptr);
+	assert(szDescription != nullptr);
+	assert(pMatrix != nullptr);
+	assert(iPlacementRelativeTo != 0);
+	assert(!vecRepresentations.empty());
 
-		string strPropertyUniqueName = szPropertyUniqueName;
-		if ((strPropertyUniqueName == "attr:str:" + strName) ||
-			_string::startsEndsWith(strPropertyUniqueName, "attr:str:", ":" + strName, false))
-		{
-			assert(GetPropertyType(iPropertyInstance) == DATATYPEPROPERTY_TYPE_WCHAR_T_ARRAY);
+	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcFurnishingElement");
+	assert(iBuildingElementInstance != 0);
 
-			SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, false);
+	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
 
-			wchar_t** szValue = nullptr;
-			int64_t iValuesCount = 0;
-			GetDatatypeProperty(
-				iInstance,
-				iPropertyInstance,
-				(void**)&szValue, 
-				&iValuesCount);
-			assert(iValuesCount == 1);
+	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
+	assert(iBuildingInstancePlacement != 0);
 
-			SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, true);
+	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
+	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
 
-#ifdef _WINDOWS
-			auto iLength = std::char_traits<char16_t>::length((char16_t*)*szValue);
+	return iBuildingElementInstance;
+}
 
-			u16string strValueU16;
-			strValueU16.resize(iLength);
-			memcpy((void*)strValueU16.data(), szValue[0], iLength * sizeof(char16_t));
+SdaiInstance _exporter_base::buildGeographicElementInstance(
+	const char* szName,
+	const char* szDescription,
+	_matrix* pMatrix,
+	SdaiInstance iPlacementRelativeTo,
+	SdaiInstance& iBuildingInstancePlacement,
+	const vector<SdaiInstance>& vecRepresentations)
+{
+	assert(szName != nullptr);
+	assert(szDescription != nullptr);
+	assert(pMatrix != nullptr);
+	assert(iPlacementRelativeTo != 0);
+	assert(!vecRepresentations.empty());
 
-			return To_UTF8(strValueU16);
-#else
-			auto iLength = std::char_traits<wchar_t>::length((wchar_t*)*szValue);
+	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcGeographicElement");
+	assert(iBuildingElementInstance != 0);
 
-			u32string strValueU32;
-			strValueU32.resize(iLength);
-			memcpy((void*)strValueU32.data(), szValue[0], iLength * sizeof(wchar_t));
+	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
 
-			return To_UTF8(strValueU32);
-#endif // _WINDOWS			
-		} // if (strPropertyUniqueName == ...
+	iBuildingInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
+	assert(iBuildingInstancePlacement != 0);
 
-		iPropertyInstance = GetInstancePropertyByIterator(iInstance, iPropertyInstance);
-	} // while (iPropertyInstance != 0)
+	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingInstancePlacement);
+	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
 
-	return "";
+	return iBuildingElementInstance;
 }
 
-string _exporter_base::getStringPropertyValue(OwlInstance iInstance, const string& strName) const
+SdaiInstance _exporter_base::buildBuildingStoreyInstance(_matrix* pMatrix, SdaiInstance iPlacementRelativeTo, SdaiInstance& iBuildingStoreyInstancePlacement)
 {
-	assert(iInstance != 0);
-	assert(!strName.empty());
-
-	int64_t iPropertyInstance = GetInstancePropertyByIterator(iInstance, 0);
-	while (iPropertyInstance != 0)
-	{
-		char* szPropertyUniqueName = nullptr;
-		GetNameOfProperty(iPropertyInstance, &szPropertyUniqueName);
+	assert(pMatrix != nullptr);
+	assert(iPlacementRelativeTo != 0);
 
-		string strPropertyUniqueName = szPropertyUniqueName;
-		if ((strPropertyUniqueName == "prop:str:" + strName) || 
-			_string::startsEndsWith(strPropertyUniqueName, "prop:str:", ":" + strName, false))
-		{
-			assert(GetPropertyType(iPropertyInstance) == DATATYPEPROPERTY_TYPE_STRING);
+	SdaiInstance iBuildingStoreyInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcBuildingStorey");
+	assert(iBuildingStoreyInstance != 0);
 
-			SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, false);
+	sdaiPutAttrBN(iBuildingStoreyInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iBuildingStoreyInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iBuildingStoreyInstance, "Name", sdaiSTRING, "Default Building Storey"); //#tbd
+	sdaiPutAttrBN(iBuildingStoreyInstance, "Description", sdaiSTRING, "Description of Default Building Storey"); //#tbd
 
-			char** szValue = nullptr;
-			int64_t iValuesCount = 0;
-			GetDatatypeProperty(
-				iInstance,
-				iPropertyInstance,
-				(void**)&szValue,
-				&iValuesCount);
-			assert(iValuesCount == 1);
+	iBuildingStoreyInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
+	assert(iBuildingStoreyInstancePlacement != 0);
 
-			SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, true);
+	sdaiPutAttrBN(iBuildingStoreyInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingStoreyInstancePlacement);
+	sdaiPutAttrBN(iBuildingStoreyInstance, "CompositionType", sdaiENUM, "ELEMENT");
 
-#ifdef _WINDOWS
-			auto iLength = std::char_traits<char16_t>::length((char16_t*)*szValue);
+	double dElevation = 0;
+	sdaiPutAttrBN(iBuildingStoreyInstance, "Elevation", sdaiREAL, &dElevation);
 
-			u16string strValueU16;
-			strValueU16.resize(iLength);
-			memcpy((void*)strValueU16.data(), szValue[0], iLength * sizeof(char16_t));
+	return iBuildingStoreyInstance;
+}
 
-			return To_UTF8(strValueU16);
-#else
-			auto iLength = std::char_traits<wchar_t>::length((wchar_t*)*szValue);
+SdaiInstance _exporter_base::buildProductDefinitionShapeInstance(const vector<SdaiInstance>& vecRepresentations)
+{
+	assert(!vecRepresentations.empty());
 
-			u32string strValueU32;
-			strValueU32.resize(iLength);
-			memcpy((void*)strValueU32.data(), szValue[0], iLength * sizeof(wchar_t));
+	SdaiInstance iProductDefinitionShapeInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcProductDefinitionShape");
+	assert(iProductDefinitionShapeInstance != 0);
 
-			return To_UTF8(strValueU32);
-#endif // _WINDOWS			
-		} // if (strPropertyUniqueName == ...
+	SdaiAggr pRepresentations = sdaiCreateAggrBN(iProductDefinitionShapeInstance, "Representations");
+	assert(pRepresentations != nullptr);
 
-		iPropertyInstance = GetInstancePropertyByIterator(iInstance, iPropertyInstance);
-	} // while (iPropertyInstance != 0)
+	for (auto iRepresentation : vecRepresentations)
+	{
+		sdaiAppend(pRepresentations, sdaiINSTANCE, (void*)iRepresentation);
+	}
 
-	return "";
+	return iProductDefinitionShapeInstance;
 }
 
-void _exporter_base::getDoublePropertyValue(OwlInstance iInstance, const string& strName, vector<double>& vecValue) const
+SdaiInstance _exporter_base::buildRelAggregatesInstance(
+	const char* szName, 
+	const char* szDescription, 
+	SdaiInstance iRelatingObjectInstance, 
+	const vector<SdaiInstance>& vecRelatedObjects)
 {
-	assert(iInstance != 0);
-	assert(!strName.empty());
-
-	vecValue.clear();
-
-	int64_t iPropertyInstance = GetInstancePropertyByIterator(iInstance, 0);
-	while (iPropertyInstance != 0)
-	{
-		char* szPropertyUniqueName = nullptr;
-		GetNameOfProperty(iPropertyInstance, &szPropertyUniqueName);
+	assert(iRelatingObjectInstance != 0);
+	assert(!vecRelatedObjects.empty());
 
-		string strPropertyUniqueName = szPropertyUniqueName;
-		if ((strPropertyUniqueName == "prop:dbl:" + strName) ||
-			_string::startsEndsWith(strPropertyUniqueName, "prop:dbl:", ":" + strName, false))
-		{
-			assert(GetPropertyType(iPropertyInstance) == DATATYPEPROPERTY_TYPE_DOUBLE);
+	SdaiInstance iRelAggregatesInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelAggregates");
+	assert(iRelAggregatesInstance != 0);
 
-			double* pdValue = nullptr;
-			int64_t iValuesCount = 0;
-			GetDatatypeProperty(
-				iInstance,
-				iPropertyInstance,
-				(void**)&pdValue,
-				&iValuesCount);
-			assert(iValuesCount > 0);
+	sdaiPutAttrBN(iRelAggregatesInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iRelAggregatesInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iRelAggregatesInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iRelAggregatesInstance, "Description", sdaiSTRING, szDescription);
+	sdaiPutAttrBN(iRelAggregatesInstance, "RelatingObject", sdaiINSTANCE, (void*)iRelatingObjectInstance);
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				vecValue.push_back(pdValue[iValue]);
-			}
+	SdaiAggr pRelatedObjects = sdaiCreateAggrBN(iRelAggregatesInstance, "RelatedObjects");
+	assert(pRelatedObjects != nullptr);
 
-			break;
-		} // if (strPropertyUniqueName == ...
+	for (auto iRelatedObject : vecRelatedObjects)
+	{
+		sdaiAppend(pRelatedObjects, sdaiINSTANCE, (void*)iRelatedObject);
+	}
 
-		iPropertyInstance = GetInstancePropertyByIterator(iInstance, iPropertyInstance);
-	} // while (iPropertyInstance != 0)
+	return iRelAggregatesInstance;
 }
 
-OwlInstance* _exporter_base::getObjectProperty(OwlInstance iInstance, const string& strPropertyName, int64_t& iInstancesCount) const
+SdaiInstance _exporter_base::buildRelNestsInstance(
+	const char* szName,
+	const char* szDescription,
+	SdaiInstance iRelatingObjectInstance,
+	const vector<SdaiInstance>& vecRelatedObjects)
 {
-	assert(iInstance != 0);
-	assert(!strPropertyName.empty());
+	assert(iRelatingObjectInstance != 0);
+	assert(!vecRelatedObjects.empty());
 
-	iInstancesCount = 0;
+	SdaiInstance iIfcRelNestsInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelNests");
+	assert(iIfcRelNestsInstance != 0);
 
-	RdfProperty iProperty = GetPropertyByName(getSite()->getOwlModel(), strPropertyName.c_str());
-	if (iProperty == 0)
-	{
-		return nullptr;
-	}
+	sdaiPutAttrBN(iIfcRelNestsInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iIfcRelNestsInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iIfcRelNestsInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iIfcRelNestsInstance, "Description", sdaiSTRING, szDescription);
+	sdaiPutAttrBN(iIfcRelNestsInstance, "RelatingObject", sdaiINSTANCE, (void*)iRelatingObjectInstance);
 
-	OwlInstance* piInstances = nullptr;
-	GetObjectProperty(
-		iInstance,
-		iProperty,
-		&piInstances,
-		&iInstancesCount);
+	SdaiAggr pRelatedObjects = sdaiCreateAggrBN(iIfcRelNestsInstance, "RelatedObjects");
+	assert(pRelatedObjects != nullptr);
 
-	if (iInstancesCount == 0)
+	for (auto iRelatedObject : vecRelatedObjects)
 	{
-		return nullptr;
+		sdaiAppend(pRelatedObjects, sdaiINSTANCE, (void*)iRelatedObject);
 	}
 
-	return piInstances;
+	return iIfcRelNestsInstance;
 }
 
-bool _exporter_base::hasObjectProperty(OwlInstance iInstance, const string& strPropertyName)
+SdaiInstance _exporter_base::buildRelContainedInSpatialStructureInstance(
+	const char* szName,
+	const char* szDescription,
+	SdaiInstance iRelatingStructureInstance,
+	const vector<SdaiInstance>& vecRelatedElements)
 {
-	int64_t iInstancesCount = 0;
+	assert(iRelatingStructureInstance != 0);
+	assert(!vecRelatedElements.empty());
 
-	return getObjectProperty(iInstance, strPropertyName, iInstancesCount) != nullptr;
-}
+	SdaiInstance iRelContainedInSpatialStructureInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelContainedInSpatialStructure");
+	assert(iRelContainedInSpatialStructureInstance != 0);
 
-void _exporter_base::getPosValues(const string& strContent, vector<double>& vecValues) const
-{
-	assert(!strContent.empty());
+	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "Description", sdaiSTRING, szDescription);
+	sdaiPutAttrBN(iRelContainedInSpatialStructureInstance, "RelatingStructure", sdaiINSTANCE, (void*)iRelatingStructureInstance);
 
-	vector<string> vecStrValues;
-	_string::split(strContent, " ", vecStrValues);
+	SdaiAggr pRelatedElements = sdaiCreateAggrBN(iRelContainedInSpatialStructureInstance, "RelatedElements");
+	assert(pRelatedElements != nullptr);
 
-	if (vecStrValues.size() > 3)
-	{
-		assert(false);
-	}
-	else if (vecStrValues.size() < 3)
+	for (auto iRelatedElement : vecRelatedElements)
 	{
-		vecStrValues.resize(3, "0"); // Z
+		sdaiAppend(pRelatedElements, sdaiINSTANCE, (void*)iRelatedElement);
 	}
 
-	for (auto strValue : vecStrValues)
-	{
-		vecValues.push_back(atof(strValue.c_str()));
-	}
+	return iRelContainedInSpatialStructureInstance;
 }
 
-void _exporter_base::getPosValuesW(const wstring& strContent, vector<double>& vecValues) const
-{
-	assert(!strContent.empty());
-
-	getPosValues((LPCSTR)CW2A(strContent.c_str()), vecValues);	
-}
-
-// ************************************************************************************************
-_citygml_exporter::_citygml_exporter(_gml2ifc_exporter* pSite)
-	: _exporter_base(pSite)
-	, m_fXmin(FLT_MAX)
-	, m_fXmax(-FLT_MAX)
-	, m_fYmin(FLT_MAX)
-	, m_fYmax(-FLT_MAX)
-	, m_fZmin(FLT_MAX)
-	, m_fZmax(-FLT_MAX)
-	, m_iPoint3DClass(0)
-	, m_iCollectionClass(0)
-	, m_iTransformationClass(0)
-	, m_mapInstanceDefaultState()
-	, m_mapMappedItems()
-	, m_iCityModelClass(0)
-	, m_iBoundingShapeClass(0)
-	, m_iEnvelopeClass(0)
-	, m_iEnvelopeInstance(0)
-	, m_mapBuildingSRS()
-	, m_mapParcelSRS()
-	, m_iCityObjectGroupMemberClass(0)
-	, m_iGeometryMemberClass(0)
-	, m_iBuildingClass(0)
-	, m_iBuildingPartClass(0)
-	, m_iWallSurfaceClass(0)
-	, m_iRoofSurfaceClass(0)
-	, m_iDoorClass(0)
-	, m_iWindowClass(0)
-	, m_mapBuildings()
-	, m_mapBuildingElements()
-	, m_iCadastralParcelClass(0)
-	, m_iPointPropertyClass(0)
-	, m_iReferencePointIndicatorClass(0)
-	, m_iVegetationObjectClass(0)
-	, m_iWaterObjectClass(0)
-	, m_iBridgeObjectClass(0)
-	, m_iTunnelObjectClass(0)
-	, m_iTransportationObjectClass(0)
-	, m_iFurnitureObjectClass(0)
-	, m_iReliefObjectClass(0)
-	, m_iLandUseClass(0)
-	, m_iTrafficSpaceClass(0)
-	, m_iTrafficAreaClass(0)
-	, m_iThingClass(0)
-	, m_mapFeatures()
-	, m_mapFeatureElements()
-	, m_mapBuildingHighestLOD()
-	, m_iFilteredBuildingElements(0)
-	, m_mapFeatureHighestLOD()
-	, m_iFilteredFeatureElements(0)
-	, m_vecSiteInstances()
-	, m_iCurrentOwlBuildingElementInstance(0)	
-	, m_dXOffset(0.)
-	, m_dYOffset(0.)
-	, m_dZOffset(0.)
-	, m_iDefaultWallSurfaceColorRgbInstance(0)
-	, m_iDefaultRoofSurfaceColorRgbInstance(0)
-	, m_iDefaultDoorColorRgbInstance(0)
-	, m_iDefaultWindowColorRgbInstance(0)
-	, m_iDefaultColorRgbInstance(0)
+SdaiInstance _exporter_base::buildBuildingElementInstance(
+	const char* szEntity,
+	const char* szName,
+	const char* szDescription,
+	_matrix* pMatrix,
+	SdaiInstance iPlacementRelativeTo,
+	SdaiInstance& iBuildingElementInstancePlacement,
+	const vector<SdaiInstance>& vecRepresentations)
 {
-	// Geometry Kernel
-	m_iPoint3DClass = GetClassByName(getSite()->getOwlModel(), "Point3D");
-	m_iCollectionClass = GetClassByName(getSite()->getOwlModel(), "Collection");
-	m_iTransformationClass = GetClassByName(getSite()->getOwlModel(), "Transformation");	
-
-	// CRS
-	m_iCityModelClass = GetClassByName(getSite()->getOwlModel(), "class:CityModelType");
-	m_iBoundingShapeClass = GetClassByName(getSite()->getOwlModel(), "class:BoundingShapeType");
-	m_iEnvelopeClass = GetClassByName(getSite()->getOwlModel(), "class:EnvelopeType");
+	assert(szEntity != nullptr);
+	assert(szName != nullptr);
+	assert(szDescription != nullptr);
+	assert(pMatrix != nullptr);
+	assert(iPlacementRelativeTo != 0);
+	assert(!vecRepresentations.empty());
 
-	// CityObjectGroup
-	m_iCityObjectGroupMemberClass = GetClassByName(getSite()->getOwlModel(), "class:CityObjectGroupMemberType");
+	SdaiInstance iBuildingElementInstance = sdaiCreateInstanceBN(m_iSdaiModel, szEntity);
+	assert(iBuildingElementInstance != 0);
 
-	// relativeGMLGeometry
-	m_iGeometryMemberClass = GetClassByName(getSite()->getOwlModel(), "class:geometryMember");
+	sdaiPutAttrBN(iBuildingElementInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iBuildingElementInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iBuildingElementInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iBuildingElementInstance, "Description", sdaiSTRING, szDescription);
 
-	// Building
-	m_iBuildingClass = GetClassByName(getSite()->getOwlModel(), "class:Building");
-	m_iBuildingPartClass = GetClassByName(getSite()->getOwlModel(), "class:BuildingPart");
-	m_iWallSurfaceClass = GetClassByName(getSite()->getOwlModel(), "class:WallSurface");
-	m_iRoofSurfaceClass = GetClassByName(getSite()->getOwlModel(), "class:RoofSurface");
-	m_iDoorClass = GetClassByName(getSite()->getOwlModel(), "class:Door");
-	m_iWindowClass = GetClassByName(getSite()->getOwlModel(), "class:Window");
+	iBuildingElementInstancePlacement = buildLocalPlacementInstance(pMatrix, iPlacementRelativeTo);
+	assert(iBuildingElementInstancePlacement != 0);
 
-	// Parcel
-	m_iCadastralParcelClass = GetClassByName(getSite()->getOwlModel(), "class:CadastralParcelType");
-	m_iPointPropertyClass = GetClassByName(getSite()->getOwlModel(), "class:PointPropertyType");
-	m_iReferencePointIndicatorClass = GetClassByName(getSite()->getOwlModel(), "ReferencePointIndicator");
+	sdaiPutAttrBN(iBuildingElementInstance, "ObjectPlacement", sdaiINSTANCE, (void*)iBuildingElementInstancePlacement);
+	sdaiPutAttrBN(iBuildingElementInstance, "Representation", sdaiINSTANCE, (void*)buildProductDefinitionShapeInstance(vecRepresentations));
 
-	// Feature
-	m_iVegetationObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_VegetationObject");
-	m_iWaterObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_WaterObject");
-	m_iBridgeObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_AbstractBridge");
-	m_iTunnelObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_AbstractTunnel");
-	m_iTransportationObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_TransportationObject");
-	m_iFurnitureObjectClass = GetClassByName(getSite()->getOwlModel(), "class:CityFurniture");
-	m_iReliefObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_ReliefComponent");
-	m_iLandUseClass = GetClassByName(getSite()->getOwlModel(), "class:LandUse");
-	m_iTrafficSpaceClass = GetClassByName(getSite()->getOwlModel(), "class:trafficSpace");
-	m_iTrafficAreaClass = GetClassByName(getSite()->getOwlModel(), "class:TrafficArea");
-	m_iThingClass = GetClassByName(getSite()->getOwlModel(), "class:Thing");
+	return iBuildingElementInstance;
 }
 
-/*virtual*/ _citygml_exporter::~_citygml_exporter()
-{}
-
-/*virtual*/ int _citygml_exporter::retrieveSRSData(OwlInstance iRootInstance) /*override*/
+SdaiInstance _exporter_base::buildRepresentationMap(_matrix* pMatrix, const vector<SdaiInstance>& vecMappedRepresentations)
 {
-	assert(iRootInstance != 0);
-
-	collectSRSData(iRootInstance);
-
-	int iTransformationsCount = 0;
+	SdaiInstance iRepresentationMapInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRepresentationMap");
+	assert(iRepresentationMapInstance != 0);
 
-	if (m_iEnvelopeInstance != 0)
-	{
-		if (transformEnvelopeSRSDataAsync(m_iEnvelopeInstance))
-		{
-			iTransformationsCount++;
-		}
-	}
-	
-	for (auto itBuildingSRS : m_mapBuildingSRS)
-	{
-		if (transformEnvelopeSRSDataAsync(itBuildingSRS.second))
-		{
-			iTransformationsCount++;
-		}
-	}
+	sdaiPutAttrBN(iRepresentationMapInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iRepresentationMapInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iRepresentationMapInstance, "MappingOrigin", sdaiINSTANCE, (void*)buildAxis2Placement3DInstance(pMatrix));
 
-	for (auto itParcelSRS : m_mapParcelSRS)
-	{
-		if (transformReferencePointSRSDataAsync(itParcelSRS.second))
-		{
-			iTransformationsCount++;
-		}
-	}
+	SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcShapeRepresentation");
+	assert(iShapeRepresentationInstance != 0);
 
-	return iTransformationsCount;
-}
+	sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
+	sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "Brep");
+	sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getRepresentationContextInstance());
 
-/*virtual*/ void _citygml_exporter::retrieveLODs(set<string>& setLODs) /*override*/
-{
-	assert(setLODs.empty());
+	SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
+	assert(pItems != 0);
 
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
+	for (auto iMappedRepresentation : vecMappedRepresentations)
 	{
-		string strLOD = getLOD(iInstance);
-		if (!strLOD.empty() && (setLODs.find(strLOD) == setLODs.end()))
-		{
-			string strEvent = "LOD: '";
-			strEvent += strLOD;
-			strEvent += "'";
-			getSite()->logInfo(strEvent);
+		sdaiAppend(pItems, sdaiINSTANCE, (void*)iMappedRepresentation);
+	}
 
-			setLODs.insert(strLOD);
-		}
+	sdaiPutAttrBN(iRepresentationMapInstance, "MappedRepresentation", sdaiINSTANCE, (void*)iShapeRepresentationInstance);	
 
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	} // while (iInstance != 0)
+	return iRepresentationMapInstance;
 }
 
-/*virtual*/ void _citygml_exporter::preProcessing() /*override*/
+SdaiInstance _exporter_base::buildMappedItem(
+	const vector<SdaiInstance>& vecRepresentations,
+	const double* pdReferencePointMatrix,
+	const double* pdTransformationMatrix)
 {
-	getInstancesDefaultState();
+	assert(!vecRepresentations.empty());
+	assert(pdReferencePointMatrix != nullptr);
+	assert(pdTransformationMatrix != nullptr);
 
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
-	{		
-		_vector3d vecBBMin;
-		_vector3d vecBBMax;
-		if (m_mapInstanceDefaultState.at(iInstance) &&
-			GetInstanceGeometryClass(iInstance) &&
-			GetBoundingBox(
-				iInstance,
-				(double*)&vecBBMin,
-				(double*)&vecBBMax))
-		{
-			m_fXmin = (float)fmin(m_fXmin, vecBBMin.x);
-			m_fXmax = (float)fmax(m_fXmax, vecBBMax.x);
-			m_fYmin = (float)fmin(m_fYmin, vecBBMin.y);
-			m_fYmax = (float)fmax(m_fYmax, vecBBMax.y);
-			m_fZmin = (float)fmin(m_fZmin, vecBBMin.z);
-			m_fZmax = (float)fmax(m_fZmax, vecBBMax.z);
-		}
+	SdaiInstance iMappedItemInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMappedItem");
+	assert(iMappedItemInstance != 0);
 
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	} // while (iInstance != 0)
+	sdaiPutAttrBN(iMappedItemInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iMappedItemInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
 
-	if (getHighestLOD())
-	{
-		calculateHighestLODForBuildings();
-		calculateHighestLODForFeatures();
-	}
-}
+	// Reference Point (Anchor)
+	_matrix mtxReferencePoint;
+	mtxReferencePoint._41 = pdReferencePointMatrix[9];
+	mtxReferencePoint._42 = pdReferencePointMatrix[10];
+	mtxReferencePoint._43 = pdReferencePointMatrix[11];
+	sdaiPutAttrBN(iMappedItemInstance, "MappingSource", sdaiINSTANCE, (void*)buildRepresentationMap(&mtxReferencePoint, vecRepresentations));
 
-/*virtual*/ bool _citygml_exporter::isBuildingElementFiltered(OwlInstance iBuildingInstance, OwlInstance iInstance) /*override*/
-{
-	assert(iBuildingInstance != 0);
-	assert(iInstance != 0);
+	SdaiInstance iCartesianTransformationOperator3DInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcCartesianTransformationOperator3D");
+	assert(iCartesianTransformationOperator3DInstance != 0);	
 
-	// LODs
-	if (getHighestLOD())
+	// Transformation Matrix
 	{
-		double dLOD = getLODAsDouble(iInstance);
+		const double* pdValues = pdTransformationMatrix;
 
-		auto itHighestLOD = m_mapBuildingHighestLOD.find(iBuildingInstance);
-		assert(itHighestLOD != m_mapBuildingHighestLOD.end());
-		
-		if ((dLOD != -DBL_MAX) && (itHighestLOD->second != -DBL_MAX))
-		{
-			if ((itHighestLOD->second - dLOD) > 0.0001)
-			{
-				m_iFilteredBuildingElements++;
+		sdaiPutAttrBN(iCartesianTransformationOperator3DInstance, "Axis1", sdaiINSTANCE, (void*)buildDirectionInstance3D(pdValues[0], pdValues[1], pdValues[2]));
+		sdaiPutAttrBN(iCartesianTransformationOperator3DInstance, "Axis2", sdaiINSTANCE, (void*)buildDirectionInstance3D(pdValues[3], pdValues[4], pdValues[5]));
+		sdaiPutAttrBN(iCartesianTransformationOperator3DInstance, "Axis3", sdaiINSTANCE, (void*)buildDirectionInstance3D(pdValues[6], pdValues[7], pdValues[8]));
 
-				return true;
-			}
-		}
-	}
-	else
-	{
-		if (!getTargetLODs().empty())
-		{
-			string strLOD = getLOD(iInstance);
-			if (!strLOD.empty() && (getTargetLODs().find(strLOD) == getTargetLODs().end()))
-			{
-				m_iFilteredBuildingElements++;
+		SdaiInstance iLocalOriginInstance = buildCartesianPointInstance(pdValues[9], pdValues[10], pdValues[11]);
+		assert(iLocalOriginInstance != 0);
 
-				return true;
-			}
-		}		
+		sdaiPutAttrBN(iCartesianTransformationOperator3DInstance, "LocalOrigin", sdaiINSTANCE, (void*)iLocalOriginInstance);
 	}	
 
-	return false;
-}
+	sdaiPutAttrBN(iMappedItemInstance, "MappingTarget", sdaiINSTANCE, (void*)iCartesianTransformationOperator3DInstance);
 
-/*virtual*/ bool _citygml_exporter::isFeatureElementFiltered(OwlInstance iFeatureInstance, OwlInstance iInstance) /*override*/
+	SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcShapeRepresentation");
+	assert(iShapeRepresentationInstance != 0);
+
+	sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
+	sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "MappedRepresentation");
+	sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getRepresentationContextInstance());
+
+	SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
+	assert(pItems != 0);
+
+	sdaiAppend(pItems, sdaiINSTANCE, (void*)iMappedItemInstance);
+
+	return iShapeRepresentationInstance;
+}
+
+SdaiInstance _exporter_base::buildMapConversion(OwlInstance iSourceCRSInstance, OwlInstance iTargetCRSInstance)
 {
-	assert(iFeatureInstance != 0);
-	assert(iInstance != 0);
+	assert(iSourceCRSInstance != 0);
+	assert(iTargetCRSInstance != 0);
 
-	// LODs
-	if (getHighestLOD())
-	{
-		double dLOD = getLODAsDouble(iInstance);
+	SdaiInstance iMapConversionInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcMapConversion");
+	assert(iMapConversionInstance != 0);
 
-		auto itHighestLOD = m_mapFeatureHighestLOD.find(iFeatureInstance);
-		assert(itHighestLOD != m_mapFeatureHighestLOD.end());
+	sdaiPutAttrBN(iMapConversionInstance, "SourceCRS", sdaiINSTANCE, (void*)iSourceCRSInstance);
+	sdaiPutAttrBN(iMapConversionInstance, "TargetCRS", sdaiINSTANCE, (void*)iTargetCRSInstance);
 
-		if ((dLOD != -DBL_MAX) && (itHighestLOD->second != -DBL_MAX))
-		{
-			if ((itHighestLOD->second - dLOD) > 0.0001)
-			{
-				m_iFilteredFeatureElements++;
+	double dValue = 0.;
+	sdaiPutAttrBN(iMapConversionInstance, "Eastings", sdaiREAL, &dValue);
 
-				return true;
-			}
-		}
-	}
-	else
-	{
-		if (!getTargetLODs().empty())
-		{
-			string strLOD = getLOD(iInstance);
-			if (!strLOD.empty() && (getTargetLODs().find(strLOD) == getTargetLODs().end()))
-			{
-				m_iFilteredFeatureElements++;
+	dValue = 0.;
+	sdaiPutAttrBN(iMapConversionInstance, "Northings", sdaiREAL, &dValue);
 
-				return true;
-			}
-		}
-	}
+	dValue = 0.;
+	sdaiPutAttrBN(iMapConversionInstance, "OrthogonalHeight", sdaiREAL, &dValue);
 
-	return false;
+	dValue = 1.;
+	sdaiPutAttrBN(iMapConversionInstance, "XAxisAbscissa", sdaiREAL, &dValue);
+
+	dValue = 0.;
+	sdaiPutAttrBN(iMapConversionInstance, "XAxisOrdinate", sdaiREAL, &dValue);
+
+	dValue = 1.;
+	sdaiPutAttrBN(iMapConversionInstance, "Scale", sdaiREAL, &dValue);
+
+	return iMapConversionInstance;
 }
 
-/*virtual*/ string _citygml_exporter::getLOD(OwlInstance iInstance) const
+SdaiInstance _exporter_base::buildProjectedCRS(const string& strEPSG)
 {
-	assert(iInstance != 0);
+	assert(!strEPSG.empty());
 
-	string strLOD;
+	SdaiInstance iProjectedCRSInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcProjectedCRS");
+	assert(iProjectedCRSInstance != 0);
 
-	// Property
-	vector<double> vecValues;
-	getDoublePropertyValue(iInstance, "lod", vecValues);
+	sdaiPutAttrBN(iProjectedCRSInstance, "Name", sdaiSTRING, strEPSG.c_str());
 
-	if (!vecValues.empty())
+	return iProjectedCRSInstance;
+}
+
+string _exporter_base::getEPSGCode(const string& strSrsName)
+{
+	assert(!strSrsName.empty());
+
+	size_t iIndex = string::npos;
+
+	// srsName="urn:ogc:def:crs,crs:EPSG::31256"
+	if ((iIndex = strSrsName.find("EPSG::")) != string::npos)
 	{
-		assert(vecValues.size() == 1);
+		string strCode = strSrsName.substr(iIndex + 6).c_str();
 
-		strLOD = _string::format("lod%d", (int)vecValues[0]);
+		return strCode;
 	}
 
-	// XML Element
-	if (strLOD.empty())
+	// EPSG:3763
+	if ((iIndex = strSrsName.find("EPSG:")) != string::npos)
 	{
-		string strTag = getTag(iInstance);
+		string strCode = strSrsName.substr(iIndex + 5).c_str();
 
-		vector<string> vecTokens;
-		_string::tokenize(strTag, ":", vecTokens);
+		return strCode;
+	}
 
-		assert(!vecTokens.empty());
+	// http://www.opengis.net/def/crs/EPSG/0/25830
+	if ((iIndex = strSrsName.find("/EPSG/0/")) != string::npos)
+	{
+		string strCode = strSrsName.substr(iIndex + 8).c_str();
 
-		string strName;
-		if (vecTokens.size() == 1)
-		{
-			strName = vecTokens[0];
-		}
-		else if (vecTokens.size() == 2)
-		{
-			strName = vecTokens[1];
-		}
+		return strCode;
+	}
 
-		if (!strName.empty())
-		{
-			if (_string::startsWith(strName, "lod0") ||
-				_string::contains(strName, ":lod0"))
-			{
-				strLOD = "lod0";
-			}
-			else if (_string::startsWith(strName, "lod1") ||
-				_string::contains(strName, ":lod1"))
-			{
-				strLOD = "lod1";
-			}
-			else if (_string::startsWith(strName, "lod2") ||
-				_string::contains(strName, ":lod2"))
-			{
-				strLOD = "lod2";
-			}
-			else if (_string::startsWith(strName, "lod3") ||
-				_string::contains(strName, ":lod3"))
-			{
-				strLOD = "lod3";
-			}
-			else if (_string::startsWith(strName, "lod4") ||
-				_string::contains(strName, ":lod4"))
-			{
-				strLOD = "lod4";
-			}
-		} // if (!strName.empty())			
-	} // if (strLOD.empty())
+	assert(false);
 
-	return strLOD;
+	return "";
 }
 
-/*virtual*/ double _citygml_exporter::getLODAsDouble(OwlInstance iInstance) const
+string _exporter_base::getEPSG(const string& strSrsName)
 {
-	assert(iInstance != 0);
-
-	double dLOD = -DBL_MAX;
+	assert(!strSrsName.empty());
 
-	// Property
-	vector<double> vecValues;
-	getDoublePropertyValue(iInstance, "lod", vecValues);
+	size_t iIndex = string::npos;
 
-	if (!vecValues.empty())
+	// srsName="urn:ogc:def:crs,crs:EPSG::31256"
+	if ((iIndex = strSrsName.find("EPSG::")) != string::npos)
 	{
-		assert(vecValues.size() == 1);
+		string strEPSG = strSrsName.substr(iIndex).c_str();
+		iIndex = strEPSG.find("::");
+		strEPSG.replace(iIndex, 2, ":");
 
-		dLOD = vecValues[0];
+		return strEPSG;
 	}
 
-	// XML Element
-	if (dLOD == -DBL_MAX)
+	// EPSG:3763
+	if (strSrsName.find("EPSG:") == 0)
 	{
-		string strTag = getTag(iInstance);
-
-		vector<string> vecTokens;
-		_string::tokenize(strTag, ":", vecTokens);
+		return strSrsName;
+	}
 
-		assert(!vecTokens.empty());
+	// http://www.opengis.net/def/crs/EPSG/0/25830
+	if (strSrsName.find("/EPSG/") != -1)
+	{
+		iIndex = strSrsName.rfind("/");
+		string strEPSG = "EPSG:";
+		strEPSG += strSrsName.substr(iIndex + 1).c_str();
 
-		string strName;
-		if (vecTokens.size() == 1)
-		{
-			strName = vecTokens[0];
-		}
-		else if (vecTokens.size() == 2)
-		{
-			strName = vecTokens[1];
-		}
+		return strEPSG;
+	}
 
-		if (!strName.empty())
-		{
-			if (_string::startsWith(strName, "lod0") ||
-				_string::contains(strName, ":lod0"))
-			{
-				dLOD = 0.;
-			}
-			else if (_string::startsWith(strName, "lod1") ||
-				_string::contains(strName, ":lod1"))
-			{
-				dLOD = 1.;
-			}
-			else if (_string::startsWith(strName, "lod2") ||
-				_string::contains(strName, ":lod2"))
-			{
-				dLOD = 2.;
-			}
-			else if (_string::startsWith(strName, "lod3") ||
-				_string::contains(strName, ":lod3"))
-			{
-				dLOD = 3.;
-			}
-			else if (_string::startsWith(strName, "lod4") ||
-				_string::contains(strName, ":lod4"))
-			{
-				dLOD = 4.;
-			}
-		} // if (!strName.empty())			
-	} // if (dLOD == -DBL_MAX)
+	assert(false);
 
-	return dLOD;
+	return "";
 }
 
-/*virtual*/ void _citygml_exporter::executeCore(OwlInstance iRootInstance, const wstring& strOuputFile)
+void _exporter_base::readMaterial(OwlInstance iOwlInstance, _geometry_material& material) const
 {
-	assert(iRootInstance != 0);
-	assert(!strOuputFile.empty());
-
-	m_iEnvelopeInstance = 0;
-	m_mapBuildingSRS.clear();
-	m_mapParcelSRS.clear();
+	assert(iOwlInstance != 0);
 
-	m_mapBuildings.clear();
-	m_mapBuildingElements.clear();
+	material = _geometry_material();
 
-	m_mapFeatures.clear();
-	m_mapFeatureElements.clear();
+	// material
+	OwlInstance* piMaterials = nullptr;
+	int64_t iMaterialsCount = 0;
+	GetObjectProperty(
+		iOwlInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "material"),
+		&piMaterials,
+		&iMaterialsCount);
 
-	m_vecSiteInstances.clear();
+	assert(iMaterialsCount == 1);
 
-	collectSRSData(iRootInstance);
+	OwlInstance iMaterialInstance = piMaterials[0];
 
-	createIfcModel(L"IFC4");
+	if (hasObjectProperty(iMaterialInstance, "textures"))
+	{
+		material.m_enMaterial = enumGeometryMaterial::Texture;
 
-	// Global SRS (if any)
-	createBuildings();
-	createFeatures();
+		return;
+	}
 
-	if (!m_vecSiteInstances.empty())
+	if (m_pStringTable->getTagId(iMaterialInstance) == m_iDefaultMaterialId)
 	{
-		m_vecSiteInstances.erase(unique(m_vecSiteInstances.begin(), m_vecSiteInstances.end()), m_vecSiteInstances.end());
+		material.m_enMaterial = enumGeometryMaterial::Default;
 
-		buildRelAggregatesInstance(
-			"ProjectContainer",
-			"ProjectContainer for Sites",
-			getProjectInstance(),
-			m_vecSiteInstances);
+		return;
+	}
 
-		createSRSMapConversion();
-	} // if (!m_vecSiteInstances.empty())
+	// color
+	OwlInstance* piInstances = nullptr;
+	int64_t iInstancesCount = 0;
+	GetObjectProperty(
+		iMaterialInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "color"),
+		&piInstances,
+		&iInstancesCount);
 
-	saveIfcFile(strOuputFile.c_str());
-}
+	assert(iInstancesCount == 1);
 
-/*virtual*/ void _citygml_exporter::postProcessing() /*override*/
-{
-	getSite()->logInfo(_string::format("Filtered Building Elements: %d", m_iFilteredBuildingElements));
-	getSite()->logInfo(_string::format("Filtered Feature Elements: %d", m_iFilteredFeatureElements));
-}
+	OwlInstance iColorInstance = piInstances[0];
 
-/*virtual*/ void _citygml_exporter::onPreCreateSite(_matrix* pSiteMatrix) /*override*/
-{
-	assert(pSiteMatrix != 0);
+	// transparency
+	double* pdValues = nullptr;
+	int64_t iValuesCount = 0;
+	GetDatatypeProperty(
+		iColorInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "transparency"),
+		(void**)&pdValues,
+		&iValuesCount);
 
-	if (m_iEnvelopeInstance != 0)
+	double dTransparency = 0.;
+	if (iValuesCount == 1)
 	{
-		getEnvelopeCenter(m_iEnvelopeInstance, pSiteMatrix->_41, pSiteMatrix->_42, pSiteMatrix->_43);
+		dTransparency = 1. - pdValues[0];
 	}
+
+	// diffuse
+	piInstances = nullptr;
+	iInstancesCount = 0;
+	GetObjectProperty(
+		iColorInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "diffuse"),
+		&piInstances,
+		&iInstancesCount);
+
+	assert(iInstancesCount == 1);
+
+	OwlInstance iDiffuseColorComponentInstance = piInstances[0];
+
+	// R
+	double* pdRValue = nullptr;
+	iValuesCount = 0;
+	GetDatatypeProperty(
+		iDiffuseColorComponentInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "R"),
+		(void**)&pdRValue,
+		&iValuesCount);
+
+	assert(iValuesCount == 1);
+
+	// G
+	double* pdGValue = nullptr;
+	iValuesCount = 0;
+	GetDatatypeProperty(
+		iDiffuseColorComponentInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "G"),
+		(void**)&pdGValue,
+		&iValuesCount);
+
+	assert(iValuesCount == 1);
+
+	// B
+	double* pdBValue = nullptr;
+	iValuesCount = 0;
+	GetDatatypeProperty(
+		iDiffuseColorComponentInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "B"),
+		(void**)&pdBValue,
+		&iValuesCount);
+
+	assert(iValuesCount == 1);
+
+	material.m_enMaterial = enumGeometryMaterial::Color;
+	material.m_dR = pdRValue[0];
+	material.m_dG = pdGValue[0];
+	material.m_dB = pdBValue[0];
+	material.m_dTransparency = dTransparency;
 }
 
-/*virtual*/ void _citygml_exporter::onPostCreateSite(SdaiInstance iSiteInstance) /*override*/
+void _exporter_base::createStyledItemInstance(OwlInstance iOwlInstance, SdaiInstance iSdaiInstance)
 {
-	assert(iSiteInstance != 0);
+	assert(iOwlInstance != 0);
+	assert(iSdaiInstance != 0);
 
-	if (m_iEnvelopeInstance != 0)
-	{
-		setSiteEnvelopeSRSData(iSiteInstance, m_iEnvelopeInstance);
-	}
+	_geometry_material material;
+	readMaterial(iOwlInstance, material);
+
+	createStyledItemInstance(material, iSdaiInstance);
 }
 
-/*virtual*/ void _citygml_exporter::createDefaultStyledItemInstance(SdaiInstance iSdaiInstance) /*override*/
+void _exporter_base::createStyledItemInstance(const _geometry_material& material, SdaiInstance iSdaiInstance)
 {
-	assert(m_iCurrentOwlBuildingElementInstance != 0);
 	assert(iSdaiInstance != 0);
 
-	OwlClass iInstanceClass = GetInstanceClass(m_iCurrentOwlBuildingElementInstance);
-	assert(iInstanceClass != 0);
-
-	if (isWallSurfaceClass(iInstanceClass))
+	if (material.m_enMaterial == enumGeometryMaterial::Texture)
 	{
-		auto pMaterial = getSite()->getDefaultMaterial("$WALL");
-		if (pMaterial != nullptr)
+		if (m_pSite->isLogEnabled(enumLogEvent::warning))
 		{
-			if (m_iDefaultWallSurfaceColorRgbInstance == 0)
-			{
-				m_iDefaultWallSurfaceColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
-
-			createStyledItemInstance(iSdaiInstance, m_iDefaultWallSurfaceColorRgbInstance, pMaterial->getA() / 255.);
+			m_pSite->logWarn("Textures are not supported.");
 		}
-	}
-	else if (isRoofSurfaceClass(iInstanceClass))
-	{
-		auto pMaterial = getSite()->getDefaultMaterial("$ROOF");
-		if (pMaterial != nullptr)
-		{
-			if (m_iDefaultRoofSurfaceColorRgbInstance == 0)
-			{
-				m_iDefaultRoofSurfaceColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
 
-			createStyledItemInstance(iSdaiInstance, m_iDefaultRoofSurfaceColorRgbInstance, pMaterial->getA() / 255.);
-		}		
-	}
-	else if (isDoorClass(iInstanceClass))
-	{
-		auto pMaterial = getSite()->getDefaultMaterial("$DOOR");
-		if (pMaterial != nullptr)
-		{
-			if (m_iDefaultDoorColorRgbInstance == 0)
-			{
-				m_iDefaultDoorColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
+		createDefaultStyledItemInstance(iSdaiInstance);
 
-			createStyledItemInstance(iSdaiInstance, m_iDefaultDoorColorRgbInstance, pMaterial->getA() / 255.);
-		}
+		return;
 	}
-	else if (isWindowClass(iInstanceClass))
+
+	if (material.m_enMaterial == enumGeometryMaterial::Default)
 	{
-		auto pMaterial = getSite()->getDefaultMaterial("$WINDOW");
-		if (pMaterial != nullptr)
-		{
-			if (m_iDefaultWindowColorRgbInstance == 0)
-			{
-				m_iDefaultWindowColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
+		createDefaultStyledItemInstance(iSdaiInstance);
 
-			createStyledItemInstance(iSdaiInstance, m_iDefaultWindowColorRgbInstance, pMaterial->getA() / 255.);
-		}
+		return;
 	}
-	else
-	{
-		auto pMaterial = getSite()->getDefaultMaterial("$ALL");
-		if (pMaterial != nullptr)
-		{
-			if (m_iDefaultColorRgbInstance == 0)
-			{
-				m_iDefaultColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
 
-			createStyledItemInstance(iSdaiInstance, m_iDefaultColorRgbInstance, pMaterial->getA() / 255.);
-		}		
+	if (createOverriddenStyledItemInstance(iSdaiInstance))
+	{
+		return;
 	}
+
+	createStyledItemInstance(iSdaiInstance, material.m_dR, material.m_dG, material.m_dB, material.m_dTransparency);
 }
 
-/*virtual*/ bool _citygml_exporter::createOverriddenStyledItemInstance(SdaiInstance iSdaiInstance) /*override*/
+void _exporter_base::createStyledItemInstance(SdaiInstance iSdaiInstance, double dR, double dG, double dB, double dTransparency)
 {
-	assert(m_iCurrentOwlBuildingElementInstance != 0);
 	assert(iSdaiInstance != 0);
 
-	OwlClass iInstanceClass = GetInstanceClass(m_iCurrentOwlBuildingElementInstance);
-	assert(iInstanceClass != 0);
-
-	if (isWallSurfaceClass(iInstanceClass))
-	{
-		auto pMaterial = getSite()->getOverriddenMaterial("$WALL");
-		if (pMaterial != nullptr)
-		{
-			if (m_iDefaultWallSurfaceColorRgbInstance == 0)
-			{
-				m_iDefaultWallSurfaceColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
+	SdaiInstance iStyledItemInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcStyledItem");
+	assert(iStyledItemInstance != 0);
 
-			createStyledItemInstance(iSdaiInstance, m_iDefaultWallSurfaceColorRgbInstance, pMaterial->getA() / 255.);
+	sdaiPutAttrBN(iStyledItemInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iStyledItemInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
 
-			return true;
-		}
-	}
-	else if (isRoofSurfaceClass(iInstanceClass))
-	{
-		auto pMaterial = getSite()->getOverriddenMaterial("$ROOF");
-		if (pMaterial != nullptr)
-		{
-			if (m_iDefaultRoofSurfaceColorRgbInstance == 0)
-			{
-				m_iDefaultRoofSurfaceColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
+	SdaiAggr pStyles = sdaiCreateAggrBN(iStyledItemInstance, "Styles");
+	assert(pStyles != nullptr);
 
-			createStyledItemInstance(iSdaiInstance, m_iDefaultRoofSurfaceColorRgbInstance, pMaterial->getA() / 255.);
+	SdaiInstance iPresentationStyleAssignmentInstance = buildPresentationStyleAssignmentInstance();
+	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iPresentationStyleAssignmentInstance);
 
-			return true;
-		}
-	}
-	else if (isDoorClass(iInstanceClass))
-	{
-		auto pMaterial = getSite()->getOverriddenMaterial("$DOOR");
-		if (pMaterial != nullptr)
-		{
-			if (m_iDefaultDoorColorRgbInstance == 0)
-			{
-				m_iDefaultDoorColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
+	pStyles = sdaiCreateAggrBN(iPresentationStyleAssignmentInstance, "Styles");
+	assert(pStyles != nullptr);
 
-			createStyledItemInstance(iSdaiInstance, m_iDefaultDoorColorRgbInstance, pMaterial->getA() / 255.);
+	SdaiInstance iSurfaceStyleInstance = buildSurfaceStyleInstance();
+	sdaiPutAttrBN(iSurfaceStyleInstance, "Side", sdaiENUM, "BOTH");
+	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iSurfaceStyleInstance);
 
-			return true;
-		}
-	}
-	else if (isWindowClass(iInstanceClass))
-	{
-		auto pMaterial = getSite()->getOverriddenMaterial("$WINDOW");
-		if (pMaterial != nullptr)
-		{
-			if (m_iDefaultWindowColorRgbInstance == 0)
-			{
-				m_iDefaultWindowColorRgbInstance = buildColorRgbInstance(
-					pMaterial->getR() / 255.,
-					pMaterial->getG() / 255.,
-					pMaterial->getB() / 255.);
-			}
+	pStyles = sdaiCreateAggrBN(iSurfaceStyleInstance, "Styles");
+	assert(pStyles != nullptr);
 
-			createStyledItemInstance(iSdaiInstance, m_iDefaultWindowColorRgbInstance, pMaterial->getA() / 255.);
+	SdaiInstance iSurfaceStyleRenderingInstance = buildSurfaceStyleRenderingInstance();
+	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "ReflectanceMethod", sdaiENUM, "NOTDEFINED");
+	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iSurfaceStyleRenderingInstance);
 
-			return true;
-		}
-	}
+	SdaiInstance iColorRgbInstance = buildColorRgbInstance(dR, dG, dB);
+	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "SurfaceColour", sdaiINSTANCE, (void*)iColorRgbInstance);
+	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "Transparency", sdaiREAL, &dTransparency);
 
-	return false;
+	sdaiPutAttrBN(iStyledItemInstance, "Item", sdaiINSTANCE, (void*)iSdaiInstance);
 }
 
-/*virtual*/ void _citygml_exporter::collectSRSData(OwlInstance iRootInstance)
+void _exporter_base::createStyledItemInstance(SdaiInstance iSdaiInstance, SdaiInstance iColorRgbInstance, double dTransparency)
 {
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
-	{
-		OwlClass iInstanceClass = GetInstanceClass(iInstance);
-		assert(iInstanceClass != 0);
+	assert(iSdaiInstance != 0);
+	assert(iColorRgbInstance != 0);
 
-		if (isEnvelopeClass(iInstanceClass))
-		{
-			OwlInstance iEnvelopeInstance = iInstance;
+	SdaiInstance iStyledItemInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcStyledItem");
+	assert(iStyledItemInstance != 0);
 
-			OwlInstance iParentInstance = GetInstanceInverseReferencesByIterator(iInstance, 0);
-			if (iParentInstance != 0)
-			{
-				OwlClass iParentInstanceClass = GetInstanceClass(iParentInstance);
-				assert(iParentInstanceClass != 0);
+	sdaiPutAttrBN(iStyledItemInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iStyledItemInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
 
-				if (isBoundingShapeClass(iParentInstanceClass))
-				{
-					iParentInstance = GetInstanceInverseReferencesByIterator(iParentInstance, 0);
-					if (iParentInstance != 0)
-					{
-						iParentInstanceClass = GetInstanceClass(iParentInstance);
-						assert(iParentInstanceClass != 0);
+	SdaiAggr pStyles = sdaiCreateAggrBN(iStyledItemInstance, "Styles");
+	assert(pStyles != nullptr);
 
-						if (isCityModelClass(iParentInstanceClass))
-						{
-							m_iEnvelopeInstance = iEnvelopeInstance;
-						}
-						else if (isBuildingClass(iParentInstanceClass) || isBuildingPartClass(iParentInstanceClass))
-						{
-							assert(m_mapBuildingSRS.find(iParentInstance) == m_mapBuildingSRS.end());
-							m_mapBuildingSRS[iParentInstance] = iEnvelopeInstance;
-						}
-					} // if (iParentInstance != 0)	
-				} // if (isBoundingShapeClass(iParentInstanceClass))
-			} // if (iParentInstance != 0)
-		} // if (isEnvelopeClass(iInstanceClass))
-		else if (IsPoint3DClass(iInstanceClass))
-		{
-			OwlInstance iReferencePointInstance = iInstance;
+	SdaiInstance iPresentationStyleAssignmentInstance = buildPresentationStyleAssignmentInstance();
+	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iPresentationStyleAssignmentInstance);
 
-			OwlInstance iParentInstance = GetInstanceInverseReferencesByIterator(iInstance, 0);
-			if (iParentInstance != 0)
-			{
-				OwlClass iParentInstanceClass = GetInstanceClass(iParentInstance);
-				assert(iParentInstanceClass != 0);
+	pStyles = sdaiCreateAggrBN(iPresentationStyleAssignmentInstance, "Styles");
+	assert(pStyles != nullptr);
 
-				if (isPointPropertyClass(iParentInstanceClass))
-				{
-					iParentInstance = GetInstanceInverseReferencesByIterator(iParentInstance, 0);
-					if (iParentInstance != 0)
-					{
-						iParentInstanceClass = GetInstanceClass(iParentInstance);
-						assert(iParentInstanceClass != 0);
+	SdaiInstance iSurfaceStyleInstance = buildSurfaceStyleInstance();
+	sdaiPutAttrBN(iSurfaceStyleInstance, "Side", sdaiENUM, "BOTH");
+	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iSurfaceStyleInstance);
 
-						if (isCadastralParcelClass(iParentInstanceClass))
-						{
-							assert(m_mapParcelSRS.find(iParentInstance) == m_mapParcelSRS.end());
-							m_mapParcelSRS[iParentInstance] = iReferencePointInstance;
-						}
-					}
-				}
-			}
-		} // if (IsPoint3DClass(iInstanceClass))
+	pStyles = sdaiCreateAggrBN(iSurfaceStyleInstance, "Styles");
+	assert(pStyles != nullptr);
 
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	} // while (iInstance != 0)
+	SdaiInstance iSurfaceStyleRenderingInstance = buildSurfaceStyleRenderingInstance();
+	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "ReflectanceMethod", sdaiENUM, "NOTDEFINED");
+	sdaiAppend(pStyles, sdaiINSTANCE, (void*)iSurfaceStyleRenderingInstance);
+
+	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "SurfaceColour", sdaiINSTANCE, (void*)iColorRgbInstance);
+	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "Transparency", sdaiREAL, &dTransparency);
+
+	sdaiPutAttrBN(iStyledItemInstance, "Item", sdaiINSTANCE, (void*)iSdaiInstance);
 }
 
-/*virtual*/ void _citygml_exporter::createSRSMapConversion()
+SdaiInstance _exporter_base::buildPresentationStyleAssignmentInstance()
 {
-	/* SRSs */
-	set<string> setSRSs;
+	SdaiInstance iPresentationStyleAssignmentInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPresentationStyleAssignment");
+	assert(iPresentationStyleAssignmentInstance != 0);
 
-	// Root
-	if (m_iEnvelopeInstance != 0)
-	{
-		string strEPSGCode;
-		vector<double> vecCenter;
-		if (retrieveEnvelopeSRSData(m_iEnvelopeInstance, strEPSGCode, vecCenter))
-		{
-			setSRSs.insert(strEPSGCode);
-		}
-	}
+	sdaiPutAttrBN(iPresentationStyleAssignmentInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iPresentationStyleAssignmentInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
 
-	// Building
-	for (auto itBuildingSRS : m_mapBuildingSRS)
-	{
-		string strEPSGCode;
-		vector<double> vecCenter;
-		if (retrieveEnvelopeSRSData(itBuildingSRS.second, strEPSGCode, vecCenter))
-		{
-			setSRSs.insert(strEPSGCode);
-		}
-	}
+	return iPresentationStyleAssignmentInstance;
+}
 
-	// Feature
-	for (auto itParcelSRS : m_mapParcelSRS)
-	{
-		string strEPSGCode;
-		vector<double> vecCenter;
-		if (retrieveReferencePointSRSData(itParcelSRS.second, strEPSGCode, vecCenter))
-		{
-			setSRSs.insert(strEPSGCode);
-		}
-	}
+SdaiInstance _exporter_base::buildSurfaceStyleInstance()
+{
+	SdaiInstance iSurfaceStyleInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcSurfaceStyle");
+	assert(iSurfaceStyleInstance != 0);
 
-	if (setSRSs.size() == 1)
-	{
-		string strSRS = "EPSG:";
-		strSRS += *setSRSs.begin();
+	sdaiPutAttrBN(iSurfaceStyleInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iSurfaceStyleInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
 
-		SdaiInstance iMapConversion = buildMapConversion(getGeometricRepresentationContextInstance(), buildProjectedCRS(strSRS));
-		assert(iMapConversion != 0);
-	}
-	else
-	{
-		assert(setSRSs.size() == 0);
-	}
+	return iSurfaceStyleInstance;
 }
 
-/*virtual*/ void _citygml_exporter::getXYZOffset(double& dX, double& dY, double& dZ)
+SdaiInstance _exporter_base::buildSurfaceStyleRenderingInstance()
 {
-	dX = 0.;
-	dY = 0.; 
-	dZ = 0.;
+	SdaiInstance iSurfaceStyleRenderingInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcSurfaceStyleRendering");
+	assert(iSurfaceStyleRenderingInstance != 0);
 
-	if (m_iEnvelopeInstance != 0)
-	{
-		getEnvelopeCenter(m_iEnvelopeInstance, dX, dY, dZ);
-	}
+	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iSurfaceStyleRenderingInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+
+	return iSurfaceStyleRenderingInstance;
 }
 
-void _citygml_exporter::createBuildings(SdaiInstance iSiteInstance, SdaiInstance iSiteInstancePlacement)
+SdaiInstance _exporter_base::buildColorRgbInstance(double dR, double dG, double dB)
 {
-	assert(iSiteInstance != 0);
-	assert(iSiteInstancePlacement != 0);
-
-	OwlClass iSchemasClass = GetClassByName(getSite()->getOwlModel(), "class:Schemas");
-	assert(iSchemasClass != 0);
+	SdaiInstance iColorRgbInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcColourRgb");
+	assert(iColorRgbInstance != 0);
 
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
-	{
-		OwlClass iInstanceClass = GetInstanceClass(iInstance);
-		assert(iInstanceClass != 0);
+	sdaiPutAttrBN(iColorRgbInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iColorRgbInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iColorRgbInstance, "Name", sdaiSTRING, "Color");
+	sdaiPutAttrBN(iColorRgbInstance, "Red", sdaiREAL, &dR);
+	sdaiPutAttrBN(iColorRgbInstance, "Green", sdaiREAL, &dG);
+	sdaiPutAttrBN(iColorRgbInstance, "Blue", sdaiREAL, &dB);
 
-		if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
-		{
-			if (iInstanceClass != iSchemasClass)
-			{
-				if (isBuildingClass(iInstanceClass) || isBuildingPartClass(iInstanceClass))
-				{
-					if (m_mapBuildings.find(iInstance) == m_mapBuildings.end())
-					{
-						m_mapBuildings[iInstance] = vector<OwlInstance>();
+	return iColorRgbInstance;
+}
 
-						searchForBuildingElements(iInstance, iInstance);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-				}
-				else
-				{
-					createBuildingsRecursively(iInstance);
-				}
-			}
-		} // if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+SdaiInstance _exporter_base::buildPropertySet(const char* szName, SdaiAggr& pHasProperties)
+{
+	SdaiInstance iPropertySetInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPropertySet");
+	assert(iPropertySetInstance != 0);
 
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	} // while (iInstance != 0)
-		
-	if (m_mapBuildings.empty())
-	{
-		return;
-	}
-		
-	_matrix mtxIdentity;
-	vector<SdaiInstance> vecBuildingInstances;
-	for (auto& itBuilding : m_mapBuildings)
-	{
-		string strTag = getTag(itBuilding.first);
+	sdaiPutAttrBN(iPropertySetInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iPropertySetInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
+	sdaiPutAttrBN(iPropertySetInstance, "Name", sdaiSTRING, szName);
 
-		OwlClass iInstanceClass = GetInstanceClass(itBuilding.first);
-		assert(iInstanceClass != 0);
+	pHasProperties = sdaiCreateAggrBN(iPropertySetInstance, "HasProperties");
+	assert(pHasProperties != nullptr);
 
-		char* szClassName = nullptr;
-		GetNameOfClass(iInstanceClass, &szClassName);
-		assert(szClassName != nullptr);
+	return iPropertySetInstance;
+}
 
-		SdaiInstance iBuildingInstancePlacement = 0;
-		SdaiInstance iBuildingInstance = buildBuildingInstance(
-			strTag.c_str(),
-			szClassName,
-			&mtxIdentity, 
-			iSiteInstancePlacement, 
-			iBuildingInstancePlacement);
-		assert(iBuildingInstance != 0);
+SdaiInstance _exporter_base::buildRelDefinesByProperties(SdaiInstance iRelatedObject, SdaiInstance iRelatingPropertyDefinition)
+{
+	assert(iRelatedObject != 0);
+	assert(iRelatingPropertyDefinition != 0);
 
-		createProperties(itBuilding.first, iBuildingInstance);
+	SdaiInstance iRelDefinesByPropertiesInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelDefinesByProperties");
+	assert(iRelDefinesByPropertiesInstance != 0);
 
-		vecBuildingInstances.push_back(iBuildingInstance);
+	sdaiPutAttrBN(iRelDefinesByPropertiesInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iRelDefinesByPropertiesInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
 
-		// Proxy/Unknown Building Elements
-		searchForProxyBuildingElements(itBuilding.first, itBuilding.first);
+	SdaiAggr pRelatedObjects = sdaiCreateAggrBN(iRelDefinesByPropertiesInstance, "RelatedObjects");
+	assert(pRelatedObjects != 0);
 
-		if (itBuilding.second.empty())
-		{
-			continue;
-		}
-		
-		vector<SdaiInstance> vecBuildingElementInstances;
-		for (auto iOwlBuildingElementInstance : itBuilding.second)
-		{
-			_auto_var<OwlInstance> owlBuildingElementInstance(m_iCurrentOwlBuildingElementInstance, iOwlBuildingElementInstance, 0);
+	sdaiAppend(pRelatedObjects, sdaiINSTANCE, (void*)iRelatedObject);
+	sdaiPutAttrBN(iRelDefinesByPropertiesInstance, "RelatingPropertyDefinition", sdaiINSTANCE, (void*)iRelatingPropertyDefinition);
 
-			auto itBuildingElement = m_mapBuildingElements.find(iOwlBuildingElementInstance);
-			assert(itBuildingElement != m_mapBuildingElements.end());
-			assert(!itBuildingElement->second.empty());
+	return iRelDefinesByPropertiesInstance;
+}
 
-			vector<SdaiInstance> vecSdaiBuildingElementGeometryInstances;
-			for (auto iOwlBuildingElementGeometryInstance : itBuildingElement->second)
-			{
-				vector<SdaiInstance> vecNewGeometryInstances;
-				createGeometry(iOwlBuildingElementGeometryInstance, vecNewGeometryInstances, true);
+SdaiInstance _exporter_base::buildPropertySingleValueText(
+	const char* szName,
+	const char* szDescription,
+	const char* szNominalValue,
+	const char* szTypePath)
+{
+	SdaiInstance iPropertySingleValueInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPropertySingleValue");
+	assert(iPropertySingleValueInstance != 0);
 
-				vecSdaiBuildingElementGeometryInstances.insert(
-					vecSdaiBuildingElementGeometryInstances.end(),
-					vecNewGeometryInstances.begin(),
-					vecNewGeometryInstances.end());
-			}
+	sdaiPutAttrBN(iPropertySingleValueInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iPropertySingleValueInstance, "Description", sdaiSTRING, szDescription);
 
-			if (vecSdaiBuildingElementGeometryInstances.empty())
-			{
-				// Not supported
-				continue;
-			}
-			
-			SdaiInstance iBuildingElementInstancePlacement = 0;
-			SdaiInstance iSdaiBuildingElementInstance = buildBuildingElementInstance(
-				itBuildingElement->first,
-				&mtxIdentity,
-				iBuildingInstancePlacement,
-				iBuildingElementInstancePlacement,
-				vecSdaiBuildingElementGeometryInstances);
-			assert(iSdaiBuildingElementInstance != 0);
+	SdaiADB pNominalValueADB = sdaiCreateADB(sdaiSTRING, szNominalValue);
+	assert(pNominalValueADB != nullptr);
 
-			createProperties(iOwlBuildingElementInstance, iSdaiBuildingElementInstance);
+	sdaiPutADBTypePath(pNominalValueADB, 1, szTypePath);
+	sdaiPutAttrBN(iPropertySingleValueInstance, "NominalValue", sdaiADB, (void*)pNominalValueADB);
 
-			vecBuildingElementInstances.push_back(iSdaiBuildingElementInstance);
-		} // for (auto iOwlBuildingElementInstance : ...
+	return iPropertySingleValueInstance;
+}
 
-		SdaiInstance iBuildingStoreyInstancePlacement = 0;
-		SdaiInstance iBuildingStoreyInstance = buildBuildingStoreyInstance(&mtxIdentity, iBuildingInstancePlacement, iBuildingStoreyInstancePlacement);
-		assert(iBuildingStoreyInstance != 0);
+SdaiInstance _exporter_base::buildPropertySingleValueInt(
+	const char* szName,
+	const char* szDescription,
+	int64_t iNominalValue,
+	const char* szTypePath)
+{
+	SdaiInstance iPropertySingleValueInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPropertySingleValue");
+	assert(iPropertySingleValueInstance != 0);
 
-		buildRelAggregatesInstance(
-			"BuildingContainer", 
-			"BuildingContainer for BuildingStories", 
-			iBuildingInstance, 
-			vector<SdaiInstance>{ iBuildingStoreyInstance });
+	sdaiPutAttrBN(iPropertySingleValueInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iPropertySingleValueInstance, "Description", sdaiSTRING, szDescription);
 
-		if (vecBuildingElementInstances.empty())
-		{
-			// Not supported
-			continue;
-		}		
+	SdaiADB pNominalValueADB = sdaiCreateADB(sdaiINTEGER, (void*)&iNominalValue);
+	assert(pNominalValueADB != nullptr);
 
-		buildRelContainedInSpatialStructureInstance(
-			"BuildingStoreyContainer", 
-			"BuildingStoreyContainer for Building Elements", 
-			iBuildingStoreyInstance, 
-			vecBuildingElementInstances);
-	} // for (auto& itBuilding : ...
+	sdaiPutADBTypePath(pNominalValueADB, 1, szTypePath);
+	sdaiPutAttrBN(iPropertySingleValueInstance, "NominalValue", sdaiADB, (void*)pNominalValueADB);
 
-	buildRelAggregatesInstance(
-		"SiteContainer", 
-		"SiteContainer For Buildings", 
-		iSiteInstance, 
-		vecBuildingInstances);
+	return iPropertySingleValueInstance;
 }
 
-void _citygml_exporter::createBuildings()
+SdaiInstance _exporter_base::buildPropertySingleValueReal(
+	const char* szName,
+	const char* szDescription,
+	double dNominalValue,
+	const char* szTypePath)
 {
-	OwlClass iSchemasClass = GetClassByName(getSite()->getOwlModel(), "class:Schemas");
-	assert(iSchemasClass != 0);
-
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
-	{
-		OwlClass iInstanceClass = GetInstanceClass(iInstance);
-		assert(iInstanceClass != 0);
-
-		if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
-		{
-			if (iInstanceClass != iSchemasClass)
-			{
-				if (isBuildingClass(iInstanceClass) || isBuildingPartClass(iInstanceClass))
-				{
-					if (m_mapBuildings.find(iInstance) == m_mapBuildings.end())
-					{
-						m_mapBuildings[iInstance] = vector<OwlInstance>();
+	SdaiInstance iPropertySingleValueInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcPropertySingleValue");
+	assert(iPropertySingleValueInstance != 0);
 
-						searchForBuildingElements(iInstance, iInstance);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-				}
-				else
-				{
-					createBuildingsRecursively(iInstance);
-				}
-			}
-		} // if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+	sdaiPutAttrBN(iPropertySingleValueInstance, "Name", sdaiSTRING, szName);
+	sdaiPutAttrBN(iPropertySingleValueInstance, "Description", sdaiSTRING, szDescription);
 
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	} // while (iInstance != 0)
+	SdaiADB pNominalValueADB = sdaiCreateADB(sdaiREAL, (void*)&dNominalValue);
+	assert(pNominalValueADB != nullptr);
 
-	if (m_mapBuildings.empty())
-	{
-		return;
-	}
+	sdaiPutADBTypePath(pNominalValueADB, 1, szTypePath);
+	sdaiPutAttrBN(iPropertySingleValueInstance, "NominalValue", sdaiADB, (void*)pNominalValueADB);
 
-	map<SdaiInstance, vector<SdaiInstance>> mapSite2Instances;
-	for (auto& itBuilding : m_mapBuildings)
-	{
-		_auto_var<double> xOffset(m_dXOffset, 0., 0.);
-		_auto_var<double> yOffset(m_dYOffset, 0., 0.);
-		_auto_var<double> zOffset(m_dZOffset, 0., 0.);
+	return iPropertySingleValueInstance;
+}
 
-		SdaiInstance iSiteInstance = 0;
-		SdaiInstance iSiteInstancePlacement = 0;
+SdaiInstance _exporter_base::buildMaterial()
+{
+	SdaiInstance iMaterialInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMaterial");
+	assert(iMaterialInstance != 0);
 
-		auto itBuildingSRS = m_mapBuildingSRS.find(itBuilding.first);
-		if (itBuildingSRS != m_mapBuildingSRS.end())
-		{
-			string strTag = getTag(itBuildingSRS->first);
+	sdaiPutAttrBN(iMaterialInstance, "Name", sdaiSTRING, (void*)"Material");
 
-			OwlClass iInstanceClass = GetInstanceClass(itBuildingSRS->first);
-			assert(iInstanceClass != 0);
+	return iMaterialInstance;
+}
 
-			char* szClassName = nullptr;
-			GetNameOfClass(iInstanceClass, &szClassName);
-			assert(szClassName != nullptr);
+SdaiInstance _exporter_base::buildMaterialLayer(double dThickness)
+{
+	SdaiInstance iMaterialLayerInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMaterialLayer");
+	assert(iMaterialLayerInstance != 0);
 
-			_matrix mtxSite;
-			getEnvelopeCenter(itBuildingSRS->second, m_dXOffset, m_dYOffset, m_dZOffset);
+	sdaiPutAttrBN(iMaterialLayerInstance, "Material", sdaiINSTANCE, (void*)buildMaterial());
+	sdaiPutAttrBN(iMaterialLayerInstance, "LayerThickness", sdaiREAL, &dThickness);
 
-			mtxSite._41 = m_dXOffset;
-			mtxSite._42 = m_dYOffset;
-			mtxSite._43 = m_dZOffset;
+	return iMaterialLayerInstance;
+}
 
-			iSiteInstance = buildSiteInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxSite,
-				iSiteInstancePlacement);
-			assert(iSiteInstance != 0);
-			assert(iSiteInstancePlacement != 0);
+SdaiInstance _exporter_base::buildMaterialLayerSet(double dThickness)
+{
+	SdaiInstance iMaterialLayerSetInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMaterialLayerSet");
+	assert(iMaterialLayerSetInstance != 0);
 
-			setSiteEnvelopeSRSData(iSiteInstance, itBuildingSRS->second);
-		}
-		else
-		{
-			getXYZOffset(m_dXOffset, m_dYOffset, m_dZOffset);
+	SdaiAggr pMaterialLayers = sdaiCreateAggrBN(iMaterialLayerSetInstance, "MaterialLayers");
+	assert(pMaterialLayers != nullptr);
 
-			iSiteInstance = getSiteInstance(iSiteInstancePlacement);
-		}
+	sdaiAppend(pMaterialLayers, sdaiINSTANCE, (void*)buildMaterialLayer(dThickness));
 
-		string strTag = getTag(itBuilding.first);
+	return iMaterialLayerSetInstance;
+}
 
-		OwlClass iInstanceClass = GetInstanceClass(itBuilding.first);
-		assert(iInstanceClass != 0);
+SdaiInstance _exporter_base::buildMaterialLayerSetUsage(double dThickness)
+{
+	double dOffsetFromReferenceLine = -dThickness / 2.;
 
-		char* szClassName = nullptr;
-		GetNameOfClass(iInstanceClass, &szClassName);
-		assert(szClassName != nullptr);
+	SdaiInstance iMaterialLayerSetUsageInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcMaterialLayerSetUsage");
+	assert(iMaterialLayerSetUsageInstance != 0);
 
-		_matrix mtxIdentity;
-		SdaiInstance iBuildingInstancePlacement = 0;
-		SdaiInstance iBuildingInstance = buildBuildingInstance(
-			strTag.c_str(),
-			szClassName,
-			&mtxIdentity,
-			iSiteInstancePlacement,
-			iBuildingInstancePlacement);
-		assert(iBuildingInstance != 0);
+	sdaiPutAttrBN(iMaterialLayerSetUsageInstance, "ForLayerSet", sdaiINSTANCE, (void*)buildMaterialLayerSet(dThickness));
+	sdaiPutAttrBN(iMaterialLayerSetUsageInstance, "LayerSetDirection", sdaiENUM, "AXIS2");
+	sdaiPutAttrBN(iMaterialLayerSetUsageInstance, "DirectionSense", sdaiENUM, "POSITIVE");
+	sdaiPutAttrBN(iMaterialLayerSetUsageInstance, "OffsetFromReferenceLine", sdaiREAL, &dOffsetFromReferenceLine);
 
-		createProperties(itBuilding.first, iBuildingInstance);
+	return iMaterialLayerSetUsageInstance;
+}
 
-		auto itSite2Instances = mapSite2Instances.find(iSiteInstance);
-		if (itSite2Instances == mapSite2Instances.end())
-		{
-			mapSite2Instances[iSiteInstance] = vector<SdaiInstance>{ iBuildingInstance };
-		}
-		else
-		{
-			itSite2Instances->second.push_back(iBuildingInstance);
-		}
+SdaiInstance _exporter_base::buildRelAssociatesMaterial(SdaiInstance iBuildingElementInstance, double dThickness)
+{
+	assert(iBuildingElementInstance != 0);
 
-		// Proxy/Unknown Building Elements
-		searchForProxyBuildingElements(itBuilding.first, itBuilding.first);
+	SdaiInstance iRelAssociatesMaterialInstance = sdaiCreateInstanceBN(m_iSdaiModel, "IfcRelAssociatesMaterial");
+	assert(iRelAssociatesMaterialInstance != 0);
 
-		if (itBuilding.second.empty())
-		{
-			continue;
-		}		
+	sdaiPutAttrBN(iRelAssociatesMaterialInstance, "GlobalId", sdaiSTRING, (void*)_guid::createGlobalId().c_str());
+	sdaiPutAttrBN(iRelAssociatesMaterialInstance, "OwnerHistory", sdaiINSTANCE, (void*)getOwnerHistoryInstance());
 
-		vector<SdaiInstance> vecBuildingElementInstances;
-		for (auto iOwlBuildingElementInstance : itBuilding.second)
-		{
-			assert(!isBuildingElementFiltered(itBuilding.first, iOwlBuildingElementInstance));
+	SdaiAggr pRelatedObjects = sdaiCreateAggrBN(iRelAssociatesMaterialInstance, "RelatedObjects");
+	assert(pRelatedObjects != nullptr);
 
-			_auto_var<OwlInstance> owlBuildingElementInstance(m_iCurrentOwlBuildingElementInstance, iOwlBuildingElementInstance, 0);
+	sdaiAppend(pRelatedObjects, sdaiINSTANCE, (void*)iBuildingElementInstance);
+	sdaiPutAttrBN(iRelAssociatesMaterialInstance, "RelatingMaterial", sdaiINSTANCE, (void*)buildMaterialLayerSetUsage(dThickness));
 
-			auto itBuildingElement = m_mapBuildingElements.find(iOwlBuildingElementInstance);
-			assert(itBuildingElement != m_mapBuildingElements.end());
-			assert(!itBuildingElement->second.empty());
+	return iRelAssociatesMaterialInstance;
+}
 
-			vector<SdaiInstance> vecSdaiBuildingElementGeometryInstances;
-			for (auto iOwlBuildingElementGeometryInstance : itBuildingElement->second)
-			{
-				assert(!isBuildingElementFiltered(itBuilding.first, iOwlBuildingElementGeometryInstance));
+const string& _exporter_base::getTag(OwlInstance iInstance) const
+{
+	assert(iInstance != 0);
 
-				vector<SdaiInstance> vecNewGeometryInstances;
-				createGeometry(iOwlBuildingElementGeometryInstance, vecNewGeometryInstances, true);
+	return m_pStringTable->getTag(iInstance);
+}
 
-				vecSdaiBuildingElementGeometryInstances.insert(
-					vecSdaiBuildingElementGeometryInstances.end(),
-					vecNewGeometryInstances.begin(),
-					vecNewGeometryInstances.end());
-			}
+void _exporter_base::getXMLElementPrefixAndName(const string& strUniqueName, string& strPrefix, string& strName) const
+{
+	assert(!strUniqueName.empty() && strPrefix.empty() && strName.empty());
 
-			if (vecSdaiBuildingElementGeometryInstances.empty())
-			{
-				// Not supported
-				continue;
-			}
+	strName = strUniqueName;
 
-			SdaiInstance iBuildingElementInstancePlacement = 0;
-			SdaiInstance iSdaiBuildingElementInstance = buildBuildingElementInstance(
-				itBuildingElement->first,
-				&mtxIdentity,
-				iBuildingInstancePlacement,
-				iBuildingElementInstancePlacement,
-				vecSdaiBuildingElementGeometryInstances);
-			assert(iSdaiBuildingElementInstance != 0);
+	vector<string> vecTokens;
+	_string::tokenize(strUniqueName, ":", vecTokens);
 
-			createProperties(iOwlBuildingElementInstance, iSdaiBuildingElementInstance);
+	assert(!vecTokens.empty() && (vecTokens.size() <= 2));
 
-			vecBuildingElementInstances.push_back(iSdaiBuildingElementInstance);
-		} // for (auto iOwlBuildingElementInstance : ...
+	if (vecTokens.size() == 2)
+	{
+		strPrefix = vecTokens[0];
+		strName = vecTokens[1];
+	}
+}
 
-		SdaiInstance iBuildingStoreyInstancePlacement = 0;
-		SdaiInstance iBuildingStoreyInstance = buildBuildingStoreyInstance(
-			&mtxIdentity, 
-			iBuildingInstancePlacement, 
-			iBuildingStoreyInstancePlacement);
-		assert(iBuildingStoreyInstance != 0);
+const string& _exporter_base::getStringAttributeValue(OwlInstance iInstance, const string& strName) const
+{
+	assert(iInstance != 0);
+	assert(!strName.empty());
 
-		buildRelAggregatesInstance(
-			"BuildingContainer",
-			"BuildingContainer for BuildingStories",
-			iBuildingInstance,
-			vector<SdaiInstance>{ iBuildingStoreyInstance });
+	int64_t iPropertyInstance = GetInstancePropertyByIterator(iInstance, 0);
+	while (iPropertyInstance != 0)
+	{
+		char* szPropertyUniqueName = nullptr;
+		GetNameOfProperty(iPropertyInstance, &szPropertyUniqueName);
 
-		if (vecBuildingElementInstances.empty())
+		string strPropertyUniqueName = szPropertyUniqueName;
+		if ((strPropertyUniqueName == "attr:str:" + strName) ||
+			_string::startsEndsWith(strPropertyUniqueName, "attr:str:", ":" + strName, false))
 		{
-			// Not supported
-			continue;
-		}
+			assert(GetPropertyType(iPropertyInstance) == DATATYPEPROPERTY_TYPE_WCHAR_T_ARRAY);
 
-		buildRelContainedInSpatialStructureInstance(
-			"BuildingStoreyContainer",
-			"BuildingStoreyContainer for Building Elements",
-			iBuildingStoreyInstance,
-			vecBuildingElementInstances);
-	} // for (auto& itBuilding : ...
+			auto pValue = m_pStringTable->getValue(iInstance, iPropertyInstance);
+			assert(pValue != nullptr);
 
-	for (const auto& itSite2Instances : mapSite2Instances)
-	{
-		buildRelAggregatesInstance(
-			"SiteContainer",
-			"SiteContainer For Buildings",
-			itSite2Instances.first,
-			itSite2Instances.second);
+			return pValue != nullptr ? *pValue : EMPTY_STRING;
+		} // if (strPropertyUniqueName == ...
 
-		m_vecSiteInstances.push_back(itSite2Instances.first);
-	}	
+		iPropertyInstance = GetInstancePropertyByIterator(iInstance, iPropertyInstance);
+	} // while (iPropertyInstance != 0)
+
+	return EMPTY_STRING;
 }
 
-void _citygml_exporter::createBuildingsRecursively(OwlInstance iInstance)
+const string& _exporter_base::getStringPropertyValue(OwlInstance iInstance, const string& strName) const
 {
 	assert(iInstance != 0);
+	assert(!strName.empty());
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
+	int64_t iPropertyInstance = GetInstancePropertyByIterator(iInstance, 0);
+	while (iPropertyInstance != 0)
 	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+		char* szPropertyUniqueName = nullptr;
+		GetNameOfProperty(iPropertyInstance, &szPropertyUniqueName);
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
-					
-				OwlClass iInstanceClass = GetInstanceClass(piValues[iValue]);
-				assert(iInstanceClass != 0);
+		string strPropertyUniqueName = szPropertyUniqueName;
+		if ((strPropertyUniqueName == "prop:str:" + strName) || 
+			_string::startsEndsWith(strPropertyUniqueName, "prop:str:", ":" + strName, false))
+		{
+			assert(GetPropertyType(iPropertyInstance) == DATATYPEPROPERTY_TYPE_STRING);
 
-				if (isCityObjectGroupMemberClass(iInstanceClass))
-				{
-					continue; // Ignore
-				}
+			auto pValue = m_pStringTable->getValue(iInstance, iPropertyInstance);
+			assert(pValue != nullptr);
 
-				if (isBuildingClass(iInstanceClass) || isBuildingPartClass(iInstanceClass))
-				{
-					if (m_mapBuildings.find(piValues[iValue]) == m_mapBuildings.end())
-					{
-						m_mapBuildings[piValues[iValue]] = vector<OwlInstance>();
+			return pValue != nullptr ? *pValue : EMPTY_STRING;
+		} // if (strPropertyUniqueName == ...
 
-						searchForBuildingElements(piValues[iValue], piValues[iValue]);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-				}
-				else
-				{
-					createBuildingsRecursively(piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		iPropertyInstance = GetInstancePropertyByIterator(iInstance, iPropertyInstance);
+	} // while (iPropertyInstance != 0)
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	return EMPTY_STRING;
 }
 
-void _citygml_exporter::searchForBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance)
+void _exporter_base::getDoublePropertyValue(OwlInstance iInstance, const string& strName, vector<double>& vecValue) const
 {
-	assert(iBuildingInstance != 0);
 	assert(iInstance != 0);
+	assert(!strName.empty());
 
-	if (isBuildingElementFiltered(iBuildingInstance, iInstance))
-	{
-		return;
-	}
+	vecValue.clear();
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
+	int64_t iPropertyInstance = GetInstancePropertyByIterator(iInstance, 0);
+	while (iPropertyInstance != 0)
 	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+		char* szPropertyUniqueName = nullptr;
+		GetNameOfProperty(iPropertyInstance, &szPropertyUniqueName);
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
-
-				if (isBuildingElementFiltered(iBuildingInstance, piValues[iValue]))
-				{
-					continue;
-				}
-
-				if (isBuildingElement(piValues[iValue]))
-				{
-					auto itBuilding = m_mapBuildings.find(iBuildingInstance);
-					if (itBuilding != m_mapBuildings.end())
-					{
-						itBuilding->second.push_back(piValues[iValue]);
-					}
-					else
-					{
-						m_mapBuildings[iBuildingInstance] = vector<OwlInstance>{ piValues[iValue] };
-					}
-
-					searchForBuildingElementGeometry(iBuildingInstance, piValues[iValue], piValues[iValue]);
-				}
-
-				searchForBuildingElements(iBuildingInstance, piValues[iValue]);
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
-}
-
-void _citygml_exporter::searchForProxyBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance)
-{
-	assert(iBuildingInstance != 0);
-	assert(iInstance != 0);
-
-	if (isBuildingElementFiltered(iBuildingInstance, iInstance))
-	{
-		return;
-	}
-
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
-	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		string strPropertyUniqueName = szPropertyUniqueName;
+		if ((strPropertyUniqueName == "prop:dbl:" + strName) ||
+			_string::startsEndsWith(strPropertyUniqueName, "prop:dbl:", ":" + strName, false))
 		{
+			assert(GetPropertyType(iPropertyInstance) == DATATYPEPROPERTY_TYPE_DOUBLE);
+
+			double* pdValue = nullptr;
 			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+			GetDatatypeProperty(
+				iInstance,
+				iPropertyInstance,
+				(void**)&pdValue,
+				&iValuesCount);
+			assert(iValuesCount > 0);
 
 			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
 			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
-
-				if (isBuildingElementFiltered(iBuildingInstance, piValues[iValue]))
-				{
-					continue;
-				}
-
-				if (isBuildingElement(piValues[iValue]))
-				{
-					continue;
-				}
-
-				if (GetInstanceGeometryClass(piValues[iValue]) &&
-					GetBoundingBox(piValues[iValue], nullptr, nullptr))
-				{
-					auto itBuilding = m_mapBuildings.find(iBuildingInstance);
-					if (itBuilding != m_mapBuildings.end())
-					{
-						itBuilding->second.push_back(piValues[iValue]);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-
-					auto itBuildingElement = m_mapBuildingElements.find(piValues[iValue]);
-					if (itBuildingElement == m_mapBuildingElements.end())
-					{
-						m_mapBuildingElements[piValues[iValue]] = vector<OwlInstance>{ piValues[iValue] };
-					}
-					else
-					{
-						OwlClass iChildInstanceClass = GetInstanceClass(piValues[iValue]);
-						assert(iChildInstanceClass != 0);
-
-						wchar_t* szClassName = nullptr;
-						GetNameOfClassW(iChildInstanceClass, &szClassName);
+				vecValue.push_back(pdValue[iValue]);
+			}
 
-						string strEvent = "Duplicated Geometry: '";
-						strEvent += CW2A(szClassName);
-						strEvent += "'";
-						getSite()->logErr(strEvent);
-					}
-				}
-				else
-				{
-					searchForProxyBuildingElements(iBuildingInstance, piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+			break;
+		} // if (strPropertyUniqueName == ...
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+		iPropertyInstance = GetInstancePropertyByIterator(iInstance, iPropertyInstance);
+	} // while (iPropertyInstance != 0)
 }
 
-void _citygml_exporter::searchForBuildingElementGeometry(OwlInstance iBuildingInstance, OwlInstance iBuildingElementInstance, OwlInstance iInstance)
+OwlInstance* _exporter_base::getObjectProperty(OwlInstance iInstance, const string& strPropertyName, int64_t& iInstancesCount) const
 {
-	assert(iBuildingInstance != 0);
-	assert(iBuildingElementInstance != 0);
 	assert(iInstance != 0);
+	assert(!strPropertyName.empty());
 
-	if (isBuildingElementFiltered(iBuildingInstance, iInstance))
-	{
-		return;
-	}
+	iInstancesCount = 0;
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
+	RdfProperty iProperty = GetPropertyByName(getSite()->getOwlModel(), strPropertyName.c_str());
+	if (iProperty == 0)
 	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+		return nullptr;
+	}
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
+	OwlInstance* piInstances = nullptr;
+	GetObjectProperty(
+		iInstance,
+		iProperty,
+		&piInstances,
+		&iInstancesCount);
 
-				if (isBuildingElementFiltered(iBuildingInstance, piValues[iValue]))
-				{
-					return;
-				}
+	if (iInstancesCount == 0)
+	{
+		return nullptr;
+	}
 
-				if (isBuildingElement(piValues[iValue]))
-				{
-					continue;
-				}
+	return piInstances;
+}
 
-				if (GetInstanceGeometryClass(piValues[iValue]) &&
-					GetBoundingBox(piValues[iValue], nullptr, nullptr))
-				{
-					auto itBuildingElement = m_mapBuildingElements.find(iBuildingElementInstance);
-					if (itBuildingElement != m_mapBuildingElements.end())
-					{
-						itBuildingElement->second.push_back(piValues[iValue]);
-					}
-					else
-					{
-						m_mapBuildingElements[iBuildingElementInstance] = vector<OwlInstance>{ piValues[iValue] };
-					}
-				}
-				else
-				{
-					searchForBuildingElementGeometry(iBuildingInstance, iBuildingElementInstance, piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+bool _exporter_base::hasObjectProperty(OwlInstance iInstance, const string& strPropertyName) const
+{
+	int64_t iInstancesCount = 0;
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	return getObjectProperty(iInstance, strPropertyName, iInstancesCount) != nullptr;
 }
 
-void _citygml_exporter::createFeatures(SdaiInstance iSiteInstance, SdaiInstance iSiteInstancePlacement)
+void _exporter_base::getPosValues(const string& strContent, vector<double>& vecValues) const
 {
-	assert(iSiteInstance != 0);
-	assert(iSiteInstancePlacement != 0);
+	assert(!strContent.empty());
 
-	OwlClass iSchemasClass = GetClassByName(getSite()->getOwlModel(), "class:Schemas");
-	assert(iSchemasClass != 0);
+	vector<string> vecStrValues;
+	_string::split(strContent, " ", vecStrValues);
 
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
+	if (vecStrValues.size() > 3)
 	{
-		if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
-		{
-			OwlClass iInstanceClass = GetInstanceClass(iInstance);
-			assert(iInstanceClass != 0);
-
-			if (iInstanceClass != iSchemasClass)
-			{
-				if (isFeatureClass(iInstanceClass))
-				{
-					if (m_mapFeatures.find(iInstance) == m_mapFeatures.end())
-					{
-						m_mapFeatures[iInstance] = vector<OwlInstance>();
-
-						searchForFeatureElements(iInstance, iInstance);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-				}
-				else
-				{
-					createFeaturesRecursively(iInstance);
-				}
-			}
-		} // if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
-
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	} // while (iInstance != 0)
-
-	if (m_mapFeatures.empty())
+		assert(false);
+	}
+	else if (vecStrValues.size() < 3)
 	{
-		return;
+		vecStrValues.resize(3, "0"); // Z
 	}
 
-	_matrix mtxIdentity;
-	vector<SdaiInstance> vecFeatureInstances;
-	for (auto& itFeature : m_mapFeatures)
+	for (auto strValue : vecStrValues)
 	{
-		if (itFeature.second.empty())
-		{
-			continue;
-		}
-
-		// Geometry
-		vector<SdaiInstance> vecSdaiFeatureElementGeometryInstances;
-		for (auto iOwlFeatureElementInstance : itFeature.second)
-		{
-			_auto_var<OwlInstance> owlBuildingElementInstance(m_iCurrentOwlBuildingElementInstance, iOwlFeatureElementInstance, 0);
-
-			auto itFeatureElement = m_mapFeatureElements.find(iOwlFeatureElementInstance);
-			assert(itFeatureElement != m_mapFeatureElements.end());
-			assert(!itFeatureElement->second.empty());
-
-			for (auto iOwlFeatureElementGeometryInstance : itFeatureElement->second)
-			{
-				vector<SdaiInstance> vecNewGeometryInstances;
-				createGeometry(iOwlFeatureElementGeometryInstance, vecNewGeometryInstances, true);
-				
-				vecSdaiFeatureElementGeometryInstances.insert(
-					vecSdaiFeatureElementGeometryInstances.end(),
-					vecNewGeometryInstances.begin(),
-					vecNewGeometryInstances.end());
-			}
-		} // for (auto iOwlFeatureElementInstance : ...
+		vecValues.push_back(atof(strValue.c_str()));
+	}
+}
 
-		if (vecSdaiFeatureElementGeometryInstances.empty())
-		{
-			// Not supported
-			continue;
-		}
+void _exporter_base::getPosValuesW(const wstring& strContent, vector<double>& vecValues) const
+{
+	assert(!strContent.empty());
 
-		// Feature
-		string strTag = getTag(itFeature.first);
+	getPosValues((LPCSTR)CW2A(strContent.c_str()), vecValues);	
+}
 
-		OwlClass iInstanceClass = GetInstanceClass(itFeature.first);
-		assert(iInstanceClass != 0);
+// "<Event>: '<Class>'"; called per object - formatted only if the level is logged, rate-limited per szEvent
+void _exporter_base::logClassEvent(enumLogEvent enLogEvent, const char* szEvent, OwlClass iClass) const
+{
+	assert(szEvent != nullptr);
+	assert(iClass != 0);
 
-		char* szClassName = nullptr;
-		GetNameOfClass(iInstanceClass, &szClassName);
-		assert(szClassName != nullptr);
+	if (!m_pSite->isLogEnabled(enLogEvent))
+	{
+		return;
+	}
 
-		SdaiInstance iFeatureInstancePlacement = 0;
-		if (isTransportationObjectClass(iInstanceClass) ||
-			isTrafficSpaceClass(iInstanceClass) ||
-			isTrafficAreaClass(iInstanceClass) ||
-			isBridgeObjectClass(iInstanceClass) ||
-			isTunnelObjectClass(iInstanceClass))
-		{			
-			SdaiInstance iFeatureInstance = buildTransportElementInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement,
-				iFeatureInstancePlacement,
-				vecSdaiFeatureElementGeometryInstances);
-			assert(iFeatureInstance != 0);
+	wchar_t* szClassName = nullptr;
+	GetNameOfClassW(iClass, &szClassName);
 
-			createProperties(itFeature.first, iFeatureInstance);
+	m_pSite->logWrite(enLogEvent, _string::format("%s: '%s'", szEvent, (LPCSTR)CW2A(szClassName)), szEvent);
+}
 
-			vecFeatureInstances.push_back(iFeatureInstance);
-		}
-		else if (isReliefObjectClass(iInstanceClass) ||
-			isLandUseClass(iInstanceClass) ||
-			isWaterObjectClass(iInstanceClass) ||
-			isVegetationObjectClass(iInstanceClass))
-		{
-			SdaiInstance iFeatureInstance = buildGeographicElementInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement,
-				iFeatureInstancePlacement,
-				vecSdaiFeatureElementGeometryInstances);
-			assert(iFeatureInstance != 0);
+// ************************************************************************************************
+_citygml_exporter::_citygml_exporter(_gml2ifc_exporter* pSite)
+	: _exporter_base(pSite)
+	, m_fXmin(FLT_MAX)
+	, m_fXmax(-FLT_MAX)
+	, m_fYmin(FLT_MAX)
+	, m_fYmax(-FLT_MAX)
+	, m_fZmin(FLT_MAX)
+	, m_fZmax(-FLT_MAX)
+	, m_iPoint3DClass(0)
+	, m_iCollectionClass(0)
+	, m_iTransformationClass(0)
+	, m_bModelDataCollected(false)
+	, m_mapInstanceDefaultState()
+	, m_mapMappedItems()
+	, m_iCityModelClass(0)
+	, m_iBoundingShapeClass(0)
+	, m_iEnvelopeClass(0)
+	, m_iEnvelopeInstance(0)
+	, m_mapBuildingSRS()
+	, m_mapParcelSRS()
+	, m_bSRSDataCollected(false)
+	, m_iCityObjectGroupMemberClass(0)
+	, m_iGeometryMemberClass(0)
+	, m_iBuildingClass(0)
+	, m_iBuildingPartClass(0)
+	, m_iWallSurfaceClass(0)
+	, m_iRoofSurfaceClass(0)
+	, m_iDoorClass(0)
+	, m_iWindowClass(0)
+	, m_mapBuildings()
+	, m_mapBuildingElements()
+	, m_iCadastralParcelClass(0)
+	, m_iPointPropertyClass(0)
+	, m_iReferencePointIndicatorClass(0)
+	, m_iVegetationObjectClass(0)
+	, m_iWaterObjectClass(0)
+	, m_iBridgeObjectClass(0)
+	, m_iTunnelObjectClass(0)
+	, m_iTransportationObjectClass(0)
+	, m_iFurnitureObjectClass(0)
+	, m_iReliefObjectClass(0)
+	, m_iLandUseClass(0)
+	, m_iTrafficSpaceClass(0)
+	, m_iTrafficAreaClass(0)
+	, m_iThingClass(0)
+	, m_mapFeatures()
+	, m_mapFeatureElements()
+	, m_iThingClassNameId(-1)
+	, m_iLengthTypeClassNameId(-1)
+	, m_iAreaValueClassNameId(-1)
+	, m_mapLODs()
+	, m_mapLODsAsDouble()
+	, m_mapBuildingHighestLOD()
+	, m_iFilteredBuildingElements(0)
+	, m_mapFeatureHighestLOD()
+	, m_iFilteredFeatureElements(0)
+	, m_mapPathLODs()
+	, m_pCityModel(nullptr)
+	, m_bCityModelRead(false)
+	, m_vecSiteInstances()
+	, m_enCurrentElement(enumCityElement::Other)
+	, m_dXOffset(0.)
+	, m_dYOffset(0.)
+	, m_dZOffset(0.)
+	, m_iDefaultWallSurfaceColorRgbInstance(0)
+	, m_iDefaultRoofSurfaceColorRgbInstance(0)
+	, m_iDefaultDoorColorRgbInstance(0)
+	, m_iDefaultWindowColorRgbInstance(0)
+	, m_iDefaultColorRgbInstance(0)
+{
+	// Geometry Kernel
+	m_iPoint3DClass = GetClassByName(getSite()->getOwlModel(), "Point3D");
+	m_iCollectionClass = GetClassByName(getSite()->getOwlModel(), "Collection");
+	m_iTransformationClass = GetClassByName(getSite()->getOwlModel(), "Transformation");	
 
-			createProperties(itFeature.first, iFeatureInstance);
+	// CRS
+	m_iCityModelClass = GetClassByName(getSite()->getOwlModel(), "class:CityModelType");
+	m_iBoundingShapeClass = GetClassByName(getSite()->getOwlModel(), "class:BoundingShapeType");
+	m_iEnvelopeClass = GetClassByName(getSite()->getOwlModel(), "class:EnvelopeType");
 
-			vecFeatureInstances.push_back(iFeatureInstance);
-		}
-		else if (isFurnitureObjectClass(iInstanceClass))
-		{
-			SdaiInstance iFeatureInstance = buildFurnitureObjectInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement,
-				iFeatureInstancePlacement,
-				vecSdaiFeatureElementGeometryInstances);
-			assert(iFeatureInstance != 0);
+	// CityObjectGroup
+	m_iCityObjectGroupMemberClass = GetClassByName(getSite()->getOwlModel(), "class:CityObjectGroupMemberType");
+
+	// relativeGMLGeometry
+	m_iGeometryMemberClass = GetClassByName(getSite()->getOwlModel(), "class:geometryMember");
+
+	// Building
+	m_iBuildingClass = GetClassByName(getSite()->getOwlModel(), "class:Building");
+	m_iBuildingPartClass = GetClassByName(getSite()->getOwlModel(), "class:BuildingPart");
+	m_iWallSurfaceClass = GetClassByName(getSite()->getOwlModel(), "class:WallSurface");
+	m_iRoofSurfaceClass = GetClassByName(getSite()->getOwlModel(), "class:RoofSurface");
+	m_iDoorClass = GetClassByName(getSite()->getOwlModel(), "class:Door");
+	m_iWindowClass = GetClassByName(getSite()->getOwlModel(), "class:Window");
+
+	// Parcel
+	m_iCadastralParcelClass = GetClassByName(getSite()->getOwlModel(), "class:CadastralParcelType");
+	m_iPointPropertyClass = GetClassByName(getSite()->getOwlModel(), "class:PointPropertyType");
+	m_iReferencePointIndicatorClass = GetClassByName(getSite()->getOwlModel(), "ReferencePointIndicator");
+
+	// Feature
+	m_iVegetationObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_VegetationObject");
+	m_iWaterObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_WaterObject");
+	m_iBridgeObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_AbstractBridge");
+	m_iTunnelObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_AbstractTunnel");
+	m_iTransportationObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_TransportationObject");
+	m_iFurnitureObjectClass = GetClassByName(getSite()->getOwlModel(), "class:CityFurniture");
+	m_iReliefObjectClass = GetClassByName(getSite()->getOwlModel(), "class:_ReliefComponent");
+	m_iLandUseClass = GetClassByName(getSite()->getOwlModel(), "class:LandUse");
+	m_iTrafficSpaceClass = GetClassByName(getSite()->getOwlModel(), "class:trafficSpace");
+	m_iTrafficAreaClass = GetClassByName(getSite()->getOwlModel(), "class:TrafficArea");
+	m_iThingClass = GetClassByName(getSite()->getOwlModel(), "class:Thing");
+
+	// Properties (UOM)
+	m_iThingClassNameId = getStringTable()->getId("class:Thing");
+	m_iLengthTypeClassNameId = getStringTable()->getId("class:LengthType");
+	m_iAreaValueClassNameId = getStringTable()->getId("class:areaValue");
 
-			createProperties(itFeature.first, iFeatureInstance);
+	m_pCityModel = new _city_model();
+}
+
+/*virtual*/ _citygml_exporter::~_citygml_exporter()
+{
+	delete m_pCityModel;
+}
+
+/*virtual*/ int _citygml_exporter::retrieveSRSData(OwlInstance iRootInstance) /*override*/
+{
+	assert(iRootInstance != 0);
+
+	collectSRSDataOnce(iRootInstance);
+
+	int iTransformationsCount = 0;
 
-			vecFeatureInstances.push_back(iFeatureInstance);
+	if (m_iEnvelopeInstance != 0)
+	{
+		if (transformEnvelopeSRSDataAsync(m_iEnvelopeInstance))
+		{
+			iTransformationsCount++;
 		}
-		else
+	}
+	
+	for (auto itBuildingSRS : m_mapBuildingSRS)
+	{
+		if (transformEnvelopeSRSDataAsync(itBuildingSRS.second))
 		{
-			SdaiInstance iFeatureInstance = buildFeatureInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement,
-				iFeatureInstancePlacement,
-				vecSdaiFeatureElementGeometryInstances);
-			assert(iFeatureInstance != 0);
-
-			createProperties(itFeature.first, iFeatureInstance);
+			iTransformationsCount++;
+		}
+	}
 
-			vecFeatureInstances.push_back(iFeatureInstance);
-		}		
-	} // for (auto& itFeature : ...
+	for (auto itParcelSRS : m_mapParcelSRS)
+	{
+		if (transformReferencePointSRSDataAsync(itParcelSRS.second))
+		{
+			iTransformationsCount++;
+		}
+	}
 
-	buildRelAggregatesInstance(
-		"SiteContainer",
-		"SiteContainer For Features",
-		iSiteInstance,
-		vecFeatureInstances);
+	return iTransformationsCount;
 }
 
-void _citygml_exporter::createFeatures()
+/*virtual*/ void _citygml_exporter::retrieveLODs(set<string>& setLODs) /*override*/
 {
-	OwlClass iSchemasClass = GetClassByName(getSite()->getOwlModel(), "class:Schemas");
-	assert(iSchemasClass != 0);
+	assert(setLODs.empty());
 
 	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
 	while (iInstance != 0)
 	{
-		if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+		string strLOD = getLOD(iInstance);
+		if (!strLOD.empty() && (setLODs.find(strLOD) == setLODs.end()))
 		{
-			OwlClass iInstanceClass = GetInstanceClass(iInstance);
-			assert(iInstanceClass != 0);
-
-			if (iInstanceClass != iSchemasClass)
-			{
-				if (isFeatureClass(iInstanceClass))
-				{
-					if (m_mapFeatures.find(iInstance) == m_mapFeatures.end())
-					{
-						m_mapFeatures[iInstance] = vector<OwlInstance>();
+			string strEvent = "LOD: '";
+			strEvent += strLOD;
+			strEvent += "'";
+			getSite()->logInfo(strEvent);
 
-						searchForFeatureElements(iInstance, iInstance);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-				}
-				else
-				{
-					createFeaturesRecursively(iInstance);
-				}
-			}
-		} // if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+			setLODs.insert(strLOD);
+		}
 
 		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
 	} // while (iInstance != 0)
+}
 
-	if (m_mapFeatures.empty())
+/*virtual*/ void _citygml_exporter::preProcessing() /*override*/
+{
+	if (!m_bModelDataCollected)
 	{
-		return;
+		collectModelData();
+
+		m_bModelDataCollected = true;
 	}
+}
 
-	_matrix mtxIdentity;
-	map<SdaiInstance, vector<SdaiInstance>> mapSite2Instances;
-	for (auto& itFeature : m_mapFeatures)
-	{
-		_auto_var<double> xOffset(m_dXOffset, 0., 0.);
-		_auto_var<double> yOffset(m_dYOffset, 0., 0.);
-		_auto_var<double> zOffset(m_dZOffset, 0., 0.);
+void _citygml_exporter::collectModelData()
+{
+	getInstancesDefaultState();
 
-		if (itFeature.second.empty())
+	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
+	while (iInstance != 0)
+	{		
+		_vector3d vecBBMin;
+		_vector3d vecBBMax;
+		if (m_mapInstanceDefaultState.at(iInstance) &&
+			GetInstanceGeometryClass(iInstance) &&
+			GetBoundingBox(
+				iInstance,
+				(double*)&vecBBMin,
+				(double*)&vecBBMax))
 		{
-			continue;
+			m_fXmin = (float)fmin(m_fXmin, vecBBMin.x);
+			m_fXmax = (float)fmax(m_fXmax, vecBBMax.x);
+			m_fYmin = (float)fmin(m_fYmin, vecBBMin.y);
+			m_fYmax = (float)fmax(m_fYmax, vecBBMax.y);
+			m_fZmin = (float)fmin(m_fZmin, vecBBMin.z);
+			m_fZmax = (float)fmax(m_fZmax, vecBBMax.z);
 		}
 
-		SdaiInstance iSiteInstance = 0;
-		SdaiInstance iSiteInstancePlacement = 0;
+		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
+	} // while (iInstance != 0)
+}
 
-		auto itParcelSRS = m_mapParcelSRS.find(itFeature.first);
-		if (itParcelSRS != m_mapParcelSRS.end())
-		{
-			string strTag = getTag(itParcelSRS->first);
+// The LOD selection of the export; see _city_lod. An Element/Element Geometry is filtered if each of
+// its paths is; the counters count the filtered Elements and Element Geometries (Buildings).
+bool _citygml_exporter::isElementFiltered(const _city_object* pObject, const _city_lod& lod)
+{
+	assert(pObject != nullptr);
 
-			OwlClass iInstanceClass = GetInstanceClass(itParcelSRS->first);
-			assert(iInstanceClass != 0);
+	bool bFiltered = false;
+	if (getHighestLOD())
+	{
+		// Anything on the path with a lower LOD
+		bFiltered = isLowerLOD(lod.m_dPathLOD, pObject->m_dHighestLOD);
+	}
+	else if (!getTargetLODs().empty())
+	{
+		// Anything on the path with another LOD
+		bFiltered = true;
+		for (auto iPathLODs : m_pCityModel->getPaths()[lod.m_iPaths])
+		{
+			bool bPathFiltered = false;
+			for (auto iLOD : m_pCityModel->getPathLODs()[iPathLODs])
+			{
+				if (getTargetLODs().find(m_pCityModel->getLOD(iLOD)) == getTargetLODs().end())
+				{
+					bPathFiltered = true;
 
-			char* szClassName = nullptr;
-			GetNameOfClass(iInstanceClass, &szClassName);
-			assert(szClassName != nullptr);
+					break;
+				}
+			}
 
-			_matrix mtxSite;
-			getReferencePoint(itParcelSRS->second, mtxSite._41, mtxSite._42, mtxSite._43);
+			if (!bPathFiltered)
+			{
+				bFiltered = false;
 
-			iSiteInstance = buildSiteInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement);
-			assert(iSiteInstance != 0);
-			assert(iSiteInstancePlacement != 0);
+				break;
+			}
+		} // for (auto iPathLODs : ...
+	}
 
-			setSiteReferencePointSRSData(iSiteInstance, itParcelSRS->second);
+	if (bFiltered)
+	{
+		if (pObject->m_enObject == enumCityObject::Building)
+		{
+			m_iFilteredBuildingElements++;
 		}
 		else
 		{
-			getXYZOffset(m_dXOffset, m_dYOffset, m_dZOffset);
-
-			iSiteInstance = getSiteInstance(iSiteInstancePlacement);
+			m_iFilteredFeatureElements++;
 		}
+	}
 
-		// Geometry
-		vector<SdaiInstance> vecSdaiFeatureElementGeometryInstances;
-		for (auto iOwlFeatureElementInstance : itFeature.second)
-		{
-			_auto_var<OwlInstance> owlBuildingElementInstance(m_iCurrentOwlBuildingElementInstance, iOwlFeatureElementInstance, 0);
-
-			auto itFeatureElement = m_mapFeatureElements.find(iOwlFeatureElementInstance);
-			assert(itFeatureElement != m_mapFeatureElements.end());
-			assert(!itFeatureElement->second.empty());
+	return bFiltered;
+}
 
-			for (auto iOwlFeatureElementGeometryInstance : itFeatureElement->second)
-			{
-				vector<SdaiInstance> vecNewGeometryInstances;
-				createGeometry(iOwlFeatureElementGeometryInstance, vecNewGeometryInstances, true);
+/*virtual*/ string _citygml_exporter::getLOD(OwlInstance iInstance) const
+{
+	assert(iInstance != 0);
 
-				vecSdaiFeatureElementGeometryInstances.insert(
-					vecSdaiFeatureElementGeometryInstances.end(),
-					vecNewGeometryInstances.begin(),
-					vecNewGeometryInstances.end());
-			}
-		} // for (auto iOwlFeatureElementInstance : ...
+	string strLOD;
 
-		if (vecSdaiFeatureElementGeometryInstances.empty())
-		{
-			assert(false); // Not supported
+	// Property
+	vector<double> vecValues;
+	getDoublePropertyValue(iInstance, "lod", vecValues);
 
-			continue;
-		}		
+	if (!vecValues.empty())
+	{
+		assert(vecValues.size() == 1);
 
-		// Feature
-		string strTag = getTag(itFeature.first);
+		strLOD = _string::format("lod%d", (int)vecValues[0]);
+	}
 
-		OwlClass iInstanceClass = GetInstanceClass(itFeature.first);
-		assert(iInstanceClass != 0);
+	// XML Element
+	if (strLOD.empty())
+	{
+		string strTag = getTag(iInstance);
 
-		char* szClassName = nullptr;
-		GetNameOfClass(iInstanceClass, &szClassName);
-		assert(szClassName != nullptr);
+		vector<string> vecTokens;
+		_string::tokenize(strTag, ":", vecTokens);
 
-		SdaiInstance iFeatureInstance = 0;
-		SdaiInstance iFeatureInstancePlacement = 0;
-		if (isTransportationObjectClass(iInstanceClass) ||
-			isTrafficSpaceClass(iInstanceClass) ||
-			isTrafficAreaClass(iInstanceClass) ||
-			isBridgeObjectClass(iInstanceClass) ||
-			isTunnelObjectClass(iInstanceClass))
-		{
-			iFeatureInstance = buildTransportElementInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement,
-				iFeatureInstancePlacement,
-				vecSdaiFeatureElementGeometryInstances);
-			assert(iFeatureInstance != 0);
+		assert(!vecTokens.empty());
 
-			createProperties(itFeature.first, iFeatureInstance);
-		}
-		else if (isReliefObjectClass(iInstanceClass) ||
-			isLandUseClass(iInstanceClass) ||
-			isWaterObjectClass(iInstanceClass) ||
-			isVegetationObjectClass(iInstanceClass))
+		string strName;
+		if (vecTokens.size() == 1)
 		{
-			iFeatureInstance = buildGeographicElementInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement,
-				iFeatureInstancePlacement,
-				vecSdaiFeatureElementGeometryInstances);
-			assert(iFeatureInstance != 0);
-
-			createProperties(itFeature.first, iFeatureInstance);
+			strName = vecTokens[0];
 		}
-		else if (isFurnitureObjectClass(iInstanceClass))
+		else if (vecTokens.size() == 2)
 		{
-			iFeatureInstance = buildFurnitureObjectInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement,
-				iFeatureInstancePlacement,
-				vecSdaiFeatureElementGeometryInstances);
-			assert(iFeatureInstance != 0);
-
-			createProperties(itFeature.first, iFeatureInstance);
+			strName = vecTokens[1];
 		}
-		else
+
+		if (!strName.empty())
 		{
-			iFeatureInstance = buildFeatureInstance(
-				strTag.c_str(),
-				szClassName,
-				&mtxIdentity,
-				iSiteInstancePlacement,
-				iFeatureInstancePlacement,
-				vecSdaiFeatureElementGeometryInstances);
-			assert(iFeatureInstance != 0);
+			if (_string::startsWith(strName, "lod0") ||
+				_string::contains(strName, ":lod0"))
+			{
+				strLOD = "lod0";
+			}
+			else if (_string::startsWith(strName, "lod1") ||
+				_string::contains(strName, ":lod1"))
+			{
+				strLOD = "lod1";
+			}
+			else if (_string::startsWith(strName, "lod2") ||
+				_string::contains(strName, ":lod2"))
+			{
+				strLOD = "lod2";
+			}
+			else if (_string::startsWith(strName, "lod3") ||
+				_string::contains(strName, ":lod3"))
+			{
+				strLOD = "lod3";
+			}
+			else if (_string::startsWith(strName, "lod4") ||
+				_string::contains(strName, ":lod4"))
+			{
+				strLOD = "lod4";
+			}
+		} // if (!strName.empty())			
+	} // if (strLOD.empty())
 
-			createProperties(itFeature.first, iFeatureInstance);
-		}
+	return strLOD;
+}
+
+/*virtual*/ double _citygml_exporter::getLODAsDouble(OwlInstance iInstance) const
+{
+	assert(iInstance != 0);
+
+	double dLOD = -DBL_MAX;
+
+	// Property
+	vector<double> vecValues;
+	getDoublePropertyValue(iInstance, "lod", vecValues);
+
+	if (!vecValues.empty())
+	{
+		assert(vecValues.size() == 1);
+
+		dLOD = vecValues[0];
+	}
 
-		assert(iFeatureInstance != 0);
+	// XML Element
+	if (dLOD == -DBL_MAX)
+	{
+		string strTag = getTag(iInstance);
+
+		vector<string> vecTokens;
+		_string::tokenize(strTag, ":", vecTokens);
+
+		assert(!vecTokens.empty());
 
-		auto itSite2Instances = mapSite2Instances.find(iSiteInstance);
-		if (itSite2Instances == mapSite2Instances.end())
+		string strName;
+		if (vecTokens.size() == 1)
 		{
-			mapSite2Instances[iSiteInstance] = vector<SdaiInstance>{ iFeatureInstance };
+			strName = vecTokens[0];
 		}
-		else
+		else if (vecTokens.size() == 2)
 		{
-			itSite2Instances->second.push_back(iFeatureInstance);
+			strName = vecTokens[1];
 		}
-	} // for (auto& itFeature : ...
 
-	for (const auto& itSite2Instances : mapSite2Instances)
-	{
-		buildRelAggregatesInstance(
-			"SiteContainer",
-			"SiteContainer For Features",
-			itSite2Instances.first,
-			itSite2Instances.second);
+		if (!strName.empty())
+		{
+			if (_string::startsWith(strName, "lod0") ||
+				_string::contains(strName, ":lod0"))
+			{
+				dLOD = 0.;
+			}
+			else if (_string::startsWith(strName, "lod1") ||
+				_string::contains(strName, ":lod1"))
+			{
+				dLOD = 1.;
+			}
+			else if (_string::startsWith(strName, "lod2") ||
+				_string::contains(strName, ":lod2"))
+			{
+				dLOD = 2.;
+			}
+			else if (_string::startsWith(strName, "lod3") ||
+				_string::contains(strName, ":lod3"))
+			{
+				dLOD = 3.;
+			}
+			else if (_string::startsWith(strName, "lod4") ||
+				_string::contains(strName, ":lod4"))
+			{
+				dLOD = 4.;
+			}
+		} // if (!strName.empty())			
+	} // if (dLOD == -DBL_MAX)
 
-		m_vecSiteInstances.push_back(itSite2Instances.first);
-	}
+	return dLOD;
 }
 
-void _citygml_exporter::createFeaturesRecursively(OwlInstance iInstance)
+const string& _citygml_exporter::getCachedLOD(OwlInstance iInstance)
 {
 	assert(iInstance != 0);
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
+	auto itLOD = m_mapLODs.find(iInstance);
+	if (itLOD == m_mapLODs.end())
 	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+		itLOD = m_mapLODs.insert({ iInstance, getLOD(iInstance) }).first;
+	}
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
+	return itLOD->second;
+}
 
-				OwlClass iInstanceClass = GetInstanceClass(piValues[iValue]);
-				assert(iInstanceClass != 0);
+double _citygml_exporter::getCachedLODAsDouble(OwlInstance iInstance)
+{
+	assert(iInstance != 0);
 
-				if (isCityObjectGroupMemberClass(iInstanceClass))
-				{					
-					continue; // Ignore
-				}
+	auto itLOD = m_mapLODsAsDouble.find(iInstance);
+	if (itLOD == m_mapLODsAsDouble.end())
+	{
+		itLOD = m_mapLODsAsDouble.insert({ iInstance, getLODAsDouble(iInstance) }).first;
+	}
 
-				if (isFeatureClass(iInstanceClass))
-				{
-					if (m_mapFeatures.find(piValues[iValue]) == m_mapFeatures.end())
-					{
-						m_mapFeatures[piValues[iValue]] = vector<OwlInstance>();
+	return itLOD->second;
+}
 
-						searchForFeatureElements(piValues[iValue], piValues[iValue]);
-					}
-				}
-				else
-				{
-					createFeaturesRecursively(piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+string _citygml_exporter::getGeometryLOD(OwlInstance iElementInstance, OwlInstance iGeometryInstance)
+{
+	assert(iElementInstance != 0);
+	assert(iGeometryInstance != 0);
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	// The geometry or a property above it, e.g. lod2MultiSurface
+	set<OwlInstance> setVisited;
+	string strLOD;
+	if (findGeometryLOD(iElementInstance, iGeometryInstance, "", setVisited, strLOD))
+	{
+		return strLOD;
+	}
+
+	return "";
 }
 
-void _citygml_exporter::searchForFeatureElements(OwlInstance iFeatureInstance, OwlInstance iInstance)
+// All the inverse references are walked, e.g. a geometry shared by the LODs of an element; the LOD
+// nearest to the geometry on a path up to the element wins (setVisited - no path from there)
+bool _citygml_exporter::findGeometryLOD(OwlInstance iElementInstance, OwlInstance iInstance, const string& strPathLOD, set<OwlInstance>& setVisited, string& strLOD)
 {
-	assert(iFeatureInstance != 0);
+	assert(iElementInstance != 0);
 	assert(iInstance != 0);
 
-	if (isFeatureElementFiltered(iFeatureInstance, iInstance))
+	if (!setVisited.insert(iInstance).second)
 	{
-		return;
+		return false;
 	}
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
+	string strInstanceLOD = strPathLOD.empty() ? getCachedLOD(iInstance) : strPathLOD;
+	if (iInstance == iElementInstance)
 	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+		strLOD = strInstanceLOD;
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
+		return true;
+	}
 
-				if (isFeatureElementFiltered(iFeatureInstance, piValues[iValue]))
-				{
-					return;
-				}
+	OwlInstance iReferencingInstance = GetInstanceInverseReferencesByIterator(iInstance, 0);
+	while (iReferencingInstance != 0)
+	{
+		if (findGeometryLOD(iElementInstance, iReferencingInstance, strInstanceLOD, setVisited, strLOD))
+		{
+			return true;
+		}
 
-				if (GetInstanceGeometryClass(piValues[iValue]) &&
-					GetBoundingBox(piValues[iValue], nullptr, nullptr))
-				{
-					auto itFeature = m_mapFeatures.find(iFeatureInstance);
-					if (itFeature != m_mapFeatures.end())
-					{
-						itFeature->second.push_back(piValues[iValue]);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
+		iReferencingInstance = GetInstanceInverseReferencesByIterator(iInstance, iReferencingInstance);
+	} // while (iReferencingInstance != 0)
 
-					auto itFeatureElement = m_mapFeatureElements.find(piValues[iValue]);
-					if (itFeatureElement == m_mapFeatureElements.end())
-					{
-						m_mapFeatureElements[piValues[iValue]] = vector<OwlInstance>{ piValues[iValue] };
-					}
-					else
-					{
-						OwlClass iChildInstanceClass = GetInstanceClass(piValues[iValue]);
-						assert(iChildInstanceClass != 0);
+	return false;
+}
 
-						wchar_t* szClassName = nullptr;
-						GetNameOfClassW(iChildInstanceClass, &szClassName);
+// The LODs on the path from the Building/Feature, iInstance included
+_city_lod _citygml_exporter::getPathLOD(const _city_lod& parentLOD, OwlInstance iInstance)
+{
+	assert(iInstance != 0);
 
-						string strEvent = "Duplicated Geometry: '";
-						strEvent += CW2A(szClassName);
-						strEvent += "'";
-						getSite()->logErr(strEvent);
-					}
-				}
-				else
-				{
-					searchForFeatureElements(iFeatureInstance, piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+	_city_lod pathLOD = parentLOD;
+	pathLOD.m_iPaths = m_pCityModel->addPathsLOD(parentLOD.m_iPaths, m_pCityModel->addLOD(getCachedLOD(iInstance)));
+	pathLOD.m_dPathLOD = getLowerLOD(parentLOD.m_dPathLOD, getCachedLODAsDouble(iInstance));
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	return pathLOD;
 }
 
-void _citygml_exporter::createGeometry(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+// An Element/Element Geometry reached by several paths keeps all of them
+void _citygml_exporter::addPathLOD(OwlInstance iInstance, const _city_lod& pathLOD)
 {
 	assert(iInstance != 0);
 
-	OwlClass iInstanceClass = GetInstanceClass(iInstance);
-	assert(iInstanceClass != 0);
-
-	if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:MultiSurfaceType"))
+	auto itPathLOD = m_mapPathLODs.find(iInstance);
+	if (itPathLOD == m_mapPathLODs.end())
 	{
-		createMultiSurface(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
-	}
-	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SolidType"))
-	{
-		createSolid(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		m_mapPathLODs[iInstance] = pathLOD;
+
+		return;
 	}
-	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSolidType"))
+
+	auto& lod = itPathLOD->second;
+	lod.m_iPaths = m_pCityModel->mergePaths(lod.m_iPaths, pathLOD.m_iPaths);
+	lod.m_dPathLOD = (lod.m_dPathLOD == -DBL_MAX) || (pathLOD.m_dPathLOD == -DBL_MAX) ?
+		-DBL_MAX :
+		fmax(lod.m_dPathLOD, pathLOD.m_dPathLOD);
+}
+
+// All LODs; the targets and the next exports (another LOD selection) reuse it
+/*virtual*/ void _citygml_exporter::prepareExport(OwlInstance iRootInstance) /*override*/
+{
+	assert(iRootInstance != 0);
+
+	collectSRSDataOnce(iRootInstance);
+
+	if (!m_bCityModelRead)
 	{
-		createCompositeSolid(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		_phase_scope phase(enumPhase::CityModel);
+
+		if (!loadCityModel())
+		{
+			readCityModel();
+
+			saveCityModel();
+		}
+
+		m_bCityModelRead = !getSite()->isCancelled();
 	}
-	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "BoundaryRepresentation"))
+}
+
+// Emission; the LOD selection of the target (see isElementFiltered())
+/*virtual*/ void _citygml_exporter::executeCore(OwlInstance iRootInstance, _output_stream* pOutputStream)
+{
+	assert(iRootInstance != 0);
+	assert(pOutputStream != nullptr);
+
+	resetExport();
+
+	if (getSite()->isCancelled() || !m_bCityModelRead)
 	{
-		createBoundaryRepresentation(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		return;
 	}
-	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "Point3D"))
+
+	createIfcModel(L"IFC4");
+
+	// Global SRS (if any)
 	{
-		//#todo
-		//createPoint3D(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		_phase_scope phase(enumPhase::Buildings);
+
+		createBuildings();
 	}
-	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "Point3DSet"))
+
+	if (getSite()->isCancelled())
 	{
-		//#todo
-		//createPoint3DSet(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		return;
 	}
-	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "PolyLine3D"))
+
 	{
-		createPolyLine3D(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		_phase_scope phase(enumPhase::Features);
+
+		createFeatures();
 	}
-	else if (isCollectionClass(iInstanceClass))
+
+	// Chunked import
+	for (auto pChunk : getSite()->getChunks())
 	{
-		OwlInstance* piInstances = nullptr;
-		int64_t iInstancesCount = 0;
-		GetObjectProperty(
-			iInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "objects"),
-			&piInstances,
-			&iInstancesCount);
+		if (getSite()->isCancelled())
+		{
+			break;
+		}
 
-		for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
+		if ((pChunk->getExporter() == nullptr) || (typeid(*pChunk->getExporter()) != typeid(*this)))
 		{
-			createGeometry(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
+			continue;
 		}
-	}
-	else if (isReferencePointIndicatorClass(iInstanceClass))
+
+		pChunk->getExporter()->executeChunk(pChunk->getOwlRootInstance(), this);
+	} // for (auto pChunk : ...
+
+	// No partial output
+	if (getSite()->isCancelled())
 	{
-		//#todo
-		//createReferencePointIndicator(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		return;
 	}
-	else if (isTransformationClass(iInstanceClass))
+
+	if (!m_vecSiteInstances.empty())
 	{
-		// Reference Point (Anchor) Transformation
-		OwlInstance iReferencePointTransformationInstance = iInstance;
+		m_vecSiteInstances.erase(unique(m_vecSiteInstances.begin(), m_vecSiteInstances.end()), m_vecSiteInstances.end());
 
-		// Reference Point Transformation - matrix
-		OwlInstance* piInstances = nullptr;
-		int64_t iInstancesCount = 0;
-		GetObjectProperty(
-			iReferencePointTransformationInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "matrix"),
-			&piInstances,
-			&iInstancesCount);
-		assert(iInstancesCount == 1);
+		buildRelAggregatesInstance(
+			"ProjectContainer",
+			"ProjectContainer for Sites",
+			getProjectInstance(),
+			m_vecSiteInstances);
 
-		OwlInstance iReferencePointMatrixInstance = piInstances[0];
-		assert(iReferencePointMatrixInstance != 0);	
+		createSRSMapConversion();
+	} // if (!m_vecSiteInstances.empty())
 
-		// Transformation Matrix Transformation
-		piInstances = nullptr;
-		iInstancesCount = 0;
-		GetObjectProperty(
-			iReferencePointTransformationInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "object"),
-			&piInstances,
-			&iInstancesCount);
-		assert(iInstancesCount == 1);
-
-		OwlInstance iTransformationMatrixTransformationInstance = piInstances[0];
-		assert(iTransformationMatrixTransformationInstance != 0);
-
-		if (isTransformationClass(GetInstanceClass(iTransformationMatrixTransformationInstance)))
-		{
-			// Transformation Matrix Transformation - matrix
-			piInstances = nullptr;
-			iInstancesCount = 0;
-			GetObjectProperty(
-				iTransformationMatrixTransformationInstance,
-				GetPropertyByName(getSite()->getOwlModel(), "matrix"),
-				&piInstances,
-				&iInstancesCount);
-			assert(iInstancesCount == 1);
-
-			OwlInstance iTransformationMatrixInstance = piInstances[0];
-			assert(iTransformationMatrixInstance != 0);
-
-			// Reference Point Transformation - object
-			piInstances = nullptr;
-			iInstancesCount = 0;
-			GetObjectProperty(
-				iTransformationMatrixTransformationInstance,
-				GetPropertyByName(getSite()->getOwlModel(), "object"),
-				&piInstances,
-				&iInstancesCount);
-			assert(iInstancesCount == 1);
-
-			OwlInstance iRelativeGMLGeometryInstance = piInstances[0];
-			assert(iRelativeGMLGeometryInstance != 0);
-
-			iInstanceClass = GetInstanceClass(iRelativeGMLGeometryInstance);
-			assert(isCollectionClass(iInstanceClass));
-
-			piInstances = nullptr;
-			iInstancesCount = 0;
-			GetObjectProperty(
-				iRelativeGMLGeometryInstance,
-				GetPropertyByName(getSite()->getOwlModel(), "objects"),
-				&piInstances,
-				&iInstancesCount);
-			assert(iInstancesCount == 1);
-
-			OwlInstance iMappedItemGeometryInstance = piInstances[0];
-			assert(iMappedItemGeometryInstance != 0);
-
-			auto itMappedItem = m_mapMappedItems.find(iMappedItemGeometryInstance);
-			if (itMappedItem == m_mapMappedItems.end())
-			{
-				vector<SdaiInstance> vecMappedItemGeometryInstances;
-				createGeometry(iMappedItemGeometryInstance, vecMappedItemGeometryInstances, false);
+	_phase_scope phase(enumPhase::Save);
 
-				m_mapMappedItems[iMappedItemGeometryInstance] = vecMappedItemGeometryInstances;
+	getSite()->reportProgress(enumPhase::Save, 0, 1);
 
-				vecGeometryInstances.push_back(
-					buildMappedItem(
-						vecMappedItemGeometryInstances,
-						iReferencePointMatrixInstance,
-						iTransformationMatrixInstance)
-				);
-			}
-			else
-			{
-				vecGeometryInstances.push_back(
-					buildMappedItem(
-						itMappedItem->second,
-						iReferencePointMatrixInstance,
-						iTransformationMatrixInstance));
-			}
-		} // if (isTransformationClass( ...
-		else
-		{
-			wchar_t* szClassName = nullptr;
-			GetNameOfClassW(GetInstanceClass(iTransformationMatrixTransformationInstance), &szClassName);
+	saveIfcFile(pOutputStream);
 
-			if (wstring(szClassName) != L"Cube")
-			{
-				string strEvent = "Internal error; expected 'Cube': '";
-				strEvent += CW2A(szClassName);
-				strEvent += "'";
-				getSite()->logErr(strEvent);
-			}
-		}
-	}
-	else
+	getSite()->reportProgress(enumPhase::Save, 1, 1);
+}
+
+/*virtual*/ void _citygml_exporter::executeChunkCore(OwlInstance iRootInstance, _exporter_base* pHost) /*override*/
+{
+	assert(iRootInstance != 0);
+	assert(pHost != nullptr);
+
+	// The same input file, i.e. the same exporter
+	auto pCityGMLHost = static_cast<_citygml_exporter*>(pHost);
+
+	resetExport();
+
+	m_iDefaultWallSurfaceColorRgbInstance = pCityGMLHost->m_iDefaultWallSurfaceColorRgbInstance;
+	m_iDefaultRoofSurfaceColorRgbInstance = pCityGMLHost->m_iDefaultRoofSurfaceColorRgbInstance;
+	m_iDefaultDoorColorRgbInstance = pCityGMLHost->m_iDefaultDoorColorRgbInstance;
+	m_iDefaultWindowColorRgbInstance = pCityGMLHost->m_iDefaultWindowColorRgbInstance;
+	m_iDefaultColorRgbInstance = pCityGMLHost->m_iDefaultColorRgbInstance;
+
+	collectSRSDataOnce(iRootInstance);
+
+	if (!m_bCityModelRead)
 	{
-		wchar_t* szClassName = nullptr;
-		GetNameOfClassW(iInstanceClass, &szClassName);
+		_phase_scope phase(enumPhase::CityModel);
 
-		string strEvent = "Geometry is not supported: '";
-		strEvent += CW2A(szClassName);
-		strEvent += "'";
-		getSite()->logErr(strEvent);
+		readCityModel();
+
+		m_bCityModelRead = !getSite()->isCancelled();
 	}
-}
 
-void _citygml_exporter::createSolid(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
-{
-	assert(iInstance != 0);
+	if (getSite()->isCancelled())
+	{
+		return;
+	}
 
-	OwlInstance* piInstances = nullptr;
-	int64_t iInstancesCount = 0;
-	GetObjectProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "objects"),
-		&piInstances,
-		&iInstancesCount);
+	{
+		_phase_scope phase(enumPhase::Buildings);
 
-	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
+		createBuildings();
+	}
+
+	if (getSite()->isCancelled())
 	{
-		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
-		assert(iChildInstanceClass != 0);
+		return;
+	}
 
-		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SolidType"))
-		{
-			createSolid(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSurfaceType"))
-		{
-			createCompositeSurface(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:ShellType"))
+	{
+		_phase_scope phase(enumPhase::Features);
+
+		createFeatures();
+	}
+
+	for (auto iSiteInstance : m_vecSiteInstances)
+	{
+		if (find(pCityGMLHost->m_vecSiteInstances.begin(), pCityGMLHost->m_vecSiteInstances.end(), iSiteInstance) == pCityGMLHost->m_vecSiteInstances.end())
 		{
-			createMultiSurface(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
+			pCityGMLHost->m_vecSiteInstances.push_back(iSiteInstance);
 		}
-		else
-		{
-			//#todo
-			wchar_t* szClassName = nullptr;
-			GetNameOfClassW(iChildInstanceClass, &szClassName);
+	}
 
-			string strEvent = "Geometry is not supported: '";
-			strEvent += CW2A(szClassName);
-			strEvent += "'";
-			getSite()->logErr(strEvent);
-		}
-	} // for (int64_t iInstanceIndex = ...
+	pCityGMLHost->m_setChunkSRSs.insert(m_pCityModel->getSRSs().begin(), m_pCityModel->getSRSs().end());
+
+	pCityGMLHost->m_iFilteredBuildingElements += m_iFilteredBuildingElements;
+	pCityGMLHost->m_iFilteredFeatureElements += m_iFilteredFeatureElements;
+
+	pCityGMLHost->m_iDefaultWallSurfaceColorRgbInstance = m_iDefaultWallSurfaceColorRgbInstance;
+	pCityGMLHost->m_iDefaultRoofSurfaceColorRgbInstance = m_iDefaultRoofSurfaceColorRgbInstance;
+	pCityGMLHost->m_iDefaultDoorColorRgbInstance = m_iDefaultDoorColorRgbInstance;
+	pCityGMLHost->m_iDefaultWindowColorRgbInstance = m_iDefaultWindowColorRgbInstance;
+	pCityGMLHost->m_iDefaultColorRgbInstance = m_iDefaultColorRgbInstance;
+
+	// The objects of the chunk are reported by the host (see postProcessing())
+	if (getSite()->getMetrics()->isEnabled())
+	{
+		nameObjectMetrics();
+
+		pHost->getSite()->getMetrics()->mergeObjects(getSite()->getMetrics());
+	}
 }
 
-void _citygml_exporter::createCompositeSolid(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+void _citygml_exporter::resetExport()
 {
-	createMultiSolid(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+	// Belong to the previous IFC model; the city model is kept
+	m_mapMappedItems.clear();
+	m_vecSiteInstances.clear();
+	m_setChunkSRSs.clear();
+
+	m_iFilteredBuildingElements = 0;
+	m_iFilteredFeatureElements = 0;
+
+	m_iDefaultWallSurfaceColorRgbInstance = 0;
+	m_iDefaultRoofSurfaceColorRgbInstance = 0;
+	m_iDefaultDoorColorRgbInstance = 0;
+	m_iDefaultWindowColorRgbInstance = 0;
+	m_iDefaultColorRgbInstance = 0;
 }
 
-void _citygml_exporter::createMultiSolid(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+/*virtual*/ void _citygml_exporter::postProcessing() /*override*/
 {
-	assert(iInstance != 0);
+	getSite()->logInfo(_string::format("Filtered Building Elements and Element Geometries: %d", m_iFilteredBuildingElements));
+	getSite()->logInfo(_string::format("Filtered Feature Elements: %d", m_iFilteredFeatureElements));
 
-	OwlInstance* piInstances = nullptr;
-	int64_t iInstancesCount = 0;
-	GetObjectProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "objects"),
-		&piInstances,
-		&iInstancesCount);
+	if (getSite()->getMetrics()->isEnabled())
+	{
+		reportObjectMetrics();
+	}
 
-	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
+	if (getSite()->getMetrics()->getEngineCalls())
 	{
-		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
-		assert(iChildInstanceClass != 0);
+		reportEngineCallMetrics();
+	}
 
-		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SolidType"))
-		{
-			createSolid(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else
-		{
-			//#todo
-			wchar_t* szClassName = nullptr;
-			GetNameOfClassW(iChildInstanceClass, &szClassName);
+	if (getSite()->getMetrics()->getAllocations())
+	{
+		reportAllocationMetrics();
+	}
+}
 
-			string strEvent = "Geometry is not supported: '";
-			strEvent += CW2A(szClassName);
-			strEvent += "'";
-			getSite()->logErr(strEvent);
+// The objects of a chunk are named by the chunk, i.e. before they are merged into the host
+void _citygml_exporter::nameObjectMetrics()
+{
+	for (auto itObject : getSite()->getMetrics()->getObjects())
+	{
+		auto pCityObject = m_pCityModel->getObject(itObject.first);
+		if ((pCityObject != nullptr) && itObject.second->m_strClassName.empty())
+		{
+			itObject.second->m_strTag = pCityObject->m_strTag;
+			itObject.second->m_strClassName = pCityObject->m_strClassName;
 		}
-	} // for (int64_t iInstanceIndex = ...
+	}
 }
 
-void _citygml_exporter::createMultiSurface(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+void _citygml_exporter::reportObjectMetrics()
 {
-	assert(iInstance != 0);
+	const auto pMetrics = getSite()->getMetrics();
+	assert(pMetrics != nullptr);
 
-	OwlInstance* piInstances = nullptr;
-	int64_t iInstancesCount = 0;
-	GetObjectProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "objects"),
-		&piInstances,
-		&iInstancesCount);
+	nameObjectMetrics();
 
-	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
+	double dElapsedTime = 0.;
+	double dReadTime = 0.;
+	int64_t iOwlNodesCount = 0;
+	int64_t iFacesCount = 0;
+	int64_t iVerticesCount = 0;
+	int64_t iIfcEntitiesCount = 0;
+	for (auto itObject : pMetrics->getObjects())
 	{
-		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
-		assert(iChildInstanceClass != 0);
+		dElapsedTime += itObject.second->m_dElapsedTime;
+		dReadTime += itObject.second->m_dReadTime;
+		iOwlNodesCount += itObject.second->m_iOwlNodesCount;
+		iFacesCount += itObject.second->m_iFacesCount;
+		iVerticesCount += itObject.second->m_iVerticesCount;
+		iIfcEntitiesCount += itObject.second->m_iIfcEntitiesCount;
+	}
 
-		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSurfaceType"))
-		{
-			createCompositeSurface(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else if ((iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SurfacePropertyType")) ||
-			(iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SurfaceType")))
-		{
-			createSurfaceMember(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "BoundaryRepresentation"))
-		{
-			createBoundaryRepresentation(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);			
-		}
-		else 
-		{
-			//#todo
-			wchar_t* szClassName = nullptr;
-			GetNameOfClassW(iChildInstanceClass, &szClassName);
+	getSite()->logInfo(_string::format("City Model: %.1f ms", m_pCityModel->getReadTime()));
 
-			string strEvent = "Geometry is not supported: '";
-			strEvent += CW2A(szClassName);
-			strEvent += "'";
-			getSite()->logErr(strEvent);
-		}
-	} // for (int64_t iInstanceIndex = ...
+	getSite()->logInfo(_string::format("Objects: %lld, Time: %.1f ms, Read: %.1f ms, OWL Nodes: %lld, Faces: %lld, Vertices: %lld, IFC Entities: %lld",
+		(int64_t)pMetrics->getObjects().size(),
+		dElapsedTime,
+		dReadTime,
+		iOwlNodesCount,
+		iFacesCount,
+		iVerticesCount,
+		iIfcEntitiesCount));
+
+	vector<const _object_metrics*> vecObjects;
+	pMetrics->getSlowestObjects(vecObjects);
+
+	getSite()->logInfo(_string::format("Slowest Objects (%d):", (int)vecObjects.size()));
+	for (auto pObject : vecObjects)
+	{
+		reportObjectMetrics(pObject);
+	}
+
+	pMetrics->getLargestObjects(vecObjects);
+
+	getSite()->logInfo(_string::format("Largest Objects (%d):", (int)vecObjects.size()));
+	for (auto pObject : vecObjects)
+	{
+		reportObjectMetrics(pObject);
+	}
 }
 
-void _citygml_exporter::createCompositeSurface(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+void _citygml_exporter::reportEngineCallMetrics()
 {
-	assert(iInstance != 0);
+	vector<_engine_call_metrics> vecCalls;
+	getSite()->getMetrics()->getCalls()->getCalls(vecCalls);
 
-	OwlInstance* piInstances = nullptr;
-	int64_t iInstancesCount = 0;
-	GetObjectProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "objects"),
-		&piInstances,
-		&iInstancesCount);
+	// API
+	vector<_engine_call_metrics> vecAPICalls;
+	for (int iCall = 0; iCall < (int)enumEngineCall::count; iCall++)
+	{
+		vecAPICalls.push_back(_engine_call_metrics((enumEngineCall)iCall, nullptr));
+	}
 
-	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
+	for (const auto& call : vecCalls)
 	{
-		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
-		assert(iChildInstanceClass != 0);
+		vecAPICalls[(int)call.m_enCall].m_iCallsCount += call.m_iCallsCount;
+		vecAPICalls[(int)call.m_enCall].m_dElapsedTime += call.m_dElapsedTime;
+	}
 
-		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSurfaceType"))
-		{
-			createCompositeSurface(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:OrientableSurfaceType"))
+	getSite()->logInfo("Engine Calls:");
+	for (const auto& call : vecAPICalls)
+	{
+		if (call.m_iCallsCount == 0)
 		{
-			//#todo
-			getSite()->logErr("Geometry is not supported: 'class:OrientableSurfaceType'");
+			continue;
 		}
-		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SurfacePropertyType"))
-		{
-			createSurfaceMember(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "BoundaryRepresentation"))
-		{
-			createBoundaryRepresentation(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else
-		{
-			//#todo
-			wchar_t* szClassName = nullptr;
-			GetNameOfClassW(iChildInstanceClass, &szClassName);
 
-			string strEvent = "Geometry is not supported: '";
-			strEvent += CW2A(szClassName);
-			strEvent += "'";
-			getSite()->logErr(strEvent);
-		}
-	} // for (int64_t iInstanceIndex = ...
+		getSite()->logInfo(_string::format("%s: %lld calls, %.1f ms",
+			_engine_calls::getName(call.m_enCall),
+			call.m_iCallsCount,
+			call.m_dElapsedTime));
+	}
+
+	// API : Caller
+	getSite()->logInfo("Engine Calls per Method:");
+	for (const auto& call : vecCalls)
+	{
+		getSite()->logInfo(_string::format("%s / %s: %lld calls, %.1f ms",
+			_engine_calls::getName(call.m_enCall),
+			call.m_szCaller,
+			call.m_iCallsCount,
+			call.m_dElapsedTime));
+	}
 }
 
-void _citygml_exporter::createSurfaceMember(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+void _citygml_exporter::reportAllocationMetrics()
 {
-	assert(iInstance != 0);
-
-	OwlInstance* piInstances = nullptr;
-	int64_t iInstancesCount = 0;
-	GetObjectProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "objects"),
-		&piInstances,
-		&iInstancesCount);
+	const auto pAllocations = getSite()->getMetrics()->getPhaseAllocations();
+	assert(pAllocations != nullptr);
 
-	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
+	getSite()->logInfo("Allocations:");
+	for (int iPhase = 0; iPhase < (int)enumPhase::count; iPhase++)
 	{
-		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
-		assert(iChildInstanceClass != 0);
+		enumPhase enPhase = (enumPhase)iPhase;
 
-		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSurfaceType"))
-		{
-			createCompositeSurface(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "BoundaryRepresentation"))
-		{
-			createBoundaryRepresentation(piInstances[iInstanceIndex], vecGeometryInstances, bCreateIfcShapeRepresentation);
-		}
-		else
-		{
-			//#todo
-			wchar_t* szClassName = nullptr;
-			GetNameOfClassW(iChildInstanceClass, &szClassName);
+		getSite()->logInfo(_string::format("%s: %lld allocations, %.1f MB, Peak Live: %.1f MB, RSS: %.1f MB",
+			_allocations::getName(enPhase),
+			pAllocations->getAllocationsCount(enPhase),
+			pAllocations->getAllocatedBytes(enPhase) / 1048576.,
+			pAllocations->getPeakLiveBytes(enPhase) / 1048576.,
+			pAllocations->getRSS(enPhase) / 1048576.));
+	}
+}
 
-			string strEvent = "Geometry is not supported: '";
-			strEvent += CW2A(szClassName);
-			strEvent += "'";
-			getSite()->logErr(strEvent);
-		}
-	} // for (int64_t iInstanceIndex = ...
+void _citygml_exporter::reportObjectMetrics(const _object_metrics* pObject)
+{
+	assert(pObject != nullptr);
+
+	getSite()->logInfo(_string::format("'%s' (%s): %.1f ms, Read: %.1f ms, OWL Nodes: %lld, Faces: %lld, Vertices: %lld, IFC Entities: %lld",
+		pObject->m_strTag.c_str(),
+		pObject->m_strClassName.c_str(),
+		pObject->m_dElapsedTime,
+		pObject->m_dReadTime,
+		pObject->m_iOwlNodesCount,
+		pObject->m_iFacesCount,
+		pObject->m_iVerticesCount,
+		pObject->m_iIfcEntitiesCount));
 }
 
-void _citygml_exporter::createBoundaryRepresentation(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+/*virtual*/ void _citygml_exporter::onPreCreateSite(string& strName, _matrix* pSiteMatrix) /*override*/
 {
-	assert(iInstance != 0);
-		
-	// Indices
-	int64_t* piIndices = nullptr;
-	int64_t iIndicesCount = 0;
-	GetDatatypeProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "indices"),
-		(void**)&piIndices,
-		&iIndicesCount);
+	assert(pSiteMatrix != 0);
 
-	// Vertices
-	double* pdValue = nullptr;
-	int64_t iVerticesCount = 0;
-	GetDatatypeProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "vertices"),
-		(void**)&pdValue,
-		&iVerticesCount);
+	const auto& site = m_pCityModel->getModelSite();
 
-	vector<SdaiInstance> vecOuterPolygons;
-	map<SdaiInstance, vector<SdaiInstance>> mapOuter2InnerPolygons;
-	vector<int64_t> vecPolygonIndices;
-	map<int64_t, SdaiInstance> mapIndex2Instance;
-	for (int64_t iIndex = 0; iIndex < iIndicesCount; iIndex++)
-	{
-		if (piIndices[iIndex] < 0)
-		{
-			SdaiInstance iPolyLoopInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop");
-			assert(iPolyLoopInstance != 0);
+	strName = site.m_strName;
+	site.getCenter(pSiteMatrix->_41, pSiteMatrix->_42, pSiteMatrix->_43);
+}
 
-			SdaiAggr pPolygon = sdaiCreateAggrBN(iPolyLoopInstance, "Polygon");
-			assert(pPolygon != nullptr);
+/*virtual*/ void _citygml_exporter::onPostCreateSite(SdaiInstance iSiteInstance) /*override*/
+{
+	assert(iSiteInstance != 0);
 
-			for (auto iIndex : vecPolygonIndices)
-			{
-				assert(mapIndex2Instance.find(iIndex) != mapIndex2Instance.end());
+	setSiteSRSData(iSiteInstance, m_pCityModel->getModelSite());
+}
 
-				sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(iIndex));
-			}
+/*virtual*/ void _citygml_exporter::createDefaultStyledItemInstance(SdaiInstance iSdaiInstance) /*override*/
+{
+	assert(iSdaiInstance != 0);
 
-			if (piIndices[iIndex] == -1)
+	if (m_enCurrentElement == enumCityElement::WallSurface)
+	{
+		auto pMaterial = getSite()->getDefaultMaterial(enumMaterialEntity::Wall);
+		if (pMaterial != nullptr)
+		{
+			if (m_iDefaultWallSurfaceColorRgbInstance == 0)
 			{
-				// Outer Polygon
-				vecOuterPolygons.push_back(iPolyLoopInstance);
+				m_iDefaultWallSurfaceColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
 			}
-			else
-			{
-				// Outer Polygon : [Inner Polygons...]
-				assert(piIndices[iIndex] == -2);
-				assert(!vecOuterPolygons.empty());
 
-				auto itOuter2InnerPolygons = mapOuter2InnerPolygons.find(vecOuterPolygons.back());
-				if (itOuter2InnerPolygons != mapOuter2InnerPolygons.end())
-				{
-					itOuter2InnerPolygons->second.push_back(iPolyLoopInstance);
-				}
-				else
-				{
-					mapOuter2InnerPolygons[vecOuterPolygons.back()] = vector<SdaiInstance>{ iPolyLoopInstance };
-				}
+			createStyledItemInstance(iSdaiInstance, m_iDefaultWallSurfaceColorRgbInstance, pMaterial->getA() / 255.);
+		}
+	}
+	else if (m_enCurrentElement == enumCityElement::RoofSurface)
+	{
+		auto pMaterial = getSite()->getDefaultMaterial(enumMaterialEntity::Roof);
+		if (pMaterial != nullptr)
+		{
+			if (m_iDefaultRoofSurfaceColorRgbInstance == 0)
+			{
+				m_iDefaultRoofSurfaceColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
 			}
 
-			vecPolygonIndices.clear();
-
-			continue;
-		} // if (piIndices[iIndex] < 0)
-
-		vecPolygonIndices.push_back(piIndices[iIndex]);
-
-		if (mapIndex2Instance.find(piIndices[iIndex]) == mapIndex2Instance.end())
+			createStyledItemInstance(iSdaiInstance, m_iDefaultRoofSurfaceColorRgbInstance, pMaterial->getA() / 255.);
+		}		
+	}
+	else if (m_enCurrentElement == enumCityElement::Door)
+	{
+		auto pMaterial = getSite()->getDefaultMaterial(enumMaterialEntity::Door);
+		if (pMaterial != nullptr)
 		{
-			mapIndex2Instance[piIndices[iIndex]] = buildCartesianPointInstance(
-				pdValue[(piIndices[iIndex] * 3) + 0] - m_dXOffset,
-				pdValue[(piIndices[iIndex] * 3) + 1] - m_dYOffset,
-				pdValue[(piIndices[iIndex] * 3) + 2] - m_dZOffset);
+			if (m_iDefaultDoorColorRgbInstance == 0)
+			{
+				m_iDefaultDoorColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
+			}
+
+			createStyledItemInstance(iSdaiInstance, m_iDefaultDoorColorRgbInstance, pMaterial->getA() / 255.);
 		}
-	} // for (int64_t iIndex = ...
+	}
+	else if (m_enCurrentElement == enumCityElement::Window)
+	{
+		auto pMaterial = getSite()->getDefaultMaterial(enumMaterialEntity::Window);
+		if (pMaterial != nullptr)
+		{
+			if (m_iDefaultWindowColorRgbInstance == 0)
+			{
+				m_iDefaultWindowColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
+			}
 
-	assert(vecPolygonIndices.empty());
-	assert(!vecOuterPolygons.empty());
+			createStyledItemInstance(iSdaiInstance, m_iDefaultWindowColorRgbInstance, pMaterial->getA() / 255.);
+		}
+	}
+	else
+	{
+		auto pMaterial = getSite()->getDefaultMaterial(enumMaterialEntity::All);
+		if (pMaterial != nullptr)
+		{
+			if (m_iDefaultColorRgbInstance == 0)
+			{
+				m_iDefaultColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
+			}
 
-	SdaiInstance iClosedShellInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcClosedShell");
-	assert(iClosedShellInstance != 0);
+			createStyledItemInstance(iSdaiInstance, m_iDefaultColorRgbInstance, pMaterial->getA() / 255.);
+		}		
+	}
+}
 
-	SdaiAggr pCfsFaces = sdaiCreateAggrBN(iClosedShellInstance, "CfsFaces");
-	assert(pCfsFaces != nullptr);	
+/*virtual*/ bool _citygml_exporter::createOverriddenStyledItemInstance(SdaiInstance iSdaiInstance) /*override*/
+{
+	assert(iSdaiInstance != 0);
 
-	for (auto iOuterPolygon : vecOuterPolygons)
+	if (m_enCurrentElement == enumCityElement::WallSurface)
 	{
-		// Outer Polygon
-		SdaiInstance iFaceOuterBoundInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFaceOuterBound");
-		assert(iFaceOuterBoundInstance != 0);
-
-		sdaiPutAttrBN(iFaceOuterBoundInstance, "Bound", sdaiINSTANCE, (void*)iOuterPolygon);
-		sdaiPutAttrBN(iFaceOuterBoundInstance, "Orientation", sdaiENUM, "T");
+		auto pMaterial = getSite()->getOverriddenMaterial(enumMaterialEntity::Wall);
+		if (pMaterial != nullptr)
+		{
+			if (m_iDefaultWallSurfaceColorRgbInstance == 0)
+			{
+				m_iDefaultWallSurfaceColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
+			}
 
-		SdaiInstance iFaceInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFace");
-		assert(iFaceInstance != 0);
+			createStyledItemInstance(iSdaiInstance, m_iDefaultWallSurfaceColorRgbInstance, pMaterial->getA() / 255.);
 
-		SdaiAggr pBounds = sdaiCreateAggrBN(iFaceInstance, "Bounds");
-		sdaiAppend(pCfsFaces, sdaiINSTANCE, (void*)iFaceInstance);
+			return true;
+		}
+	}
+	else if (m_enCurrentElement == enumCityElement::RoofSurface)
+	{
+		auto pMaterial = getSite()->getOverriddenMaterial(enumMaterialEntity::Roof);
+		if (pMaterial != nullptr)
+		{
+			if (m_iDefaultRoofSurfaceColorRgbInstance == 0)
+			{
+				m_iDefaultRoofSurfaceColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
+			}
 
-		sdaiAppend(pBounds, sdaiINSTANCE, (void*)iFaceOuterBoundInstance);
+			createStyledItemInstance(iSdaiInstance, m_iDefaultRoofSurfaceColorRgbInstance, pMaterial->getA() / 255.);
 
-		// Inner Polygons
-		auto itOuter2InnerPolygons = mapOuter2InnerPolygons.find(iOuterPolygon);
-		if (itOuter2InnerPolygons != mapOuter2InnerPolygons.end())
+			return true;
+		}
+	}
+	else if (m_enCurrentElement == enumCityElement::Door)
+	{
+		auto pMaterial = getSite()->getOverriddenMaterial(enumMaterialEntity::Door);
+		if (pMaterial != nullptr)
 		{
-			for (auto iInnerPolygon : itOuter2InnerPolygons->second)
+			if (m_iDefaultDoorColorRgbInstance == 0)
 			{
-				SdaiInstance iFaceBoundInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFaceBound");
-				assert(iFaceBoundInstance != 0);
+				m_iDefaultDoorColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
+			}
 
-				sdaiPutAttrBN(iFaceBoundInstance, "Bound", sdaiINSTANCE, (void*)iInnerPolygon);
-				sdaiPutAttrBN(iFaceBoundInstance, "Orientation", sdaiENUM, "T");
+			createStyledItemInstance(iSdaiInstance, m_iDefaultDoorColorRgbInstance, pMaterial->getA() / 255.);
 
-				sdaiAppend(pBounds, sdaiINSTANCE, (void*)iFaceBoundInstance);
-			}
+			return true;
 		}
-	} // auto iOuterPolygon : ...
+	}
+	else if (m_enCurrentElement == enumCityElement::Window)
+	{
+		auto pMaterial = getSite()->getOverriddenMaterial(enumMaterialEntity::Window);
+		if (pMaterial != nullptr)
+		{
+			if (m_iDefaultWindowColorRgbInstance == 0)
+			{
+				m_iDefaultWindowColorRgbInstance = buildColorRgbInstance(
+					pMaterial->getR() / 255.,
+					pMaterial->getG() / 255.,
+					pMaterial->getB() / 255.);
+			}
 
-	SdaiInstance iFacetedBrepInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFacetedBrep");
-	assert(iFacetedBrepInstance != 0);
+			createStyledItemInstance(iSdaiInstance, m_iDefaultWindowColorRgbInstance, pMaterial->getA() / 255.);
 
-	sdaiPutAttrBN(iFacetedBrepInstance, "Outer", sdaiINSTANCE, (void*)iClosedShellInstance);
+			return true;
+		}
+	}
 
-	createStyledItemInstance(iInstance, iFacetedBrepInstance);
+	return false;
+}
 
-	if (bCreateIfcShapeRepresentation)
+/*virtual*/ void _citygml_exporter::collectSRSData(OwlInstance iRootInstance)
+{
+	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
+	while (iInstance != 0)
 	{
-		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
-		assert(iShapeRepresentationInstance != 0);
+		OwlClass iInstanceClass = GetInstanceClass(iInstance);
+		assert(iInstanceClass != 0);
 
-		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
-		assert(pItems != 0);
+		if (isEnvelopeClass(iInstanceClass))
+		{
+			OwlInstance iEnvelopeInstance = iInstance;
 
-		sdaiAppend(pItems, sdaiINSTANCE, (void*)iFacetedBrepInstance);
+			OwlInstance iParentInstance = GetInstanceInverseReferencesByIterator(iInstance, 0);
+			if (iParentInstance != 0)
+			{
+				OwlClass iParentInstanceClass = GetInstanceClass(iParentInstance);
+				assert(iParentInstanceClass != 0);
 
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "Brep");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+				if (isBoundingShapeClass(iParentInstanceClass))
+				{
+					iParentInstance = GetInstanceInverseReferencesByIterator(iParentInstance, 0);
+					if (iParentInstance != 0)
+					{
+						iParentInstanceClass = GetInstanceClass(iParentInstance);
+						assert(iParentInstanceClass != 0);
+
+						if (isCityModelClass(iParentInstanceClass))
+						{
+							m_iEnvelopeInstance = iEnvelopeInstance;
+						}
+						else if (isBuildingClass(iParentInstanceClass) || isBuildingPartClass(iParentInstanceClass))
+						{
+							assert(m_mapBuildingSRS.find(iParentInstance) == m_mapBuildingSRS.end());
+							m_mapBuildingSRS[iParentInstance] = iEnvelopeInstance;
+						}
+					} // if (iParentInstance != 0)	
+				} // if (isBoundingShapeClass(iParentInstanceClass))
+			} // if (iParentInstance != 0)
+		} // if (isEnvelopeClass(iInstanceClass))
+		else if (IsPoint3DClass(iInstanceClass))
+		{
+			OwlInstance iReferencePointInstance = iInstance;
+
+			OwlInstance iParentInstance = GetInstanceInverseReferencesByIterator(iInstance, 0);
+			if (iParentInstance != 0)
+			{
+				OwlClass iParentInstanceClass = GetInstanceClass(iParentInstance);
+				assert(iParentInstanceClass != 0);
+
+				if (isPointPropertyClass(iParentInstanceClass))
+				{
+					iParentInstance = GetInstanceInverseReferencesByIterator(iParentInstance, 0);
+					if (iParentInstance != 0)
+					{
+						iParentInstanceClass = GetInstanceClass(iParentInstance);
+						assert(iParentInstanceClass != 0);
+
+						if (isCadastralParcelClass(iParentInstanceClass))
+						{
+							assert(m_mapParcelSRS.find(iParentInstance) == m_mapParcelSRS.end());
+							m_mapParcelSRS[iParentInstance] = iReferencePointInstance;
+						}
+					}
+				}
+			}
+		} // if (IsPoint3DClass(iInstanceClass))
+
+		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
+	} // while (iInstance != 0)
+}
+
+void _citygml_exporter::collectSRSDataOnce(OwlInstance iRootInstance)
+{
+	assert(iRootInstance != 0);
+
+	if (m_bSRSDataCollected)
+	{
+		return;
+	}
+
+	collectSRSData(iRootInstance);
+
+	m_bSRSDataCollected = true;
+}
+
+void _citygml_exporter::createSRSMapConversion()
+{
+	/* SRSs */
+	set<string> setSRSs = m_setChunkSRSs;
+	setSRSs.insert(m_pCityModel->getSRSs().begin(), m_pCityModel->getSRSs().end());
+
+	if (setSRSs.size() == 1)
+	{
+		string strSRS = "EPSG:";
+		strSRS += *setSRSs.begin();
+
+		SdaiInstance iMapConversion = buildMapConversion(getGeometricRepresentationContextInstance(), buildProjectedCRS(strSRS));
+		assert(iMapConversion != 0);
+	}
+	else if (setSRSs.size() > 1)
+	{
+		// E.g. the chunks of an input (see _gml2ifc_exporter::importChunks())
+		string strSRSs;
+		for (const auto& strSRS : setSRSs)
+		{
+			strSRSs += strSRSs.empty() ? "EPSG:" : ", EPSG:";
+			strSRSs += strSRS;
+		}
+
+		getSite()->logErr(_string::format("Several SRSs (%s); IfcMapConversion is not created.", strSRSs.c_str()));
+	}
+}
+
+/*virtual*/ void _citygml_exporter::collectSRSs(set<string>& setSRSs)
+
+{
+	// Root
+	if (m_iEnvelopeInstance != 0)
+	{
+		string strEPSGCode;
+		vector<double> vecCenter;
+		if (retrieveEnvelopeSRSData(m_iEnvelopeInstance, strEPSGCode, vecCenter))
+		{
+			setSRSs.insert(strEPSGCode);
+		}
+	}
+
+	// Building
+	for (auto itBuildingSRS : m_mapBuildingSRS)
+	{
+		string strEPSGCode;
+		vector<double> vecCenter;
+		if (retrieveEnvelopeSRSData(itBuildingSRS.second, strEPSGCode, vecCenter))
+		{
+			setSRSs.insert(strEPSGCode);
+		}
+	}
+
+	// Feature
+	for (auto itParcelSRS : m_mapParcelSRS)
+	{
+		string strEPSGCode;
+		vector<double> vecCenter;
+		if (retrieveReferencePointSRSData(itParcelSRS.second, strEPSGCode, vecCenter))
+		{
+			setSRSs.insert(strEPSGCode);
+		}
+	}
+}
+
+/*virtual*/ void _citygml_exporter::readModelSite(_city_site& site)
+{
+	OwlClass iInstanceClass = GetInstanceClass(getSite()->getOwlRootInstance());
+	assert(iInstanceClass != 0);
+
+	char* szClassName = nullptr;
+	GetNameOfClass(iInstanceClass, &szClassName);
+	assert(szClassName != nullptr);
+
+	site.m_strName = szClassName;
+	site.m_strDescription = szClassName;
+
+	if (m_iEnvelopeInstance != 0)
+	{
+		readEnvelopeSite(m_iEnvelopeInstance, site);
+	}
+}
+
+void _citygml_exporter::readEnvelopeSite(OwlInstance iEnvelopeInstance, _city_site& site)
+{
+	assert(iEnvelopeInstance != 0);
+
+	string strEPSGCode;
+	vector<double> vecLowerCorner;
+	vector<double> vecUpperCorner;
+	if (retrieveEnvelopeSRSData(iEnvelopeInstance, strEPSGCode, vecLowerCorner, vecUpperCorner))
+	{
+		site.m_enSRS = enumCitySRS::Envelope;
+		site.m_strEPSGCode = strEPSGCode;
+
+		for (int iValue = 0; iValue < 3; iValue++)
+		{
+			site.m_arLowerCorner[iValue] = vecLowerCorner[iValue];
+			site.m_arUpperCorner[iValue] = vecUpperCorner[iValue];
+		}
+	}
+}
+
+void _citygml_exporter::readReferencePointSite(OwlInstance iReferencePointInstance, _city_site& site)
+{
+	assert(iReferencePointInstance != 0);
+
+	string strEPSGCode;
+	vector<double> vecCenter;
+	if (retrieveReferencePointSRSData(iReferencePointInstance, strEPSGCode, vecCenter))
+	{
+		site.m_enSRS = enumCitySRS::ReferencePoint;
+		site.m_strEPSGCode = strEPSGCode;
+
+		for (int iValue = 0; iValue < 3; iValue++)
+		{
+			site.m_arLowerCorner[iValue] = vecCenter[iValue];
+			site.m_arUpperCorner[iValue] = vecCenter[iValue];
+		}
+	}
+}
+
+void _citygml_exporter::getXYZOffset(double& dX, double& dY, double& dZ)
+{
+	m_pCityModel->getModelSite().getOffset(dX, dY, dZ);
+}
+
+SdaiInstance _citygml_exporter::createSite(const _city_object* pObject, SdaiInstance& iSiteInstancePlacement)
+{
+	assert(pObject != nullptr);
+
+	iSiteInstancePlacement = 0;
+
+	if (pObject->m_iSite == -1)
+	{
+		getXYZOffset(m_dXOffset, m_dYOffset, m_dZOffset);
+
+		return getSiteInstance(iSiteInstancePlacement);
+	}
+
+	const auto& site = m_pCityModel->getSite(pObject->m_iSite);
+
+	site.getOffset(m_dXOffset, m_dYOffset, m_dZOffset);
+
+	_matrix mtxSite;
+	mtxSite._41 = m_dXOffset;
+	mtxSite._42 = m_dYOffset;
+	mtxSite._43 = m_dZOffset;
+
+	SdaiInstance iSiteInstance = buildSiteInstance(
+		site.m_strName.c_str(),
+		site.m_strDescription.c_str(),
+		&mtxSite,
+		iSiteInstancePlacement);
+	assert(iSiteInstance != 0);
+	assert(iSiteInstancePlacement != 0);
+
+	setSiteSRSData(iSiteInstance, site);
+
+	return iSiteInstance;
+}
+
+void _citygml_exporter::setSiteSRSData(SdaiInstance iSiteInstance, const _city_site& site)
+{
+	assert(iSiteInstance != 0);
+
+	if (!site.hasSRSData())
+	{
+		return;
+	}
+
+	string strCoordinates;
+	if (getSiteWGS84(site, strCoordinates))
+	{
+		vector<double> vecCoordinates;
+		getPosValues(strCoordinates, vecCoordinates);
+
+		double dLatitude = vecCoordinates[0];
+		double dLongitude = vecCoordinates[1];
+
+		SdaiAggr pRefLatitude = sdaiCreateAggrBN(iSiteInstance, "RefLatitude");
+		assert(pRefLatitude != nullptr);
+
+		/*
+		  c[1] :=    a;                                           -- -50
+		  c[2] :=   (a - c[1]) * 60;                              -- -58
+		  c[3] :=  ((a - c[1]) * 60 - c[2]) * 60;                 -- -33
+		  c[4] := (((a - c[1]) * 60 - c[2]) * 60 - c[3]) * 1.e6;  -- -110400
+		*/
+
+		// c[4] - Envelope only
+		int64_t iRefLatitude1 = (int64_t)dLatitude;
+		int64_t iRefLatitude2 = (int64_t)((dLatitude - iRefLatitude1) * 60.);
+		int64_t iRefLatitude3 = (int64_t)(((dLatitude - iRefLatitude1) * 60. - iRefLatitude2) * 60.);
+		int64_t iRefLatitude4 = site.m_enSRS == enumCitySRS::Envelope ?
+			(int64_t)(((((dLatitude - iRefLatitude1) * 60. - iRefLatitude2) * 60.) - iRefLatitude3) * 1.e6) : 0;
+		sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude1);
+		sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude2);
+		sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude3);
+		sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude4);
+
+		SdaiAggr pRefLongitude = sdaiCreateAggrBN(iSiteInstance, "RefLongitude");
+		assert(pRefLongitude != nullptr);
+
+		int64_t iRefLongitude1 = (int64_t)dLongitude;
+		int64_t iRefLongitude2 = (int64_t)((dLongitude - iRefLongitude1) * 60.);
+		int64_t iRefLongitude3 = (int64_t)(((dLongitude - iRefLongitude1) * 60. - iRefLongitude2) * 60.);
+		int64_t iRefLongitude4 = site.m_enSRS == enumCitySRS::Envelope ?
+			(int64_t)(((((dLongitude - iRefLongitude1) * 60. - iRefLongitude2) * 60.) - iRefLongitude3) * 1.e6) : 0;
+		sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude1);
+		sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude2);
+		sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude3);
+		sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude4);
+
+		double dRefElevation = site.m_arLowerCorner[2];
+		sdaiPutAttrBN(iSiteInstance, "RefElevation", sdaiREAL, &dRefElevation);
+	} // if (getSiteWGS84(site, strCoordinates))
+}
+
+bool _citygml_exporter::getSiteWGS84(const _city_site& site, string& strCoordinates)
+{
+	assert(site.hasSRSData());
+
+	return getSite()->getWGS84(
+		atoi(site.m_strEPSGCode.c_str()),
+		(float)(site.m_arLowerCorner[0] + site.m_arUpperCorner[0]) / 2.f,
+		(float)(site.m_arLowerCorner[1] + site.m_arUpperCorner[1]) / 2.f,
+		(float)(site.m_arLowerCorner[2] + site.m_arUpperCorner[2]) / 2.f,
+		strCoordinates);
+}
+
+// The Buildings/Features, all LODs; the records are added on this thread (see getCachedLOD()),
+// the attributes and the geometry are read by the worker threads ('$EXPORT $THREADS'), see readCityObject()
+void _citygml_exporter::readCityModel()
+{
+	auto tpStart = chrono::steady_clock::now();
+
+	m_pCityModel->clear();
+	clearDiscovery();
+
+	readModelSite(m_pCityModel->getModelSite());
+	collectSRSs(m_pCityModel->getSRSs());
+
+	searchForBuildings();
+
+	if (getSite()->isCancelled())
+	{
+		return;
+	}
+
+	searchForFeatures();
+
+	if (getSite()->isCancelled())
+	{
+		return;
+	}
+
+	addCityObjects(enumCityObject::Building, m_mapBuildings, m_mapBuildingElements);
+	addCityObjects(enumCityObject::Feature, m_mapFeatures, m_mapFeatureElements);
+
+	vector<_city_object*> vecObjects = m_pCityModel->getBuildings();
+	vecObjects.insert(vecObjects.end(), m_pCityModel->getFeatures().begin(), m_pCityModel->getFeatures().end());
+
+	readCityObjects(vecObjects, getSite()->getExportThreadsCount());
+
+	clearDiscovery();
+
+	m_pCityModel->setReadTime(chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count());
+}
+
+void _citygml_exporter::clearDiscovery()
+{
+	m_mapBuildings.clear();
+	m_mapBuildingElements.clear();
+
+	m_mapFeatures.clear();
+	m_mapFeatureElements.clear();
+
+	m_mapBuildingHighestLOD.clear();
+	m_mapFeatureHighestLOD.clear();
+	m_mapPathLODs.clear();
+}
+
+void _citygml_exporter::addCityObjects(enumCityObject enObject, const map<OwlInstance, vector<OwlInstance>>& mapObjects, const map<OwlInstance, vector<OwlInstance>>& mapElements)
+{
+	for (const auto& itObject : mapObjects)
+	{
+		OwlClass iInstanceClass = GetInstanceClass(itObject.first);
+		assert(iInstanceClass != 0);
+
+		char* szClassName = nullptr;
+		GetNameOfClass(iInstanceClass, &szClassName);
+		assert(szClassName != nullptr);
+
+		auto pObject = m_pCityModel->addObject(enObject, itObject.first, getTag(itObject.first), szClassName);
+
+		const auto& mapHighestLOD = enObject == enumCityObject::Building ? m_mapBuildingHighestLOD : m_mapFeatureHighestLOD;
+		auto itHighestLOD = mapHighestLOD.find(itObject.first);
+		if (itHighestLOD != mapHighestLOD.end())
+		{
+			pObject->m_dHighestLOD = itHighestLOD->second;
+		}
+
+		// Site
+		if (enObject == enumCityObject::Building)
+		{
+			auto itBuildingSRS = m_mapBuildingSRS.find(itObject.first);
+			if (itBuildingSRS != m_mapBuildingSRS.end())
+			{
+				_city_site site;
+				site.m_strName = pObject->m_strTag;
+				site.m_strDescription = pObject->m_strClassName;
+				readEnvelopeSite(itBuildingSRS->second, site);
+
+				pObject->m_iSite = m_pCityModel->addSite(site);
+			}
+		}
+		else
+		{
+			pObject->m_enFeature = getCityFeature(iInstanceClass);
+
+			auto itParcelSRS = m_mapParcelSRS.find(itObject.first);
+			if (itParcelSRS != m_mapParcelSRS.end())
+			{
+				_city_site site;
+				site.m_strName = pObject->m_strTag;
+				site.m_strDescription = pObject->m_strClassName;
+				readReferencePointSite(itParcelSRS->second, site);
+
+				pObject->m_iSite = m_pCityModel->addSite(site);
+			}
+		}
+
+		// Elements
+		int64_t iElementGeometry = 0;
+		for (auto iElementInstance : itObject.second)
+		{
+			auto itElement = mapElements.find(iElementInstance);
+			if ((itElement == mapElements.end()) || itElement->second.empty())
+			{
+				// No geometry
+				continue;
+			}
+
+			const auto& vecGeometries = itElement->second;
+
+			OwlClass iElementClass = GetInstanceClass(iElementInstance);
+			assert(iElementClass != 0);
+
+			char* szElementClassName = nullptr;
+			GetNameOfClass(iElementClass, &szElementClassName);
+			assert(szElementClassName != nullptr);
+
+			_city_element element(iElementInstance, getTag(iElementInstance), szElementClassName, getCityElement(iElementClass));
+			element.m_lod = m_mapPathLODs.at(iElementInstance);
+
+			element.m_iFirstGeometry = iElementGeometry;
+			element.m_iGeometriesCount = (int64_t)vecGeometries.size();
+			iElementGeometry += element.m_iGeometriesCount;
+
+			for (auto iGeometryInstance : vecGeometries)
+			{
+				_city_lod lod = m_mapPathLODs.at(iGeometryInstance);
+				lod.m_iLOD = m_pCityModel->addLOD(getGeometryLOD(iElementInstance, iGeometryInstance));
+
+				pObject->m_vecGeometryLODs.push_back(lod);
+			}
+
+			pObject->m_vecElements.push_back(element);
+		} // for (auto iElementInstance : ...
+	} // for (const auto& itObject : ...
+}
+
+// The OWL model is read on this thread: the engine doesn't document concurrent reads of an OWL model,
+// i.e. the reads are engine-serialized anyway. The faces are built without the engine by $THREADS
+// (see _geometry_buffer::buildFaces()); the records are in the discovery order, i.e. the IFC model
+// doesn't depend on the threads.
+void _citygml_exporter::readCityObjects(const vector<_city_object*>& vecObjects, int iThreadsCount)
+{
+	for (size_t iObject = 0; iObject < vecObjects.size(); iObject++)
+	{
+		if (getSite()->isCancelled())
+		{
+			return;
+		}
+
+		getSite()->reportProgress(enumPhase::CityModel, (int64_t)iObject, (int64_t)vecObjects.size());
+
+		readCityObject(vecObjects[iObject]);
+	}
+
+	// Largest first; Element Geometries count : Object
+	vector<pair<int64_t, size_t>> vecObjectsBySize;
+	for (size_t iObject = 0; iObject < vecObjects.size(); iObject++)
+	{
+		vecObjectsBySize.push_back({ vecObjects[iObject]->getGeometriesCount(), iObject });
+	}
+
+	stable_sort(vecObjectsBySize.begin(), vecObjectsBySize.end(),
+		[](const pair<int64_t, size_t>& prObject1, const pair<int64_t, size_t>& prObject2)
+		{
+			return prObject1.first > prObject2.first;
+		});
+
+	// A thread takes the largest object left when it is done with the previous one
+	atomic<size_t> iNextObject(0);
+	enumPhase enPhase = _metrics::getCurrentPhase();
+	auto build = [&]()
+	{
+		_log_context_scope logContext(getSite()->getLogContext());
+		_metrics_scope metrics(getSite()->getMetrics(), enPhase);
+
+		size_t iNext = 0;
+		while (((iNext = iNextObject++) < vecObjectsBySize.size()) && !getSite()->isCancelled())
+		{
+			auto pObject = vecObjects[vecObjectsBySize[iNext].second];
+
+			auto tpStart = chrono::steady_clock::now();
+
+			pObject->m_geometryBuffer.buildFaces();
+
+			pObject->m_dReadTime += chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count();
+		}
+	};
+
+#ifndef _GML2IFC_NO_THREADS
+	vector<thread*> vecThreads;
+	for (int iThread = 1; iThread < min(iThreadsCount, (int)vecObjects.size()); iThread++)
+	{
+		vecThreads.push_back(new thread(build));
+	}
+#else
+	(void)iThreadsCount;
+#endif
+
+	build();
+
+#ifndef _GML2IFC_NO_THREADS
+	for (auto pThread : vecThreads)
+	{
+		pThread->join();
+		delete pThread;
+	}
+#endif
+
+	if (getSite()->isCancelled())
+	{
+		return;
+	}
+
+	getSite()->reportProgress(enumPhase::CityModel, (int64_t)vecObjects.size(), (int64_t)vecObjects.size());
+}
+
+// Reads the OWL model and the discovery results (m_mapBuildings, ...); the faces are built by
+// readCityObjects()
+void _citygml_exporter::readCityObject(_city_object* pObject)
+{
+	assert(pObject != nullptr);
+
+	auto tpStart = chrono::steady_clock::now();
+
+	auto pGeometryBuffer = &pObject->m_geometryBuffer;
+	pGeometryBuffer->clear();
+
+	pObject->m_vecAttributes.clear();
+	readAttributes(pObject->m_iInstance, pObject->m_vecAttributes);
+	pObject->m_iAttributesCount = (int64_t)pObject->m_vecAttributes.size();
+
+	const auto& mapElements = pObject->m_enObject == enumCityObject::Building ? m_mapBuildingElements : m_mapFeatureElements;
+	for (auto& element : pObject->m_vecElements)
+	{
+		// The properties of the Feature Elements are not exported
+		if (pObject->m_enObject == enumCityObject::Building)
+		{
+			element.m_iFirstAttribute = (int64_t)pObject->m_vecAttributes.size();
+			readAttributes(element.m_iInstance, pObject->m_vecAttributes);
+			element.m_iAttributesCount = (int64_t)pObject->m_vecAttributes.size() - element.m_iFirstAttribute;
+		}
+
+		for (auto iGeometryInstance : mapElements.at(element.m_iInstance))
+		{
+			vector<int64_t> vecRoots;
+			readGeometry(pGeometryBuffer, iGeometryInstance, vecRoots);
+
+			pGeometryBuffer->addRoots(vecRoots);
+		}
+	} // for (auto& element : ...
+
+	pObject->m_dReadTime = chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count();
+}
+
+enumCityElement _citygml_exporter::getCityElement(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	if (isWallSurfaceClass(iInstanceClass))
+	{
+		return enumCityElement::WallSurface;
+	}
+
+	if (isRoofSurfaceClass(iInstanceClass))
+	{
+		return enumCityElement::RoofSurface;
+	}
+
+	if (isDoorClass(iInstanceClass))
+	{
+		return enumCityElement::Door;
+	}
+
+	if (isWindowClass(iInstanceClass))
+	{
+		return enumCityElement::Window;
+	}
+
+	return enumCityElement::Other;
+}
+
+enumCityFeature _citygml_exporter::getCityFeature(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	if (isTransportationObjectClass(iInstanceClass) ||
+		isTrafficSpaceClass(iInstanceClass) ||
+		isTrafficAreaClass(iInstanceClass) ||
+		isBridgeObjectClass(iInstanceClass) ||
+		isTunnelObjectClass(iInstanceClass))
+	{
+		return enumCityFeature::Transportation;
+	}
+
+	if (isReliefObjectClass(iInstanceClass) ||
+		isLandUseClass(iInstanceClass) ||
+		isWaterObjectClass(iInstanceClass) ||
+		isVegetationObjectClass(iInstanceClass))
+	{
+		return enumCityFeature::Geographic;
+	}
+
+	if (isFurnitureObjectClass(iInstanceClass))
+	{
+		return enumCityFeature::Furniture;
+	}
+
+	return enumCityFeature::Other;
+}
+
+// The city model saved by a previous export of the input (all LODs); the import of the input
+// is skipped (see _gml2ifc_exporter::importCachedModel())
+bool _citygml_exporter::loadCityModel()
+{
+	auto pCityModelCache = getSite()->getCityModelCache();
+	if (pCityModelCache == nullptr)
+	{
+		return false;
+	}
+
+	// All LODs
+	if (!pCityModelCache->hasCityModel())
+	{
+		return false;
+	}
+
+	auto tpStart = chrono::steady_clock::now();
+
+	if (!pCityModelCache->load(m_pCityModel))
+	{
+		getSite()->logErr("City Model Cache: the city model can't be loaded.");
+
+		return false;
+	}
+
+	m_pCityModel->setReadTime(chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count());
+
+	getSite()->logInfo(_string::format("City Model Cache: %lld Buildings, %lld Features loaded, %.1f ms",
+		(int64_t)m_pCityModel->getBuildings().size(),
+		(int64_t)m_pCityModel->getFeatures().size(),
+		m_pCityModel->getReadTime()));
+
+	return true;
+}
+
+void _citygml_exporter::saveCityModel()
+{
+	auto pCityModelCache = getSite()->getCityModelCache();
+	if ((pCityModelCache == nullptr) || getSite()->isCachedImport() || getSite()->isCancelled())
+	{
+		return;
+	}
+
+	// The objects of the chunks are not in this city model
+	if (!getSite()->getChunks().empty())
+	{
+		getSite()->logInfo("City Model Cache: chunked import is not cached.");
+
+		return;
+	}
+
+	auto tpStart = chrono::steady_clock::now();
+
+	// The SRS transformations are saved as well
+	string strCoordinates;
+	if (m_pCityModel->getModelSite().hasSRSData())
+	{
+		getSiteWGS84(m_pCityModel->getModelSite(), strCoordinates);
+	}
+
+	for (int64_t iSite = 0; iSite < m_pCityModel->getSitesCount(); iSite++)
+	{
+		if (m_pCityModel->getSite(iSite).hasSRSData())
+		{
+			getSiteWGS84(m_pCityModel->getSite(iSite), strCoordinates);
+		}
+	}
+
+	if (!pCityModelCache->save(m_pCityModel))
+	{
+		getSite()->logWarn(_string::format("City Model Cache: '%s' can't be written.",
+			(LPCSTR)CW2A(pCityModelCache->getFile().c_str())));
+
+		return;
+	}
+
+	getSite()->logInfo(_string::format("City Model Cache: saved, %.1f ms",
+		chrono::duration<double, milli>(chrono::steady_clock::now() - tpStart).count()));
+}
+
+// Discovery; the Building Elements and their geometry, all LODs
+void _citygml_exporter::searchForBuildings()
+{
+	OwlClass iSchemasClass = GetClassByName(getSite()->getOwlModel(), "class:Schemas");
+	assert(iSchemasClass != 0);
+
+	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
+	while (iInstance != 0)
+	{
+		if (getSite()->isCancelled())
+		{
+			return;
+		}
+
+		OwlClass iInstanceClass = GetInstanceClass(iInstance);
+		assert(iInstanceClass != 0);
+
+		if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+		{
+			if (iInstanceClass != iSchemasClass)
+			{
+				if (isBuildingClass(iInstanceClass) || isBuildingPartClass(iInstanceClass))
+				{
+					if (m_mapBuildings.find(iInstance) == m_mapBuildings.end())
+					{
+						m_mapBuildings[iInstance] = vector<OwlInstance>();
+
+						_object_metrics_scope objectMetrics(getSite()->getMetrics(), iInstance);
+
+						searchForBuildingElements(iInstance, iInstance, _city_lod());
+					}
+					else
+					{
+						assert(false); // Internal error!
+					}
+				}
+				else
+				{
+					createBuildingsRecursively(iInstance);
+				}
+			}
+		} // if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+
+		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
+	} // while (iInstance != 0)
+
+	// Proxy/Unknown Building Elements; the discovery is complete before any geometry is read
+	for (auto& itBuilding : m_mapBuildings)
+	{
+		if (getSite()->isCancelled())
+		{
+			return;
+		}
+
+		_object_metrics_scope objectMetrics(getSite()->getMetrics(), itBuilding.first);
+
+		searchForProxyBuildingElements(itBuilding.first, itBuilding.first, _city_lod());
+	}
+}
+
+void _citygml_exporter::createBuildings()
+{
+	const auto& vecBuildings = m_pCityModel->getBuildings();
+	if (vecBuildings.empty())
+	{
+		return;
+	}
+
+	map<SdaiInstance, vector<SdaiInstance>> mapSite2Instances;
+	int64_t iDone = 0;
+	for (auto pBuilding : vecBuildings)
+	{
+		if (getSite()->isCancelled())
+		{
+			return;
+		}
+
+		getSite()->reportProgress(enumPhase::Buildings, iDone++, (int64_t)vecBuildings.size());
+
+		_object_metrics_scope objectMetrics(getSite()->getMetrics(), pBuilding->m_iInstance);
+
+		getSite()->getMetrics()->onRead(pBuilding->m_geometryBuffer.getOwlNodesCount(), pBuilding->m_dReadTime);
+
+		createBuilding(pBuilding, mapSite2Instances);
+	} // for (auto pBuilding : ...
+
+	getSite()->reportProgress(enumPhase::Buildings, iDone, iDone);
+
+	for (const auto& itSite2Instances : mapSite2Instances)
+	{
+		buildRelAggregatesInstance(
+			"SiteContainer",
+			"SiteContainer For Buildings",
+			itSite2Instances.first,
+			itSite2Instances.second);
+
+		m_vecSiteInstances.push_back(itSite2Instances.first);
+	}	
+}
+
+void _citygml_exporter::createBuilding(const _city_object* pBuilding, map<SdaiInstance, vector<SdaiInstance>>& mapSite2Instances)
+{
+	assert(pBuilding != nullptr);
+
+	_auto_var<double> xOffset(m_dXOffset, 0., 0.);
+	_auto_var<double> yOffset(m_dYOffset, 0., 0.);
+	_auto_var<double> zOffset(m_dZOffset, 0., 0.);
+
+	SdaiInstance iSiteInstancePlacement = 0;
+	SdaiInstance iSiteInstance = createSite(pBuilding, iSiteInstancePlacement);
+
+	_matrix mtxIdentity;
+	SdaiInstance iBuildingInstancePlacement = 0;
+	SdaiInstance iSdaiBuildingInstance = buildBuildingInstance(
+		pBuilding->m_strTag.c_str(),
+		pBuilding->m_strClassName.c_str(),
+		&mtxIdentity,
+		iSiteInstancePlacement,
+		iBuildingInstancePlacement);
+	assert(iSdaiBuildingInstance != 0);
+
+	createProperties(pBuilding, 0, pBuilding->m_iAttributesCount, iSdaiBuildingInstance);
+
+	auto itSite2Instances = mapSite2Instances.find(iSiteInstance);
+	if (itSite2Instances == mapSite2Instances.end())
+	{
+		mapSite2Instances[iSiteInstance] = vector<SdaiInstance>{ iSdaiBuildingInstance };
+	}
+	else
+	{
+		itSite2Instances->second.push_back(iSdaiBuildingInstance);
+	}
+
+	if (pBuilding->m_vecElements.empty())
+	{
+		return;
+	}
+
+	vector<SdaiInstance> vecBuildingElementInstances;
+	for (const auto& element : pBuilding->m_vecElements)
+	{
+		if (isElementFiltered(pBuilding, element.m_lod))
+		{
+			continue;
+		}
+
+		_auto_var<enumCityElement> currentElement(m_enCurrentElement, element.m_enElement, enumCityElement::Other);
+
+		vector<SdaiInstance> vecSdaiBuildingElementGeometryInstances;
+		createElementGeometry(pBuilding, element, vecSdaiBuildingElementGeometryInstances);
+
+		if (vecSdaiBuildingElementGeometryInstances.empty())
+		{
+			// Not supported
+			continue;
+		}
+
+		SdaiInstance iBuildingElementInstancePlacement = 0;
+		SdaiInstance iSdaiBuildingElementInstance = buildBuildingElementInstance(
+			element,
+			&mtxIdentity,
+			iBuildingInstancePlacement,
+			iBuildingElementInstancePlacement,
+			vecSdaiBuildingElementGeometryInstances);
+		assert(iSdaiBuildingElementInstance != 0);
+
+		createProperties(pBuilding, element.m_iFirstAttribute, element.m_iAttributesCount, iSdaiBuildingElementInstance);
+
+		vecBuildingElementInstances.push_back(iSdaiBuildingElementInstance);
+	} // for (const auto& element : ...
+
+	SdaiInstance iBuildingStoreyInstancePlacement = 0;
+	SdaiInstance iBuildingStoreyInstance = buildBuildingStoreyInstance(
+		&mtxIdentity, 
+		iBuildingInstancePlacement, 
+		iBuildingStoreyInstancePlacement);
+	assert(iBuildingStoreyInstance != 0);
+
+	buildRelAggregatesInstance(
+		"BuildingContainer",
+		"BuildingContainer for BuildingStories",
+		iSdaiBuildingInstance,
+		vector<SdaiInstance>{ iBuildingStoreyInstance });
+
+	if (vecBuildingElementInstances.empty())
+	{
+		// Not supported
+		return;
+	}
+
+	buildRelContainedInSpatialStructureInstance(
+		"BuildingStoreyContainer",
+		"BuildingStoreyContainer for Building Elements",
+		iBuildingStoreyInstance,
+		vecBuildingElementInstances);
+}
+
+void _citygml_exporter::createBuildingsRecursively(OwlInstance iInstance)
+{
+	assert(iInstance != 0);
+
+	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
+	while (iProperty != 0)
+	{
+		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		{
+			int64_t iValuesCount = 0;
+			OwlInstance* piValues = nullptr;
+			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+
+			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
+			{
+				if (piValues[iValue] == 0)
+				{
+					continue;
+				}
+					
+				OwlClass iInstanceClass = GetInstanceClass(piValues[iValue]);
+				assert(iInstanceClass != 0);
+
+				if (isCityObjectGroupMemberClass(iInstanceClass))
+				{
+					continue; // Ignore
+				}
+
+				if (isBuildingClass(iInstanceClass) || isBuildingPartClass(iInstanceClass))
+				{
+					if (m_mapBuildings.find(piValues[iValue]) == m_mapBuildings.end())
+					{
+						m_mapBuildings[piValues[iValue]] = vector<OwlInstance>();
+
+						_object_metrics_scope objectMetrics(getSite()->getMetrics(), piValues[iValue]);
+
+						searchForBuildingElements(piValues[iValue], piValues[iValue], _city_lod());
+					}
+					else
+					{
+						assert(false); // Internal error!
+					}
+				}
+				else
+				{
+					createBuildingsRecursively(piValues[iValue]);
+				}
+			} // for (int64_t iValue = ...
+		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+
+		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
+	} // while (iProperty != 0)
+}
+
+void _citygml_exporter::searchForBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance, const _city_lod& pathLOD)
+{
+	assert(iBuildingInstance != 0);
+	assert(iInstance != 0);
+
+	getSite()->getMetrics()->onOwlNode();
+
+	// All LODs; the LOD selection is applied on emission (see isElementFiltered())
+	updateBuildingHighestLOD(iBuildingInstance, iInstance);
+	_city_lod instanceLOD = getPathLOD(pathLOD, iInstance);
+
+	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
+	while (iProperty != 0)
+	{
+		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		{
+			int64_t iValuesCount = 0;
+			OwlInstance* piValues = nullptr;
+			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+
+			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
+			{
+				if (piValues[iValue] == 0)
+				{
+					continue;
+				}
+
+				if (isBuildingElement(piValues[iValue]))
+				{
+					auto itBuilding = m_mapBuildings.find(iBuildingInstance);
+					if (itBuilding != m_mapBuildings.end())
+					{
+						itBuilding->second.push_back(piValues[iValue]);
+					}
+					else
+					{
+						m_mapBuildings[iBuildingInstance] = vector<OwlInstance>{ piValues[iValue] };
+					}
+
+					addPathLOD(piValues[iValue], getPathLOD(instanceLOD, piValues[iValue]));
+
+					searchForBuildingElementGeometry(iBuildingInstance, piValues[iValue], piValues[iValue], instanceLOD);
+				}
+
+				searchForBuildingElements(iBuildingInstance, piValues[iValue], instanceLOD);
+			} // for (int64_t iValue = ...
+		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+
+		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
+	} // while (iProperty != 0)
+}
+
+void _citygml_exporter::searchForProxyBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance, const _city_lod& pathLOD)
+{
+	assert(iBuildingInstance != 0);
+	assert(iInstance != 0);
+
+	getSite()->getMetrics()->onOwlNode();
+
+	_city_lod instanceLOD = getPathLOD(pathLOD, iInstance);
+
+	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
+	while (iProperty != 0)
+	{
+		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		{
+			int64_t iValuesCount = 0;
+			OwlInstance* piValues = nullptr;
+			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+
+			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
+			{
+				if (piValues[iValue] == 0)
+				{
+					continue;
+				}
+
+				if (isBuildingElement(piValues[iValue]))
+				{
+					continue;
+				}
+
+				if (GetInstanceGeometryClass(piValues[iValue]) &&
+					GetBoundingBox(piValues[iValue], nullptr, nullptr))
+				{
+					auto itBuilding = m_mapBuildings.find(iBuildingInstance);
+					if (itBuilding != m_mapBuildings.end())
+					{
+						itBuilding->second.push_back(piValues[iValue]);
+					}
+					else
+					{
+						assert(false); // Internal error!
+					}
+
+					auto itBuildingElement = m_mapBuildingElements.find(piValues[iValue]);
+					if (itBuildingElement == m_mapBuildingElements.end())
+					{
+						m_mapBuildingElements[piValues[iValue]] = vector<OwlInstance>{ piValues[iValue] };
+						addPathLOD(piValues[iValue], getPathLOD(instanceLOD, piValues[iValue]));
+					}
+					else
+					{
+						OwlClass iChildInstanceClass = GetInstanceClass(piValues[iValue]);
+						assert(iChildInstanceClass != 0);
+
+						logClassEvent(enumLogEvent::error, "Duplicated Geometry", iChildInstanceClass);
+					}
+				}
+				else
+				{
+					searchForProxyBuildingElements(iBuildingInstance, piValues[iValue], instanceLOD);
+				}
+			} // for (int64_t iValue = ...
+		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+
+		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
+	} // while (iProperty != 0)
+}
+
+void _citygml_exporter::searchForBuildingElementGeometry(OwlInstance iBuildingInstance, OwlInstance iBuildingElementInstance, OwlInstance iInstance, const _city_lod& pathLOD)
+{
+	assert(iBuildingInstance != 0);
+	assert(iBuildingElementInstance != 0);
+	assert(iInstance != 0);
+
+	getSite()->getMetrics()->onOwlNode();
+
+	updateBuildingHighestLOD(iBuildingInstance, iInstance);
+	_city_lod instanceLOD = getPathLOD(pathLOD, iInstance);
+
+	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
+	while (iProperty != 0)
+	{
+		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		{
+			int64_t iValuesCount = 0;
+			OwlInstance* piValues = nullptr;
+			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+
+			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
+			{
+				if (piValues[iValue] == 0)
+				{
+					continue;
+				}
 
-		vecGeometryInstances.push_back(iShapeRepresentationInstance);
+				if (isBuildingElement(piValues[iValue]))
+				{
+					continue;
+				}
+
+				if (GetInstanceGeometryClass(piValues[iValue]) &&
+					GetBoundingBox(piValues[iValue], nullptr, nullptr))
+				{
+					auto itBuildingElement = m_mapBuildingElements.find(iBuildingElementInstance);
+					if (itBuildingElement != m_mapBuildingElements.end())
+					{
+						itBuildingElement->second.push_back(piValues[iValue]);
+					}
+					else
+					{
+						m_mapBuildingElements[iBuildingElementInstance] = vector<OwlInstance>{ piValues[iValue] };
+					}
+
+					updateBuildingHighestLOD(iBuildingInstance, piValues[iValue]);
+					addPathLOD(piValues[iValue], getPathLOD(instanceLOD, piValues[iValue]));
+				}
+				else
+				{
+					searchForBuildingElementGeometry(iBuildingInstance, iBuildingElementInstance, piValues[iValue], instanceLOD);
+				}
+			} // for (int64_t iValue = ...
+		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+
+		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
+	} // while (iProperty != 0)
+}
+
+// Discovery; the Feature Elements and their geometry, all LODs
+void _citygml_exporter::searchForFeatures()
+{
+	OwlClass iSchemasClass = GetClassByName(getSite()->getOwlModel(), "class:Schemas");
+	assert(iSchemasClass != 0);
+
+	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
+	while (iInstance != 0)
+	{
+		if (getSite()->isCancelled())
+		{
+			return;
+		}
+
+		if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+		{
+			OwlClass iInstanceClass = GetInstanceClass(iInstance);
+			assert(iInstanceClass != 0);
+
+			if (iInstanceClass != iSchemasClass)
+			{
+				if (isFeatureClass(iInstanceClass))
+				{
+					if (m_mapFeatures.find(iInstance) == m_mapFeatures.end())
+					{
+						m_mapFeatures[iInstance] = vector<OwlInstance>();
+
+						_object_metrics_scope objectMetrics(getSite()->getMetrics(), iInstance);
+
+						searchForFeatureElements(iInstance, iInstance, _city_lod());
+					}
+					else
+					{
+						assert(false); // Internal error!
+					}
+				}
+				else
+				{
+					createFeaturesRecursively(iInstance);
+				}
+			}
+		} // if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+
+		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
+	} // while (iInstance != 0)
+
+}
+
+void _citygml_exporter::createFeatures()
+{
+	const auto& vecFeatures = m_pCityModel->getFeatures();
+	if (vecFeatures.empty())
+	{
+		return;
+	}
+
+	map<SdaiInstance, vector<SdaiInstance>> mapSite2Instances;
+	int64_t iDone = 0;
+	for (auto pFeature : vecFeatures)
+	{
+		if (getSite()->isCancelled())
+		{
+			return;
+		}
+
+		getSite()->reportProgress(enumPhase::Features, iDone++, (int64_t)vecFeatures.size());
+
+		_object_metrics_scope objectMetrics(getSite()->getMetrics(), pFeature->m_iInstance);
+
+		getSite()->getMetrics()->onRead(pFeature->m_geometryBuffer.getOwlNodesCount(), pFeature->m_dReadTime);
+
+		if (pFeature->m_vecElements.empty())
+		{
+			continue;
+		}
+
+		createFeature(pFeature, mapSite2Instances);
+	} // for (auto pFeature : ...
+
+	getSite()->reportProgress(enumPhase::Features, iDone, iDone);
+
+	for (const auto& itSite2Instances : mapSite2Instances)
+	{
+		buildRelAggregatesInstance(
+			"SiteContainer",
+			"SiteContainer For Features",
+			itSite2Instances.first,
+			itSite2Instances.second);
+
+		m_vecSiteInstances.push_back(itSite2Instances.first);
+	}
+}
+
+void _citygml_exporter::createFeature(const _city_object* pFeature, map<SdaiInstance, vector<SdaiInstance>>& mapSite2Instances)
+{
+	assert(pFeature != nullptr);
+
+	_auto_var<double> xOffset(m_dXOffset, 0., 0.);
+	_auto_var<double> yOffset(m_dYOffset, 0., 0.);
+	_auto_var<double> zOffset(m_dZOffset, 0., 0.);
+
+	// LODs
+	vector<const _city_element*> vecElements;
+	for (const auto& element : pFeature->m_vecElements)
+	{
+		if (!isElementFiltered(pFeature, element.m_lod))
+		{
+			vecElements.push_back(&element);
+		}
+	}
+
+	if (vecElements.empty())
+	{
+		return;
+	}
+
+	SdaiInstance iSiteInstancePlacement = 0;
+	SdaiInstance iSiteInstance = createSite(pFeature, iSiteInstancePlacement);
+
+	// Geometry
+	vector<SdaiInstance> vecSdaiFeatureElementGeometryInstances;
+	for (auto pElement : vecElements)
+	{
+		_auto_var<enumCityElement> currentElement(m_enCurrentElement, pElement->m_enElement, enumCityElement::Other);
+
+		createElementGeometry(pFeature, *pElement, vecSdaiFeatureElementGeometryInstances);
+	}
+
+	if (vecSdaiFeatureElementGeometryInstances.empty())
+	{
+		assert(false); // Not supported
+
+		return;
+	}
+
+	// Feature
+	_matrix mtxIdentity;
+	SdaiInstance iFeatureInstance = 0;
+	SdaiInstance iFeatureInstancePlacement = 0;
+	switch (pFeature->m_enFeature)
+	{
+		case enumCityFeature::Transportation:
+		{
+			iFeatureInstance = buildTransportElementInstance(
+				pFeature->m_strTag.c_str(),
+				pFeature->m_strClassName.c_str(),
+				&mtxIdentity,
+				iSiteInstancePlacement,
+				iFeatureInstancePlacement,
+				vecSdaiFeatureElementGeometryInstances);
+		}
+		break;
+
+		case enumCityFeature::Geographic:
+		{
+			iFeatureInstance = buildGeographicElementInstance(
+				pFeature->m_strTag.c_str(),
+				pFeature->m_strClassName.c_str(),
+				&mtxIdentity,
+				iSiteInstancePlacement,
+				iFeatureInstancePlacement,
+				vecSdaiFeatureElementGeometryInstances);
+		}
+		break;
+
+		case enumCityFeature::Furniture:
+		{
+			iFeatureInstance = buildFurnitureObjectInstance(
+				pFeature->m_strTag.c_str(),
+				pFeature->m_strClassName.c_str(),
+				&mtxIdentity,
+				iSiteInstancePlacement,
+				iFeatureInstancePlacement,
+				vecSdaiFeatureElementGeometryInstances);
+		}
+		break;
+
+		default:
+		{
+			iFeatureInstance = buildFeatureInstance(
+				pFeature->m_strTag.c_str(),
+				pFeature->m_strClassName.c_str(),
+				&mtxIdentity,
+				iSiteInstancePlacement,
+				iFeatureInstancePlacement,
+				vecSdaiFeatureElementGeometryInstances);
+		}
+		break;
+	} // switch (pFeature->m_enFeature)
+
+	assert(iFeatureInstance != 0);
+
+	createProperties(pFeature, 0, pFeature->m_iAttributesCount, iFeatureInstance);
+
+	auto itSite2Instances = mapSite2Instances.find(iSiteInstance);
+	if (itSite2Instances == mapSite2Instances.end())
+	{
+		mapSite2Instances[iSiteInstance] = vector<SdaiInstance>{ iFeatureInstance };
 	}
 	else
 	{
-		vecGeometryInstances.push_back(iFacetedBrepInstance);
-	}	
+		itSite2Instances->second.push_back(iFeatureInstance);
+	}
 }
 
-void _citygml_exporter::createReferencePointIndicator(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+void _citygml_exporter::createFeaturesRecursively(OwlInstance iInstance)
 {
 	assert(iInstance != 0);
 
-#pragma region Geometry
+	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
+	while (iProperty != 0)
+	{
+		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		{
+			int64_t iValuesCount = 0;
+			OwlInstance* piValues = nullptr;
+			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
 
-	// Matrix
-	OwlInstance* piInstances = nullptr;
-	int64_t iInstancesCount = 0;
-	GetObjectProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "matrix"),
-		&piInstances,
-		&iInstancesCount);
-	assert(iInstancesCount == 1);
+			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
+			{
+				if (piValues[iValue] == 0)
+				{
+					continue;
+				}
 
-	OwlInstance iMatrixInstance = piInstances[0];
-	assert(iMatrixInstance != 0);
+				OwlClass iInstanceClass = GetInstanceClass(piValues[iValue]);
+				assert(iInstanceClass != 0);
 
-	int64_t iValuesCount = 0;
-	double* pdValues = nullptr;
-	GetDatatypeProperty(
-		iMatrixInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "coordinates"),
-		(void**)&pdValues,
-		&iValuesCount);
-	assert(iValuesCount == 12);
+				if (isCityObjectGroupMemberClass(iInstanceClass))
+				{					
+					continue; // Ignore
+				}
 
-	// Cube
-	piInstances = nullptr;
-	iInstancesCount = 0;
-	GetObjectProperty(
-		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "object"),
-		&piInstances,
-		&iInstancesCount);
-	assert(iInstancesCount == 1);
+				if (isFeatureClass(iInstanceClass))
+				{
+					if (m_mapFeatures.find(piValues[iValue]) == m_mapFeatures.end())
+					{
+						m_mapFeatures[piValues[iValue]] = vector<OwlInstance>();
+
+						_object_metrics_scope objectMetrics(getSite()->getMetrics(), piValues[iValue]);
+
+						searchForFeatureElements(piValues[iValue], piValues[iValue], _city_lod());
+					}
+				}
+				else
+				{
+					createFeaturesRecursively(piValues[iValue]);
+				}
+			} // for (int64_t iValue = ...
+		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+
+		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
+	} // while (iProperty != 0)
+}
+
+void _citygml_exporter::searchForFeatureElements(OwlInstance iFeatureInstance, OwlInstance iInstance, const _city_lod& pathLOD)
+{
+	assert(iFeatureInstance != 0);
+	assert(iInstance != 0);
+
+	getSite()->getMetrics()->onOwlNode();
+
+	// All LODs; the LOD selection is applied on emission (see isElementFiltered())
+	updateFeatureHighestLOD(iFeatureInstance, iInstance);
+	_city_lod instanceLOD = getPathLOD(pathLOD, iInstance);
+
+	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
+	while (iProperty != 0)
+	{
+		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		{
+			int64_t iValuesCount = 0;
+			OwlInstance* piValues = nullptr;
+			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
 
-	OwlInstance iCubeInstance = piInstances[0];
-	assert(iCubeInstance != 0);
+			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
+			{
+				if (piValues[iValue] == 0)
+				{
+					continue;
+				}
 
-	float fBoundingSphereDiameter = m_fXmax - m_fXmin;
-	fBoundingSphereDiameter = max(fBoundingSphereDiameter, m_fYmax - m_fYmin);
-	fBoundingSphereDiameter = max(fBoundingSphereDiameter, m_fZmax - m_fZmin);
-	float fCubeLength = fBoundingSphereDiameter / 150.f;	
+				if (GetInstanceGeometryClass(piValues[iValue]) &&
+					GetBoundingBox(piValues[iValue], nullptr, nullptr))
+				{
+					auto itFeature = m_mapFeatures.find(iFeatureInstance);
+					if (itFeature != m_mapFeatures.end())
+					{
+						itFeature->second.push_back(piValues[iValue]);
+					}
+					else
+					{
+						assert(false); // Internal error!
+					}
 
-	/*
-	Front
-	X3 -- X2
-	 |    |	
-	X0 -- X1
+					updateFeatureHighestLOD(iFeatureInstance, piValues[iValue]);
 
-	Back
-	X7 -- X6
-	 |    |
-	X4 -- X5
-	*/
-	vector<double> vecVertices
-	{
-		// front
-		pdValues[9], pdValues[10], pdValues[11], // X0
-		pdValues[9] + fCubeLength, pdValues[10], pdValues[11], // X1
-		pdValues[9] + fCubeLength, pdValues[10] + fCubeLength, pdValues[11], // X2
-		pdValues[9], pdValues[10] + fCubeLength, pdValues[11], // X3
-		// back
-		pdValues[9], pdValues[10], pdValues[11] + fCubeLength, // X4
-		pdValues[9] + fCubeLength, pdValues[10], pdValues[11] + fCubeLength, // X5
-		pdValues[9] + fCubeLength, pdValues[10] + fCubeLength, pdValues[11] + fCubeLength, // X6
-		pdValues[9], pdValues[10] + fCubeLength, pdValues[11] + fCubeLength, // X7
-	};
+					auto itFeatureElement = m_mapFeatureElements.find(piValues[iValue]);
+					if (itFeatureElement == m_mapFeatureElements.end())
+					{
+						m_mapFeatureElements[piValues[iValue]] = vector<OwlInstance>{ piValues[iValue] };
+						addPathLOD(piValues[iValue], getPathLOD(instanceLOD, piValues[iValue]));
+					}
+					else
+					{
+						OwlClass iChildInstanceClass = GetInstanceClass(piValues[iValue]);
+						assert(iChildInstanceClass != 0);
 
-	map<int64_t, SdaiInstance> mapIndex2Instance;
+						logClassEvent(enumLogEvent::error, "Duplicated Geometry", iChildInstanceClass);
+					}
+				}
+				else
+				{
+					searchForFeatureElements(iFeatureInstance, piValues[iValue], instanceLOD);
+				}
+			} // for (int64_t iValue = ...
+		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
 
-	// Front
-	// 0
-	mapIndex2Instance[0] = buildCartesianPointInstance(
-		vecVertices[(0 * 3) + 0],
-		vecVertices[(0 * 3) + 1],
-		vecVertices[(0 * 3) + 2]);
-	// 1
-	mapIndex2Instance[1] = buildCartesianPointInstance(
-		vecVertices[(1 * 3) + 0],
-		vecVertices[(1 * 3) + 1],
-		vecVertices[(1 * 3) + 2]);
-	// 2
-	mapIndex2Instance[2] = buildCartesianPointInstance(
-		vecVertices[(2 * 3) + 0],
-		vecVertices[(2 * 3) + 1],
-		vecVertices[(2 * 3) + 2]);
-	// 3
-	mapIndex2Instance[3] = buildCartesianPointInstance(
-		vecVertices[(3 * 3) + 0],
-		vecVertices[(3 * 3) + 1],
-		vecVertices[(3 * 3) + 2]);
-		
-	// Back
-	// 4
-	mapIndex2Instance[4] = buildCartesianPointInstance(
-		vecVertices[(4 * 3) + 0],
-		vecVertices[(4 * 3) + 1],
-		vecVertices[(4 * 3) + 2]);
-	// 5
-	mapIndex2Instance[5] = buildCartesianPointInstance(
-		vecVertices[(5 * 3) + 0],
-		vecVertices[(5 * 3) + 1],
-		vecVertices[(5 * 3) + 2]);
-	// 6
-	mapIndex2Instance[6] = buildCartesianPointInstance(
-		vecVertices[(6 * 3) + 0],
-		vecVertices[(6 * 3) + 1],
-		vecVertices[(6 * 3) + 2]);
-	// 7
-	mapIndex2Instance[7] = buildCartesianPointInstance(
-		vecVertices[(7 * 3) + 0],
-		vecVertices[(7 * 3) + 1],
-		vecVertices[(7 * 3) + 2]);
+		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
+	} // while (iProperty != 0)
+}
 
-#pragma endregion // Geometry
+void _citygml_exporter::createElementGeometry(const _city_object* pObject, const _city_element& element, vector<SdaiInstance>& vecGeometryInstances)
+{
+	assert(pObject != nullptr);
 
-	vector<SdaiInstance> vecPolyLoopInstances;
+	const auto pGeometryBuffer = &pObject->m_geometryBuffer;
 
-	// Front
-	// 0, 1, 2, 3
-	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
+	for (int64_t iElementGeometry = element.m_iFirstGeometry; iElementGeometry < element.m_iFirstGeometry + element.m_iGeometriesCount; iElementGeometry++)
+	{
+		const auto& lod = pObject->m_vecGeometryLODs[iElementGeometry];
 
-	SdaiAggr pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(0));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(1));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(2));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(3));
+		// An element of the same LOD (Feature) is filtered already
+		if ((pObject->m_enObject == enumCityObject::Building) && isElementFiltered(pObject, lod))
+		{
+			continue;
+		}
 
-	// Front
-	// 4, 5, 6, 7
-	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
+		if (getAllLODs())
+		{
+			setRepresentationContextInstance(getRepresentationSubContextInstance(m_pCityModel->getLOD(lod.m_iLOD)));
+		}
 
-	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(4));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(5));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(6));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(7));
+		int64_t iFirstRoot = 0;
+		int64_t iEndRoot = 0;
+		pGeometryBuffer->getRoots(iElementGeometry, iFirstRoot, iEndRoot);
 
-	// Left
-	// 4, 0, 3, 7
-	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
+		for (int64_t iRoot = iFirstRoot; iRoot < iEndRoot; iRoot++)
+		{
+			createGeometry(pGeometryBuffer, pGeometryBuffer->getRoot(iRoot), vecGeometryInstances, true);
+		}
 
-	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(4));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(0));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(3));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(7));
+		setRepresentationContextInstance(0);
+	} // for (int64_t iElementGeometry = ...
+}
 
-	// Right
-	// 1, 5, 6, 2
-	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
+void _citygml_exporter::createGeometry(const _geometry_buffer* pGeometryBuffer, int64_t iGeometry, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+{
+	assert(pGeometryBuffer != nullptr);
 
-	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(1));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(5));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(6));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(2));
+	const auto& geometry = pGeometryBuffer->getGeometry(iGeometry);
+	switch (geometry.m_enGeometry)
+	{
+		case enumGeometry::BoundaryRepresentation:
+		{
+			createBoundaryRepresentation(pGeometryBuffer, geometry, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		}
+		break;
 
-	// Top
-	// 3, 2, 6, 7
-	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
+		case enumGeometry::PolyLine:
+		{
+			createPolyLine3D(pGeometryBuffer, geometry, vecGeometryInstances, bCreateIfcShapeRepresentation);
+		}
+		break;
 
-	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(3));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(2));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(6));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(7));
+		case enumGeometry::MappedItem:
+		{
+			createMappedItem(pGeometryBuffer, geometry, vecGeometryInstances);
+		}
+		break;
 
-	// Bottom
-	// 0, 1, 5, 4
-	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
+		default:
+		{
+			assert(false); // Internal error!
+		}
+		break;
+	} // switch (geometry.m_enGeometry)
+}
 
-	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(0));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(1));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(5));
-	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(4));
+void _citygml_exporter::readGeometry(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
+{
+	assert(pGeometryBuffer != nullptr);
+	assert(iInstance != 0);
 
-	SdaiInstance iClosedShellInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcClosedShell");
-	assert(iClosedShellInstance != 0);
+	pGeometryBuffer->onOwlNode();
 
-	SdaiAggr pCfsFaces = sdaiCreateAggrBN(iClosedShellInstance, "CfsFaces");
-	assert(pCfsFaces != nullptr);
+	OwlClass iInstanceClass = GetInstanceClass(iInstance);
+	assert(iInstanceClass != 0);
 
-	for (auto iPolyLoopInstance : vecPolyLoopInstances)
+	if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:MultiSurfaceType"))
 	{
-		// Outer Polygon
-		SdaiInstance iFaceOuterBoundInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFaceOuterBound");
-		assert(iFaceOuterBoundInstance != 0);
+		readMultiSurface(pGeometryBuffer, iInstance, vecGeometries);
+	}
+	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SolidType"))
+	{
+		readSolid(pGeometryBuffer, iInstance, vecGeometries);
+	}
+	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSolidType"))
+	{
+		readCompositeSolid(pGeometryBuffer, iInstance, vecGeometries);
+	}
+	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "BoundaryRepresentation"))
+	{
+		readBoundaryRepresentation(pGeometryBuffer, iInstance, vecGeometries);
+	}
+	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "Point3D"))
+	{
+		//#todo
+		//createPoint3D(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+	}
+	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "Point3DSet"))
+	{
+		//#todo
+		//createPoint3DSet(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+	}
+	else if (iInstanceClass == GetClassByName(getSite()->getOwlModel(), "PolyLine3D"))
+	{
+		readPolyLine3D(pGeometryBuffer, iInstance, vecGeometries);
+	}
+	else if (isCollectionClass(iInstanceClass))
+	{
+		OwlInstance* piInstances = nullptr;
+		int64_t iInstancesCount = 0;
+		GetObjectProperty(
+			iInstance,
+			GetPropertyByName(getSite()->getOwlModel(), "objects"),
+			&piInstances,
+			&iInstancesCount);
 
-		sdaiPutAttrBN(iFaceOuterBoundInstance, "Bound", sdaiINSTANCE, (void*)iPolyLoopInstance);
-		sdaiPutAttrBN(iFaceOuterBoundInstance, "Orientation", sdaiENUM, "T");
+		for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
+		{
+			readGeometry(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+	}
+	else if (isReferencePointIndicatorClass(iInstanceClass))
+	{
+		//#todo
+		//createReferencePointIndicator(iInstance, vecGeometryInstances, bCreateIfcShapeRepresentation);
+	}
+	else if (isTransformationClass(iInstanceClass))
+	{
+		readMappedItem(pGeometryBuffer, iInstance, vecGeometries);
+	}
+	else
+	{
+		logClassEvent(enumLogEvent::error, "Geometry is not supported", iInstanceClass);
+	}
+}
 
-		SdaiInstance iFaceInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFace");
-		assert(iFaceInstance != 0);
+void _citygml_exporter::readSolid(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
+{
+	assert(pGeometryBuffer != nullptr);
+	assert(iInstance != 0);
+
+	OwlInstance* piInstances = nullptr;
+	int64_t iInstancesCount = 0;
+	GetObjectProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "objects"),
+		&piInstances,
+		&iInstancesCount);
 
-		SdaiAggr pBounds = sdaiCreateAggrBN(iFaceInstance, "Bounds");
-		sdaiAppend(pCfsFaces, sdaiINSTANCE, (void*)iFaceInstance);
+	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
+	{
+		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
+		assert(iChildInstanceClass != 0);
 
-		sdaiAppend(pBounds, sdaiINSTANCE, (void*)iFaceOuterBoundInstance);
-	} // auto iPolyLoopInstance : ...
+		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SolidType"))
+		{
+			readSolid(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSurfaceType"))
+		{
+			readCompositeSurface(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:ShellType"))
+		{
+			readMultiSurface(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else
+		{
+			//#todo
+			logClassEvent(enumLogEvent::error, "Geometry is not supported", iChildInstanceClass);
+		}
+	} // for (int64_t iInstanceIndex = ...
+}
 
-	SdaiInstance iFacetedBrepInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFacetedBrep");
-	assert(iFacetedBrepInstance != 0);
+void _citygml_exporter::readCompositeSolid(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
+{
+	readMultiSolid(pGeometryBuffer, iInstance, vecGeometries);
+}
 
-	sdaiPutAttrBN(iFacetedBrepInstance, "Outer", sdaiINSTANCE, (void*)iClosedShellInstance);
+void _citygml_exporter::readMultiSolid(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
+{
+	assert(pGeometryBuffer != nullptr);
+	assert(iInstance != 0);
 
-	createStyledItemInstance(iCubeInstance, iFacetedBrepInstance);
+	OwlInstance* piInstances = nullptr;
+	int64_t iInstancesCount = 0;
+	GetObjectProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "objects"),
+		&piInstances,
+		&iInstancesCount);
 
-	if (bCreateIfcShapeRepresentation)
+	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
 	{
-		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
-		assert(iShapeRepresentationInstance != 0);
+		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
+		assert(iChildInstanceClass != 0);
 
-		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
-		assert(pItems != 0);
+		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SolidType"))
+		{
+			readSolid(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else
+		{
+			//#todo
+			logClassEvent(enumLogEvent::error, "Geometry is not supported", iChildInstanceClass);
+		}
+	} // for (int64_t iInstanceIndex = ...
+}
 
-		sdaiAppend(pItems, sdaiINSTANCE, (void*)iFacetedBrepInstance);
+void _citygml_exporter::readMultiSurface(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
+{
+	assert(pGeometryBuffer != nullptr);
+	assert(iInstance != 0);
 
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "Brep");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+	OwlInstance* piInstances = nullptr;
+	int64_t iInstancesCount = 0;
+	GetObjectProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "objects"),
+		&piInstances,
+		&iInstancesCount);
 
-		vecGeometryInstances.push_back(iShapeRepresentationInstance);
-	}
-	else
+	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
 	{
-		vecGeometryInstances.push_back(iFacetedBrepInstance);
-	}
+		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
+		assert(iChildInstanceClass != 0);
+
+		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSurfaceType"))
+		{
+			readCompositeSurface(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else if ((iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SurfacePropertyType")) ||
+			(iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SurfaceType")))
+		{
+			readSurfaceMember(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "BoundaryRepresentation"))
+		{
+			readBoundaryRepresentation(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else 
+		{
+			//#todo
+			logClassEvent(enumLogEvent::error, "Geometry is not supported", iChildInstanceClass);
+		}
+	} // for (int64_t iInstanceIndex = ...
 }
 
-void _citygml_exporter::createPoint3D(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+void _citygml_exporter::readCompositeSurface(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
 {
+	assert(pGeometryBuffer != nullptr);
 	assert(iInstance != 0);
 
-	int64_t iValuesCount = 0;
-	double* pdValue = nullptr;
-	GetDatatypeProperty(
+	OwlInstance* piInstances = nullptr;
+	int64_t iInstancesCount = 0;
+	GetObjectProperty(
 		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "points"),
-		(void**)&pdValue,
-		&iValuesCount);
-
-	assert(iValuesCount == 3);
-
-	SdaiInstance iCartesianPointInstance = buildCartesianPointInstance(
-		pdValue[0] - m_dXOffset,
-		pdValue[1] - m_dYOffset,
-		pdValue[2] - m_dZOffset);
-	assert(iCartesianPointInstance != 0);
+		GetPropertyByName(getSite()->getOwlModel(), "objects"),
+		&piInstances,
+		&iInstancesCount);
 
-	if (bCreateIfcShapeRepresentation)
+	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
 	{
-		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
-		assert(iShapeRepresentationInstance != 0);
+		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
+		assert(iChildInstanceClass != 0);
 
-		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
-		assert(pItems != 0);
+		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSurfaceType"))
+		{
+			readCompositeSurface(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:OrientableSurfaceType"))
+		{
+			//#todo
+			getSite()->logErr("Geometry is not supported: 'class:OrientableSurfaceType'");
+		}
+		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:SurfacePropertyType"))
+		{
+			readSurfaceMember(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "BoundaryRepresentation"))
+		{
+			readBoundaryRepresentation(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else
+		{
+			//#todo
+			logClassEvent(enumLogEvent::error, "Geometry is not supported", iChildInstanceClass);
+		}
+	} // for (int64_t iInstanceIndex = ...
+}
 
-		sdaiAppend(pItems, sdaiINSTANCE, (void*)iCartesianPointInstance);
+void _citygml_exporter::readSurfaceMember(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
+{
+	assert(pGeometryBuffer != nullptr);
+	assert(iInstance != 0);
 
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "PointCloud");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+	OwlInstance* piInstances = nullptr;
+	int64_t iInstancesCount = 0;
+	GetObjectProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "objects"),
+		&piInstances,
+		&iInstancesCount);
 
-		vecGeometryInstances.push_back(iShapeRepresentationInstance);
-	}
-	else
+	for (int64_t iInstanceIndex = 0; iInstanceIndex < iInstancesCount; iInstanceIndex++)
 	{
-		vecGeometryInstances.push_back(iCartesianPointInstance);
-	}	
+		OwlClass iChildInstanceClass = GetInstanceClass(piInstances[iInstanceIndex]);
+		assert(iChildInstanceClass != 0);
+
+		if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "class:CompositeSurfaceType"))
+		{
+			readCompositeSurface(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else if (iChildInstanceClass == GetClassByName(getSite()->getOwlModel(), "BoundaryRepresentation"))
+		{
+			readBoundaryRepresentation(pGeometryBuffer, piInstances[iInstanceIndex], vecGeometries);
+		}
+		else
+		{
+			//#todo
+			logClassEvent(enumLogEvent::error, "Geometry is not supported", iChildInstanceClass);
+		}
+	} // for (int64_t iInstanceIndex = ...
 }
 
-void _citygml_exporter::createPoint3DSet(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+void _citygml_exporter::readBoundaryRepresentation(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
 {
+	assert(pGeometryBuffer != nullptr);
 	assert(iInstance != 0);
 
-	int64_t iValuesCount = 0;
+	// Indices
+	int64_t* piIndices = nullptr;
+	int64_t iIndicesCount = 0;
+	GetDatatypeProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "indices"),
+		(void**)&piIndices,
+		&iIndicesCount);
+
+	// Vertices
 	double* pdValue = nullptr;
+	int64_t iVerticesCount = 0;
 	GetDatatypeProperty(
 		iInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "points"),
+		GetPropertyByName(getSite()->getOwlModel(), "vertices"),
 		(void**)&pdValue,
-		&iValuesCount);
-
-	assert(iValuesCount >= 3);
-
-	if (bCreateIfcShapeRepresentation)
-	{
-		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
-		assert(iShapeRepresentationInstance != 0);
+		&iVerticesCount);
 
-		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
-		assert(pItems != 0);
+	// The faces are built after the engine data is read (see readCityObject())
+	int64_t iGeometry = pGeometryBuffer->addGeometry(enumGeometry::BoundaryRepresentation, iInstance);
+	int64_t iFirstVertex = pGeometryBuffer->addVertices(pdValue, iVerticesCount);
+	pGeometryBuffer->addFaces(iGeometry, piIndices, iIndicesCount, iFirstVertex);
 
-		for (int64_t iValue = 0; iValue < iValuesCount; iValue += 3)
-		{
-			SdaiInstance iCartesianPointInstance = buildCartesianPointInstance(
-				pdValue[iValue + 0] - m_dXOffset,
-				pdValue[iValue + 1] - m_dYOffset,
-				pdValue[iValue + 2] - m_dZOffset);
-			assert(iCartesianPointInstance != 0);
+	// Material; read once per buffer
+	OwlInstance* piMaterials = nullptr;
+	int64_t iMaterialsCount = 0;
+	GetObjectProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "material"),
+		&piMaterials,
+		&iMaterialsCount);
 
-			sdaiAppend(pItems, sdaiINSTANCE, (void*)iCartesianPointInstance);
-		} // for (int64_t iValue = ...
+	assert(iMaterialsCount == 1);
 
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "PointCloud");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+	int64_t iMaterial = pGeometryBuffer->findMaterial(piMaterials[0]);
+	if (iMaterial == -1)
+	{
+		_geometry_material material;
+		readMaterial(iInstance, material);
 
-		vecGeometryInstances.push_back(iShapeRepresentationInstance);
+		iMaterial = pGeometryBuffer->addMaterial(piMaterials[0], material);
 	}
-	else
-	{
-		for (int64_t iValue = 0; iValue < iValuesCount; iValue += 3)
-		{
-			SdaiInstance iCartesianPointInstance = buildCartesianPointInstance(
-				pdValue[iValue + 0] - m_dXOffset,
-				pdValue[iValue + 1] - m_dYOffset,
-				pdValue[iValue + 2] - m_dZOffset);
-			assert(iCartesianPointInstance != 0);
 
-			vecGeometryInstances.push_back(iCartesianPointInstance);
-		} // for (int64_t iValue = ...
-	}	
+	pGeometryBuffer->getGeometry(iGeometry).m_iMaterial = iMaterial;
+
+	vecGeometries.push_back(iGeometry);
 }
 
-void _citygml_exporter::createPolyLine3D(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+void _citygml_exporter::readPolyLine3D(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
 {
+	assert(pGeometryBuffer != nullptr);
 	assert(iInstance != 0);
 
 	int64_t iValuesCount = 0;
@@ -5161,1738 +6738,1636 @@ void _citygml_exporter::createPolyLine3D(OwlInstance iInstance, vector<SdaiInsta
 		(void**)&pdValue,
 		&iValuesCount);
 
-	assert(iValuesCount >= 6);
-
-	SdaiInstance iPolyLineInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyline");
-	assert(iPolyLineInstance != 0);
-
-	SdaiAggr pPoints = sdaiCreateAggrBN(iPolyLineInstance, "Points");
-	assert(pPoints != nullptr);
-
-	for (int64_t iValue = 0; iValue < iValuesCount; iValue += 3)
-	{
-		SdaiInstance iCartesianPointInstance = buildCartesianPointInstance(
-			pdValue[iValue + 0] - m_dXOffset,
-			pdValue[iValue + 1] - m_dYOffset,
-			pdValue[iValue + 2] - m_dZOffset);
-		assert(iCartesianPointInstance != 0);
-
-		sdaiAppend(pPoints, sdaiINSTANCE, (void*)iCartesianPointInstance);
-	} // for (int64_t iValue = ...
-
-	if (bCreateIfcShapeRepresentation)
-	{
-		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
-		assert(iShapeRepresentationInstance != 0);
-
-		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
-		assert(pItems != 0);
-
-		sdaiAppend(pItems, sdaiINSTANCE, (void*)iPolyLineInstance);
+	assert(iValuesCount >= 6);
 
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "Curve3D");
-		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getGeometricRepresentationContextInstance());
+	int64_t iGeometry = pGeometryBuffer->addGeometry(enumGeometry::PolyLine, iInstance);
+	int64_t iFirstVertex = pGeometryBuffer->addVertices(pdValue, iValuesCount);
 
-		vecGeometryInstances.push_back(iShapeRepresentationInstance);
-	}
-	else
-	{
-		vecGeometryInstances.push_back(iPolyLineInstance);
-	}	
+	auto& geometry = pGeometryBuffer->getGeometry(iGeometry);
+	geometry.m_iFirst = iFirstVertex;
+	geometry.m_iCount = iValuesCount / 3;
+
+	vecGeometries.push_back(iGeometry);
 }
 
-void _citygml_exporter::createProperties(OwlInstance iOwlInstance, SdaiInstance iSdaiInstance)
+void _citygml_exporter::readMappedItem(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries)
 {
-	assert(iOwlInstance != 0);
-	assert(iSdaiInstance != 0);
+	assert(pGeometryBuffer != nullptr);
+	assert(iInstance != 0);
 
-	// Property Set : Properties
-	map<string, vector<SdaiInstance>> mapPropertySets;
+	// Reference Point (Anchor) Transformation
+	OwlInstance iReferencePointTransformationInstance = iInstance;
 
-	RdfProperty iPropertyInstance = GetInstancePropertyByIterator(iOwlInstance, 0);
-	while (iPropertyInstance != 0)
+	// Reference Point Transformation - matrix
+	OwlInstance* piInstances = nullptr;
+	int64_t iInstancesCount = 0;
+	GetObjectProperty(
+		iReferencePointTransformationInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "matrix"),
+		&piInstances,
+		&iInstancesCount);
+	assert(iInstancesCount == 1);
+
+	OwlInstance iReferencePointMatrixInstance = piInstances[0];
+	assert(iReferencePointMatrixInstance != 0);	
+
+	// Transformation Matrix Transformation
+	piInstances = nullptr;
+	iInstancesCount = 0;
+	GetObjectProperty(
+		iReferencePointTransformationInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "object"),
+		&piInstances,
+		&iInstancesCount);
+	assert(iInstancesCount == 1);
+
+	OwlInstance iTransformationMatrixTransformationInstance = piInstances[0];
+	assert(iTransformationMatrixTransformationInstance != 0);
+
+	if (!isTransformationClass(GetInstanceClass(iTransformationMatrixTransformationInstance)))
 	{
-		char* szPropertyUniqueName = nullptr;
-		GetNameOfProperty(iPropertyInstance, &szPropertyUniqueName);
+		wchar_t* szClassName = nullptr;
+		GetNameOfClassW(GetInstanceClass(iTransformationMatrixTransformationInstance), &szClassName);
 
-		string strPropertyUniqueName = szPropertyUniqueName;
-		
-		if (strPropertyUniqueName.find("prop:") == 0)
+		if (wstring(szClassName) != L"Cube")
 		{
-			// Properties
-			switch (GetPropertyType(iPropertyInstance))
-			{
-				case DATATYPEPROPERTY_TYPE_DOUBLE:
-				{
-					string strPropertyName = strPropertyUniqueName.replace(0, string("prop:dbl:").size(), "");
+			string strEvent = "Internal error; expected 'Cube': '";
+			strEvent += CW2A(szClassName);
+			strEvent += "'";
+			getSite()->logErr(strEvent);
+		}
 
-					string strPrefix;
-					string strName;
-					getXMLElementPrefixAndName(strPropertyName, strPrefix, strName);
+		return;
+	} // if (!isTransformationClass( ...
 
-					auto pProperty = getSite()->getProperty(strName);
-					assert(pProperty != nullptr);
+	// Transformation Matrix Transformation - matrix
+	piInstances = nullptr;
+	iInstancesCount = 0;
+	GetObjectProperty(
+		iTransformationMatrixTransformationInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "matrix"),
+		&piInstances,
+		&iInstancesCount);
+	assert(iInstancesCount == 1);
 
-					strPropertyName = pProperty->getOverrideName();
+	OwlInstance iTransformationMatrixInstance = piInstances[0];
+	assert(iTransformationMatrixInstance != 0);
 
-					double* pdValues = nullptr;
-					int64_t iValuesCount = 0;
-					GetDatatypeProperty(iOwlInstance, iPropertyInstance, (void**)&pdValues, &iValuesCount);					
+	// Reference Point Transformation - object
+	piInstances = nullptr;
+	iInstancesCount = 0;
+	GetObjectProperty(
+		iTransformationMatrixTransformationInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "object"),
+		&piInstances,
+		&iInstancesCount);
+	assert(iInstancesCount == 1);
 
-					SdaiInstance iPropertyInstance = 0;
-					if (iValuesCount == 1)
-					{
-						if (!pProperty->getType().empty())
-						{
-							if ((pProperty->getType() == "IFCREAL") ||
-								(pProperty->getType() == "IFCAREAMEASURE"))
-							{
-								iPropertyInstance = buildPropertySingleValueReal(
-									strPropertyName.c_str(),
-									"property",
-									pdValues[0],
-									pProperty->getType().c_str());
-							}
-							else if ((pProperty->getType() == "IFCINTEGER") ||
-								(pProperty->getType() == "IFCLENGTHMEASURE"))
-							{
-								iPropertyInstance = buildPropertySingleValueInt(
-									strPropertyName.c_str(),
-									"property",
-									(int64_t)pdValues[0],
-									pProperty->getType().c_str());
-							}
-							else
-							{
-								assert(false);
-							}
-						} // if (!pProperty->getType().empty())
-						else
-						{
-							iPropertyInstance = buildPropertySingleValueReal(
-								strPropertyName.c_str(),
-								"property",
-								pdValues[0],
-								"IFCREAL");
-						}
-					} // if (iValuesCount == 1)
-					else
-					{
-						wstring strValue;
-						for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-						{
-							if (!strValue.empty())
-							{
-								strValue += L", ";
-							}
+	OwlInstance iRelativeGMLGeometryInstance = piInstances[0];
+	assert(iRelativeGMLGeometryInstance != 0);
 
-							strValue += to_wstring(pdValues[iValue]);
-						}
-#ifdef _WINDOWS
-						auto iLength = std::char_traits<char16_t>::length((char16_t*)strValue.c_str());
+	assert(isCollectionClass(GetInstanceClass(iRelativeGMLGeometryInstance)));
 
-						u16string strValueU16;
-						strValueU16.resize(iLength);
-						memcpy((void*)strValueU16.data(), strValue.data(), iLength * sizeof(char16_t));
+	piInstances = nullptr;
+	iInstancesCount = 0;
+	GetObjectProperty(
+		iRelativeGMLGeometryInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "objects"),
+		&piInstances,
+		&iInstancesCount);
+	assert(iInstancesCount == 1);
 
-						iPropertyInstance = buildPropertySingleValueText(
-							strPropertyName.c_str(),
-							"property",
-							To_UTF8(strValueU16).c_str(),
-							"IFCTEXT");
-#else
-						auto iLength = std::char_traits<wchar_t>::length((wchar_t*)strValue.c_str());
+	OwlInstance iMappedItemGeometryInstance = piInstances[0];
+	assert(iMappedItemGeometryInstance != 0);
 
-						u32string strValueU32;
-						strValueU32.resize(iLength);
-						memcpy((void*)strValueU32.data(), strValue.data(), iLength * sizeof(wchar_t));
+	// The mapped geometry is read once per buffer
+	int64_t iGeometry = pGeometryBuffer->addGeometry(enumGeometry::MappedItem, iMappedItemGeometryInstance);
 
-						iPropertyInstance = buildPropertySingleValueText(
-							strPropertyName.c_str(),
-							"property",
-							To_UTF8(strValueU32).c_str(),
-							"IFCTEXT");
-#endif // _WINDOWS
-					} // else if (iValuesCount == 1)					
+	int64_t iMappedItem = pGeometryBuffer->findMappedItem(iMappedItemGeometryInstance);
+	if (iMappedItem == -1)
+	{
+		vector<int64_t> vecChildren;
+		readGeometry(pGeometryBuffer, iMappedItemGeometryInstance, vecChildren);
 
-					auto itPropertySet = mapPropertySets.find(pProperty->getPropertySet());
-					if (itPropertySet != mapPropertySets.end())
-					{
-						itPropertySet->second.push_back(iPropertyInstance);
-					}
-					else
-					{
-						mapPropertySets[pProperty->getPropertySet()] = vector<SdaiInstance>{ iPropertyInstance };
-					}
-				}
-				break;
+		pGeometryBuffer->addChildren(iGeometry, vecChildren);
+		pGeometryBuffer->setMappedItem(iMappedItemGeometryInstance, iGeometry);
+	}
+	else
+	{
+		pGeometryBuffer->getGeometry(iGeometry).m_iFirst = pGeometryBuffer->getGeometry(iMappedItem).m_iFirst;
+		pGeometryBuffer->getGeometry(iGeometry).m_iCount = pGeometryBuffer->getGeometry(iMappedItem).m_iCount;
+	}
 
-				case DATATYPEPROPERTY_TYPE_WCHAR_T_ARRAY:
-				{
-					string strPropertyName = strPropertyUniqueName.replace(0, string("prop:str:").size(), "");
+	// Matrices
+	double* pdReferencePointMatrix = nullptr;
+	int64_t iValuesCount = 0;
+	GetDatatypeProperty(
+		iReferencePointMatrixInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "coordinates"),
+		(void**)&pdReferencePointMatrix,
+		&iValuesCount);
 
-					string strPrefix;
-					string strName;
-					getXMLElementPrefixAndName(strPropertyName, strPrefix, strName);
+	assert(iValuesCount == 12);
 
-					auto pProperty = getSite()->getProperty(strName);
-					assert(pProperty != nullptr);
+	double* pdTransformationMatrix = nullptr;
+	iValuesCount = 0;
+	GetDatatypeProperty(
+		iTransformationMatrixInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "coordinates"),
+		(void**)&pdTransformationMatrix,
+		&iValuesCount);
 
-					strPropertyName = pProperty->getOverrideName();
+	assert(iValuesCount == 12);
 
-					SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, false);
+	auto& geometry = pGeometryBuffer->getGeometry(iGeometry);
+	geometry.m_iMatrix = pGeometryBuffer->addMatrix(pdReferencePointMatrix);
+	pGeometryBuffer->addMatrix(pdTransformationMatrix);
 
-					wchar_t** szValue = nullptr;
-					int64_t iValuesCount = 0;
-					GetDatatypeProperty(iOwlInstance, iPropertyInstance, (void**)&szValue, &iValuesCount);
-					assert(iValuesCount == 1);
+	vecGeometries.push_back(iGeometry);
+}
 
-					SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, true);
-#ifdef _WINDOWS
-					auto iLength = std::char_traits<char16_t>::length((char16_t*)*szValue);
+void _citygml_exporter::createBoundaryRepresentation(const _geometry_buffer* pGeometryBuffer, const _geometry& geometry, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
+{
+	assert(pGeometryBuffer != nullptr);
+	assert(geometry.m_enGeometry == enumGeometry::BoundaryRepresentation);
 
-					u16string strValueU16;
-					strValueU16.resize(iLength);
-					memcpy((void*)strValueU16.data(), szValue[0], iLength * sizeof(char16_t));
+	// Polygons; a face is an Outer Polygon followed by the Inner Polygons
+	vector<SdaiInstance> vecPolygons;
+	map<int64_t, SdaiInstance> mapIndex2Instance;
+	for (int64_t iFace = geometry.m_iFirst; iFace < geometry.m_iFirst + geometry.m_iCount; iFace++)
+	{
+		int64_t iFirstRing = 0;
+		int64_t iEndRing = 0;
+		pGeometryBuffer->getFaceRings(iFace, iFirstRing, iEndRing);
 
-					SdaiInstance iPropertyInstance = 0;
-					if (!pProperty->getType().empty())
-					{
-						if ((pProperty->getType() == "IFCTEXT") ||
-							(pProperty->getType() == "IFCIDENTIFIER"))
-						{
-							iPropertyInstance = buildPropertySingleValueText(
-								strPropertyName.c_str(),
-								"property",
-								To_UTF8(strValueU16).c_str(),
-								pProperty->getType().c_str());
-						}
-						else
-						{
-							assert(false);
-						}
-					} // if (!pProperty->getType().empty())
-					else
-					{
-						iPropertyInstance = buildPropertySingleValueText(
-							strPropertyName.c_str(),
-							"property",
-							To_UTF8(strValueU16).c_str(),
-							"IFCTEXT");
-					}
-#else
-					auto iLength = std::char_traits<wchar_t>::length((wchar_t*)*szValue);
+		for (int64_t iRing = iFirstRing; iRing < iEndRing; iRing++)
+		{
+			int64_t iFirstIndex = 0;
+			int64_t iEndIndex = 0;
+			pGeometryBuffer->getRingIndices(iRing, iFirstIndex, iEndIndex);
 
-					u32string strValueU32;
-					strValueU32.resize(iLength);
-					memcpy((void*)strValueU32.data(), szValue[0], iLength * sizeof(wchar_t));
+			for (int64_t iIndex = iFirstIndex; iIndex < iEndIndex; iIndex++)
+			{
+				int64_t iVertex = pGeometryBuffer->getRingIndex(iIndex);
+				if (mapIndex2Instance.find(iVertex) == mapIndex2Instance.end())
+				{
+					const double* pdVertex = pGeometryBuffer->getVertex(iVertex);
 
-					SdaiInstance iPropertyInstance = 0;
-					if (!pProperty->getType().empty())
-					{
-						if ((pProperty->getType() == "IFCTEXT") ||
-							(pProperty->getType() == "IFCIDENTIFIER"))
-						{
-							iPropertyInstance = buildPropertySingleValueText(
-								strPropertyName.c_str(),
-								"property",
-								To_UTF8(strValueU32).c_str(),
-								pProperty->getType().c_str());
-						}
-						else
-						{
-							assert(false);
-						}
-					} // if (!pProperty->getType().empty())
-					else
-					{
-						iPropertyInstance = buildPropertySingleValueText(
-							strPropertyName.c_str(),
-							"property",
-							To_UTF8(strValueU32).c_str(),
-							"IFCTEXT");
-					}
-#endif // _WINDOWS	
-					auto itProperty = mapPropertySets.find(pProperty->getPropertySet());
-					if (itProperty != mapPropertySets.end())
-					{
-						itProperty->second.push_back(iPropertyInstance);
-					}
-					else
-					{
-						mapPropertySets[pProperty->getPropertySet()] = vector<SdaiInstance>{ iPropertyInstance };
-					}
+					mapIndex2Instance[iVertex] = buildCartesianPointInstance(
+						pdVertex[0] - m_dXOffset,
+						pdVertex[1] - m_dYOffset,
+						pdVertex[2] - m_dZOffset);
 				}
-				break;
+			}
 
-				case OBJECTTYPEPROPERTY_TYPE:
-				{
-					//#todo
-				}
-				break;
+			SdaiInstance iPolyLoopInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop");
+			assert(iPolyLoopInstance != 0);
 
-				default:
-				{
-					//#todo
-				}
-				break;
-			} // switch (GetPropertyType(iPropertyInstance))
-		} // prop:
-		else if (strPropertyUniqueName.find("attr:") == 0)
-		{
-			// Attributes
-			assert(GetPropertyType(iPropertyInstance) == DATATYPEPROPERTY_TYPE_WCHAR_T_ARRAY);
+			SdaiAggr pPolygon = sdaiCreateAggrBN(iPolyLoopInstance, "Polygon");
+			assert(pPolygon != nullptr);
 
-			string strPropertyName = strPropertyUniqueName.replace(0, string("attr:str:").size(), "");
+			for (int64_t iIndex = iFirstIndex; iIndex < iEndIndex; iIndex++)
+			{
+				sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(pGeometryBuffer->getRingIndex(iIndex)));
+			}
 
-			string strPrefix;
-			string strName;
-			getXMLElementPrefixAndName(strPropertyName, strPrefix, strName);
+			vecPolygons.push_back(iPolyLoopInstance);
+		} // for (int64_t iRing = ...
+	} // for (int64_t iFace = ...
 
-			auto pProperty = getSite()->getProperty(strName);
-			assert(pProperty != nullptr);
+	getSite()->getMetrics()->onBoundaryRepresentation(geometry.m_iCount, (int64_t)mapIndex2Instance.size());
 
-			strPropertyName = pProperty->getOverrideName();
+	SdaiInstance iClosedShellInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcClosedShell");
+	assert(iClosedShellInstance != 0);
 
-			SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, false);
+	SdaiAggr pCfsFaces = sdaiCreateAggrBN(iClosedShellInstance, "CfsFaces");
+	assert(pCfsFaces != nullptr);	
 
-			wchar_t** szValue = nullptr;
-			int64_t iValuesCount = 0;
-			GetDatatypeProperty(iOwlInstance, iPropertyInstance, (void**)&szValue, &iValuesCount);
-			assert(iValuesCount == 1);
+	size_t iPolygon = 0;
+	for (int64_t iFace = geometry.m_iFirst; iFace < geometry.m_iFirst + geometry.m_iCount; iFace++)
+	{
+		int64_t iFirstRing = 0;
+		int64_t iEndRing = 0;
+		pGeometryBuffer->getFaceRings(iFace, iFirstRing, iEndRing);
 
-			SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, true);
-#ifdef _WINDOWS
-			auto iLength = std::char_traits<char16_t>::length((char16_t*)*szValue);
+		// Outer Polygon
+		SdaiInstance iFaceOuterBoundInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFaceOuterBound");
+		assert(iFaceOuterBoundInstance != 0);
 
-			u16string strValueU16;
-			strValueU16.resize(iLength);
-			memcpy((void*)strValueU16.data(), szValue[0], iLength * sizeof(char16_t));
+		sdaiPutAttrBN(iFaceOuterBoundInstance, "Bound", sdaiINSTANCE, (void*)vecPolygons[iPolygon++]);
+		sdaiPutAttrBN(iFaceOuterBoundInstance, "Orientation", sdaiENUM, "T");
 
-			SdaiInstance iPropertyInstance = 0;
-			if (!pProperty->getType().empty())
-			{
-				if ((pProperty->getType() == "IFCTEXT") ||
-					(pProperty->getType() == "IFCIDENTIFIER"))
-				{
-					iPropertyInstance = buildPropertySingleValueText(
-						strPropertyName.c_str(),
-						"attribute",
-						To_UTF8(strValueU16).c_str(),
-						pProperty->getType().c_str());
-				}
-				else
-				{
-					assert(false);
-				}
-			} // if (!pProperty->getType().empty())
-			else
-			{
-				iPropertyInstance = buildPropertySingleValueText(
-					strPropertyName.c_str(),
-					"attribute",
-					To_UTF8(strValueU16).c_str(),
-					"IFCTEXT");
-			}
-#else
-			auto iLength = std::char_traits<wchar_t>::length((wchar_t*)*szValue);
+		SdaiInstance iFaceInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFace");
+		assert(iFaceInstance != 0);
 
-			u32string strValueU32;
-			strValueU32.resize(iLength);
-			memcpy((void*)strValueU32.data(), szValue[0], iLength * sizeof(wchar_t));
+		SdaiAggr pBounds = sdaiCreateAggrBN(iFaceInstance, "Bounds");
+		sdaiAppend(pCfsFaces, sdaiINSTANCE, (void*)iFaceInstance);
 
-			SdaiInstance iPropertyInstance = 0;
-			if (!pProperty->getType().empty())
-			{
-				if ((pProperty->getType() == "IFCTEXT") ||
-					(pProperty->getType() == "IFCIDENTIFIER"))
-				{
-					iPropertyInstance = buildPropertySingleValueText(
-						strPropertyName.c_str(),
-						"attribute",
-						To_UTF8(strValueU32).c_str(),
-						pProperty->getType().c_str());
-				}
-				else
-				{
-					assert(false);
-				}
-			} // if (!pProperty->getType().empty())
-			else
-			{
-				iPropertyInstance = buildPropertySingleValueText(
-					strPropertyName.c_str(),
-					"attribute",
-					To_UTF8(strValueU32).c_str(),
-					"IFCTEXT");
-			}
-#endif // _WINDOWS
-			auto itProperty = mapPropertySets.find(pProperty->getPropertySet());
-			if (itProperty != mapPropertySets.end())
-			{
-				itProperty->second.push_back(iPropertyInstance);
-			}
-			else
-			{
-				mapPropertySets[pProperty->getPropertySet()] = vector<SdaiInstance>{ iPropertyInstance };
-			}
-		} // attr:
-		else if (strPropertyUniqueName == "$relations")
+		sdaiAppend(pBounds, sdaiINSTANCE, (void*)iFaceOuterBoundInstance);
+
+		// Inner Polygons
+		for (int64_t iRing = iFirstRing + 1; iRing < iEndRing; iRing++)
 		{
-			createObjectProperties(iOwlInstance, mapPropertySets);
+			SdaiInstance iFaceBoundInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFaceBound");
+			assert(iFaceBoundInstance != 0);
+
+			sdaiPutAttrBN(iFaceBoundInstance, "Bound", sdaiINSTANCE, (void*)vecPolygons[iPolygon++]);
+			sdaiPutAttrBN(iFaceBoundInstance, "Orientation", sdaiENUM, "T");
+
+			sdaiAppend(pBounds, sdaiINSTANCE, (void*)iFaceBoundInstance);
 		}
+	} // for (int64_t iFace = ...
 
-		iPropertyInstance = GetInstancePropertyByIterator(iOwlInstance, iPropertyInstance);
-	} // while (iPropertyInstance != 0)
+	SdaiInstance iFacetedBrepInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFacetedBrep");
+	assert(iFacetedBrepInstance != 0);
 
-	if (mapPropertySets.empty())
+	sdaiPutAttrBN(iFacetedBrepInstance, "Outer", sdaiINSTANCE, (void*)iClosedShellInstance);
+
+	createStyledItemInstance(pGeometryBuffer->getMaterial(geometry.m_iMaterial), iFacetedBrepInstance);
+
+	if (bCreateIfcShapeRepresentation)
 	{
-		return;
-	}
+		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
+		assert(iShapeRepresentationInstance != 0);
 
-	// PropertySet-s
-	for (auto& itPropertySet : mapPropertySets)
+		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
+		assert(pItems != 0);
+
+		sdaiAppend(pItems, sdaiINSTANCE, (void*)iFacetedBrepInstance);
+
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "Brep");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getRepresentationContextInstance());
+
+		vecGeometryInstances.push_back(iShapeRepresentationInstance);
+	}
+	else
 	{
-		SdaiAggr pHasProperties = nullptr;
-		SdaiInstance iPropertySetInstance = buildPropertySet(itPropertySet.first.c_str(), pHasProperties);
+		vecGeometryInstances.push_back(iFacetedBrepInstance);
+	}	
+}
 
-		for (auto iPropertyInstance : itPropertySet.second)
+void _citygml_exporter::createMappedItem(const _geometry_buffer* pGeometryBuffer, const _geometry& geometry, vector<SdaiInstance>& vecGeometryInstances)
+{
+	assert(pGeometryBuffer != nullptr);
+	assert(geometry.m_enGeometry == enumGeometry::MappedItem);
+
+	// The SDAI instances are shared by the exporter; the mapped geometry is created once per
+	// ContextOfItems, i.e. per LOD for ALL_LODS (see createElementGeometry())
+	auto prKey = make_pair(geometry.m_iInstance, getRepresentationContextInstance());
+
+	auto itMappedItem = m_mapMappedItems.find(prKey);
+	if (itMappedItem == m_mapMappedItems.end())
+	{
+		vector<SdaiInstance> vecMappedItemGeometryInstances;
+		for (int64_t iChild = geometry.m_iFirst; iChild < geometry.m_iFirst + geometry.m_iCount; iChild++)
 		{
-			sdaiAppend(pHasProperties, sdaiINSTANCE, (void*)iPropertyInstance);
+			createGeometry(pGeometryBuffer, pGeometryBuffer->getChild(iChild), vecMappedItemGeometryInstances, false);
 		}
 
-		buildRelDefinesByProperties(iSdaiInstance, iPropertySetInstance);
-	}	
+		itMappedItem = m_mapMappedItems.insert({ prKey, vecMappedItemGeometryInstances }).first;
+	}
+
+	vecGeometryInstances.push_back(
+		buildMappedItem(
+			itMappedItem->second,
+			pGeometryBuffer->getMatrix(geometry.m_iMatrix),
+			pGeometryBuffer->getMatrix(geometry.m_iMatrix + 1)));
 }
 
-void _citygml_exporter::createObjectProperties(OwlInstance iOwlInstance, map<string, vector<SdaiInstance>>& mapPropertySets)
+void _citygml_exporter::createReferencePointIndicator(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
 {
-	assert(iOwlInstance != 0);
+	assert(iInstance != 0);
+
+#pragma region Geometry
 
+	// Matrix
 	OwlInstance* piInstances = nullptr;
 	int64_t iInstancesCount = 0;
 	GetObjectProperty(
-		iOwlInstance,
-		GetPropertyByName(getSite()->getOwlModel(), "$relations"),
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "matrix"),
 		&piInstances,
 		&iInstancesCount);
-	assert(iInstancesCount > 0);
-
-	for (int64_t iIndex = 0; iIndex < iInstancesCount; iIndex++)
-	{
-		SdaiInstance iUnitInstance = 0;
-		string strUOMAttr = getStringAttributeValue(piInstances[iIndex], "uom");
-		if (!strUOMAttr.empty())
-		{
-			OwlClass iInstanceClass = GetInstanceClass(piInstances[iIndex]);
-			assert(iInstanceClass != 0);
+	assert(iInstancesCount == 1);
 
-			char* szClassName = nullptr;
-			GetNameOfClass(iInstanceClass, &szClassName);
-			assert(szClassName != nullptr);
+	OwlInstance iMatrixInstance = piInstances[0];
+	assert(iMatrixInstance != 0);
 
-			if (string(szClassName) != "class:Thing")
-			{
-				if (string(szClassName) == "class:LengthType")
-				{
-					iUnitInstance = getLengthUnitInstance();
-				}
-				else if (string(szClassName) == "class:areaValue")
-				{
-					iUnitInstance = getAreaUnitInstance();
-				}
-				else
-				{
-					getSite()->logWarn(_string::format("UOM is not supported: '%s'", strUOMAttr.c_str()).c_str());
-				}
-			} // if (string(szClassName) != "class:Thing")
-		} // if (!strUOMAttr.empty())
+	int64_t iValuesCount = 0;
+	double* pdValues = nullptr;
+	GetDatatypeProperty(
+		iMatrixInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "coordinates"),
+		(void**)&pdValues,
+		&iValuesCount);
+	assert(iValuesCount == 12);
 
-		string strPropertyName = getTag(piInstances[iIndex]);
+	// Cube
+	piInstances = nullptr;
+	iInstancesCount = 0;
+	GetObjectProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "object"),
+		&piInstances,
+		&iInstancesCount);
+	assert(iInstancesCount == 1);
 
-		string strPrefix;
-		string strName;
-		getXMLElementPrefixAndName(strPropertyName, strPrefix, strName);
+	OwlInstance iCubeInstance = piInstances[0];
+	assert(iCubeInstance != 0);
 
-		auto pProperty = getSite()->getProperty(strName);
-		assert(pProperty != nullptr);
+	float fBoundingSphereDiameter = m_fXmax - m_fXmin;
+	fBoundingSphereDiameter = max(fBoundingSphereDiameter, m_fYmax - m_fYmin);
+	fBoundingSphereDiameter = max(fBoundingSphereDiameter, m_fZmax - m_fZmin);
+	float fCubeLength = fBoundingSphereDiameter / 150.f;	
 
-		strPropertyName = pProperty->getOverrideName();
+	/*
+	Front
+	X3 -- X2
+	 |    |	
+	X0 -- X1
 
-		// value
-		SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, false);
+	Back
+	X7 -- X6
+	 |    |
+	X4 -- X5
+	*/
+	vector<double> vecVertices
+	{
+		// front
+		pdValues[9], pdValues[10], pdValues[11], // X0
+		pdValues[9] + fCubeLength, pdValues[10], pdValues[11], // X1
+		pdValues[9] + fCubeLength, pdValues[10] + fCubeLength, pdValues[11], // X2
+		pdValues[9], pdValues[10] + fCubeLength, pdValues[11], // X3
+		// back
+		pdValues[9], pdValues[10], pdValues[11] + fCubeLength, // X4
+		pdValues[9] + fCubeLength, pdValues[10], pdValues[11] + fCubeLength, // X5
+		pdValues[9] + fCubeLength, pdValues[10] + fCubeLength, pdValues[11] + fCubeLength, // X6
+		pdValues[9], pdValues[10] + fCubeLength, pdValues[11] + fCubeLength, // X7
+	};
 
-		wchar_t** szValue = nullptr;
-		int64_t iValuesCount = 0;
-		GetDatatypeProperty(
-			piInstances[iIndex],
-			GetPropertyByName(getSite()->getOwlModel(), "value"),
-			(void**)&szValue,
-			&iValuesCount);
+	map<int64_t, SdaiInstance> mapIndex2Instance;
 
-		SetCharacterSerialization(getSite()->getOwlModel(), 0, 0, true);
+	// Front
+	// 0
+	mapIndex2Instance[0] = buildCartesianPointInstance(
+		vecVertices[(0 * 3) + 0],
+		vecVertices[(0 * 3) + 1],
+		vecVertices[(0 * 3) + 2]);
+	// 1
+	mapIndex2Instance[1] = buildCartesianPointInstance(
+		vecVertices[(1 * 3) + 0],
+		vecVertices[(1 * 3) + 1],
+		vecVertices[(1 * 3) + 2]);
+	// 2
+	mapIndex2Instance[2] = buildCartesianPointInstance(
+		vecVertices[(2 * 3) + 0],
+		vecVertices[(2 * 3) + 1],
+		vecVertices[(2 * 3) + 2]);
+	// 3
+	mapIndex2Instance[3] = buildCartesianPointInstance(
+		vecVertices[(3 * 3) + 0],
+		vecVertices[(3 * 3) + 1],
+		vecVertices[(3 * 3) + 2]);
 		
-		if (iValuesCount > 0)
-		{
-			assert(iValuesCount == 1);
-#ifdef _WINDOWS
-			auto iLength = std::char_traits<char16_t>::length((char16_t*)*szValue);
-
-			u16string strValueU16;
-			strValueU16.resize(iLength);
-			memcpy((void*)strValueU16.data(), szValue[0], iLength * sizeof(char16_t));
+	// Back
+	// 4
+	mapIndex2Instance[4] = buildCartesianPointInstance(
+		vecVertices[(4 * 3) + 0],
+		vecVertices[(4 * 3) + 1],
+		vecVertices[(4 * 3) + 2]);
+	// 5
+	mapIndex2Instance[5] = buildCartesianPointInstance(
+		vecVertices[(5 * 3) + 0],
+		vecVertices[(5 * 3) + 1],
+		vecVertices[(5 * 3) + 2]);
+	// 6
+	mapIndex2Instance[6] = buildCartesianPointInstance(
+		vecVertices[(6 * 3) + 0],
+		vecVertices[(6 * 3) + 1],
+		vecVertices[(6 * 3) + 2]);
+	// 7
+	mapIndex2Instance[7] = buildCartesianPointInstance(
+		vecVertices[(7 * 3) + 0],
+		vecVertices[(7 * 3) + 1],
+		vecVertices[(7 * 3) + 2]);
 
-			SdaiInstance iPropertyInstance = 0;
-			if (!pProperty->getType().empty())
-			{
-				if ((pProperty->getType() == "IFCTEXT") ||
-					(pProperty->getType() == "IFCIDENTIFIER"))
-				{
-					iPropertyInstance = buildPropertySingleValueText(
-						strPropertyName.c_str(),
-						"property",
-						To_UTF8(strValueU16).c_str(),
-						pProperty->getType().c_str());
-				}
-				else
-				{
-					assert(false);
-				}
-			} // if (!pProperty->getType().empty())
-			else
-			{
-				iPropertyInstance = buildPropertySingleValueText(
-					strPropertyName.c_str(),
-					"property",
-					To_UTF8(strValueU16).c_str(),
-					"IFCTEXT");
-			}
-#else
-			auto iLength = std::char_traits<wchar_t>::length((wchar_t*)*szValue);
+#pragma endregion // Geometry
 
-			u32string strValueU32;
-			strValueU32.resize(iLength);
-			memcpy((void*)strValueU32.data(), szValue[0], iLength * sizeof(wchar_t));
+	vector<SdaiInstance> vecPolyLoopInstances;
 
-			SdaiInstance iPropertyInstance = 0;
-			if (!pProperty->getType().empty())
-			{
-				if ((pProperty->getType() == "IFCTEXT") ||
-					(pProperty->getType() == "IFCIDENTIFIER"))
-				{
-					iPropertyInstance = buildPropertySingleValueText(
-						strPropertyName.c_str(),
-						"property",
-						To_UTF8(strValueU32).c_str(),
-						pProperty->getType().c_str());
-				}
-				else
-				{
-					assert(false);
-				}
-			} // if (!pProperty->getType().empty())
-			else
-			{
-				iPropertyInstance = buildPropertySingleValueText(
-					strPropertyName.c_str(),
-					"property",
-					To_UTF8(strValueU32).c_str(),
-					"IFCTEXT");
-			}
-#endif // _WINDOWS
-			auto itPropertySet = mapPropertySets.find(pProperty->getPropertySet());
-			if (itPropertySet != mapPropertySets.end())
-			{
-				itPropertySet->second.push_back(iPropertyInstance);
-			}
-			else
-			{
-				mapPropertySets[pProperty->getPropertySet()] = vector<SdaiInstance>{ iPropertyInstance };
-			}
-		} // value
-		else
-		{	
-			// double-value
-			double* pdValues = nullptr;
-			iValuesCount = 0;
-			GetDatatypeProperty(
-				piInstances[iIndex],
-				GetPropertyByName(getSite()->getOwlModel(), "double-value"),
-				(void**)&pdValues,
-				&iValuesCount);
+	// Front
+	// 0, 1, 2, 3
+	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
 
-			if (iValuesCount == 1)
-			{
-				SdaiInstance iPropertyInstance = 0;
-				if (!pProperty->getType().empty())
-				{
-					if ((pProperty->getType() == "IFCREAL") ||
-						(pProperty->getType() == "IFCAREAMEASURE"))
-					{
-						iPropertyInstance = buildPropertySingleValueReal(
-							strPropertyName.c_str(),
-							"property",
-							pdValues[0],
-							pProperty->getType().c_str());
-					}
-					else if ((pProperty->getType() == "IFCINTEGER") ||
-						(pProperty->getType() == "IFCLENGTHMEASURE"))
-					{
-						iPropertyInstance = buildPropertySingleValueInt(
-							strPropertyName.c_str(),
-							"property",
-							(int64_t)pdValues[0],
-							pProperty->getType().c_str());
-					}
-					else
-					{
-						assert(false);
-					}
-				} // if (!pProperty->getType().empty())
-				else
-				{
-					iPropertyInstance = buildPropertySingleValueReal(
-						strPropertyName.c_str(),
-						"property",
-						pdValues[0],
-						"IFCREAL");
-				}
+	SdaiAggr pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(0));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(1));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(2));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(3));
 
-				if (iUnitInstance != 0)
-				{
-					sdaiPutAttrBN(iPropertyInstance, "Unit", sdaiINSTANCE, (void*)iUnitInstance);
-				}
+	// Front
+	// 4, 5, 6, 7
+	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
 
-				auto itPropertySet = mapPropertySets.find(pProperty->getPropertySet());
-				if (itPropertySet != mapPropertySets.end())
-				{
-					itPropertySet->second.push_back(iPropertyInstance);
-				}
-				else
-				{
-					mapPropertySets[pProperty->getPropertySet()] = vector<SdaiInstance>{ iPropertyInstance };
-				}
-			} // if (iValuesCount == 1)
-			else
-			{
-				if (iValuesCount > 1)
-				{
-					assert(false); // TODO
-				}				
-			}
-		} // double-value
-	} // for (int64_t iIndex = ...
-}
+	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(4));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(5));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(6));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(7));
 
-SdaiInstance _citygml_exporter::buildBuildingElementInstance(
-	OwlInstance iOwlInstance,
-	_matrix* pMatrix,
-	SdaiInstance iPlacementRelativeTo,
-	SdaiInstance& iBuildingElementInstancePlacement,
-	const vector<SdaiInstance>& vecRepresentations)
-{
-	assert(iOwlInstance != 0);
-	assert(pMatrix != nullptr);
-	assert(iPlacementRelativeTo != 0);
-	assert(!vecRepresentations.empty());
+	// Left
+	// 4, 0, 3, 7
+	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
 
-	string strTag = getTag(iOwlInstance);
+	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(4));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(0));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(3));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(7));
 
-	OwlClass iInstanceClass = GetInstanceClass(iOwlInstance);
-	assert(iInstanceClass != 0);
+	// Right
+	// 1, 5, 6, 2
+	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
 
-	char* szClassName = nullptr;
-	GetNameOfClass(iInstanceClass, &szClassName);
-	assert(szClassName != nullptr);
+	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(1));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(5));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(6));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(2));
 
-	string strClass = szClassName;
+	// Top
+	// 3, 2, 6, 7
+	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
 
-	string strEntity = "IfcBuildingElement";
-	if (isWallSurfaceClass(iInstanceClass))
-	{
-		strEntity = "IfcWall";
-	}
-	else if (isRoofSurfaceClass(iInstanceClass))
-	{
-		strEntity = "IfcRoof";
-	}
-	else if (isDoorClass(iInstanceClass))
-	{
-		strEntity = "IfcDoor";
-	}
-	else if (isWindowClass(iInstanceClass))
-	{
-		strEntity = "IfcWindow";
-	}
-	else
-	{
-		strEntity = "IfcBuildingElementProxy"; // Proxy/Unknown Building Element
-	}
+	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(3));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(2));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(6));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(7));
 
-	return _exporter_base::buildBuildingElementInstance(
-		strEntity.c_str(),
-		strTag.c_str(),
-		szClassName,
-		pMatrix,
-		iPlacementRelativeTo,
-		iBuildingElementInstancePlacement,
-		vecRepresentations);
-}
+	// Bottom
+	// 0, 1, 5, 4
+	vecPolyLoopInstances.push_back(sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyLoop"));
 
-bool _citygml_exporter::IsPoint3DClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+	pPolygon = sdaiCreateAggrBN(vecPolyLoopInstances.back(), "Polygon");
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(0));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(1));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(5));
+	sdaiAppend(pPolygon, sdaiINSTANCE, (void*)mapIndex2Instance.at(4));
 
-	return (iInstanceClass == m_iPoint3DClass) || IsClassAncestor(iInstanceClass, m_iPoint3DClass);
-}
+	SdaiInstance iClosedShellInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcClosedShell");
+	assert(iClosedShellInstance != 0);
 
-bool _citygml_exporter::isCollectionClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+	SdaiAggr pCfsFaces = sdaiCreateAggrBN(iClosedShellInstance, "CfsFaces");
+	assert(pCfsFaces != nullptr);
 
-	return (iInstanceClass == m_iCollectionClass) || IsClassAncestor(iInstanceClass, m_iCollectionClass);
-}
+	for (auto iPolyLoopInstance : vecPolyLoopInstances)
+	{
+		// Outer Polygon
+		SdaiInstance iFaceOuterBoundInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFaceOuterBound");
+		assert(iFaceOuterBoundInstance != 0);
 
-bool _citygml_exporter::isTransformationClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+		sdaiPutAttrBN(iFaceOuterBoundInstance, "Bound", sdaiINSTANCE, (void*)iPolyLoopInstance);
+		sdaiPutAttrBN(iFaceOuterBoundInstance, "Orientation", sdaiENUM, "T");
 
-	return (iInstanceClass == m_iTransformationClass) || IsClassAncestor(iInstanceClass, m_iTransformationClass);
-}
+		SdaiInstance iFaceInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFace");
+		assert(iFaceInstance != 0);
 
-void _citygml_exporter::getInstancesDefaultState()
-{
-	m_mapInstanceDefaultState.clear();
+		SdaiAggr pBounds = sdaiCreateAggrBN(iFaceInstance, "Bounds");
+		sdaiAppend(pCfsFaces, sdaiINSTANCE, (void*)iFaceInstance);
 
-	// Enable only unreferenced instances
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
-	{
-		m_mapInstanceDefaultState[iInstance] = GetInstanceInverseReferencesByIterator(iInstance, 0) == 0;
+		sdaiAppend(pBounds, sdaiINSTANCE, (void*)iFaceOuterBoundInstance);
+	} // auto iPolyLoopInstance : ...
 
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	}
+	SdaiInstance iFacetedBrepInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcFacetedBrep");
+	assert(iFacetedBrepInstance != 0);
 
-	// Enable children/descendants with geometry
-	for (auto& itInstanceDefaultState : m_mapInstanceDefaultState)
+	sdaiPutAttrBN(iFacetedBrepInstance, "Outer", sdaiINSTANCE, (void*)iClosedShellInstance);
+
+	createStyledItemInstance(iCubeInstance, iFacetedBrepInstance);
+
+	if (bCreateIfcShapeRepresentation)
 	{
-		if (!itInstanceDefaultState.second)
-		{
-			continue;
-		}
+		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
+		assert(iShapeRepresentationInstance != 0);
 
-		if (!GetInstanceGeometryClass(itInstanceDefaultState.first) ||
-			!GetBoundingBox(itInstanceDefaultState.first, nullptr, nullptr))
-		{
-			OwlClass iNillClass = GetClassByName(getSite()->getOwlModel(), "Nill");
+		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
+		assert(pItems != 0);
 
-			OwlClass iInstanceClass = GetInstanceClass(itInstanceDefaultState.first);
-			assert(iInstanceClass != 0);
+		sdaiAppend(pItems, sdaiINSTANCE, (void*)iFacetedBrepInstance);
 
-			if ((iInstanceClass != iNillClass) && !IsClassAncestor(iInstanceClass, iNillClass))
-			{
-				getInstanceDefaultStateRecursive(itInstanceDefaultState.first);
-			}
-		}
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "Brep");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getRepresentationContextInstance());
+
+		vecGeometryInstances.push_back(iShapeRepresentationInstance);
+	}
+	else
+	{
+		vecGeometryInstances.push_back(iFacetedBrepInstance);
 	}
 }
 
-void _citygml_exporter::getInstanceDefaultStateRecursive(OwlInstance iInstance)
+void _citygml_exporter::createPoint3D(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
 {
 	assert(iInstance != 0);
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
-	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+	int64_t iValuesCount = 0;
+	double* pdValue = nullptr;
+	GetDatatypeProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "points"),
+		(void**)&pdValue,
+		&iValuesCount);
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if ((piValues[iValue] != 0) &&
-					!m_mapInstanceDefaultState.at(piValues[iValue]))
-				{
-					// Enable to avoid infinity recursion
-					m_mapInstanceDefaultState.at(piValues[iValue]) = true;
+	assert(iValuesCount == 3);
 
-					if (!GetInstanceGeometryClass(piValues[iValue]) ||
-						!GetBoundingBox(piValues[iValue], nullptr, nullptr))
-					{
-						getInstanceDefaultStateRecursive(piValues[iValue]);
-					}
-				}
-			}
-		}
+	SdaiInstance iCartesianPointInstance = buildCartesianPointInstance(
+		pdValue[0] - m_dXOffset,
+		pdValue[1] - m_dYOffset,
+		pdValue[2] - m_dZOffset);
+	assert(iCartesianPointInstance != 0);
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	}
-}
+	if (bCreateIfcShapeRepresentation)
+	{
+		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
+		assert(iShapeRepresentationInstance != 0);
 
-OwlClass _citygml_exporter::isCityModelClass(OwlClass iInstanceClass) const
-{
-	return (iInstanceClass == m_iCityModelClass) || IsClassAncestor(iInstanceClass, m_iCityModelClass);
-}
+		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
+		assert(pItems != 0);
 
-OwlClass _citygml_exporter::isBoundingShapeClass(OwlClass iInstanceClass) const
-{
-	return (iInstanceClass == m_iBoundingShapeClass) || IsClassAncestor(iInstanceClass, m_iBoundingShapeClass);
-}
+		sdaiAppend(pItems, sdaiINSTANCE, (void*)iCartesianPointInstance);
 
-OwlClass _citygml_exporter::isEnvelopeClass(OwlClass iInstanceClass) const
-{
-	return (iInstanceClass == m_iEnvelopeClass) || IsClassAncestor(iInstanceClass, m_iEnvelopeClass);
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "PointCloud");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getRepresentationContextInstance());
+
+		vecGeometryInstances.push_back(iShapeRepresentationInstance);
+	}
+	else
+	{
+		vecGeometryInstances.push_back(iCartesianPointInstance);
+	}	
 }
 
-bool _citygml_exporter::isCityObjectGroupMemberClass(OwlClass iInstanceClass) const
+void _citygml_exporter::createPoint3DSet(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
 {
-	assert(iInstanceClass != 0);
+	assert(iInstance != 0);
 
-	return ((iInstanceClass == m_iCityObjectGroupMemberClass) || IsClassAncestor(iInstanceClass, m_iCityObjectGroupMemberClass));
-}
+	int64_t iValuesCount = 0;
+	double* pdValue = nullptr;
+	GetDatatypeProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "points"),
+		(void**)&pdValue,
+		&iValuesCount);
+
+	assert(iValuesCount >= 3);
 
-bool _citygml_exporter::isGeometryMemberClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+	if (bCreateIfcShapeRepresentation)
+	{
+		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
+		assert(iShapeRepresentationInstance != 0);
 
-	return ((iInstanceClass == m_iGeometryMemberClass) || IsClassAncestor(iInstanceClass, m_iGeometryMemberClass));
-}
+		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
+		assert(pItems != 0);
 
-bool _citygml_exporter::isBuildingElement(OwlInstance iInstance) const
-{
-	assert(iInstance != 0);
+		for (int64_t iValue = 0; iValue < iValuesCount; iValue += 3)
+		{
+			SdaiInstance iCartesianPointInstance = buildCartesianPointInstance(
+				pdValue[iValue + 0] - m_dXOffset,
+				pdValue[iValue + 1] - m_dYOffset,
+				pdValue[iValue + 2] - m_dZOffset);
+			assert(iCartesianPointInstance != 0);
 
-	OwlClass iInstanceClass = GetInstanceClass(iInstance);
-	assert(iInstanceClass != 0);
+			sdaiAppend(pItems, sdaiINSTANCE, (void*)iCartesianPointInstance);
+		} // for (int64_t iValue = ...
 
-	if (isWallSurfaceClass(iInstanceClass))
-	{
-		return true;
-	}
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "PointCloud");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getRepresentationContextInstance());
 
-	if (isRoofSurfaceClass(iInstanceClass))
-	{
-		return true;
-	}
-	
-	if (isDoorClass(iInstanceClass))
-	{
-		return true;
+		vecGeometryInstances.push_back(iShapeRepresentationInstance);
 	}
-	
-	if (isWindowClass(iInstanceClass))
+	else
 	{
-		return true;
-	}
+		for (int64_t iValue = 0; iValue < iValuesCount; iValue += 3)
+		{
+			SdaiInstance iCartesianPointInstance = buildCartesianPointInstance(
+				pdValue[iValue + 0] - m_dXOffset,
+				pdValue[iValue + 1] - m_dYOffset,
+				pdValue[iValue + 2] - m_dZOffset);
+			assert(iCartesianPointInstance != 0);
 
-	return false;
+			vecGeometryInstances.push_back(iCartesianPointInstance);
+		} // for (int64_t iValue = ...
+	}	
 }
 
-bool _citygml_exporter::isBuildingClass(OwlClass iInstanceClass) const
+void _citygml_exporter::createPolyLine3D(const _geometry_buffer* pGeometryBuffer, const _geometry& geometry, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation)
 {
-	assert(iInstanceClass != 0);
+	assert(pGeometryBuffer != nullptr);
+	assert(geometry.m_enGeometry == enumGeometry::PolyLine);
 
-	return (iInstanceClass == m_iBuildingClass) || IsClassAncestor(iInstanceClass, m_iBuildingClass);
-}
+	SdaiInstance iPolyLineInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcPolyline");
+	assert(iPolyLineInstance != 0);
 
-bool _citygml_exporter::isBuildingPartClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+	SdaiAggr pPoints = sdaiCreateAggrBN(iPolyLineInstance, "Points");
+	assert(pPoints != nullptr);
 
-	return (iInstanceClass == m_iBuildingPartClass) || IsClassAncestor(iInstanceClass, m_iBuildingPartClass);
-}
+	for (int64_t iVertex = geometry.m_iFirst; iVertex < geometry.m_iFirst + geometry.m_iCount; iVertex++)
+	{
+		const double* pdVertex = pGeometryBuffer->getVertex(iVertex);
 
-bool _citygml_exporter::isWallSurfaceClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+		SdaiInstance iCartesianPointInstance = buildCartesianPointInstance(
+			pdVertex[0] - m_dXOffset,
+			pdVertex[1] - m_dYOffset,
+			pdVertex[2] - m_dZOffset);
+		assert(iCartesianPointInstance != 0);
 
-	return (iInstanceClass == m_iWallSurfaceClass) || IsClassAncestor(iInstanceClass, m_iWallSurfaceClass);
-}
+		sdaiAppend(pPoints, sdaiINSTANCE, (void*)iCartesianPointInstance);
+	} // for (int64_t iVertex = ...
 
-bool _citygml_exporter::isRoofSurfaceClass(OwlInstance iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+	if (bCreateIfcShapeRepresentation)
+	{
+		SdaiInstance iShapeRepresentationInstance = sdaiCreateInstanceBN(getSdaiModel(), "IfcShapeRepresentation");
+		assert(iShapeRepresentationInstance != 0);
 
-	return (iInstanceClass == m_iRoofSurfaceClass) || IsClassAncestor(iInstanceClass, m_iRoofSurfaceClass);
-}
+		SdaiAggr pItems = sdaiCreateAggrBN(iShapeRepresentationInstance, "Items");
+		assert(pItems != 0);
 
-bool _citygml_exporter::isDoorClass(OwlInstance iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+		sdaiAppend(pItems, sdaiINSTANCE, (void*)iPolyLineInstance);
 
-	return (iInstanceClass == m_iDoorClass) || IsClassAncestor(iInstanceClass, m_iDoorClass);
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationIdentifier", sdaiSTRING, "Body");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "RepresentationType", sdaiSTRING, "Curve3D");
+		sdaiPutAttrBN(iShapeRepresentationInstance, "ContextOfItems", sdaiINSTANCE, (void*)getRepresentationContextInstance());
+
+		vecGeometryInstances.push_back(iShapeRepresentationInstance);
+	}
+	else
+	{
+		vecGeometryInstances.push_back(iPolyLineInstance);
+	}	
 }
 
-bool _citygml_exporter::isWindowClass(OwlInstance iInstanceClass) const
+// Thread-safe; the properties/attributes are resolved against the settings on export (see createProperties())
+void _citygml_exporter::readAttributes(OwlInstance iInstance, vector<_city_attribute>& vecAttributes)
 {
-	assert(iInstanceClass != 0);
+	assert(iInstance != 0);
 
-	return (iInstanceClass == m_iWindowClass) || IsClassAncestor(iInstanceClass, m_iWindowClass);
-}
+	RdfProperty iPropertyInstance = GetInstancePropertyByIterator(iInstance, 0);
+	while (iPropertyInstance != 0)
+	{
+		char* szPropertyUniqueName = nullptr;
+		GetNameOfProperty(iPropertyInstance, &szPropertyUniqueName);
 
-bool _citygml_exporter::isCadastralParcelClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+		string strPropertyUniqueName = szPropertyUniqueName;
+		
+		if (strPropertyUniqueName.find("prop:") == 0)
+		{
+			// Properties
+			switch (GetPropertyType(iPropertyInstance))
+			{
+				case DATATYPEPROPERTY_TYPE_DOUBLE:
+				{
+					string strPropertyName = strPropertyUniqueName.replace(0, string("prop:dbl:").size(), "");
 
-	return (iInstanceClass == m_iCadastralParcelClass) || IsClassAncestor(iInstanceClass, m_iCadastralParcelClass);
-}
+					string strPrefix;
+					string strName;
+					getXMLElementPrefixAndName(strPropertyName, strPrefix, strName);
 
-bool _citygml_exporter::isPointPropertyClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+					double* pdValues = nullptr;
+					int64_t iValuesCount = 0;
+					GetDatatypeProperty(iInstance, iPropertyInstance, (void**)&pdValues, &iValuesCount);
 
-	return (iInstanceClass == m_iPointPropertyClass) || IsClassAncestor(iInstanceClass, m_iPointPropertyClass);
-}
+					if (iValuesCount == 1)
+					{
+						vecAttributes.push_back(_city_attribute(strName, false, pdValues[0], enumCityAttributeUnit::None));
+					}
+					else
+					{
+						wstring strValue;
+						for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
+						{
+							if (!strValue.empty())
+							{
+								strValue += L", ";
+							}
 
-bool _citygml_exporter::isReferencePointIndicatorClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+							strValue += to_wstring(pdValues[iValue]);
+						}
+						string strValueUTF8;
+						_string_table::toUTF8(strValue.data(), strValue.size(), strValueUTF8);
 
-	return (iInstanceClass == m_iReferencePointIndicatorClass) || IsClassAncestor(iInstanceClass, m_iReferencePointIndicatorClass);
-}
+						vecAttributes.push_back(_city_attribute(strName, false, enumCityAttributeValue::Reals, strValueUTF8));
+					} // else if (iValuesCount == 1)
+				}
+				break;
 
-bool _citygml_exporter::isFeatureClass(OwlInstance iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+				case DATATYPEPROPERTY_TYPE_WCHAR_T_ARRAY:
+				{
+					string strPropertyName = strPropertyUniqueName.replace(0, string("prop:str:").size(), "");
 
-	if (isVegetationObjectClass(iInstanceClass) ||
-		isWaterObjectClass(iInstanceClass) ||
-		isBridgeObjectClass(iInstanceClass) ||
-		isTunnelObjectClass(iInstanceClass) ||
-		isTransportationObjectClass(iInstanceClass) ||
-		isTrafficSpaceClass(iInstanceClass) ||
-		isTrafficAreaClass(iInstanceClass) ||
-		isFurnitureObjectClass(iInstanceClass) ||
-		isReliefObjectClass(iInstanceClass) ||
-		isLandUseClass(iInstanceClass) ||
-		isCadastralParcelClass(iInstanceClass))
-	{
-		return true;
-	}
+					string strPrefix;
+					string strName;
+					getXMLElementPrefixAndName(strPropertyName, strPrefix, strName);
 
-	return false;
-}
+					auto pValue = getStringTable()->getValue(iInstance, iPropertyInstance);
+					assert(pValue != nullptr);
 
-bool _citygml_exporter::isVegetationObjectClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+					vecAttributes.push_back(_city_attribute(strName, false, enumCityAttributeValue::Text, pValue != nullptr ? *pValue : EMPTY_STRING));
+				}
+				break;
 
-	return (iInstanceClass == m_iVegetationObjectClass) || IsClassAncestor(iInstanceClass, m_iVegetationObjectClass);
-}
+				case OBJECTTYPEPROPERTY_TYPE:
+				{
+					//#todo
+				}
+				break;
 
-bool _citygml_exporter::isWaterObjectClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+				default:
+				{
+					//#todo
+				}
+				break;
+			} // switch (GetPropertyType(iPropertyInstance))
+		} // prop:
+		else if (strPropertyUniqueName.find("attr:") == 0)
+		{
+			// Attributes
+			assert(GetPropertyType(iPropertyInstance) == DATATYPEPROPERTY_TYPE_WCHAR_T_ARRAY);
 
-	return (iInstanceClass == m_iWaterObjectClass) || IsClassAncestor(iInstanceClass, m_iWaterObjectClass);
-}
+			string strPropertyName = strPropertyUniqueName.replace(0, string("attr:str:").size(), "");
 
-bool _citygml_exporter::isBridgeObjectClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+			string strPrefix;
+			string strName;
+			getXMLElementPrefixAndName(strPropertyName, strPrefix, strName);
 
-	return (iInstanceClass == m_iBridgeObjectClass) || IsClassAncestor(iInstanceClass, m_iBridgeObjectClass);
-}
+			auto pValue = getStringTable()->getValue(iInstance, iPropertyInstance);
+			assert(pValue != nullptr);
 
-bool _citygml_exporter::isTunnelObjectClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+			vecAttributes.push_back(_city_attribute(strName, true, enumCityAttributeValue::Text, pValue != nullptr ? *pValue : EMPTY_STRING));
+		} // attr:
+		else if (strPropertyUniqueName == "$relations")
+		{
+			readObjectAttributes(iInstance, vecAttributes);
+		}
 
-	return (iInstanceClass == m_iTunnelObjectClass) || IsClassAncestor(iInstanceClass, m_iTunnelObjectClass);
+		iPropertyInstance = GetInstancePropertyByIterator(iInstance, iPropertyInstance);
+	} // while (iPropertyInstance != 0)
 }
 
-bool _citygml_exporter::isTransportationObjectClass(OwlClass iInstanceClass) const
+void _citygml_exporter::readObjectAttributes(OwlInstance iInstance, vector<_city_attribute>& vecAttributes)
 {
-	assert(iInstanceClass != 0);
+	assert(iInstance != 0);
+
+	OwlInstance* piInstances = nullptr;
+	int64_t iInstancesCount = 0;
+	GetObjectProperty(
+		iInstance,
+		GetPropertyByName(getSite()->getOwlModel(), "$relations"),
+		&piInstances,
+		&iInstancesCount);
+	assert(iInstancesCount > 0);
+
+	for (int64_t iIndex = 0; iIndex < iInstancesCount; iIndex++)
+	{
+		enumCityAttributeUnit enUnit = enumCityAttributeUnit::None;
+		string strUOMAttr = getStringAttributeValue(piInstances[iIndex], "uom");
+		if (!strUOMAttr.empty())
+		{
+			OwlClass iInstanceClass = GetInstanceClass(piInstances[iIndex]);
+			assert(iInstanceClass != 0);
+
+			int iClassNameId = getStringTable()->getClassNameId(iInstanceClass);
+			if (iClassNameId != m_iThingClassNameId)
+			{
+				if (iClassNameId == m_iLengthTypeClassNameId)
+				{
+					enUnit = enumCityAttributeUnit::Length;
+				}
+				else if (iClassNameId == m_iAreaValueClassNameId)
+				{
+					enUnit = enumCityAttributeUnit::Area;
+				}
+				else
+				{
+					if (getSite()->isLogEnabled(enumLogEvent::warning))
+					{
+						getSite()->logWrite(enumLogEvent::warning, _string::format("UOM is not supported: '%s'", strUOMAttr.c_str()), "UOM is not supported");
+					}
+				}
+			} // if (iClassNameId != m_iThingClassNameId)
+		} // if (!strUOMAttr.empty())
 
-	return (iInstanceClass == m_iTransportationObjectClass) || IsClassAncestor(iInstanceClass, m_iTransportationObjectClass);
-}
+		string strPrefix;
+		string strName;
+		getXMLElementPrefixAndName(getTag(piInstances[iIndex]), strPrefix, strName);
 
-bool _citygml_exporter::isFurnitureObjectClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+		// value
+		auto pValue = getStringTable()->getValue(
+			piInstances[iIndex],
+			GetPropertyByName(getSite()->getOwlModel(), "value"));
+		
+		if (pValue != nullptr)
+		{
+			vecAttributes.push_back(_city_attribute(strName, false, enumCityAttributeValue::Text, *pValue));
+		} // value
+		else
+		{	
+			// double-value
+			double* pdValues = nullptr;
+			int64_t iValuesCount = 0;
+			GetDatatypeProperty(
+				piInstances[iIndex],
+				GetPropertyByName(getSite()->getOwlModel(), "double-value"),
+				(void**)&pdValues,
+				&iValuesCount);
 
-	return (iInstanceClass == m_iFurnitureObjectClass) || IsClassAncestor(iInstanceClass, m_iFurnitureObjectClass);
+			if (iValuesCount == 1)
+			{
+				vecAttributes.push_back(_city_attribute(strName, false, pdValues[0], enUnit));
+			}
+			else
+			{
+				if (iValuesCount > 1)
+				{
+					assert(false); // TODO
+				}				
+			}
+		} // double-value
+	} // for (int64_t iIndex = ...
 }
 
-bool _citygml_exporter::isReliefObjectClass(OwlClass iInstanceClass) const
+void _citygml_exporter::createProperties(const _city_object* pObject, int64_t iFirstAttribute, int64_t iAttributesCount, SdaiInstance iSdaiInstance)
 {
-	assert(iInstanceClass != 0);
+	assert(pObject != nullptr);
+	assert(iSdaiInstance != 0);
 
-	return (iInstanceClass == m_iReliefObjectClass) || IsClassAncestor(iInstanceClass, m_iReliefObjectClass);
-}
+	// Property Set : Properties
+	map<string, vector<SdaiInstance>> mapPropertySets;
 
-bool _citygml_exporter::isLandUseClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+	for (int64_t iAttribute = iFirstAttribute; iAttribute < iFirstAttribute + iAttributesCount; iAttribute++)
+	{
+		const auto& attribute = pObject->m_vecAttributes[iAttribute];
 
-	return (iInstanceClass == m_iLandUseClass) || IsClassAncestor(iInstanceClass, m_iLandUseClass);
-}
+		auto pProperty = getSite()->getProperty(attribute.m_strName);
+		assert(pProperty != nullptr);
 
-bool _citygml_exporter::isTrafficSpaceClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+		const string& strPropertyName = pProperty->getOverrideName();
+		const char* szDescription = attribute.m_bAttribute ? "attribute" : "property";
 
-	return (iInstanceClass == m_iTrafficSpaceClass) || IsClassAncestor(iInstanceClass, m_iTrafficSpaceClass);
-}
+		SdaiInstance iPropertyInstance = 0;
+		switch (attribute.m_enValue)
+		{
+			case enumCityAttributeValue::Real:
+			{
+				if (!pProperty->getType().empty())
+				{
+					if ((pProperty->getType() == "IFCREAL") ||
+						(pProperty->getType() == "IFCAREAMEASURE"))
+					{
+						iPropertyInstance = buildPropertySingleValueReal(
+							strPropertyName.c_str(),
+							szDescription,
+							attribute.m_dValue,
+							pProperty->getType().c_str());
+					}
+					else if ((pProperty->getType() == "IFCINTEGER") ||
+						(pProperty->getType() == "IFCLENGTHMEASURE"))
+					{
+						iPropertyInstance = buildPropertySingleValueInt(
+							strPropertyName.c_str(),
+							szDescription,
+							(int64_t)attribute.m_dValue,
+							pProperty->getType().c_str());
+					}
+					else
+					{
+						assert(false);
+					}
+				} // if (!pProperty->getType().empty())
+				else
+				{
+					iPropertyInstance = buildPropertySingleValueReal(
+						strPropertyName.c_str(),
+						szDescription,
+						attribute.m_dValue,
+						"IFCREAL");
+				}
 
-bool _citygml_exporter::isTrafficAreaClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+				if ((iPropertyInstance != 0) && (attribute.m_enUnit != enumCityAttributeUnit::None))
+				{
+					SdaiInstance iUnitInstance = attribute.m_enUnit == enumCityAttributeUnit::Length ?
+						getLengthUnitInstance() :
+						getAreaUnitInstance();
 
-	return (iInstanceClass == m_iTrafficAreaClass) || IsClassAncestor(iInstanceClass, m_iTrafficAreaClass);
-}
+					sdaiPutAttrBN(iPropertyInstance, "Unit", sdaiINSTANCE, (void*)iUnitInstance);
+				}
+			}
+			break;
 
-bool _citygml_exporter::isUnknownClass(OwlClass iInstanceClass) const
-{
-	assert(iInstanceClass != 0);
+			case enumCityAttributeValue::Reals:
+			{
+				iPropertyInstance = buildPropertySingleValueText(
+					strPropertyName.c_str(),
+					szDescription,
+					attribute.m_strValue.c_str(),
+					"IFCTEXT");
+			}
+			break;
 
-	return (iInstanceClass == m_iThingClass) || IsClassAncestor(iInstanceClass, m_iThingClass);
-}
+			case enumCityAttributeValue::Text:
+			{
+				if (!pProperty->getType().empty())
+				{
+					if ((pProperty->getType() == "IFCTEXT") ||
+						(pProperty->getType() == "IFCIDENTIFIER"))
+					{
+						iPropertyInstance = buildPropertySingleValueText(
+							strPropertyName.c_str(),
+							szDescription,
+							attribute.m_strValue.c_str(),
+							pProperty->getType().c_str());
+					}
+					else
+					{
+						assert(false);
+					}
+				} // if (!pProperty->getType().empty())
+				else
+				{
+					iPropertyInstance = buildPropertySingleValueText(
+						strPropertyName.c_str(),
+						szDescription,
+						attribute.m_strValue.c_str(),
+						"IFCTEXT");
+				}
+			}
+			break;
 
-void _citygml_exporter::getEnvelopeCenter(OwlInstance iEnvelopeInstance, double& dX, double& dY, double& dZ)
-{
-	assert(iEnvelopeInstance != 0);
+			default:
+			{
+				assert(false); // Internal error!
+			}
+			break;
+		} // switch (attribute.m_enValue)
 
-	dX = 0.;
-	dY = 0.;
-	dZ = 0.;
+		auto itPropertySet = mapPropertySets.find(pProperty->getPropertySet());
+		if (itPropertySet != mapPropertySets.end())
+		{
+			itPropertySet->second.push_back(iPropertyInstance);
+		}
+		else
+		{
+			mapPropertySets[pProperty->getPropertySet()] = vector<SdaiInstance>{ iPropertyInstance };
+		}
+	} // for (int64_t iAttribute = ...
 
-	string strEPSGCode;
-	vector<double> vecLowerCorner;
-	vector<double> vecUpperCorner;
-	if (retrieveEnvelopeSRSData(iEnvelopeInstance, strEPSGCode, vecLowerCorner, vecUpperCorner))
+	if (mapPropertySets.empty())
 	{
-		dX = (vecLowerCorner[0] + vecUpperCorner[0]) / 2.;
-		dY = (vecLowerCorner[1] + vecUpperCorner[1]) / 2.;
-		dZ = (vecLowerCorner[2] + vecUpperCorner[2]) / 2.;
+		return;
 	}
-}
-
-void _citygml_exporter::getReferencePoint(OwlInstance iReferencePointInstance, double& dX, double& dY, double& dZ)
-{
-	assert(iReferencePointInstance != 0);
-
-	dX = 0.;
-	dY = 0.;
-	dZ = 0.;
 
-	string strSrsName = getStringAttributeValue(iReferencePointInstance, "srsName");
-	if (!strSrsName.empty() && (strSrsName.find("EPSG") != string::npos))
+	// PropertySet-s
+	for (auto& itPropertySet : mapPropertySets)
 	{
-		int64_t iValuesCount = 0;
-		double* pdValue = nullptr;
-		GetDatatypeProperty(
-			iReferencePointInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "points"),
-			(void**)&pdValue,
-			&iValuesCount);
-		assert(iValuesCount == 3);
+		SdaiAggr pHasProperties = nullptr;
+		SdaiInstance iPropertySetInstance = buildPropertySet(itPropertySet.first.c_str(), pHasProperties);
 
-		dX = pdValue[0];
-		dY = pdValue[1];
-		dZ = pdValue[2];
-	}
+		for (auto iPropertyInstance : itPropertySet.second)
+		{
+			sdaiAppend(pHasProperties, sdaiINSTANCE, (void*)iPropertyInstance);
+		}
+
+		buildRelDefinesByProperties(iSdaiInstance, iPropertySetInstance);
+	}	
 }
 
-void _citygml_exporter::setSiteEnvelopeSRSData(SdaiInstance iSiteInstance, OwlInstance iEnvelopeInstance)
+SdaiInstance _citygml_exporter::buildBuildingElementInstance(
+	const _city_element& element,
+	_matrix* pMatrix,
+	SdaiInstance iPlacementRelativeTo,
+	SdaiInstance& iBuildingElementInstancePlacement,
+	const vector<SdaiInstance>& vecRepresentations)
 {
-	assert(iSiteInstance != 0);
-	assert(iEnvelopeInstance != 0);
+	assert(pMatrix != nullptr);
+	assert(iPlacementRelativeTo != 0);
+	assert(!vecRepresentations.empty());
 
-	string strEPSGCode;
-	vector<double> vecLowerCorner;
-	vector<double> vecUpperCorner;
-	if (retrieveEnvelopeSRSData(iEnvelopeInstance, strEPSGCode, vecLowerCorner, vecUpperCorner))
+	string strEntity = "IfcBuildingElement";
+	switch (element.m_enElement)
 	{
-		string strCoordinates;
-		if (getSite()->getWGS84(
-			atoi(strEPSGCode.c_str()),
-			(float)(vecLowerCorner[0] + vecUpperCorner[0]) / 2.f,
-			(float)(vecLowerCorner[1] + vecUpperCorner[1]) / 2.f,
-			(float)(vecLowerCorner[2] + vecUpperCorner[2]) / 2.f,
-			strCoordinates))
-		{
-			vector<double> vecCoordinates;
-			getPosValues(strCoordinates, vecCoordinates);
-
-			double dLatitude = vecCoordinates[0];
-			double dLongitude = vecCoordinates[1];
-
-			SdaiAggr pRefLatitude = sdaiCreateAggrBN(iSiteInstance, "RefLatitude");
-			assert(pRefLatitude != nullptr);
-
-			/*
-			  c[1] :=    a;                                           -- -50
-			  c[2] :=   (a - c[1]) * 60;                              -- -58
-			  c[3] :=  ((a - c[1]) * 60 - c[2]) * 60;                 -- -33
-			  c[4] := (((a - c[1]) * 60 - c[2]) * 60 - c[3]) * 1.e6;  -- -110400
-			*/
-
-			int64_t iRefLatitude1 = (int64_t)dLatitude;
-			int64_t iRefLatitude2 = (int64_t)((dLatitude - iRefLatitude1) * 60.);
-			int64_t iRefLatitude3 = (int64_t)(((dLatitude - iRefLatitude1) * 60. - iRefLatitude2) * 60.);
-			int64_t iRefLatitude4 = (int64_t)(((((dLatitude - iRefLatitude1) * 60. - iRefLatitude2) * 60.) - iRefLatitude3) * 1.e6);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude1);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude2);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude3);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude4);
-
-			SdaiAggr pRefLongitude = sdaiCreateAggrBN(iSiteInstance, "RefLongitude");
-			assert(pRefLongitude != nullptr);
-
-			int64_t iRefLongitude1 = (int64_t)dLongitude;
-			int64_t iRefLongitude2 = (int64_t)((dLongitude - iRefLongitude1) * 60.);
-			int64_t iRefLongitude3 = (int64_t)(((dLongitude - iRefLongitude1) * 60. - iRefLongitude2) * 60.);
-			int64_t iRefLongitude4 = (int64_t)(((((dLongitude - iRefLongitude1) * 60. - iRefLongitude2) * 60.) - iRefLongitude3) * 1.e6);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude1);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude2);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude3);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude4);
-
-			double dRefElevation = vecLowerCorner[2];
-			sdaiPutAttrBN(iSiteInstance, "RefElevation", sdaiREAL, &dRefElevation);
-		} // if (getSite()->getWGS84( ...
-	} // if (retrieveEnvelopeSRSData( ...
-}
-
-void _citygml_exporter::setSiteReferencePointSRSData(SdaiInstance iSiteInstance, OwlInstance iReferencePointInstance)
-{
-	assert(iSiteInstance != 0);
-	assert(iReferencePointInstance != 0);
+		case enumCityElement::WallSurface:
+		{
+			strEntity = "IfcWall";
+		}
+		break;
 
-	string strEPSGCode;
-	vector<double> vecCenter;
-	if (retrieveReferencePointSRSData(iReferencePointInstance, strEPSGCode, vecCenter))
-	{
-		string strCoordinates;
-		if (getSite()->getWGS84(
-			atoi(strEPSGCode.c_str()),
-			(float)vecCenter[0],
-			(float)vecCenter[1],
-			(float)vecCenter[2],
-			strCoordinates))
+		case enumCityElement::RoofSurface:
 		{
-			vector<double> vecCoordinates;
-			getPosValues(strCoordinates, vecCoordinates);
+			strEntity = "IfcRoof";
+		}
+		break;
 
-			double dLatitude = vecCoordinates[0];
-			double dLongitude = vecCoordinates[1];
+		case enumCityElement::Door:
+		{
+			strEntity = "IfcDoor";
+		}
+		break;
 
-			SdaiAggr pRefLatitude = sdaiCreateAggrBN(iSiteInstance, "RefLatitude");
-			assert(pRefLatitude != nullptr);
+		case enumCityElement::Window:
+		{
+			strEntity = "IfcWindow";
+		}
+		break;
 
-			/*
-			  c[1] :=    a;                                           -- -50
-			  c[2] :=   (a - c[1]) * 60;                              -- -58
-			  c[3] :=  ((a - c[1]) * 60 - c[2]) * 60;                 -- -33
-			  c[4] := (((a - c[1]) * 60 - c[2]) * 60 - c[3]) * 1.e6;  -- -110400
-			*/
+		default:
+		{
+			strEntity = "IfcBuildingElementProxy"; // Proxy/Unknown Building Element
+		}
+		break;
+	} // switch (element.m_enElement)
 
-			int64_t iRefLatitude1 = (int64_t)dLatitude;
-			int64_t iRefLatitude2 = (int64_t)((dLatitude - iRefLatitude1) * 60.);
-			int64_t iRefLatitude3 = (int64_t)(((dLatitude - iRefLatitude1) * 60. - iRefLatitude2) * 60.);
-			int64_t iRefLatitude4 = 0;
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude1);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude2);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude3);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude4);
+	return _exporter_base::buildBuildingElementInstance(
+		strEntity.c_str(),
+		element.m_strTag.c_str(),
+		element.m_strClassName.c_str(),
+		pMatrix,
+		iPlacementRelativeTo,
+		iBuildingElementInstancePlacement,
+		vecRepresentations);
+}
 
-			SdaiAggr pRefLongitude = sdaiCreateAggrBN(iSiteInstance, "RefLongitude");
-			assert(pRefLongitude != nullptr);
+bool _citygml_exporter::IsPoint3DClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-			int64_t iRefLongitude1 = (int64_t)dLongitude;
-			int64_t iRefLongitude2 = (int64_t)((dLongitude - iRefLongitude1) * 60.);
-			int64_t iRefLongitude3 = (int64_t)(((dLongitude - iRefLongitude1) * 60. - iRefLongitude2) * 60.);
-			int64_t iRefLongitude4 = 0;
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude1);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude2);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude3);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude4);
+	return (iInstanceClass == m_iPoint3DClass) || IsClassAncestor(iInstanceClass, m_iPoint3DClass);
+}
 
-			double dRefElevation = vecCenter[2];
-			sdaiPutAttrBN(iSiteInstance, "RefElevation", sdaiREAL, &dRefElevation);
-		} // if (getSite()->getWGS84( ...
-	}
+bool _citygml_exporter::isCollectionClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	return (iInstanceClass == m_iCollectionClass) || IsClassAncestor(iInstanceClass, m_iCollectionClass);
 }
 
-bool _citygml_exporter::retrieveEnvelopeSRSData(OwlInstance iEnvelopeInstance, string& strEPSGCode, vector<double>& vecLowerCorner, vector<double>& vecUpperCorner)
+bool _citygml_exporter::isTransformationClass(OwlClass iInstanceClass) const
 {
-	assert(iEnvelopeInstance != 0);
+	assert(iInstanceClass != 0);
 
-	strEPSGCode = "";
-	vecLowerCorner.clear();
-	vecUpperCorner.clear();
+	return (iInstanceClass == m_iTransformationClass) || IsClassAncestor(iInstanceClass, m_iTransformationClass);
+}
 
-	string strSrsName = getStringAttributeValue(iEnvelopeInstance, "srsName");
-	if (!strSrsName.empty() && (strSrsName.find("EPSG") != string::npos))
-	{
-		strEPSGCode = getEPSGCode(strSrsName);
-		assert(!strEPSGCode.empty());
+void _citygml_exporter::getInstancesDefaultState()
+{
+	m_mapInstanceDefaultState.clear();
 
-		OwlInstance* piInstances = nullptr;
-		int64_t iInstancesCount = 0;
-		GetObjectProperty(
-			iEnvelopeInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "$relations"),
-			&piInstances,
-			&iInstancesCount);
-		assert(iInstancesCount == 2);
+	// Enable only unreferenced instances
+	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
+	while (iInstance != 0)
+	{
+		m_mapInstanceDefaultState[iInstance] = GetInstanceInverseReferencesByIterator(iInstance, 0) == 0;
 
-		OwlInstance iLowerCornerInstance = 0;
-		OwlInstance iUpperCornerInstance = 0;
+		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
+	}
 
-		string strTag0 = getTag(piInstances[0]);
-		string strTag1 = getTag(piInstances[1]);
+	// Enable children/descendants with geometry
+	for (auto& itInstanceDefaultState : m_mapInstanceDefaultState)
+	{
+		if (!itInstanceDefaultState.second)
+		{
+			continue;
+		}
 
-		if (_string::endsWith(strTag0, "lowerCorner"))
+		if (!GetInstanceGeometryClass(itInstanceDefaultState.first) ||
+			!GetBoundingBox(itInstanceDefaultState.first, nullptr, nullptr))
 		{
-			iLowerCornerInstance = piInstances[0];
+			OwlClass iNillClass = GetClassByName(getSite()->getOwlModel(), "Nill");
 
-			if (_string::endsWith(strTag1, "upperCorner"))
-			{
-				iUpperCornerInstance = piInstances[1];
-			}
-			else
-			{
-				assert(false);
+			OwlClass iInstanceClass = GetInstanceClass(itInstanceDefaultState.first);
+			assert(iInstanceClass != 0);
 
-				return false;
+			if ((iInstanceClass != iNillClass) && !IsClassAncestor(iInstanceClass, iNillClass))
+			{
+				getInstanceDefaultStateRecursive(itInstanceDefaultState.first);
 			}
 		}
-		else if (_string::endsWith(strTag1, "lowerCorner"))
+	}
+}
+
+void _citygml_exporter::getInstanceDefaultStateRecursive(OwlInstance iInstance)
+{
+	assert(iInstance != 0);
+
+	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
+	while (iProperty != 0)
+	{
+		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
 		{
-			iLowerCornerInstance = piInstances[1];
+			int64_t iValuesCount = 0;
+			OwlInstance* piValues = nullptr;
+			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
 
-			if (_string::endsWith(strTag0, "upperCorner"))
-			{
-				iUpperCornerInstance = piInstances[0];
-			}
-			else
+			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
 			{
-				assert(false);
+				if ((piValues[iValue] != 0) &&
+					!m_mapInstanceDefaultState.at(piValues[iValue]))
+				{
+					// Enable to avoid infinity recursion
+					m_mapInstanceDefaultState.at(piValues[iValue]) = true;
 
-				return false;
+					if (!GetInstanceGeometryClass(piValues[iValue]) ||
+						!GetBoundingBox(piValues[iValue], nullptr, nullptr))
+					{
+						getInstanceDefaultStateRecursive(piValues[iValue]);
+					}
+				}
 			}
 		}
-		else
-		{
-			assert(false);
 
-			return false;
-		}
+		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
+	}
+}
 
-		// lowerCorner
-		double* pdValues = nullptr;
-		int64_t iValuesCount = 0;
-		GetDatatypeProperty(
-			iLowerCornerInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "double-value"),
-			(void**)&pdValues,
-			&iValuesCount);
-		assert(iValuesCount == 3);
+OwlClass _citygml_exporter::isCityModelClass(OwlClass iInstanceClass) const
+{
+	return (iInstanceClass == m_iCityModelClass) || IsClassAncestor(iInstanceClass, m_iCityModelClass);
+}
 
-		vecLowerCorner = vector<double>{ pdValues[0], pdValues[1], pdValues[2] };
+OwlClass _citygml_exporter::isBoundingShapeClass(OwlClass iInstanceClass) const
+{
+	return (iInstanceClass == m_iBoundingShapeClass) || IsClassAncestor(iInstanceClass, m_iBoundingShapeClass);
+}
 
-		// upperCorner
-		pdValues = nullptr;
-		iValuesCount = 0;
-		GetDatatypeProperty(
-			iUpperCornerInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "double-value"),
-			(void**)&pdValues,
-			&iValuesCount);
-		assert(iValuesCount == 3);
+OwlClass _citygml_exporter::isEnvelopeClass(OwlClass iInstanceClass) const
+{
+	return (iInstanceClass == m_iEnvelopeClass) || IsClassAncestor(iInstanceClass, m_iEnvelopeClass);
+}
 
-		vecUpperCorner = vector<double>{ pdValues[0], pdValues[1], pdValues[2] };
+bool _citygml_exporter::isCityObjectGroupMemberClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-		return true;
-	} // if (!strSrsName.empty() && ...
+	return ((iInstanceClass == m_iCityObjectGroupMemberClass) || IsClassAncestor(iInstanceClass, m_iCityObjectGroupMemberClass));
+}
 
-	return false;
+bool _citygml_exporter::isGeometryMemberClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	return ((iInstanceClass == m_iGeometryMemberClass) || IsClassAncestor(iInstanceClass, m_iGeometryMemberClass));
 }
 
-bool _citygml_exporter::retrieveEnvelopeSRSData(OwlInstance iEnvelopeInstance, string& strEPSGCode, vector<double>& vecCenter)
+bool _citygml_exporter::isBuildingElement(OwlInstance iInstance) const
 {
-	assert(iEnvelopeInstance != 0);
+	assert(iInstance != 0);
 
-	strEPSGCode = "";
-	vecCenter.clear();
+	OwlClass iInstanceClass = GetInstanceClass(iInstance);
+	assert(iInstanceClass != 0);
 
-	vector<double> vecLowerCorner;
-	vector<double> vecUpperCorner;
-	if (retrieveEnvelopeSRSData(iEnvelopeInstance, strEPSGCode, vecLowerCorner, vecUpperCorner))
+	if (isWallSurfaceClass(iInstanceClass))
 	{
-		vecCenter.push_back((vecLowerCorner[0] + vecUpperCorner[0]) / 2.);
-		vecCenter.push_back((vecLowerCorner[1] + vecUpperCorner[1]) / 2.);
-		vecCenter.push_back((vecLowerCorner[2] + vecUpperCorner[2]) / 2.);
+		return true;
+	}
 
+	if (isRoofSurfaceClass(iInstanceClass))
+	{
+		return true;
+	}
+	
+	if (isDoorClass(iInstanceClass))
+	{
+		return true;
+	}
+	
+	if (isWindowClass(iInstanceClass))
+	{
 		return true;
 	}
 
 	return false;
 }
 
-bool _citygml_exporter::transformEnvelopeSRSDataAsync(OwlInstance iEnvelopeInstance)
+bool _citygml_exporter::isBuildingClass(OwlClass iInstanceClass) const
 {
-	assert(iEnvelopeInstance != 0);
+	assert(iInstanceClass != 0);
 
-	string strEPSGCode;
-	vector<double> vecCenter;
-	if (retrieveEnvelopeSRSData(iEnvelopeInstance, strEPSGCode, vecCenter))
-	{
-		return getSite()->toWGS84Async(
-			atoi(strEPSGCode.c_str()),
-			(float)vecCenter[0],
-			(float)vecCenter[1],
-			(float)vecCenter[2]);
-	}
+	return (iInstanceClass == m_iBuildingClass) || IsClassAncestor(iInstanceClass, m_iBuildingClass);
+}
 
-	return false;
+bool _citygml_exporter::isBuildingPartClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	return (iInstanceClass == m_iBuildingPartClass) || IsClassAncestor(iInstanceClass, m_iBuildingPartClass);
 }
 
-bool _citygml_exporter::retrieveReferencePointSRSData(OwlInstance iReferencePointInstance, string& strEPSGCode, vector<double>& vecCenter)
+bool _citygml_exporter::isWallSurfaceClass(OwlClass iInstanceClass) const
 {
-	assert(iReferencePointInstance != 0);
+	assert(iInstanceClass != 0);
 
-	strEPSGCode = "";
-	vecCenter.clear();
+	return (iInstanceClass == m_iWallSurfaceClass) || IsClassAncestor(iInstanceClass, m_iWallSurfaceClass);
+}
 
-	string strSrsName = getStringAttributeValue(iReferencePointInstance, "srsName");
-	if (!strSrsName.empty() && (strSrsName.find("EPSG") != string::npos))
-	{
-		strEPSGCode = getEPSGCode(strSrsName);
-		assert(!strEPSGCode.empty());
+bool _citygml_exporter::isRoofSurfaceClass(OwlInstance iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-		int64_t iValuesCount = 0;
-		double* pdValue = nullptr;
-		GetDatatypeProperty(
-			iReferencePointInstance,
-			GetPropertyByName(getSite()->getOwlModel(), "points"),
-			(void**)&pdValue,
-			&iValuesCount);
-		assert(iValuesCount == 3);
+	return (iInstanceClass == m_iRoofSurfaceClass) || IsClassAncestor(iInstanceClass, m_iRoofSurfaceClass);
+}
 
-		vecCenter.push_back(pdValue[0]);
-		vecCenter.push_back(pdValue[1]);
-		vecCenter.push_back(pdValue[2]);
+bool _citygml_exporter::isDoorClass(OwlInstance iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-		return true;
-	}
+	return (iInstanceClass == m_iDoorClass) || IsClassAncestor(iInstanceClass, m_iDoorClass);
+}
 
-	return false;
+bool _citygml_exporter::isWindowClass(OwlInstance iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	return (iInstanceClass == m_iWindowClass) || IsClassAncestor(iInstanceClass, m_iWindowClass);
 }
 
-bool _citygml_exporter::transformReferencePointSRSDataAsync(OwlInstance iReferencePointInstance)
+bool _citygml_exporter::isCadastralParcelClass(OwlClass iInstanceClass) const
 {
-	assert(iReferencePointInstance != 0);
+	assert(iInstanceClass != 0);
 
-	string strEPSGCode;
-	vector<double> vecCenter;
-	if (retrieveReferencePointSRSData(iReferencePointInstance, strEPSGCode, vecCenter))
-	{
-		return getSite()->toWGS84Async(
-			atoi(strEPSGCode.c_str()),
-			(float)vecCenter[0],
-			(float)vecCenter[1],
-			(float)vecCenter[2]);
+	return (iInstanceClass == m_iCadastralParcelClass) || IsClassAncestor(iInstanceClass, m_iCadastralParcelClass);
+}
+
+bool _citygml_exporter::isPointPropertyClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	return (iInstanceClass == m_iPointPropertyClass) || IsClassAncestor(iInstanceClass, m_iPointPropertyClass);
+}
+
+bool _citygml_exporter::isReferencePointIndicatorClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	return (iInstanceClass == m_iReferencePointIndicatorClass) || IsClassAncestor(iInstanceClass, m_iReferencePointIndicatorClass);
+}
+
+bool _citygml_exporter::isFeatureClass(OwlInstance iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
+
+	if (isVegetationObjectClass(iInstanceClass) ||
+		isWaterObjectClass(iInstanceClass) ||
+		isBridgeObjectClass(iInstanceClass) ||
+		isTunnelObjectClass(iInstanceClass) ||
+		isTransportationObjectClass(iInstanceClass) ||
+		isTrafficSpaceClass(iInstanceClass) ||
+		isTrafficAreaClass(iInstanceClass) ||
+		isFurnitureObjectClass(iInstanceClass) ||
+		isReliefObjectClass(iInstanceClass) ||
+		isLandUseClass(iInstanceClass) ||
+		isCadastralParcelClass(iInstanceClass))
+	{
+		return true;
 	}
 
 	return false;
 }
 
-void _citygml_exporter::calculateHighestLODForBuildings()
+bool _citygml_exporter::isVegetationObjectClass(OwlClass iInstanceClass) const
 {
-	m_mapBuildingHighestLOD.clear();
-	m_iFilteredBuildingElements = 0;
+	assert(iInstanceClass != 0);
 
-	OwlClass iSchemasClass = GetClassByName(getSite()->getOwlModel(), "class:Schemas");
-	assert(iSchemasClass != 0);
+	return (iInstanceClass == m_iVegetationObjectClass) || IsClassAncestor(iInstanceClass, m_iVegetationObjectClass);
+}
 
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
-	{
-		OwlClass iInstanceClass = GetInstanceClass(iInstance);
-		assert(iInstanceClass != 0);
+bool _citygml_exporter::isWaterObjectClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-		if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
-		{
-			if (iInstanceClass != iSchemasClass)
-			{
-				if (isBuildingClass(iInstanceClass) || isBuildingPartClass(iInstanceClass))
-				{
-					if (m_mapBuildingHighestLOD.find(iInstance) == m_mapBuildingHighestLOD.end())
-					{
-						m_mapBuildingHighestLOD[iInstance] = -DBL_MAX;
+	return (iInstanceClass == m_iWaterObjectClass) || IsClassAncestor(iInstanceClass, m_iWaterObjectClass);
+}
 
-						calculateHighestLODForBuildingElements(iInstance, iInstance);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-				}
-				else
-				{
-					calculateHighestLODForBuildingsRecursively(iInstance);
-				}
-			}
-		} // if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+bool _citygml_exporter::isBridgeObjectClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	} // while (iInstance != 0)
+	return (iInstanceClass == m_iBridgeObjectClass) || IsClassAncestor(iInstanceClass, m_iBridgeObjectClass);
 }
 
-void _citygml_exporter::calculateHighestLODForBuildingsRecursively(OwlInstance iInstance)
+bool _citygml_exporter::isTunnelObjectClass(OwlClass iInstanceClass) const
 {
-	assert(iInstance != 0);
+	assert(iInstanceClass != 0);
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
-	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+	return (iInstanceClass == m_iTunnelObjectClass) || IsClassAncestor(iInstanceClass, m_iTunnelObjectClass);
+}
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
+bool _citygml_exporter::isTransportationObjectClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-				OwlClass iInstanceClass = GetInstanceClass(piValues[iValue]);
-				assert(iInstanceClass != 0);
+	return (iInstanceClass == m_iTransportationObjectClass) || IsClassAncestor(iInstanceClass, m_iTransportationObjectClass);
+}
 
-				if (isCityObjectGroupMemberClass(iInstanceClass))
-				{
-					continue; // Ignore
-				}
+bool _citygml_exporter::isFurnitureObjectClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-				if (isBuildingClass(iInstanceClass) || isBuildingPartClass(iInstanceClass))
-				{
-					if (m_mapBuildingHighestLOD.find(piValues[iValue]) == m_mapBuildingHighestLOD.end())
-					{
-						m_mapBuildingHighestLOD[piValues[iValue]] = -DBL_MAX;
+	return (iInstanceClass == m_iFurnitureObjectClass) || IsClassAncestor(iInstanceClass, m_iFurnitureObjectClass);
+}
 
-						calculateHighestLODForBuildingElements(piValues[iValue], piValues[iValue]);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-				}
-				else
-				{
-					calculateHighestLODForBuildingsRecursively(piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+bool _citygml_exporter::isReliefObjectClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	return (iInstanceClass == m_iReliefObjectClass) || IsClassAncestor(iInstanceClass, m_iReliefObjectClass);
 }
 
-void _citygml_exporter::calculateHighestLODForBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance)
+bool _citygml_exporter::isLandUseClass(OwlClass iInstanceClass) const
 {
-	assert(iBuildingInstance != 0);
-	assert(iInstance != 0);
-
-	updateBuildingHighestLOD(iBuildingInstance, iInstance);
+	assert(iInstanceClass != 0);
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
-	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+	return (iInstanceClass == m_iLandUseClass) || IsClassAncestor(iInstanceClass, m_iLandUseClass);
+}
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
+bool _citygml_exporter::isTrafficSpaceClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-				updateBuildingHighestLOD(iBuildingInstance, piValues[iValue]);
+	return (iInstanceClass == m_iTrafficSpaceClass) || IsClassAncestor(iInstanceClass, m_iTrafficSpaceClass);
+}
 
-				if (isBuildingElement(piValues[iValue]))
-				{
-					if (m_mapBuildingHighestLOD.find(piValues[iValue]) == m_mapBuildingHighestLOD.end())
-					{
-						m_mapBuildingHighestLOD[piValues[iValue]] = -DBL_MAX;
-					}
+bool _citygml_exporter::isTrafficAreaClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-					calculateHighestLODForBuildingElementGeometry(iBuildingInstance, piValues[iValue], piValues[iValue]);
-				}
+	return (iInstanceClass == m_iTrafficAreaClass) || IsClassAncestor(iInstanceClass, m_iTrafficAreaClass);
+}
 
-				calculateHighestLODForBuildingElements(iBuildingInstance, piValues[iValue]);
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+bool _citygml_exporter::isUnknownClass(OwlClass iInstanceClass) const
+{
+	assert(iInstanceClass != 0);
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	return (iInstanceClass == m_iThingClass) || IsClassAncestor(iInstanceClass, m_iThingClass);
 }
 
-void _citygml_exporter::calculateHighestLODForBuildingElementGeometry(OwlInstance iBuildingInstance, OwlInstance iBuildingElementInstance, OwlInstance iInstance)
+bool _citygml_exporter::retrieveEnvelopeSRSData(OwlInstance iEnvelopeInstance, string& strEPSGCode, vector<double>& vecLowerCorner, vector<double>& vecUpperCorner)
 {
-	assert(iBuildingInstance != 0);
-	assert(iBuildingElementInstance != 0);
-	assert(iInstance != 0);
+	assert(iEnvelopeInstance != 0);
 
-	updateBuildingHighestLOD(iBuildingInstance, iInstance);
+	strEPSGCode = "";
+	vecLowerCorner.clear();
+	vecUpperCorner.clear();
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
+	string strSrsName = getStringAttributeValue(iEnvelopeInstance, "srsName");
+	if (!strSrsName.empty() && (strSrsName.find("EPSG") != string::npos))
 	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+		strEPSGCode = getEPSGCode(strSrsName);
+		assert(!strEPSGCode.empty());
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
+		OwlInstance* piInstances = nullptr;
+		int64_t iInstancesCount = 0;
+		GetObjectProperty(
+			iEnvelopeInstance,
+			GetPropertyByName(getSite()->getOwlModel(), "$relations"),
+			&piInstances,
+			&iInstancesCount);
+		assert(iInstancesCount == 2);
 
-				updateBuildingHighestLOD(iBuildingInstance, piValues[iValue]);
+		OwlInstance iLowerCornerInstance = 0;
+		OwlInstance iUpperCornerInstance = 0;
 
-				if (isBuildingElement(piValues[iValue]))
-				{
-					continue;
-				}
+		string strTag0 = getTag(piInstances[0]);
+		string strTag1 = getTag(piInstances[1]);
 
-				if (!GetInstanceGeometryClass(piValues[iValue]) ||
-					!GetBoundingBox(piValues[iValue], nullptr, nullptr))
-				{
-					calculateHighestLODForBuildingElementGeometry(iBuildingInstance, iBuildingElementInstance, piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		if (_string::endsWith(strTag0, "lowerCorner"))
+		{
+			iLowerCornerInstance = piInstances[0];
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
-}
+			if (_string::endsWith(strTag1, "upperCorner"))
+			{
+				iUpperCornerInstance = piInstances[1];
+			}
+			else
+			{
+				assert(false);
 
-void _citygml_exporter::calculateHighestLODForProxyBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance)
-{
-	assert(iBuildingInstance != 0);
-	assert(iInstance != 0);
+				return false;
+			}
+		}
+		else if (_string::endsWith(strTag1, "lowerCorner"))
+		{
+			iLowerCornerInstance = piInstances[1];
 
-	updateBuildingHighestLOD(iBuildingInstance, iInstance);
+			if (_string::endsWith(strTag0, "upperCorner"))
+			{
+				iUpperCornerInstance = piInstances[0];
+			}
+			else
+			{
+				assert(false);
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
-	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+				return false;
+			}
+		}
+		else
 		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+			assert(false);
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
+			return false;
+		}
+
+		// lowerCorner
+		double* pdValues = nullptr;
+		int64_t iValuesCount = 0;
+		GetDatatypeProperty(
+			iLowerCornerInstance,
+			GetPropertyByName(getSite()->getOwlModel(), "double-value"),
+			(void**)&pdValues,
+			&iValuesCount);
+		assert(iValuesCount == 3);
 
-				updateBuildingHighestLOD(iBuildingInstance, piValues[iValue]);
+		vecLowerCorner = vector<double>{ pdValues[0], pdValues[1], pdValues[2] };
+
+		// upperCorner
+		pdValues = nullptr;
+		iValuesCount = 0;
+		GetDatatypeProperty(
+			iUpperCornerInstance,
+			GetPropertyByName(getSite()->getOwlModel(), "double-value"),
+			(void**)&pdValues,
+			&iValuesCount);
+		assert(iValuesCount == 3);
 
-				if (isBuildingElement(piValues[iValue]))
-				{
-					continue;
-				}
+		vecUpperCorner = vector<double>{ pdValues[0], pdValues[1], pdValues[2] };
 
-				if (!GetInstanceGeometryClass(piValues[iValue]) ||
-					!GetBoundingBox(piValues[iValue], nullptr, nullptr))
-				{
-					calculateHighestLODForProxyBuildingElements(iBuildingInstance, piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		return true;
+	} // if (!strSrsName.empty() && ...
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	return false;
 }
 
-void _citygml_exporter::updateBuildingHighestLOD(OwlInstance iBuildingInstance, OwlInstance iBuildingElementInstance)
+bool _citygml_exporter::retrieveEnvelopeSRSData(OwlInstance iEnvelopeInstance, string& strEPSGCode, vector<double>& vecCenter)
 {
-	assert(iBuildingInstance != 0);
-	assert(iBuildingElementInstance != 0);
+	assert(iEnvelopeInstance != 0);
 
-	double dLOD = getLODAsDouble(iBuildingElementInstance);
+	strEPSGCode = "";
+	vecCenter.clear();
 
-	auto itHighestLOD = m_mapBuildingHighestLOD.find(iBuildingInstance);
-	if (itHighestLOD != m_mapBuildingHighestLOD.end())
+	vector<double> vecLowerCorner;
+	vector<double> vecUpperCorner;
+	if (retrieveEnvelopeSRSData(iEnvelopeInstance, strEPSGCode, vecLowerCorner, vecUpperCorner))
 	{
-		if (itHighestLOD->second < dLOD)
-		{
-			m_mapBuildingHighestLOD.at(iBuildingInstance) = dLOD;
-		}
+		vecCenter.push_back((vecLowerCorner[0] + vecUpperCorner[0]) / 2.);
+		vecCenter.push_back((vecLowerCorner[1] + vecUpperCorner[1]) / 2.);
+		vecCenter.push_back((vecLowerCorner[2] + vecUpperCorner[2]) / 2.);
+
+		return true;
 	}
-	else
+
+	return false;
+}
+
+bool _citygml_exporter::transformEnvelopeSRSDataAsync(OwlInstance iEnvelopeInstance)
+{
+	assert(iEnvelopeInstance != 0);
+
+	string strEPSGCode;
+	vector<double> vecCenter;
+	if (retrieveEnvelopeSRSData(iEnvelopeInstance, strEPSGCode, vecCenter))
 	{
-		m_mapBuildingHighestLOD[iBuildingInstance] = dLOD;
+		return getSite()->toWGS84Async(
+			atoi(strEPSGCode.c_str()),
+			(float)vecCenter[0],
+			(float)vecCenter[1],
+			(float)vecCenter[2]);
 	}
+
+	return false;
 }
 
-void _citygml_exporter::calculateHighestLODForFeatures()
+bool _citygml_exporter::retrieveReferencePointSRSData(OwlInstance iReferencePointInstance, string& strEPSGCode, vector<double>& vecCenter)
 {
-	m_mapFeatureHighestLOD.clear();
-	m_iFilteredFeatureElements = 0;
+	assert(iReferencePointInstance != 0);
 
-	OwlClass iSchemasClass = GetClassByName(getSite()->getOwlModel(), "class:Schemas");
-	assert(iSchemasClass != 0);
+	strEPSGCode = "";
+	vecCenter.clear();
 
-	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
-	while (iInstance != 0)
+	string strSrsName = getStringAttributeValue(iReferencePointInstance, "srsName");
+	if (!strSrsName.empty() && (strSrsName.find("EPSG") != string::npos))
 	{
-		if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
-		{
-			OwlClass iInstanceClass = GetInstanceClass(iInstance);
-			assert(iInstanceClass != 0);
+		strEPSGCode = getEPSGCode(strSrsName);
+		assert(!strEPSGCode.empty());
 
-			if (iInstanceClass != iSchemasClass)
-			{
-				if (isFeatureClass(iInstanceClass))
-				{
-					if (m_mapFeatureHighestLOD.find(iInstance) == m_mapFeatureHighestLOD.end())
-					{
-						m_mapFeatureHighestLOD[iInstance] = -DBL_MAX;
+		int64_t iValuesCount = 0;
+		double* pdValue = nullptr;
+		GetDatatypeProperty(
+			iReferencePointInstance,
+			GetPropertyByName(getSite()->getOwlModel(), "points"),
+			(void**)&pdValue,
+			&iValuesCount);
+		assert(iValuesCount == 3);
 
-						calculateHighestLODForFeatureElements(iInstance, iInstance);
-					}
-					else
-					{
-						assert(false); // Internal error!
-					}
-				}
-				else
-				{
-					calculateHighestLODForFeaturesRecursively(iInstance);
-				}
-			}
-		} // if (GetInstanceInverseReferencesByIterator(iInstance, 0) == 0)
+		vecCenter.push_back(pdValue[0]);
+		vecCenter.push_back(pdValue[1]);
+		vecCenter.push_back(pdValue[2]);
 
-		iInstance = GetInstancesByIterator(getSite()->getOwlModel(), iInstance);
-	} // while (iInstance != 0)
+		return true;
+	}
+
+	return false;
 }
 
-void _citygml_exporter::calculateHighestLODForFeaturesRecursively(OwlInstance iInstance)
+bool _citygml_exporter::transformReferencePointSRSDataAsync(OwlInstance iReferencePointInstance)
 {
-	assert(iInstance != 0);
+	assert(iReferencePointInstance != 0);
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
+	string strEPSGCode;
+	vector<double> vecCenter;
+	if (retrieveReferencePointSRSData(iReferencePointInstance, strEPSGCode, vecCenter))
 	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
-		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
+		return getSite()->toWGS84Async(
+			atoi(strEPSGCode.c_str()),
+			(float)vecCenter[0],
+			(float)vecCenter[1],
+			(float)vecCenter[2]);
+	}
 
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
+	return false;
+}
 
-				OwlClass iInstanceClass = GetInstanceClass(piValues[iValue]);
-				assert(iInstanceClass != 0);
+/*static*/ double _citygml_exporter::getLowerLOD(double dLOD1, double dLOD2)
+{
+	// -DBL_MAX - no LOD
+	if (dLOD1 == -DBL_MAX)
+	{
+		return dLOD2;
+	}
 
-				if (isCityObjectGroupMemberClass(iInstanceClass))
-				{
-					continue; // Ignore
-				}
+	if (dLOD2 == -DBL_MAX)
+	{
+		return dLOD1;
+	}
 
-				if (isFeatureClass(iInstanceClass))
-				{
-					if (m_mapFeatureHighestLOD.find(piValues[iValue]) == m_mapFeatureHighestLOD.end())
-					{
-						m_mapFeatureHighestLOD[piValues[iValue]] = -DBL_MAX;
+	return fmin(dLOD1, dLOD2);
+}
 
-						calculateHighestLODForFeatureElements(piValues[iValue], piValues[iValue]);
-					}
-				}
-				else
-				{
-					calculateHighestLODForFeaturesRecursively(piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+/*static*/ bool _citygml_exporter::isLowerLOD(double dLOD, double dHighestLOD)
+{
+	if ((dLOD == -DBL_MAX) || (dHighestLOD == -DBL_MAX))
+	{
+		return false;
+	}
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	return (dHighestLOD - dLOD) > 0.0001;
 }
 
-void _citygml_exporter::calculateHighestLODForFeatureElements(OwlInstance iFeatureInstance, OwlInstance iInstance)
+double _citygml_exporter::updateBuildingHighestLOD(OwlInstance iBuildingInstance, OwlInstance iInstance)
 {
-	assert(iFeatureInstance != 0);
+	assert(iBuildingInstance != 0);
 	assert(iInstance != 0);
 
-	updateFeatureHighestLOD(iFeatureInstance, iInstance);
+	double dLOD = getCachedLODAsDouble(iInstance);
 
-	RdfProperty iProperty = GetInstancePropertyByIterator(iInstance, 0);
-	while (iProperty != 0)
+	auto itHighestLOD = m_mapBuildingHighestLOD.find(iBuildingInstance);
+	if (itHighestLOD != m_mapBuildingHighestLOD.end())
 	{
-		if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+		if (itHighestLOD->second < dLOD)
 		{
-			int64_t iValuesCount = 0;
-			OwlInstance* piValues = nullptr;
-			GetObjectProperty(iInstance, iProperty, &piValues, &iValuesCount);
-
-			for (int64_t iValue = 0; iValue < iValuesCount; iValue++)
-			{
-				if (piValues[iValue] == 0)
-				{
-					continue;
-				}
-
-				updateBuildingHighestLOD(iFeatureInstance, piValues[iValue]);
-
-				if (!GetInstanceGeometryClass(piValues[iValue]) ||
-					!GetBoundingBox(piValues[iValue], nullptr, nullptr))
-				{
-					calculateHighestLODForFeatureElements(iFeatureInstance, piValues[iValue]);
-				}
-			} // for (int64_t iValue = ...
-		} // if (GetPropertyType(iProperty) == OBJECTPROPERTY_TYPE)
+			itHighestLOD->second = dLOD;
+		}
+	}
+	else
+	{
+		m_mapBuildingHighestLOD[iBuildingInstance] = dLOD;
+	}
 
-		iProperty = GetInstancePropertyByIterator(iInstance, iProperty);
-	} // while (iProperty != 0)
+	return dLOD;
 }
 
-void _citygml_exporter::updateFeatureHighestLOD(OwlInstance iFeatureInstance, OwlInstance iFeatureElementInstance)
+double _citygml_exporter::updateFeatureHighestLOD(OwlInstance iFeatureInstance, OwlInstance iInstance)
 {
 	assert(iFeatureInstance != 0);
-	assert(iFeatureElementInstance != 0);
+	assert(iInstance != 0);
 
-	double dLOD = getLODAsDouble(iFeatureElementInstance);
+	double dLOD = getCachedLODAsDouble(iInstance);
 
 	auto itHighestLOD = m_mapFeatureHighestLOD.find(iFeatureInstance);
 	if (itHighestLOD != m_mapFeatureHighestLOD.end())
 	{
 		if (itHighestLOD->second < dLOD)
 		{
-			m_mapFeatureHighestLOD.at(iFeatureInstance) = dLOD;
+			itHighestLOD->second = dLOD;
 		}
 	}
 	else
 	{
 		m_mapFeatureHighestLOD[iFeatureInstance] = dLOD;
 	}
+
+	return dLOD;
 }
 
 // ************************************************************************************************
@@ -6922,7 +8397,7 @@ _cityjson_exporter::_cityjson_exporter(_gml2ifc_exporter* pSite)
 {
 	assert(iRootInstance != 0);
 
-	collectSRSData(iRootInstance);
+	collectSRSDataOnce(iRootInstance);
 
 	int iTransformationsCount = 0;
 
@@ -6977,26 +8452,6 @@ _cityjson_exporter::_cityjson_exporter(_gml2ifc_exporter* pSite)
 	return dLOD;
 }
 
-/*virtual*/ void _cityjson_exporter::onPreCreateSite(_matrix* pSiteMatrix) /*override*/
-{
-	assert(pSiteMatrix != 0);
-
-	if (m_iMetadataInstance != 0)
-	{
-		getMetadataCenter(m_iMetadataInstance, pSiteMatrix->_41, pSiteMatrix->_42, pSiteMatrix->_43);
-	}
-}
-
-/*virtual*/ void _cityjson_exporter::onPostCreateSite(SdaiInstance iSiteInstance) /*override*/
-{
-	assert(iSiteInstance != 0);
-
-	if (m_iMetadataInstance != 0)
-	{
-		setSiteMetadataSRSData(iSiteInstance, m_iMetadataInstance);
-	}
-}
-
 /*virtual*/ void _cityjson_exporter::collectSRSData(OwlInstance iRootInstance) /*override*/
 {
 	OwlInstance iInstance = GetInstancesByIterator(getSite()->getOwlModel(), 0);
@@ -7035,7 +8490,7 @@ _cityjson_exporter::_cityjson_exporter(_gml2ifc_exporter* pSite)
 	} // while (iInstance != 0)
 }
 
-/*virtual*/ void _cityjson_exporter::createSRSMapConversion() /*override*/
+/*virtual*/ void _cityjson_exporter::collectSRSs(set<string>& setSRSs) /*override*/
 {
 	// Root
 	if (m_iMetadataInstance != 0)
@@ -7044,25 +8499,32 @@ _cityjson_exporter::_cityjson_exporter(_gml2ifc_exporter* pSite)
 		vector<double> vecCenter;
 		if (retrieveMetadataSRSData(m_iMetadataInstance, strEPSGCode, vecCenter))
 		{
-			string strSRS = "EPSG:";
-			strSRS += strEPSGCode;
-
-			SdaiInstance iMapConversion = buildMapConversion(getGeometricRepresentationContextInstance(), buildProjectedCRS(strSRS));
-			assert(iMapConversion != 0);
-		} // if (retrieveMetadataSRSData(...
-	} // if (m_iMetadataInstance != 0)
+			setSRSs.insert(strEPSGCode);
+		}
+	}
 }
 
-/*virtual*/ void _cityjson_exporter::getXYZOffset(double& dX, double& dY, double& dZ)
+/*virtual*/ void _cityjson_exporter::readModelSite(_city_site& site) /*override*/
 {
-	dX = 0.;
-	dY = 0.;
-	dZ = 0.;
+	_citygml_exporter::readModelSite(site);
 
 	if (m_iMetadataInstance != 0)
 	{
-		getMetadataCenter(m_iMetadataInstance, dX, dY, dZ);
-	}
+		string strEPSGCode;
+		vector<double> vecLowerCorner;
+		vector<double> vecUpperCorner;
+		if (retrieveMetadataSRSData(m_iMetadataInstance, strEPSGCode, vecLowerCorner, vecUpperCorner))
+		{
+			site.m_enSRS = enumCitySRS::Metadata;
+			site.m_strEPSGCode = strEPSGCode;
+
+			for (int iValue = 0; iValue < 3; iValue++)
+			{
+				site.m_arLowerCorner[iValue] = vecLowerCorner[iValue];
+				site.m_arUpperCorner[iValue] = vecUpperCorner[iValue];
+			}
+		}
+	} // if (m_iMetadataInstance != 0)
 }
 
 OwlClass _cityjson_exporter::isCityJSONClass(OwlClass iInstanceClass) const
@@ -7075,25 +8537,6 @@ OwlClass _cityjson_exporter::isMetadataClass(OwlClass iInstanceClass) const
 	return (iInstanceClass == m_iMetadataClass) || IsClassAncestor(iInstanceClass, m_iMetadataClass);
 }
 
-void _cityjson_exporter::getMetadataCenter(OwlInstance iMetadataInstance, double& dX, double& dY, double& dZ)
-{
-	assert(iMetadataInstance != 0);
-
-	dX = 0.;
-	dY = 0.;
-	dZ = 0.;
-
-	string strEPSGCode;
-	vector<double> vecLowerCorner;
-	vector<double> vecUpperCorner;
-	if (retrieveMetadataSRSData(iMetadataInstance, strEPSGCode, vecLowerCorner, vecUpperCorner))
-	{
-		dX = (vecLowerCorner[0] + vecUpperCorner[0]) / 2.;
-		dY = (vecLowerCorner[1] + vecUpperCorner[1]) / 2.;
-		dZ = (vecLowerCorner[2] + vecUpperCorner[2]) / 2.;
-	}
-}
-
 bool _cityjson_exporter::transformMetadataSRSDataAsync(OwlInstance iMetadataInstance)
 {
 	assert(iMetadataInstance != 0);
@@ -7158,65 +8601,4 @@ bool _cityjson_exporter::retrieveMetadataSRSData(OwlInstance iMetadataInstance,
 	}
 
 	return false;
-}
-
-void _cityjson_exporter::setSiteMetadataSRSData(SdaiInstance iSiteInstance, OwlInstance iMetadataInstance)
-{
-	assert(iSiteInstance != 0);
-	assert(iMetadataInstance != 0);
-
-	string strEPSGCode;
-	vector<double> vecLowerCorner;
-	vector<double> vecUpperCorner;
-	if (retrieveMetadataSRSData(iMetadataInstance, strEPSGCode, vecLowerCorner, vecUpperCorner))
-	{
-		string strCoordinates;
-		if (getSite()->getWGS84(
-			atoi(strEPSGCode.c_str()),
-			(float)(vecLowerCorner[0] + vecUpperCorner[0]) / 2.f,
-			(float)(vecLowerCorner[1] + vecUpperCorner[1]) / 2.f,
-			(float)(vecLowerCorner[2] + vecUpperCorner[2]) / 2.f,
-			strCoordinates))
-		{
-			vector<double> vecCoordinates;
-			getPosValues(strCoordinates, vecCoordinates);
-
-			double dLatitude = vecCoordinates[0];
-			double dLongitude = vecCoordinates[1];
-
-			SdaiAggr pRefLatitude = sdaiCreateAggrBN(iSiteInstance, "RefLatitude");
-			assert(pRefLatitude != nullptr);
-
-			/*
-			  c[1] :=    a;                                           -- -50
-			  c[2] :=   (a - c[1]) * 60;                              -- -58
-			  c[3] :=  ((a - c[1]) * 60 - c[2]) * 60;                 -- -33
-			  c[4] := (((a - c[1]) * 60 - c[2]) * 60 - c[3]) * 1.e6;  -- -110400
-			*/
-
-			int64_t iRefLatitude1 = (int64_t)dLatitude;
-			int64_t iRefLatitude2 = (int64_t)((dLatitude - iRefLatitude1) * 60.);
-			int64_t iRefLatitude3 = (int64_t)(((dLatitude - iRefLatitude1) * 60. - iRefLatitude2) * 60.);
-			int64_t iRefLatitude4 = 0;
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude1);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude2);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude3);
-			sdaiAppend(pRefLatitude, sdaiINTEGER, &iRefLatitude4);
-
-			SdaiAggr pRefLongitude = sdaiCreateAggrBN(iSiteInstance, "RefLongitude");
-			assert(pRefLongitude != nullptr);
-
-			int64_t iRefLongitude1 = (int64_t)dLongitude;
-			int64_t iRefLongitude2 = (int64_t)((dLongitude - iRefLongitude1) * 60.);
-			int64_t iRefLongitude3 = (int64_t)(((dLongitude - iRefLongitude1) * 60. - iRefLongitude2) * 60.);
-			int64_t iRefLongitude4 = 0;
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude1);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude2);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude3);
-			sdaiAppend(pRefLongitude, sdaiINTEGER, &iRefLongitude4);
-
-			double dRefElevation = vecLowerCorner[2];
-			sdaiPutAttrBN(iSiteInstance, "RefElevation", sdaiREAL, &dRefElevation);
-		} // if (getSite()->getWGS84( ...
-	} // if (retrieveMetadataSRSData( ...
 }
\ No newline at end of file
@@ -14,6 +14,14 @@
 #endif
 
 #include "_guid.h"
+#include "_metrics.h"
+#include "_log_pipeline.h"
+#include "_input_stream.h"
+#include "_output_stream.h"
+#include "_zip_output_stream.h"
+#include "_geometry_buffer.h"
+#include "_city_model.h"
+#include "_city_model_cache.h"
 
 #include <string>
 #include <chrono>
@@ -27,8 +35,16 @@
 #include <time.h>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <functional>
 using namespace std;
 
+// ************************************************************************************************
+// The version of the converter; IfcApplication, '$EXPORT $CACHE'
+#define GML2IFC_VERSION "0.10"
+
 // ************************************************************************************************
 template<class T>
 class _auto_var
@@ -137,8 +153,120 @@ public: // methods
 	virtual const char* getWGS84(int iCRS, float fX, float fY, float fZ) = 0;
 };
 
+// ************************************************************************************************
+// Objects done/total per phase; Import and Save are reported as a single step
+typedef void(STDCALL* _progress_callback)(enumPhase enPhase, int64_t iDone, int64_t iTotal);
+
+// ************************************************************************************************
+// Owned by the caller; can be shared by several exporters, e.g. in a batch
+class _cancellation_token
+{
+
+private: // Members
+
+	atomic<bool> m_bCancelled;
+
+public: // Methods
+
+	_cancellation_token()
+		: m_bCancelled(false)
+	{}
+
+	virtual ~_cancellation_token()
+	{}
+
+	void cancel() { m_bCancelled = true; }
+	void reset() { m_bCancelled = false; }
+	bool isCancelled() const { return m_bCancelled; }
+};
+
+// ************************************************************************************************
+// Interned UTF-8 strings of an OWL model: string property values, tags and class names; the engine
+// serializes the characters as wchar_t while a scope is open (_string_table_scope) and each distinct
+// value is converted once; an id identifies a string, i.e. the comparisons are integer compares
+class _string_table
+{
+
+private: // Members
+
+	OwlModel m_iOwlModel;
+	RdfProperty m_iTagProperty;
+	int m_iScopesCount;
+
+	mutex m_mtx; // Filled lazily, read by several threads
+	deque<string> m_dqStrings; // Id : UTF-8
+	unordered_map<string, int> m_mapIds; // UTF-8 : Id
+	unordered_map<wstring, int> m_mapValues; // Value : Id
+	unordered_map<OwlInstance, int> m_mapTags; // Instance : Id
+	unordered_map<OwlClass, int> m_mapClassNames; // Class : Id
+	wstring m_strKey; // Lookup buffer
+
+public: // Methods
+
+	_string_table(OwlModel iOwlModel);
+	virtual ~_string_table();
+
+	void beginScope();
+	void endScope();
+
+	// nullptr - no value
+	const string* getValue(OwlInstance iInstance, RdfProperty iProperty);
+
+	// -1 - no tag
+	int getTagId(OwlInstance iInstance);
+	int getClassNameId(OwlClass iClass);
+	int getId(const string& strValue);
+
+	// Empty for -1
+	const string& getString(int iId);
+	const string& getTag(OwlInstance iInstance) { return getString(getTagId(iInstance)); }
+	const string& getClassName(OwlClass iClass) { return getString(getClassNameId(iClass)); }
+
+	static void toUTF8(const wchar_t* szValue, size_t iLength, string& strValue);
+
+private: // Methods
+
+	int readValue(OwlInstance iInstance, RdfProperty iProperty);
+	int intern(const string& strValue);
+};
+
+// ************************************************************************************************
+class _string_table_scope
+{
+
+private: // Members
+
+	_string_table* m_pStringTable;
+
+public: // Methods
+
+	_string_table_scope(_string_table* pStringTable)
+		: m_pStringTable(pStringTable)
+	{
+		m_pStringTable->beginScope();
+	}
+
+	virtual ~_string_table_scope()
+	{
+		m_pStringTable->endScope();
+	}
+};
+
 // ************************************************************************************************
 class _gml2ifc_exporter;
+class _exporter_base;
+
+// ************************************************************************************************
+// $MATERIAL entities
+enum class enumMaterialEntity : int
+{
+	Wall = 0,
+	Roof,
+	Door,
+	Window,
+	All,
+	Count,
+};
 
 // ************************************************************************************************
 class _material
@@ -179,6 +307,7 @@ class _property
 
 private: // Members
 
+	int m_iId;
 	string m_strType;
 	string m_strPropertySet;
 	string m_strName;
@@ -186,8 +315,9 @@ private: // Members
 
 public: // Methods
 
-	_property(const string& strType, const string& strPropertySet, const string& strName, const string& strOverrideName)
-		: m_strType(strType)
+	_property(int iId, const string& strType, const string& strPropertySet, const string& strName, const string& strOverrideName)
+		: m_iId(iId)
+		, m_strType(strType)
 		, m_strPropertySet(strPropertySet)
 		, m_strName(strName)
 		, m_strOverrideName(strOverrideName)
@@ -196,6 +326,7 @@ public: // Methods
 	virtual ~_property()
 	{}
 
+	int getId() const { return m_iId; }
 	const string& getType() const { return m_strType; }
 	const string& getPropertySet() const { return m_strPropertySet; }
 	const string& getName() const { return m_strName; }
@@ -203,67 +334,152 @@ public: // Methods
 };
 
 // ************************************************************************************************
+// Immutable after loadSettings(); the materials are resolved per entity and the properties have ids,
+// i.e. the lookups don't allocate; the names discovered during an export go to a separate table
 class _settings_provider
 {
 
 private: // Members
 
-	_gml2ifc_exporter* m_pSite;
+	// Reported by each exporter borrowing the settings (_conversion_environment)
+	vector<pair<enumLogEvent, string>> m_vecLoadMessages;
+
+	// The settings read (the lines); see _city_model_cache
+	uint64_t m_iSettingsHash;
+
+	// $MATERIAL
+	vector<_material> m_vecMaterials;
+	vector<int> m_vecDefaultMaterials; // enumMaterialEntity : Material; $OVERRIDE, $DEFAULT, $DEFAULT $ALL
+	vector<int> m_vecOverriddenMaterials; // enumMaterialEntity : Material
+
+	// $PROPERTY
+	vector<_property> m_vecProperties; // Id : Property
+	unordered_map<string, int> m_mapProperties; // Name : Id
+
+	// Not in the settings; Id >= m_vecProperties.size()
+	mutex m_mtxDynamicProperties;
+	deque<_property> m_dqDynamicProperties;
+	unordered_map<string, int> m_mapDynamicProperties; // Name : Id
 
-	// $ROOF, $DOOR, etc. or $ALL : _material*
-	map<string, _material*> m_mapDefaultMaterials;
-	map<string, _material*> m_mapOverriddenMaterials;
-	map<string, _property*> m_mapProperties;
+	// $LOG
+	enumLogEvent m_enLogMinLevel;
+	int m_iLogRateLimit;
+	bool m_bLogAsync;
+
+	// $METRICS
+	int m_iMetricsTopObjectsCount;
+	bool m_bMetricsEngineCalls;
+	bool m_bMetricsAllocations;
+
+	// $IMPORT
+	bool m_bImportMemoryMapped;
+	int m_iImportChunksCount; // 0 - disabled
+	int64_t m_iImportChunkThreshold; // bytes; smaller files are imported at once
+
+	// $EXPORT
+	int m_iExportThreadsCount; // City model face builders; 0 - disabled
+	bool m_bExportCache; // <input>.citymodel
 
 public: // Methods
 
-	_settings_provider(_gml2ifc_exporter* pSite, const wstring& strSettingsFile);
+	_settings_provider(const wstring& strSettingsFile);
 	virtual ~_settings_provider();
 
-	const map<string, _material*>& getDefaultMaterials() const { return m_mapDefaultMaterials; }
-	const map<string, _material*>& getOverriddenMaterials() const { return m_mapOverriddenMaterials; }
-	const map<string, _property*>& getProperties() const { return m_mapProperties; }
-	_property* getProperty(const string& strName, bool bCreateNewIfNeeded)
-	{
-		_property* pProperty = nullptr;
-
-		auto itProperty = m_mapProperties.find(strName);
-		if (itProperty != m_mapProperties.end())
-		{
-			pProperty = itProperty->second;
-		}
-		else
-		{
-			if (bCreateNewIfNeeded)
-			{
-				m_mapProperties[strName] = 
-					pProperty = new _property("", "set_BsAttributes&Properties", strName, strName);
-			}
-		}
-
-		return pProperty;
-	}
+	const vector<pair<enumLogEvent, string>>& getLoadMessages() const { return m_vecLoadMessages; }
+	uint64_t getSettingsHash() const { return m_iSettingsHash; }
+
+	const _material* getDefaultMaterial(enumMaterialEntity enEntity) const;
+	const _material* getOverriddenMaterial(enumMaterialEntity enEntity) const;
+	const _property* getProperty(const string& strName); // A new property if needed
+	enumLogEvent getLogMinLevel() const { return m_enLogMinLevel; }
+	int getLogRateLimit() const { return m_iLogRateLimit; }
+	bool getLogAsync() const { return m_bLogAsync; }
+	int getMetricsTopObjectsCount() const { return m_iMetricsTopObjectsCount; }
+	bool getMetricsEngineCalls() const { return m_bMetricsEngineCalls; }
+	bool getMetricsAllocations() const { return m_bMetricsAllocations; }
+	bool getImportMemoryMapped() const { return m_bImportMemoryMapped; }
+	int getImportChunksCount() const { return m_iImportChunksCount; }
+	int64_t getImportChunkThreshold() const { return m_iImportChunkThreshold; }
+	int getExportThreadsCount() const { return m_iExportThreadsCount; }
+	bool getExportCache() const { return m_bExportCache; }
 
 private: // Methods
 
 	void loadSettings(const wstring& strSettingsFile);
+	void resolveMaterials();
+	static bool getMaterialEntity(const string& strEntity, enumMaterialEntity& enEntity);
 
-	_gml2ifc_exporter* getSite() const { return m_pSite; }
+	void logWarn(const string& strEvent) { m_vecLoadMessages.push_back({ enumLogEvent::warning, strEvent }); }
+	void logErr(const string& strEvent) { m_vecLoadMessages.push_back({ enumLogEvent::error, strEvent }); }
 };
 
 // ************************************************************************************************
-class _gml2ifc_exporter
+// Process-wide, shared by the exporters with the same root folder (reference counted): the parsed
+// settings and the GIS options; a job borrows it instead of parsing CityGML2IFC.settings again;
+// the OWL class/property handles belong to an OWL model, i.e. they stay in the exporters.
+// It is deleted with the last reference, i.e. a host of consecutive exports holds a reference of its
+// own (the server; the dialog for a run) and the settings are read again after it is released.
+class _conversion_environment
 {
 
 private: // Members
 
 	wstring m_strRootFolder;
 	_settings_provider* m_pSettingsProvider;
+	int m_iReferencesCount;
+	double m_dLoadTime; // ms
+
+	static mutex s_mtx;
+	static map<wstring, _conversion_environment*> s_mapEnvironments; // Root folder : Environment
+
+	// SetGISOptionsW() is global
+	static const _conversion_environment* s_pGISOptionsEnvironment;
+	static _log_callback s_pGISOptionsLogCallback;
+
+public: // Methods
+
+	// bCreated - cold start
+	static _conversion_environment* acquire(const wstring& strRootFolder, _log_callback pLogCallback, bool& bCreated);
+	static void release(_conversion_environment* pEnvironment);
+
+	const wstring& getRootFolder() const { return m_strRootFolder; }
+	_settings_provider* getSettingsProvider() const { return m_pSettingsProvider; }
+	double getLoadTime() const { return m_dLoadTime; }
+
+private: // Methods
+
+	_conversion_environment(const wstring& strRootFolder);
+	virtual ~_conversion_environment();
+
+	void applyGISOptions(_log_callback pLogCallback);
+};
+
+// ************************************************************************************************
+class _gml2ifc_exporter
+{
+
+private: // Members
+
+	wstring m_strRootFolder;
+	_conversion_environment* m_pEnvironment;
+	_settings_provider* m_pSettingsProvider; // Borrowed from m_pEnvironment
+	_metrics* m_pMetrics;
 	_log_callback m_pLogCallback;
+	_log_pipeline* m_pLogPipeline;
+	_progress_callback m_pProgressCallback;
+	_cancellation_token* m_pCancellationToken;
+	enumPhase m_enProgressPhase;
+	chrono::steady_clock::time_point m_tpProgress;
 	CSRSTransformer* m_pSRSTransformer;
 	OwlModel m_iOwlModel;
 	OwlInstance m_iOwlRootInstance;
+	_exporter_base* m_pExporter; // Lives as long as the model; reused by all exports
+	int m_iTransformationsCount;
+	bool m_bMemoryMappedImport;
 	set<string> m_setLODs;
+	vector<_gml2ifc_exporter*> m_vecChunks; // Chunked import: the chunks after the first one
+	_city_model_cache* m_pCityModelCache; // '$EXPORT $CACHE'; nullptr - disabled or not an input file
+	bool m_bCachedImport; // The input is not imported; the city models are loaded from the cache
 
 public: // Methods
 
@@ -273,20 +489,36 @@ public: // Methods
 		CSRSTransformer* pSRSTransformer);
 	virtual ~_gml2ifc_exporter();
 
-	// pre-processing
+	// pre-processing; imports the model - exportAsIFC() doesn't parse the input again
 	int retrieveSRSData(const wstring& strInputFile);
 	int retrieveSRSData(unsigned char* szData, size_t iSize);
 
-	// import
+	// import; the SRS transformations are requested as well (CSRSTransformer)
 	void importGML(const wstring& strInputFile);
 	void importGML(unsigned char* szData, size_t iSize);
+	void importGML(_input_stream* pInputStream);
+	void setMemoryMappedImport(bool bMemoryMappedImport) { m_bMemoryMappedImport = bMemoryMappedImport; }
+	bool getMemoryMappedImport() const { return m_bMemoryMappedImport; }
+	int getTransformationsCount() const { return m_iTransformationsCount; }
 
 	// export
 	void exportAsIFC(const char* szTargetLODs, const wstring& strOuputFile);
+	void exportAsIFC(const char* szTargetLODs, _output_stream* pOutputStream);
+	unsigned char* exportAsIFC(const char* szTargetLODs, size_t& iOutputSize, bool bIfcZIP = false); // free()
+	bool exportAsIFC(const char* szTargetLODs, unsigned char* szBuffer, size_t iBufferSize, size_t& iOutputSize, bool bIfcZIP = false);
+	int64_t getIFCSize(const char* szTargetLODs); // dry run; a full conversion
+
+	// export; LODs : IFC - an IFC model per target, the city model (all LODs) is read once
+	void exportAsIFC(const vector<pair<string, wstring>>& vecTargets);
+	void exportAsIFC(const vector<pair<string, _output_stream*>>& vecTargets);
 
 	// import & export
 	void execute(const wstring& strInputFile, const wstring& strOuputFile);
+	void execute(const wstring& strInputFile, _output_stream* pOutputStream);
 	void execute(unsigned char* szData, size_t iSize, const wstring& strOuputFile);
+	void execute(unsigned char* szData, size_t iSize, _output_stream* pOutputStream);
+	unsigned char* execute(unsigned char* szData, size_t iSize, size_t& iOutputSize, bool bIfcZIP = false); // free()
+	void execute(_input_stream* pInputStream, _output_stream* pOutputStream);
 
 	// SRS
 	bool toWGS84Async(int iCRS, float fX, float fY, float fZ);
@@ -296,28 +528,58 @@ public: // Methods
 	const set<string>& getLODs() { return m_setLODs; }
 
 	// Settings
-	_material* getDefaultMaterial(const string& strEntity);
-	_material* getOverriddenMaterial(const string& strEntity);
-	_property* getProperty(const string& strName);
-	string getPropertyName(const string& strName);
-	string getPropertySet(const string& strName) const;
+	const _material* getDefaultMaterial(enumMaterialEntity enEntity) const;
+	const _material* getOverriddenMaterial(enumMaterialEntity enEntity) const;
+	const _property* getProperty(const string& strName);
+	const string& getPropertyName(const string& strName);
+	const string& getPropertySet(const string& strName);
+	int getExportThreadsCount() const;
+
+	// Metrics
+	_metrics* getMetrics() const { return m_pMetrics; }
+
+	// Progress & Cancellation
+	void setProgressCallback(_progress_callback pProgressCallback) { m_pProgressCallback = pProgressCallback; }
+	void setCancellationToken(_cancellation_token* pCancellationToken) { m_pCancellationToken = pCancellationToken; }
+	void reportProgress(enumPhase enPhase, int64_t iDone, int64_t iTotal);
+	bool isCancelled() const { return (m_pCancellationToken != nullptr) && m_pCancellationToken->isCancelled(); }
 
 	// Log
 	static string dateTimeStamp();
 	static string addDateTimeStamp(const string& strInput);
-	void logWrite(enumLogEvent enLogEvent, const string& strEvent);
+	bool isLogEnabled(enumLogEvent enLogEvent) const { return m_pLogPipeline->isEnabled(enLogEvent); }
+	void logWrite(enumLogEvent enLogEvent, const string& strEvent, const char* szKey = nullptr); // szKey - see _log_pipeline
 	void logInfo(const string& strEvent) { logWrite(enumLogEvent::info, strEvent); }
 	void logWarn(const string& strEvent) { logWrite(enumLogEvent::warning, strEvent); }
 	void logErr(const string& strEvent) { logWrite(enumLogEvent::error, strEvent); }
+	void flushLog() { m_pLogPipeline->flush(); }
+	void* getLogContext() const { return m_pLogPipeline->getContext(); } // See _log_context_scope
 
 	OwlModel getOwlModel() const { return m_iOwlModel; }
 	OwlInstance getOwlRootInstance() const { return m_iOwlRootInstance; }
+	_exporter_base* getExporter() const { return m_pExporter; }
+	const vector<_gml2ifc_exporter*>& getChunks() const { return m_vecChunks; }
+	_city_model_cache* getCityModelCache() const { return m_pCityModelCache; }
+	bool isCachedImport() const { return m_bCachedImport; }
 
 private: // Methods
 
 	void setFormatSettings(OwlModel iOwlModel);
+	void importFile(const wstring& strInputFile, bool bCachedImport);
+	void importCore(const function<bool()>& fnImport);
+	bool importCachedModel();
+	void importOnCacheMiss();
+	void deleteCityModelCache();
+	static enumCityModelFormat getFormat(OwlModel iOwlModel);
+	bool importChunks(const wstring& strInputFile, int iChunksCount, bool& bFailed);
+	void deleteChunks();
+	void createExporter();
+	void deleteExporter();
+	void retrieveSRSDataOnImport();
 	int retrieveSRSDataCore(OwlInstance iRootInstance);
-	void executeCore(OwlInstance iRootInstance, const wstring& strOuputFile);	
+	void executeCore(OwlInstance iRootInstance, _output_stream* pOutputStream);
+	static bool isIfcZIP(const wstring& strOuputFile);
+	static string getIfcZIPEntryName(const wstring& strOuputFile);
 };
 
 // ************************************************************************************************
@@ -328,7 +590,8 @@ private: // Members
 
 	_gml2ifc_exporter* m_pSite;
 
-	RdfProperty m_iTagProperty;
+	_string_table* m_pStringTable;
+	int m_iDefaultMaterialId;
 
 	SdaiModel m_iSdaiModel;	
 	SdaiInstance m_iPersonInstance;
@@ -346,9 +609,12 @@ private: // Members
 	SdaiInstance m_iSiteInstance;
 	SdaiInstance m_iSiteInstancePlacement;	
 	SdaiInstance m_iGeometricRepresentationContextInstance;
+	map<string, SdaiInstance> m_mapRepresentationSubContexts; // LOD : IfcGeometricRepresentationSubContext
+	SdaiInstance m_iRepresentationContextInstance; // ContextOfItems; 0 - IfcGeometricRepresentationContext
 
 	set<string> m_setTargetLODs;
 	bool m_bHighestLOD;
+	bool m_bAllLODs; // A representation sub-context per LOD
 
 public: // Methods
 
@@ -360,10 +626,14 @@ public: // Methods
 	virtual void retrieveLODs(set<string>& setLODs) { setLODs.clear(); }	
 
 	// export
-	void execute(OwlInstance iRootInstance, const char* szTargetLODs, const wstring& strOuputFile);
+	void execute(OwlInstance iRootInstance, const char* szTargetLODs, _output_stream* pOutputStream);
+	void execute(OwlInstance iRootInstance, const vector<pair<string, _output_stream*>>& vecTargets); // LODs : IFC
+	void executeChunk(OwlInstance iRootInstance, _exporter_base* pHost); // Chunked import
+	static void parseTargetLODs(const char* szTargetLODs, set<string>& setTargetLODs, bool& bHighestLOD, bool& bAllLODs);
 
 	_gml2ifc_exporter* getSite() const { return m_pSite; }
 	SdaiModel getSdaiModel() const { return m_iSdaiModel; }
+	_string_table* getStringTable() const { return m_pStringTable; }
 	SdaiInstance getPersonInstance();
 	SdaiInstance getOrganizationInstance();
 	SdaiInstance getPersonAndOrganizationInstance();
@@ -378,25 +648,29 @@ public: // Methods
 	SdaiInstance getProjectInstance();
 	SdaiInstance getSiteInstance(SdaiInstance& iSiteInstancePlacement);
 	SdaiInstance getGeometricRepresentationContextInstance();
+	SdaiInstance getRepresentationSubContextInstance(const string& strLOD);
+	SdaiInstance getRepresentationContextInstance();
 
 	const set<string>& getTargetLODs() const { return m_setTargetLODs; }
 	bool getHighestLOD() const { return m_bHighestLOD; }
+	bool getAllLODs() const { return m_bAllLODs; }
 
 protected: // Methods
 
-	virtual bool isBuildingElementFiltered(OwlInstance iBuildingInstance, OwlInstance iInstance) = 0;
-	virtual bool isFeatureElementFiltered(OwlInstance iFeatureInstance, OwlInstance iInstance) = 0;
-
 	virtual void preProcessing() {}
-	virtual void executeCore(OwlInstance iRootInstance, const wstring& strOuputFile) = 0;
+	virtual void prepareExport(OwlInstance /*iRootInstance*/) {} // Once for the targets of an export
+	virtual void executeCore(OwlInstance iRootInstance, _output_stream* pOutputStream) = 0;
+	virtual void executeChunkCore(OwlInstance /*iRootInstance*/, _exporter_base* /*pHost*/) {}
 	virtual void postProcessing() {}
 
-	virtual void onPreCreateSite(_matrix* pSiteMatrix) {}
+	virtual void onPreCreateSite(string& strName, _matrix* pSiteMatrix);
 	virtual void onPostCreateSite(SdaiInstance iSiteInstance) {}
 
 	/* Model */
 	void createIfcModel(const wchar_t* szSchemaName);
-	void saveIfcFile(const wchar_t* szFileName);
+	void copyIfcModel(const _exporter_base* pSource);
+	void setRepresentationContextInstance(SdaiInstance iRepresentationContextInstance) { m_iRepresentationContextInstance = iRepresentationContextInstance; }
+	void saveIfcFile(_output_stream* pOutputStream);
 
 	/* Geometry */
 	SdaiInstance buildSIUnitInstance(const char* szUnitType, const char* szPrefix, const char* szName);
@@ -473,8 +747,8 @@ protected: // Methods
 	SdaiInstance buildRepresentationMap(_matrix* pMatrix, const vector<SdaiInstance>& vecRepresentations);
 	SdaiInstance buildMappedItem(
 		const vector<SdaiInstance>& vecRepresentations,
-		OwlInstance iReferencePointMatrixInstance,
-		OwlInstance iTransformationMatrixInstance);
+		const double* pdReferencePointMatrix,
+		const double* pdTransformationMatrix);
 
 	/* CRS */
 	SdaiInstance buildMapConversion(OwlInstance iSourceCRSInstance, OwlInstance iTargetCRSInstance);
@@ -483,7 +757,9 @@ protected: // Methods
 	string getEPSG(const string& strSrsName);
 
 	/* Style */
+	void readMaterial(OwlInstance iOwlInstance, _geometry_material& material) const;
 	void createStyledItemInstance(OwlInstance iOwlInstance, SdaiInstance iSdaiInstance);
+	void createStyledItemInstance(const _geometry_material& material, SdaiInstance iSdaiInstance);
 	void createStyledItemInstance(SdaiInstance iSdaiInstance, double dR, double G, double dB, double dTransparency);
 	void createStyledItemInstance(SdaiInstance iSdaiInstance, SdaiInstance iColorRgbInstance, double dTransparency);
 	virtual void createDefaultStyledItemInstance(SdaiInstance iSdaiInstance) {}
@@ -520,15 +796,16 @@ protected: // Methods
 	SdaiInstance buildRelAssociatesMaterial(SdaiInstance iBuildingElementInstance, double dThickness);
 
 	/* Helpers */
-	string getTag(OwlInstance iInstance) const;
+	const string& getTag(OwlInstance iInstance) const;
 	void getXMLElementPrefixAndName(const string& strUniqueName, string& strPrefix, string& strName) const;
-	string getStringAttributeValue(OwlInstance iInstance, const string& strName) const;
-	string getStringPropertyValue(OwlInstance iInstance, const string& strName) const;
+	const string& getStringAttributeValue(OwlInstance iInstance, const string& strName) const;
+	const string& getStringPropertyValue(OwlInstance iInstance, const string& strName) const;
 	void getDoublePropertyValue(OwlInstance iInstance, const string& strName, vector<double>& vecValue) const;
 	OwlInstance* getObjectProperty(OwlInstance iInstance, const string& strPropertyName, int64_t& iInstancesCount) const;
-	bool hasObjectProperty(OwlInstance iInstance, const string& strPropertyName);
+	bool hasObjectProperty(OwlInstance iInstance, const string& strPropertyName) const;
 	void getPosValues(const string& strContent, vector<double>& vecValues) const;
 	void getPosValuesW(const wstring& strContent, vector<double>& vecValues) const;
+	void logClassEvent(enumLogEvent enLogEvent, const char* szEvent, OwlClass iClass) const;
 };
 
 // ************************************************************************************************
@@ -549,8 +826,9 @@ private: // Members
 	OwlClass m_iPoint3DClass;
 	OwlClass m_iCollectionClass;
 	OwlClass m_iTransformationClass;	
+	bool m_bModelDataCollected; // Default state & world; once per model
 	map<OwlInstance, bool> m_mapInstanceDefaultState;
-	map<OwlInstance, vector<SdaiInstance>> m_mapMappedItems; // OwlInstance : Geometries
+	map<pair<OwlInstance, SdaiInstance>, vector<SdaiInstance>> m_mapMappedItems; // OwlInstance, ContextOfItems (LOD) : Geometries
 
 	// CRS
 	OwlClass m_iCityModelClass;
@@ -559,6 +837,7 @@ private: // Members
 	OwlInstance m_iEnvelopeInstance;
 	map<OwlInstance, OwlInstance> m_mapBuildingSRS; // Building : Envelope
 	map<OwlInstance, OwlInstance> m_mapParcelSRS; // Parcel : Reference Point		
+	bool m_bSRSDataCollected;
 
 	// CityObjectGroup
 	OwlClass m_iCityObjectGroupMemberClass;
@@ -596,17 +875,30 @@ private: // Members
 	map<OwlInstance, vector<OwlInstance>> m_mapFeatures; // Feature : Supported Elements
 	map<OwlInstance, vector<OwlInstance>> m_mapFeatureElements; // Feature Supported Element : Geometries
 
+	// Properties (UOM); see _string_table
+	int m_iThingClassNameId;
+	int m_iLengthTypeClassNameId;
+	int m_iAreaValueClassNameId;
+
 	// LODs
+	map<OwlInstance, string> m_mapLODs; // Instance : LOD; shared by the exports
+	map<OwlInstance, double> m_mapLODsAsDouble; // Instance : LOD; shared by the exports
 	map<OwlInstance, double> m_mapBuildingHighestLOD; // Building : Highest LOD
-	int m_iFilteredBuildingElements;
+	int m_iFilteredBuildingElements; // Elements and Element Geometries
 	map<OwlInstance, double> m_mapFeatureHighestLOD; // Feature : Highest LOD
 	int m_iFilteredFeatureElements;
+	map<OwlInstance, _city_lod> m_mapPathLODs; // Element/Geometry : LODs on the paths from the Building/Feature
+
+	// City Model; all LODs, read once per model; the IFC models are created from it
+	_city_model* m_pCityModel;
+	bool m_bCityModelRead;
 	
 	// Sites
 	vector<SdaiInstance> m_vecSiteInstances;
+	set<string> m_setChunkSRSs; // Chunked import: EPSG codes
 	
 	 // Temp
-	OwlInstance m_iCurrentOwlBuildingElementInstance;
+	enumCityElement m_enCurrentElement;
 	double m_dXOffset;
 	double m_dYOffset;
 	double m_dZOffset;
@@ -628,59 +920,106 @@ public: // Methods
 
 protected:  // Methods	
 
-	virtual bool isBuildingElementFiltered(OwlInstance iBuildingInstance, OwlInstance iInstance) override;
-	virtual bool isFeatureElementFiltered(OwlInstance iFeatureInstance, OwlInstance iInstance) override;
+	bool isElementFiltered(const _city_object* pObject, const _city_lod& lod);
 	virtual string getLOD(OwlInstance iInstance) const;
 	virtual double getLODAsDouble(OwlInstance iInstance) const;
+	const string& getCachedLOD(OwlInstance iInstance);
+	double getCachedLODAsDouble(OwlInstance iInstance);
+	string getGeometryLOD(OwlInstance iElementInstance, OwlInstance iGeometryInstance);
+	bool findGeometryLOD(OwlInstance iElementInstance, OwlInstance iInstance, const string& strPathLOD, set<OwlInstance>& setVisited, string& strLOD);
+	_city_lod getPathLOD(const _city_lod& parentLOD, OwlInstance iInstance);
+	void addPathLOD(OwlInstance iInstance, const _city_lod& pathLOD);
 
 	virtual void preProcessing() override;
-	virtual void executeCore(OwlInstance iRootInstance, const wstring& strOuputFile) override;
+	virtual void prepareExport(OwlInstance iRootInstance) override;
+	virtual void executeCore(OwlInstance iRootInstance, _output_stream* pOutputStream) override;
+	virtual void executeChunkCore(OwlInstance iRootInstance, _exporter_base* pHost) override;
 	virtual void postProcessing() override;
+	void resetExport();
+
+	void collectModelData();
 
-	virtual void onPreCreateSite(_matrix* pSiteMatrix) override;
+	// Metrics
+	void nameObjectMetrics();
+	void reportObjectMetrics();
+	void reportObjectMetrics(const _object_metrics* pObject);
+	void reportEngineCallMetrics();
+	void reportAllocationMetrics();
+
+	virtual void onPreCreateSite(string& strName, _matrix* pSiteMatrix) override;
 	virtual void onPostCreateSite(SdaiInstance iSiteInstance) override;
 
 	virtual void createDefaultStyledItemInstance(SdaiInstance iSdaiInstance) override;
 	virtual bool createOverriddenStyledItemInstance(SdaiInstance iSdaiInstance) override;
 
 	// SRS
+	void collectSRSDataOnce(OwlInstance iRootInstance);
 	virtual void collectSRSData(OwlInstance iRootInstance);
-	virtual void createSRSMapConversion();
-	virtual void getXYZOffset(double& dX, double& dY, double& dZ);
+	virtual void collectSRSs(set<string>& setSRSs);
+	virtual void readModelSite(_city_site& site);
+	void readEnvelopeSite(OwlInstance iEnvelopeInstance, _city_site& site);
+	void readReferencePointSite(OwlInstance iReferencePointInstance, _city_site& site);
+	void createSRSMapConversion();
+	void getXYZOffset(double& dX, double& dY, double& dZ);
+	SdaiInstance createSite(const _city_object* pObject, SdaiInstance& iSiteInstancePlacement);
+	void setSiteSRSData(SdaiInstance iSiteInstance, const _city_site& site);
+	bool getSiteWGS84(const _city_site& site, string& strCoordinates);
+
+	// City Model; the OWL model is read on a thread, the faces are built in parallel
+	void readCityModel();
+	void clearDiscovery();
+	void addCityObjects(enumCityObject enObject, const map<OwlInstance, vector<OwlInstance>>& mapObjects, const map<OwlInstance, vector<OwlInstance>>& mapElements);
+	void readCityObjects(const vector<_city_object*>& vecObjects, int iThreadsCount);
+	void readCityObject(_city_object* pObject);
+	void readAttributes(OwlInstance iInstance, vector<_city_attribute>& vecAttributes);
+	void readObjectAttributes(OwlInstance iInstance, vector<_city_attribute>& vecAttributes);
+	enumCityElement getCityElement(OwlClass iInstanceClass) const;
+	enumCityFeature getCityFeature(OwlClass iInstanceClass) const;
+
+	// City Model Cache ('$EXPORT $CACHE')
+	bool loadCityModel();
+	void saveCityModel();
 
 	// Buildings
-	void createBuildings(SdaiInstance iSiteInstance, SdaiInstance iSiteInstancePlacement);
+	void searchForBuildings();
 	void createBuildings();
+	void createBuilding(const _city_object* pBuilding, map<SdaiInstance, vector<SdaiInstance>>& mapSite2Instances);
 	void createBuildingsRecursively(OwlInstance iInstance);
-	void searchForBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance);
-	void searchForProxyBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance);
-	void searchForBuildingElementGeometry(OwlInstance iBuildingInstance, OwlInstance iBuildingElementInstance, OwlInstance iInstance);
+	void searchForBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance, const _city_lod& pathLOD);
+	void searchForProxyBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance, const _city_lod& pathLOD);
+	void searchForBuildingElementGeometry(OwlInstance iBuildingInstance, OwlInstance iBuildingElementInstance, OwlInstance iInstance, const _city_lod& pathLOD);
 
 	// Features
-	void createFeatures(SdaiInstance iSiteInstance, SdaiInstance iSiteInstancePlacement);
+	void searchForFeatures();
 	void createFeatures();
+	void createFeature(const _city_object* pFeature, map<SdaiInstance, vector<SdaiInstance>>& mapSite2Instances);
 	void createFeaturesRecursively(OwlInstance iInstance);
-	void searchForFeatureElements(OwlInstance iFeatureInstance, OwlInstance iInstance);
-
-	// Geometry
-	void createGeometry(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
-	void createSolid(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
-	void createCompositeSolid(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
-	void createMultiSolid(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
-	void createMultiSurface(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
-	void createCompositeSurface(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
-	void createSurfaceMember(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
-	void createBoundaryRepresentation(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
+	void searchForFeatureElements(OwlInstance iFeatureInstance, OwlInstance iInstance, const _city_lod& pathLOD);
+
+	// Geometry; read into _geometry_buffer (thread-safe), then the SDAI instances are created from it
+	void createElementGeometry(const _city_object* pObject, const _city_element& element, vector<SdaiInstance>& vecGeometryInstances);
+	void createGeometry(const _geometry_buffer* pGeometryBuffer, int64_t iGeometry, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
+	void readGeometry(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readSolid(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readCompositeSolid(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readMultiSolid(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readMultiSurface(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readCompositeSurface(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readSurfaceMember(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readBoundaryRepresentation(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readPolyLine3D(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void readMappedItem(_geometry_buffer* pGeometryBuffer, OwlInstance iInstance, vector<int64_t>& vecGeometries);
+	void createBoundaryRepresentation(const _geometry_buffer* pGeometryBuffer, const _geometry& geometry, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
+	void createPolyLine3D(const _geometry_buffer* pGeometryBuffer, const _geometry& geometry, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
+	void createMappedItem(const _geometry_buffer* pGeometryBuffer, const _geometry& geometry, vector<SdaiInstance>& vecGeometryInstances);
 	void createReferencePointIndicator(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
 	void createPoint3D(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
 	void createPoint3DSet(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);
-	void createPolyLine3D(OwlInstance iInstance, vector<SdaiInstance>& vecGeometryInstances, bool bCreateIfcShapeRepresentation);	
 
-	void createProperties(OwlInstance iOwlInstance, SdaiInstance iSdaiInstance);
-	void createObjectProperties(OwlInstance iOwlInstance, map<string, vector<SdaiInstance>>& mapPropertySets);
+	void createProperties(const _city_object* pObject, int64_t iFirstAttribute, int64_t iAttributesCount, SdaiInstance iSdaiInstance);
 
 	SdaiInstance buildBuildingElementInstance(
-		OwlInstance iOwlInstance,
+		const _city_element& element,
 		_matrix* pMatrix,
 		SdaiInstance iPlacementRelativeTo,
 		SdaiInstance& iBuildingElementInstancePlacement,
@@ -735,10 +1074,6 @@ protected:  // Methods
 private: // Methods
 
 	// SRS
-	void getEnvelopeCenter(OwlInstance iEnvelopeInstance, double& dX, double& dY, double& dZ);
-	void getReferencePoint(OwlInstance iReferencePointInstance, double& dX, double& dY, double& dZ);
-	void setSiteEnvelopeSRSData(SdaiInstance iSiteInstance, OwlInstance iEnvelopeInstance);
-	void setSiteReferencePointSRSData(SdaiInstance iSiteInstance, OwlInstance iReferencePointInstance);	
 	bool retrieveEnvelopeSRSData(OwlInstance iEnvelopeInstance, string& strEPSGCode, vector<double>& vecLowerCorner, vector<double>& vecUpperCorner);
 	bool retrieveEnvelopeSRSData(OwlInstance iEnvelopeInstance, string& strEPSGCode, vector<double>& vecCenter);
 	bool transformEnvelopeSRSDataAsync(OwlInstance iEnvelopeInstance);
@@ -746,16 +1081,10 @@ private: // Methods
 	bool transformReferencePointSRSDataAsync(OwlInstance iReferencePointInstance);
 
 	// LODs
-	void calculateHighestLODForBuildings();
-	void calculateHighestLODForBuildingsRecursively(OwlInstance iInstance);
-	void calculateHighestLODForBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance);
-	void calculateHighestLODForBuildingElementGeometry(OwlInstance iBuildingInstance, OwlInstance iBuildingElementInstance, OwlInstance iInstance);
-	void calculateHighestLODForProxyBuildingElements(OwlInstance iBuildingInstance, OwlInstance iInstance);
-	void updateBuildingHighestLOD(OwlInstance iBuildingInstance, OwlInstance iBuildingElementInstance);
-	void calculateHighestLODForFeatures();
-	void calculateHighestLODForFeaturesRecursively(OwlInstance iInstance);
-	void calculateHighestLODForFeatureElements(OwlInstance iFeatureInstance, OwlInstance iInstance);
-	void updateFeatureHighestLOD(OwlInstance iFeatureInstance, OwlInstance iFeatureElementInstance);
+	static double getLowerLOD(double dLOD1, double dLOD2);
+	static bool isLowerLOD(double dLOD, double dHighestLOD);
+	double updateBuildingHighestLOD(OwlInstance iBuildingInstance, OwlInstance iInstance);
+	double updateFeatureHighestLOD(OwlInstance iFeatureInstance, OwlInstance iInstance);
 };
 
 // ************************************************************************************************
@@ -791,12 +1120,9 @@ protected: // Methods
 	virtual string getLOD(OwlInstance iInstance) const override;
 	virtual double getLODAsDouble(OwlInstance iInstance) const override;
 
-	virtual void onPreCreateSite(_matrix* pSiteMatrix) override;
-	virtual void onPostCreateSite(SdaiInstance iSiteInstance) override;
-
 	virtual void collectSRSData(OwlInstance iRootInstance) override;
-	virtual void createSRSMapConversion() override;
-	virtual void getXYZOffset(double& dX, double& dY, double& dZ) override;
+	virtual void collectSRSs(set<string>& setSRSs) override;
+	virtual void readModelSite(_city_site& site) override;
 
 	// CRS
 	OwlClass isCityJSONClass(OwlClass iInstanceClass) const;
@@ -804,9 +1130,7 @@ protected: // Methods
 
 private: // Methods
 
-	void getMetadataCenter(OwlInstance iMetadataInstance, double& dX, double& dY, double& dZ);
 	bool transformMetadataSRSDataAsync(OwlInstance iMetadataInstance);
 	bool retrieveMetadataSRSData(OwlInstance iMetadataInstance, string& strEPSGCode, vector<double>& vecLowerCorner, vector<double>& vecUpperCorner);
 	bool retrieveMetadataSRSData(OwlInstance iMetadataInstance, string& strEPSGCode, vector<double>& vecCenter);
-	void setSiteMetadataSRSData(SdaiInstance iSiteInstance, OwlInstance iMetadataInstance);
 };
\ No newline at end of file
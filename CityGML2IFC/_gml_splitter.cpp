@@ -0,0 +1,562 @@
+#include "pch.h"
+#include "_gml_splitter.h"
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+// ************************************************************************************************
+_gml_splitter::_gml_splitter(const unsigned char* szData, size_t iSize)
+	: m_szData(szData)
+	, m_iSize(iSize)
+	, m_strError()
+	, m_iRootStartTagEnd(0)
+	, m_strRootEndTag()
+	, m_vecSharedElements()
+	, m_vecMembers()
+{
+	assert(m_szData != nullptr);
+}
+
+/*virtual*/ _gml_splitter::~_gml_splitter()
+{
+}
+
+bool _gml_splitter::split(int iChunksCount, vector<_chunk_input_stream*>& vecChunks)
+{
+	assert(iChunksCount > 1);
+	assert(vecChunks.empty());
+
+	if (!scan())
+	{
+		return false;
+	}
+
+	if (m_vecMembers.size() < 2)
+	{
+		m_strError = "Less than 2 members.";
+
+		return false;
+	}
+
+	size_t iMembersSize = 0;
+	for (const auto& prMember : m_vecMembers)
+	{
+		iMembersSize += prMember.second;
+	}
+
+	iChunksCount = (int)min<size_t>((size_t)iChunksCount, m_vecMembers.size());
+	size_t iChunkSize = (iMembersSize + iChunksCount - 1) / iChunksCount;
+
+	_chunk_input_stream* pChunk = nullptr;
+	size_t iCurrentChunkSize = 0;
+	vector<size_t> vecMemberChunks;
+	for (size_t iMember = 0; iMember < m_vecMembers.size(); iMember++)
+	{
+		if (pChunk == nullptr)
+		{
+			pChunk = new _chunk_input_stream(_string::format("chunk %d", (int)vecChunks.size() + 1));
+			vecChunks.push_back(pChunk);
+
+			pChunk->addRange(m_szData, m_iRootStartTagEnd);
+			for (const auto& prSharedElement : m_vecSharedElements)
+			{
+				pChunk->addRange((const unsigned char*)"\n", 1);
+				pChunk->addRange(m_szData + prSharedElement.first, prSharedElement.second);
+			}
+
+			iCurrentChunkSize = 0;
+		} // if (pChunk == nullptr)
+
+		const auto& prMember = m_vecMembers[iMember];
+		vecMemberChunks.push_back(vecChunks.size() - 1);
+
+		pChunk->addRange((const unsigned char*)"\n", 1);
+		pChunk->addRange(m_szData + prMember.first, prMember.second);
+
+		iCurrentChunkSize += prMember.second;
+
+		// The last chunk takes the rest
+		if ((iCurrentChunkSize >= iChunkSize) && ((int)vecChunks.size() < iChunksCount))
+		{
+			pChunk->addRange((const unsigned char*)m_strRootEndTag.c_str(), m_strRootEndTag.size());
+			pChunk = nullptr;
+		}
+	} // for (size_t iMember = ...
+
+	if (pChunk != nullptr)
+	{
+		pChunk->addRange((const unsigned char*)m_strRootEndTag.c_str(), m_strRootEndTag.size());
+	}
+
+	if (!checkReferences(vecMemberChunks))
+	{
+		for (auto pChunkStream : vecChunks)
+		{
+			delete pChunkStream;
+		}
+		vecChunks.clear();
+
+		return false;
+	}
+
+	return true;
+}
+
+// The ids (gml:id) and the local references are scanned, not parsed: xlink:href="#...", the targets of
+// the appearances (<app:target>#...</app:target>, <app:target uri="#...">). A reference to an id of
+// another chunk fails the split. The shared elements are in each chunk, i.e. a reference of a shared
+// element (e.g. a top-level app:appearanceMember) to a member fails it, too.
+bool _gml_splitter::checkReferences(const vector<size_t>& vecMemberChunks)
+{
+	assert(vecMemberChunks.size() == m_vecMembers.size());
+
+	map<string, size_t> mapIds; // Id : Chunk
+	vector<vector<string>> vecMemberReferences(m_vecMembers.size());
+	for (size_t iMember = 0; iMember < m_vecMembers.size(); iMember++)
+	{
+		vector<string> vecIds;
+		getReferences(m_vecMembers[iMember], vecIds, vecMemberReferences[iMember]);
+
+		for (const auto& strId : vecIds)
+		{
+			mapIds[strId] = vecMemberChunks[iMember];
+		}
+	}
+
+	for (size_t iMember = 0; iMember < m_vecMembers.size(); iMember++)
+	{
+		for (const auto& strReference : vecMemberReferences[iMember])
+		{
+			auto itId = mapIds.find(strReference);
+			if ((itId != mapIds.end()) && (itId->second != vecMemberChunks[iMember]))
+			{
+				m_strError = _string::format("A reference between the chunks (#%s).", strReference.c_str());
+
+				return false;
+			}
+		}
+	} // for (size_t iMember = ...
+
+	for (const auto& prSharedElement : m_vecSharedElements)
+	{
+		vector<string> vecIds;
+		vector<string> vecReferences;
+		getReferences(prSharedElement, vecIds, vecReferences);
+
+		for (const auto& strReference : vecReferences)
+		{
+			if (mapIds.find(strReference) != mapIds.end())
+			{
+				m_strError = _string::format("A reference of a shared element to a member (#%s).", strReference.c_str());
+
+				return false;
+			}
+		}
+	} // for (const auto& prSharedElement : ...
+
+	return true;
+}
+
+// prElement - Offset, Size
+void _gml_splitter::getReferences(const pair<size_t, size_t>& prElement, vector<string>& vecIds, vector<string>& vecReferences) const
+{
+	size_t iEnd = prElement.first + prElement.second;
+	for (size_t iPosition = prElement.first; iPosition < iEnd; iPosition++)
+	{
+		// <app:target>#...</app:target>; '#' is optional
+		if (m_szData[iPosition] == '<')
+		{
+			size_t iTagEnd = 0;
+			bool bEndTag = false;
+			bool bEmptyElement = false;
+			if (!matchLocalName(iPosition, "target") ||
+				!scanTag(iPosition, iTagEnd, bEndTag, bEmptyElement) ||
+				bEndTag || bEmptyElement)
+			{
+				continue;
+			}
+
+			size_t iValueStart = iTagEnd;
+			while ((iValueStart < iEnd) && isspace(m_szData[iValueStart]))
+			{
+				iValueStart++;
+			}
+
+			if ((iValueStart < iEnd) && (m_szData[iValueStart] == '#'))
+			{
+				iValueStart++;
+			}
+
+			size_t iValueEnd = iValueStart;
+			while ((iValueEnd < iEnd) && (m_szData[iValueEnd] != '<') && !isspace(m_szData[iValueEnd]))
+			{
+				iValueEnd++;
+			}
+
+			if (iValueEnd > iValueStart)
+			{
+				vecReferences.push_back(string((const char*)m_szData + iValueStart, iValueEnd - iValueStart));
+			}
+
+			continue;
+		} // if (m_szData[iPosition] == '<')
+
+		// Attributes; ':id=', ' id=', ':href=', ' uri='
+		if (m_szData[iPosition] != '=')
+		{
+			continue;
+		}
+
+		size_t iValueStart = 0;
+		if (matchAttribute(iPosition, "id", iValueStart))
+		{
+			size_t iValueEnd = iValueStart;
+			while ((iValueEnd < iEnd) && (m_szData[iValueEnd] != m_szData[iValueStart - 1]))
+			{
+				iValueEnd++;
+			}
+
+			vecIds.push_back(string((const char*)m_szData + iValueStart, iValueEnd - iValueStart));
+		}
+		else if ((matchAttribute(iPosition, "href", iValueStart) || matchAttribute(iPosition, "uri", iValueStart)) &&
+			(iValueStart < iEnd) && (m_szData[iValueStart] == '#'))
+		{
+			iValueStart++;
+
+			size_t iValueEnd = iValueStart;
+			while ((iValueEnd < iEnd) && (m_szData[iValueEnd] != m_szData[iValueStart - 2]))
+			{
+				iValueEnd++;
+			}
+
+			vecReferences.push_back(string((const char*)m_szData + iValueStart, iValueEnd - iValueStart));
+		}
+	} // for (size_t iPosition = ...
+}
+
+// iStart - '<'; a start tag with the local name szLocalName (any prefix)
+bool _gml_splitter::matchLocalName(size_t iStart, const char* szLocalName) const
+{
+	assert(m_szData[iStart] == '<');
+
+	size_t iNameStart = iStart + 1;
+	size_t iPosition = iNameStart;
+	while ((iPosition < m_iSize) &&
+		!isspace(m_szData[iPosition]) &&
+		(m_szData[iPosition] != '>') &&
+		(m_szData[iPosition] != '/'))
+	{
+		if (m_szData[iPosition] == ':')
+		{
+			iNameStart = iPosition + 1;
+		}
+
+		iPosition++;
+	}
+
+	size_t iLength = strlen(szLocalName);
+
+	return (iPosition - iNameStart == iLength) && (memcmp(m_szData + iNameStart, szLocalName, iLength) == 0);
+}
+
+// iPosition - '='; iValueStart - after the quote
+bool _gml_splitter::matchAttribute(size_t iPosition, const char* szName, size_t& iValueStart) const
+{
+	assert(m_szData[iPosition] == '=');
+
+	size_t iNameSize = strlen(szName);
+	if ((iPosition < iNameSize + 1) || (iPosition + 1 >= m_iSize))
+	{
+		return false;
+	}
+
+	size_t iNameStart = iPosition - iNameSize;
+	if ((memcmp(m_szData + iNameStart, szName, iNameSize) != 0) ||
+		((m_szData[iNameStart - 1] != ':') && !isspace(m_szData[iNameStart - 1])))
+	{
+		return false;
+	}
+
+	if ((m_szData[iPosition + 1] != '"') && (m_szData[iPosition + 1] != '\''))
+	{
+		return false;
+	}
+
+	iValueStart = iPosition + 2;
+
+	return true;
+}
+
+bool _gml_splitter::scan()
+{
+	m_iRootStartTagEnd = 0;
+	m_strRootEndTag.clear();
+	m_vecSharedElements.clear();
+	m_vecMembers.clear();
+
+	// Prolog
+	size_t iPosition = 0;
+	while (true)
+	{
+		const unsigned char* szTag = (const unsigned char*)memchr(m_szData + iPosition, '<', m_iSize - iPosition);
+		if (szTag == nullptr)
+		{
+			m_strError = "No root element.";
+
+			return false;
+		}
+
+		iPosition = szTag - m_szData;
+		if ((iPosition + 1 < m_iSize) && ((m_szData[iPosition + 1] == '?') || (m_szData[iPosition + 1] == '!')))
+		{
+			if (!skipMarkup(iPosition))
+			{
+				m_strError = "Invalid prolog.";
+
+				return false;
+			}
+
+			continue;
+		}
+
+		break;
+	} // while (true)
+
+	// Root
+	size_t iEnd = 0;
+	bool bEndTag = false;
+	bool bEmptyElement = false;
+	if (!scanTag(iPosition, iEnd, bEndTag, bEmptyElement) || bEndTag || bEmptyElement)
+	{
+		m_strError = "Invalid root element.";
+
+		return false;
+	}
+
+	string strRootName;
+	getTagName(iPosition, strRootName);
+
+	m_iRootStartTagEnd = iEnd;
+	m_strRootEndTag = "\n</";
+	m_strRootEndTag += strRootName;
+	m_strRootEndTag += ">\n";
+
+	// Top-level children
+	int iDepth = 1;
+	size_t iChildStart = 0;
+	bool bMember = false;
+	iPosition = iEnd;
+	while (iDepth > 0)
+	{
+		const unsigned char* szTag = (const unsigned char*)memchr(m_szData + iPosition, '<', m_iSize - iPosition);
+		if (szTag == nullptr)
+		{
+			m_strError = "Unexpected end of the document.";
+
+			return false;
+		}
+
+		iPosition = szTag - m_szData;
+		if ((iPosition + 1 < m_iSize) && ((m_szData[iPosition + 1] == '?') || (m_szData[iPosition + 1] == '!')))
+		{
+			if (!skipMarkup(iPosition))
+			{
+				m_strError = "Invalid markup.";
+
+				return false;
+			}
+
+			continue;
+		}
+
+		if (!scanTag(iPosition, iEnd, bEndTag, bEmptyElement))
+		{
+			m_strError = "Invalid tag.";
+
+			return false;
+		}
+
+		if (bEndTag)
+		{
+			iDepth--;
+			if (iDepth == 1)
+			{
+				if (bMember)
+				{
+					m_vecMembers.push_back({ iChildStart, iEnd - iChildStart });
+				}
+				else
+				{
+					m_vecSharedElements.push_back({ iChildStart, iEnd - iChildStart });
+				}
+			}
+		}
+		else if (iDepth == 1)
+		{
+			string strName;
+			getTagName(iPosition, strName);
+
+			iChildStart = iPosition;
+			bMember = isMember(strName);
+
+			if (bEmptyElement)
+			{
+				if (!bMember)
+				{
+					m_vecSharedElements.push_back({ iChildStart, iEnd - iChildStart });
+				}
+			}
+			else
+			{
+				iDepth++;
+			}
+		}
+		else if (!bEmptyElement)
+		{
+			iDepth++;
+		}
+
+		iPosition = iEnd;
+	} // while (iDepth > 0)
+
+	return true;
+}
+
+// Markup without elements; iPosition - '<' => after '>'
+bool _gml_splitter::skipMarkup(size_t& iPosition) const
+{
+	assert(m_szData[iPosition] == '<');
+
+	auto find = [this](size_t iStart, const char* szText) -> size_t
+	{
+		size_t iLength = strlen(szText);
+		while (iStart + iLength <= m_iSize)
+		{
+			const unsigned char* szFound = (const unsigned char*)memchr(m_szData + iStart, szText[0], m_iSize - iStart);
+			if (szFound == nullptr)
+			{
+				return string::npos;
+			}
+
+			size_t iFound = szFound - m_szData;
+			if ((iFound + iLength <= m_iSize) && (memcmp(szFound, szText, iLength) == 0))
+			{
+				return iFound + iLength;
+			}
+
+			iStart = iFound + 1;
+		}
+
+		return string::npos;
+	};
+
+	auto startsWith = [this, iPosition](const char* szText)
+	{
+		size_t iLength = strlen(szText);
+
+		return (iPosition + iLength <= m_iSize) && (memcmp(m_szData + iPosition, szText, iLength) == 0);
+	};
+
+	size_t iEnd = string::npos;
+	if (startsWith("<!--"))
+	{
+		iEnd = find(iPosition + 4, "-->");
+	}
+	else if (startsWith("<![CDATA["))
+	{
+		iEnd = find(iPosition + 9, "]]>");
+	}
+	else if (startsWith("<?"))
+	{
+		iEnd = find(iPosition + 2, "?>");
+	}
+	else
+	{
+		// <!DOCTYPE ... [ ... ]>
+		size_t iClose = find(iPosition + 2, ">");
+		size_t iSubset = find(iPosition + 2, "[");
+		iEnd = (iSubset != string::npos) && (iSubset < iClose) ? find(iSubset, "]>") : iClose;
+	}
+
+	if (iEnd == string::npos)
+	{
+		return false;
+	}
+
+	iPosition = iEnd;
+
+	return true;
+}
+
+// iStart - '<'; iEnd - after '>'
+bool _gml_splitter::scanTag(size_t iStart, size_t& iEnd, bool& bEndTag, bool& bEmptyElement) const
+{
+	assert(m_szData[iStart] == '<');
+
+	bEndTag = (iStart + 1 < m_iSize) && (m_szData[iStart + 1] == '/');
+	bEmptyElement = false;
+
+	char chQuote = 0;
+	for (size_t iPosition = iStart + 1; iPosition < m_iSize; iPosition++)
+	{
+		char chCurrent = (char)m_szData[iPosition];
+		if (chQuote != 0)
+		{
+			if (chCurrent == chQuote)
+			{
+				chQuote = 0;
+			}
+
+			continue;
+		}
+
+		if ((chCurrent == '"') || (chCurrent == '\''))
+		{
+			chQuote = chCurrent;
+		}
+		else if (chCurrent == '>')
+		{
+			bEmptyElement = !bEndTag && (m_szData[iPosition - 1] == '/');
+			iEnd = iPosition + 1;
+
+			return true;
+		}
+	} // for (size_t iPosition = ...
+
+	return false;
+}
+
+void _gml_splitter::getTagName(size_t iStart, string& strName) const
+{
+	assert(m_szData[iStart] == '<');
+
+	size_t iPosition = iStart + 1;
+	if ((iPosition < m_iSize) && (m_szData[iPosition] == '/'))
+	{
+		iPosition++;
+	}
+
+	size_t iNameStart = iPosition;
+	while ((iPosition < m_iSize) &&
+		!isspace(m_szData[iPosition]) &&
+		(m_szData[iPosition] != '>') &&
+		(m_szData[iPosition] != '/'))
+	{
+		iPosition++;
+	}
+
+	strName.assign((const char*)m_szData + iNameStart, iPosition - iNameStart);
+}
+
+/*static*/ bool _gml_splitter::isMember(const string& strName)
+{
+	// Local name
+	size_t iColon = strName.find(':');
+	string strLocalName = iColon != string::npos ? strName.substr(iColon + 1) : strName;
+
+	return (strLocalName == "cityObjectMember") ||
+		(strLocalName == "featureMember") ||
+		(strLocalName == "featureMembers") ||
+		(strLocalName == "member");
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "_input_stream.h"
+
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+// ************************************************************************************************
+// Splits a GML document by the top-level members (cityObjectMember, featureMember, ...) without
+// parsing it: the tags are only scanned. Each chunk is a well-formed document: the prolog and the
+// root start tag (namespaces), the other top-level children (boundedBy, ...), a contiguous run of
+// members and the root end tag. The engine doesn't resolve the references between the members of
+// different chunks (xlink:href, the targets of the appearances), i.e. the split fails if there are any;
+// so does a reference of a shared element to a member.
+class _gml_splitter
+{
+
+private: // Members
+
+	const unsigned char* m_szData;
+	size_t m_iSize;
+
+	string m_strError;
+
+	// Document
+	size_t m_iRootStartTagEnd; // The prolog and the root start tag
+	string m_strRootEndTag;
+	vector<pair<size_t, size_t>> m_vecSharedElements; // Offset, Size; replicated in each chunk
+	vector<pair<size_t, size_t>> m_vecMembers; // Offset, Size
+
+public: // Methods
+
+	_gml_splitter(const unsigned char* szData, size_t iSize);
+	virtual ~_gml_splitter();
+
+	// At most iChunksCount chunks of similar size; false - not a GML document or less than 2 members
+	bool split(int iChunksCount, vector<_chunk_input_stream*>& vecChunks); // delete
+
+	const string& getError() const { return m_strError; }
+	size_t getMembersCount() const { return m_vecMembers.size(); }
+
+private: // Methods
+
+	bool scan();
+	bool checkReferences(const vector<size_t>& vecMemberChunks); // Member : Chunk
+	void getReferences(const pair<size_t, size_t>& prElement, vector<string>& vecIds, vector<string>& vecReferences) const;
+	bool matchAttribute(size_t iPosition, const char* szName, size_t& iValueStart) const;
+	bool matchLocalName(size_t iStart, const char* szLocalName) const;
+	bool skipMarkup(size_t& iPosition) const; // <!-- -->, <![CDATA[ ]]>, <? ?>, <!DOCTYPE >
+	bool scanTag(size_t iStart, size_t& iEnd, bool& bEndTag, bool& bEmptyElement) const;
+	void getTagName(size_t iStart, string& strName) const;
+
+	static bool isMember(const string& strName);
+};
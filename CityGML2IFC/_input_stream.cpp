@@ -0,0 +1,392 @@
+#include "pch.h"
+#include "_input_stream.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// ************************************************************************************************
+/*static*/ thread_local _input_stream* _input_stream::s_pCurrentStream = nullptr;
+
+_input_stream::_input_stream()
+	: m_iBytesRead(0)
+	, m_bFailed(false)
+{
+}
+
+/*virtual*/ _input_stream::~_input_stream()
+{
+}
+
+OwlInstance _input_stream::import(OwlModel iOwlModel)
+{
+	assert(iOwlModel != 0);
+	assert(s_pCurrentStream == nullptr);
+
+	m_iBytesRead = 0;
+	m_bFailed = false;
+
+	s_pCurrentStream = this;
+
+	OwlInstance iRootInstance = ImportGISModelS(iOwlModel, &_input_stream::readCallback);
+
+	s_pCurrentStream = nullptr;
+
+	return iRootInstance;
+}
+
+/*static*/ size_t STDCALL _input_stream::readCallback(unsigned char* szData, size_t iSize)
+{
+	assert(s_pCurrentStream != nullptr);
+
+	// The engine can't be stopped; the rest of the input is dropped
+	if (s_pCurrentStream->m_bFailed || (iSize == 0))
+	{
+		return 0;
+	}
+
+	size_t iRead = 0;
+	if (!s_pCurrentStream->read(szData, iSize, iRead))
+	{
+		s_pCurrentStream->m_bFailed = true;
+
+		return 0;
+	}
+
+	assert(iRead <= iSize);
+
+	s_pCurrentStream->m_iBytesRead += iRead;
+
+	return iRead;
+}
+
+// ************************************************************************************************
+_callback_input_stream::_callback_input_stream(_read_callback pReadCallback, void* pContext)
+	: _input_stream()
+	, m_pReadCallback(pReadCallback)
+	, m_pContext(pContext)
+{
+	assert(m_pReadCallback != nullptr);
+}
+
+/*virtual*/ _callback_input_stream::~_callback_input_stream()
+{
+}
+
+/*virtual*/ bool _callback_input_stream::read(unsigned char* szData, size_t iSize, size_t& iRead) /*override*/
+{
+	iRead = (*m_pReadCallback)(szData, iSize, m_pContext);
+
+	return true;
+}
+
+// ************************************************************************************************
+_fd_input_stream::_fd_input_stream(int iFD)
+	: _input_stream()
+	, m_iFD(iFD)
+{
+	assert(m_iFD >= 0);
+}
+
+/*virtual*/ _fd_input_stream::~_fd_input_stream()
+{
+}
+
+/*virtual*/ string _fd_input_stream::getName() const /*override*/
+{
+	return _string::format("fd %d", m_iFD);
+}
+
+/*virtual*/ bool _fd_input_stream::read(unsigned char* szData, size_t iSize, size_t& iRead) /*override*/
+{
+	assert(szData != nullptr);
+
+	iRead = 0;
+
+	while (true)
+	{
+#ifdef _WINDOWS
+		int iResult = ::_read(m_iFD, szData, (unsigned int)min<size_t>(iSize, INT_MAX));
+#else
+		ssize_t iResult = ::read(m_iFD, szData, iSize);
+#endif
+		if (iResult < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return false;
+		}
+
+		iRead = (size_t)iResult;
+
+		return true;
+	} // while (true)
+}
+
+// ************************************************************************************************
+_stdin_input_stream::_stdin_input_stream()
+	: _fd_input_stream(0)
+{
+#ifdef _WINDOWS
+	_setmode(_fileno(stdin), _O_BINARY);
+#endif
+}
+
+/*virtual*/ _stdin_input_stream::~_stdin_input_stream()
+{
+}
+
+// ************************************************************************************************
+_chunk_input_stream::_chunk_input_stream(const string& strName)
+	: _input_stream()
+	, m_strName(strName)
+	, m_vecRanges()
+	, m_iRange(0)
+	, m_iOffset(0)
+{
+}
+
+/*virtual*/ _chunk_input_stream::~_chunk_input_stream()
+{
+}
+
+void _chunk_input_stream::addRange(const unsigned char* szData, size_t iSize)
+{
+	assert(szData != nullptr);
+
+	if (iSize == 0)
+	{
+		return;
+	}
+
+	// Adjacent blocks
+	if (!m_vecRanges.empty() && (m_vecRanges.back().first + m_vecRanges.back().second == szData))
+	{
+		m_vecRanges.back().second += iSize;
+
+		return;
+	}
+
+	m_vecRanges.push_back({ szData, iSize });
+}
+
+size_t _chunk_input_stream::getSize() const
+{
+	size_t iSize = 0;
+	for (const auto& prRange : m_vecRanges)
+	{
+		iSize += prRange.second;
+	}
+
+	return iSize;
+}
+
+/*virtual*/ bool _chunk_input_stream::read(unsigned char* szData, size_t iSize, size_t& iRead) /*override*/
+{
+	assert(szData != nullptr);
+
+	iRead = 0;
+
+	while ((iRead < iSize) && (m_iRange < m_vecRanges.size()))
+	{
+		const auto& prRange = m_vecRanges[m_iRange];
+
+		size_t iCount = min(iSize - iRead, prRange.second - m_iOffset);
+		memcpy(szData + iRead, prRange.first + m_iOffset, iCount);
+
+		iRead += iCount;
+		m_iOffset += iCount;
+
+		if (m_iOffset == prRange.second)
+		{
+			m_iRange++;
+			m_iOffset = 0;
+		}
+	} // while ((iRead < iSize) && ...
+
+	return true;
+}
+
+// ************************************************************************************************
+_mapped_file::_mapped_file(const wstring& strFile)
+	: m_strFile(strFile)
+	, m_szData(nullptr)
+	, m_iSize(0)
+#ifdef _WINDOWS
+	, m_hFile(INVALID_HANDLE_VALUE)
+	, m_hMapping(nullptr)
+#endif
+{
+	assert(!m_strFile.empty());
+}
+
+/*virtual*/ _mapped_file::~_mapped_file()
+{
+	close();
+}
+
+bool _mapped_file::open()
+{
+	close();
+
+#ifdef _WINDOWS
+	m_hFile = ::CreateFileW(
+		m_strFile.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER liSize;
+	if (!::GetFileSizeEx(m_hFile, &liSize) || (liSize.QuadPart == 0))
+	{
+		close();
+
+		return false;
+	}
+
+	m_hMapping = ::CreateFileMappingW(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping == nullptr)
+	{
+		close();
+
+		return false;
+	}
+
+	m_szData = (const unsigned char*)::MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_szData == nullptr)
+	{
+		close();
+
+		return false;
+	}
+
+	m_iSize = (size_t)liSize.QuadPart;
+#else
+	int iFD = ::open((LPCSTR)CW2A(m_strFile.c_str()), O_RDONLY);
+	if (iFD < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if ((::fstat(iFD, &fileStat) != 0) || (fileStat.st_size == 0))
+	{
+		::close(iFD);
+
+		return false;
+	}
+
+	void* pData = ::mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, iFD, 0);
+
+	// The mapping keeps the file referenced
+	::close(iFD);
+
+	if (pData == MAP_FAILED)
+	{
+		return false;
+	}
+
+	::madvise(pData, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+
+	m_szData = (const unsigned char*)pData;
+	m_iSize = (size_t)fileStat.st_size;
+#endif // _WINDOWS
+
+	return true;
+}
+
+void _mapped_file::close()
+{
+#ifdef _WINDOWS
+	if (m_szData != nullptr)
+	{
+		::UnmapViewOfFile(m_szData);
+	}
+
+	if (m_hMapping != nullptr)
+	{
+		::CloseHandle(m_hMapping);
+		m_hMapping = nullptr;
+	}
+
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		::CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_szData != nullptr)
+	{
+		::munmap((void*)m_szData, m_iSize);
+	}
+#endif // _WINDOWS
+
+	m_szData = nullptr;
+	m_iSize = 0;
+}
+
+/*static*/ int64_t _mapped_file::getFileSize(const wstring& strFile)
+{
+#ifdef _WINDOWS
+	struct _stat64 fileStat;
+	if (_wstat64(strFile.c_str(), &fileStat) != 0)
+	{
+		return -1;
+	}
+#else
+	struct stat fileStat;
+	if (stat((LPCSTR)CW2A(strFile.c_str()), &fileStat) != 0)
+	{
+		return -1;
+	}
+#endif
+
+	return (int64_t)fileStat.st_size;
+}
+
+/*static*/ int64_t _mapped_file::getFileTime(const wstring& strFile)
+{
+#ifdef _WINDOWS
+	// 100 ns; _wstat64() has seconds only
+	WIN32_FILE_ATTRIBUTE_DATA fileData;
+	if (!::GetFileAttributesExW(strFile.c_str(), GetFileExInfoStandard, &fileData))
+	{
+		return -1;
+	}
+
+	return ((int64_t)fileData.ftLastWriteTime.dwHighDateTime << 32) | (int64_t)fileData.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat fileStat;
+	if (stat((LPCSTR)CW2A(strFile.c_str()), &fileStat) != 0)
+	{
+		return -1;
+	}
+
+	return (int64_t)fileStat.st_mtime;
+#endif
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "../include/engine.h"
+
+#ifdef _WINDOWS
+#include "gisengine.h"
+#include "_log.h"
+#endif
+
+#ifdef __EMSCRIPTEN__
+#include "../gisengine/gisengine.h"
+#include "../gisengine/Parsers/_log.h"
+#endif
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// ************************************************************************************************
+// Returns the count of the bytes copied to szData; 0 - end of data
+typedef size_t(STDCALL* _read_callback)(unsigned char* szData, size_t iSize, void* pContext);
+
+// ************************************************************************************************
+// GIS input; the data is pulled by ImportGISModelS, i.e. the file is never fully loaded in memory
+class _input_stream
+{
+
+private: // Members
+
+	int64_t m_iBytesRead;
+	bool m_bFailed;
+
+	// ImportGISModelS() callback has no context
+	static thread_local _input_stream* s_pCurrentStream;
+
+public: // Methods
+
+	_input_stream();
+	virtual ~_input_stream();
+
+	OwlInstance import(OwlModel iOwlModel);
+	virtual string getName() const = 0;
+
+	int64_t getBytesRead() const { return m_iBytesRead; }
+	bool isFailed() const { return m_bFailed; }
+
+protected: // Methods
+
+	// Returns false on error; iRead = 0 - end of data
+	virtual bool read(unsigned char* szData, size_t iSize, size_t& iRead) = 0;
+
+private: // Methods
+
+	static size_t STDCALL readCallback(unsigned char* szData, size_t iSize);
+};
+
+// ************************************************************************************************
+// E.g. a decompressing reader
+class _callback_input_stream : public _input_stream
+{
+
+private: // Members
+
+	_read_callback m_pReadCallback;
+	void* m_pContext;
+
+public: // Methods
+
+	_callback_input_stream(_read_callback pReadCallback, void* pContext);
+	virtual ~_callback_input_stream();
+
+	virtual string getName() const override { return "callback"; }
+
+protected: // Methods
+
+	virtual bool read(unsigned char* szData, size_t iSize, size_t& iRead) override;
+};
+
+// ************************************************************************************************
+// Already open file descriptor, e.g. a pipe or a socket; not closed
+class _fd_input_stream : public _input_stream
+{
+
+private: // Members
+
+	int m_iFD;
+
+public: // Methods
+
+	_fd_input_stream(int iFD);
+	virtual ~_fd_input_stream();
+
+	virtual string getName() const override;
+
+	int getFD() const { return m_iFD; }
+
+protected: // Methods
+
+	virtual bool read(unsigned char* szData, size_t iSize, size_t& iRead) override;
+};
+
+// ************************************************************************************************
+class _stdin_input_stream : public _fd_input_stream
+{
+
+public: // Methods
+
+	_stdin_input_stream();
+	virtual ~_stdin_input_stream();
+
+	virtual string getName() const override { return "stdin"; }
+};
+
+// ************************************************************************************************
+// Concatenation of memory blocks owned by the caller, e.g. a chunk of a mapped file (_gml_splitter)
+class _chunk_input_stream : public _input_stream
+{
+
+private: // Members
+
+	string m_strName;
+	vector<pair<const unsigned char*, size_t>> m_vecRanges;
+	size_t m_iRange;
+	size_t m_iOffset;
+
+public: // Methods
+
+	_chunk_input_stream(const string& strName);
+	virtual ~_chunk_input_stream();
+
+	virtual string getName() const override { return m_strName; }
+
+	void addRange(const unsigned char* szData, size_t iSize);
+	size_t getSize() const;
+
+protected: // Methods
+
+	virtual bool read(unsigned char* szData, size_t iSize, size_t& iRead) override;
+};
+
+// ************************************************************************************************
+// Read-only mapping of a whole file with a sequential access hint; see ImportGISModelA()
+class _mapped_file
+{
+
+private: // Members
+
+	wstring m_strFile;
+	const unsigned char* m_szData;
+	size_t m_iSize;
+
+#ifdef _WINDOWS
+	void* m_hFile;
+	void* m_hMapping;
+#endif
+
+public: // Methods
+
+	_mapped_file(const wstring& strFile);
+	virtual ~_mapped_file();
+
+	bool open();
+	void close();
+
+	const unsigned char* getData() const { return m_szData; }
+	size_t getSize() const { return m_iSize; }
+
+	static int64_t getFileSize(const wstring& strFile); // -1 - error
+	static int64_t getFileTime(const wstring& strFile); // Last write, platform units; -1 - error
+};
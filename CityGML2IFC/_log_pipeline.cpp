@@ -0,0 +1,323 @@
+#include "pch.h"
+#include "_log_pipeline.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+// ************************************************************************************************
+_log_queue::_log_queue(size_t iCapacity)
+	: m_vecSlots(iCapacity)
+	, m_iMask(iCapacity - 1)
+	, m_iEnqueuePos(0)
+	, m_iDequeuePos(0)
+{
+	assert((iCapacity >= 2) && ((iCapacity & (iCapacity - 1)) == 0));
+
+	for (size_t iSlot = 0; iSlot < iCapacity; iSlot++)
+	{
+		m_vecSlots[iSlot].m_iSequence.store(iSlot, memory_order_relaxed);
+	}
+}
+
+/*virtual*/ _log_queue::~_log_queue()
+{
+}
+
+bool _log_queue::enqueue(enumLogEvent enLogEvent, const chrono::system_clock::time_point& tpTime, const string& strEvent, const char* szKey)
+{
+	_slot* pSlot = nullptr;
+
+	size_t iPos = m_iEnqueuePos.load(memory_order_relaxed);
+	while (true)
+	{
+		pSlot = &m_vecSlots[iPos & m_iMask];
+
+		size_t iSequence = pSlot->m_iSequence.load(memory_order_acquire);
+		intptr_t iDiff = (intptr_t)iSequence - (intptr_t)iPos;
+		if (iDiff == 0)
+		{
+			if (m_iEnqueuePos.compare_exchange_weak(iPos, iPos + 1, memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (iDiff < 0)
+		{
+			// Full
+			return false;
+		}
+		else
+		{
+			iPos = m_iEnqueuePos.load(memory_order_relaxed);
+		}
+	} // while (true)
+
+	pSlot->m_entry.m_enLogEvent = enLogEvent;
+	pSlot->m_entry.m_tpTime = tpTime;
+	pSlot->m_entry.m_strEvent = strEvent;
+	pSlot->m_entry.m_szKey = szKey;
+
+	pSlot->m_iSequence.store(iPos + 1, memory_order_release);
+
+	return true;
+}
+
+bool _log_queue::dequeue(_log_entry& entry)
+{
+	_slot* pSlot = &m_vecSlots[m_iDequeuePos & m_iMask];
+
+	size_t iSequence = pSlot->m_iSequence.load(memory_order_acquire);
+	if (iSequence != m_iDequeuePos + 1)
+	{
+		// Empty
+		return false;
+	}
+
+	entry.m_enLogEvent = pSlot->m_entry.m_enLogEvent;
+	entry.m_tpTime = pSlot->m_entry.m_tpTime;
+	entry.m_strEvent.swap(pSlot->m_entry.m_strEvent);
+	entry.m_szKey = pSlot->m_entry.m_szKey;
+
+	pSlot->m_iSequence.store(m_iDequeuePos + m_iMask + 1, memory_order_release);
+	m_iDequeuePos++;
+
+	return true;
+}
+
+// ************************************************************************************************
+/*static*/ thread_local void* _log_pipeline::s_pCurrentContext = nullptr;
+
+// ************************************************************************************************
+_log_pipeline::_log_pipeline(_log_callback pLogCallback)
+	: m_pLogCallback(pLogCallback)
+	, m_pContext(s_pCurrentContext)
+	, m_enMinLevel(enumLogEvent::info)
+	, m_iRateLimit(0)
+	, m_mapOccurrences()
+	, m_mapSuppressedEvents()
+	, m_pQueue(nullptr)
+	, m_pConsumer(nullptr)
+	, m_bStop(false)
+	, m_bFlushRequested(false)
+	, m_iEnqueued(0)
+	, m_iProcessed(0)
+	, m_mtxConsumer()
+	, m_cvConsumer()
+	, m_cvFlushed()
+	, m_mtx()
+	, m_iTimeStampSeconds(0)
+	, m_iTimeStampLength(0)
+	, m_szTimeStamp()
+{
+	assert(m_pLogCallback != nullptr);
+}
+
+/*virtual*/ _log_pipeline::~_log_pipeline()
+{
+	setAsync(false);
+}
+
+void _log_pipeline::setAsync(bool bAsync)
+{
+#ifdef _GML2IFC_NO_THREADS
+	bAsync = false;
+#endif
+
+	if (bAsync == getAsync())
+	{
+		return;
+	}
+
+	if (bAsync)
+	{
+		m_pQueue = new _log_queue(4096);
+
+		m_bStop = false;
+		m_pConsumer = new thread(&_log_pipeline::consume, this);
+	}
+	else
+	{
+		flush();
+
+		m_bStop = true;
+		notifyConsumer();
+
+		m_pConsumer->join();
+
+		delete m_pConsumer;
+		m_pConsumer = nullptr;
+
+		delete m_pQueue;
+		m_pQueue = nullptr;
+	}
+}
+
+void _log_pipeline::write(enumLogEvent enLogEvent, const string& strEvent, const char* szKey/* = nullptr*/)
+{
+	if (!isEnabled(enLogEvent))
+	{
+		return;
+	}
+
+	auto tpTime = chrono::system_clock::now();
+
+	if (m_pQueue != nullptr)
+	{
+		while (!m_pQueue->enqueue(enLogEvent, tpTime, strEvent, szKey))
+		{
+			// Full
+			this_thread::yield();
+		}
+
+		m_iEnqueued++;
+
+		notifyConsumer();
+
+		return;
+	}
+
+	lock_guard<mutex> lock(m_mtx);
+
+	_log_entry entry;
+	entry.m_enLogEvent = enLogEvent;
+	entry.m_tpTime = tpTime;
+	entry.m_strEvent = strEvent;
+	entry.m_szKey = szKey;
+
+	deliver(entry);
+}
+
+void _log_pipeline::flush()
+{
+	if (m_pQueue != nullptr)
+	{
+		m_bFlushRequested = true;
+		notifyConsumer();
+
+		unique_lock<mutex> lock(m_mtxConsumer);
+		m_cvFlushed.wait(lock, [this]() { return !m_bFlushRequested; });
+
+		return;
+	}
+
+	lock_guard<mutex> lock(m_mtx);
+
+	deliverSummaries();
+}
+
+void _log_pipeline::consume()
+{
+	_log_entry entry;
+	while (true)
+	{
+		if (m_pQueue->dequeue(entry))
+		{
+			deliver(entry);
+
+			m_iProcessed++;
+
+			continue;
+		}
+
+		if (m_bFlushRequested && (m_iProcessed == m_iEnqueued))
+		{
+			deliverSummaries();
+
+			{
+				lock_guard<mutex> lock(m_mtxConsumer);
+				m_bFlushRequested = false;
+			}
+			m_cvFlushed.notify_all();
+
+			continue;
+		}
+
+		if (m_bStop)
+		{
+			break;
+		}
+
+		// m_iProcessed is ahead of m_iEnqueued while a producer is between enqueue() and the count
+		unique_lock<mutex> lock(m_mtxConsumer);
+		m_cvConsumer.wait(lock, [this]()
+			{
+				return (m_iProcessed != m_iEnqueued) || m_bFlushRequested || m_bStop;
+			});
+	} // while (true)
+}
+
+void _log_pipeline::notifyConsumer()
+{
+	// The consumer checks its condition under m_mtxConsumer, i.e. the notification is not lost
+	{
+		lock_guard<mutex> lock(m_mtxConsumer);
+	}
+
+	m_cvConsumer.notify_one();
+}
+
+void _log_pipeline::deliver(const _log_entry& entry)
+{
+	if (m_iRateLimit > 0)
+	{
+		const char* szKey = entry.m_szKey != nullptr ? entry.m_szKey : entry.m_strEvent.c_str();
+
+		auto itOccurrences = m_mapOccurrences.find(szKey);
+		if (itOccurrences == m_mapOccurrences.end())
+		{
+			itOccurrences = m_mapOccurrences.insert({ szKey, 0 }).first;
+		}
+
+		if (++itOccurrences->second > m_iRateLimit)
+		{
+			m_mapSuppressedEvents[itOccurrences->first] = entry.m_enLogEvent;
+
+			return;
+		}
+	}
+
+	string strEvent = formatTimeStamp(entry.m_tpTime);
+	strEvent += ": ";
+	strEvent += entry.m_strEvent;
+
+	_log_context_scope logContext(m_pContext);
+	(*m_pLogCallback)(entry.m_enLogEvent, strEvent.c_str());
+}
+
+void _log_pipeline::deliverSummaries()
+{
+	auto tpTime = chrono::system_clock::now();
+
+	_log_context_scope logContext(m_pContext);
+	for (const auto& itSuppressedEvent : m_mapSuppressedEvents)
+	{
+		string strEvent = formatTimeStamp(tpTime);
+		strEvent += ": ";
+		strEvent += _string::format("%s (%lld occurrences)",
+			itSuppressedEvent.first.c_str(),
+			m_mapOccurrences.at(itSuppressedEvent.first));
+
+		(*m_pLogCallback)(itSuppressedEvent.second, strEvent.c_str());
+	}
+
+	m_mapOccurrences.clear();
+	m_mapSuppressedEvents.clear();
+}
+
+const char* _log_pipeline::formatTimeStamp(const chrono::system_clock::time_point& tpTime)
+{
+	// Date and time are formatted once per second
+	time_t iTime = chrono::system_clock::to_time_t(tpTime);
+	if (iTime != m_iTimeStampSeconds)
+	{
+		m_iTimeStampSeconds = iTime;
+		m_iTimeStampLength = strftime(m_szTimeStamp, sizeof(m_szTimeStamp), "%Y-%m-%d %H:%M:%S", localtime(&iTime));
+	}
+
+	auto iMilliseconds = chrono::duration_cast<chrono::milliseconds>(tpTime.time_since_epoch()).count() % 1000;
+	snprintf(m_szTimeStamp + m_iTimeStampLength, sizeof(m_szTimeStamp) - m_iTimeStampLength, ".%03d", (int)iMilliseconds);
+
+	return m_szTimeStamp;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#ifdef _WINDOWS
+#include "_log.h"
+#endif
+
+#ifdef __EMSCRIPTEN__
+#include "../gisengine/Parsers/_log.h"
+#endif
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+using namespace std;
+
+// ************************************************************************************************
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define _GML2IFC_NO_THREADS
+#endif
+
+// ************************************************************************************************
+class _log_entry
+{
+
+public: // Members
+
+	enumLogEvent m_enLogEvent;
+	chrono::system_clock::time_point m_tpTime;
+	string m_strEvent;
+	const char* m_szKey; // Rate limiting; a string literal, nullptr - m_strEvent
+
+public: // Methods
+
+	_log_entry()
+		: m_enLogEvent(enumLogEvent::info)
+		, m_tpTime()
+		, m_strEvent()
+		, m_szKey(nullptr)
+	{}
+
+	virtual ~_log_entry()
+	{}
+};
+
+// ************************************************************************************************
+// Bounded lock-free multi-producer/single-consumer queue
+class _log_queue
+{
+
+private: // Members
+
+	class _slot
+	{
+
+	public: // Members
+
+		atomic<size_t> m_iSequence;
+		_log_entry m_entry;
+	};
+
+	vector<_slot> m_vecSlots;
+	size_t m_iMask;
+	atomic<size_t> m_iEnqueuePos;
+	size_t m_iDequeuePos;
+
+public: // Methods
+
+	_log_queue(size_t iCapacity); // power of 2
+	virtual ~_log_queue();
+
+	bool enqueue(enumLogEvent enLogEvent, const chrono::system_clock::time_point& tpTime, const string& strEvent, const char* szKey);
+	bool dequeue(_log_entry& entry);
+};
+
+// ************************************************************************************************
+// Level filter, rate limiting per message and (optionally) asynchronous delivery to the log callback.
+// The messages of a call site with variable text pass the format/call site as the key of the rate
+// limiting; they should be formatted only if isEnabled() (see _exporter_base::logClassEvent()).
+// The context of the thread that creates the pipeline (see _log_context_scope) is the context of
+// the callback on any thread, i.e. the log callback can tell the conversions of a process apart.
+class _log_pipeline
+{
+
+private: // Members
+
+	_log_callback m_pLogCallback;
+	void* m_pContext;
+
+	// Filter
+	enumLogEvent m_enMinLevel;
+
+	// Rate limiting; 0 - disabled
+	int m_iRateLimit;
+	map<string, int64_t, less<>> m_mapOccurrences; // Key : Count
+	map<string, enumLogEvent, less<>> m_mapSuppressedEvents; // Key : Level
+
+	// Asynchronous delivery
+	_log_queue* m_pQueue;
+	thread* m_pConsumer;
+	atomic<bool> m_bStop;
+	atomic<bool> m_bFlushRequested;
+	atomic<int64_t> m_iEnqueued;
+	atomic<int64_t> m_iProcessed;
+	mutex m_mtxConsumer;
+	condition_variable m_cvConsumer; // Enqueued, Flush requested, Stop
+	condition_variable m_cvFlushed;
+
+	// Synchronous delivery
+	mutex m_mtx;
+
+	// Time stamp cache
+	time_t m_iTimeStampSeconds;
+	size_t m_iTimeStampLength;
+	char m_szTimeStamp[32];
+
+	static thread_local void* s_pCurrentContext;
+
+public: // Methods
+
+	_log_pipeline(_log_callback pLogCallback);
+	virtual ~_log_pipeline();
+
+	void setMinLevel(enumLogEvent enMinLevel) { m_enMinLevel = enMinLevel; }
+	enumLogEvent getMinLevel() const { return m_enMinLevel; }
+	void setRateLimit(int iRateLimit) { m_iRateLimit = iRateLimit; }
+	int getRateLimit() const { return m_iRateLimit; }
+	void setAsync(bool bAsync);
+	bool getAsync() const { return m_pConsumer != nullptr; }
+	void* getContext() const { return m_pContext; }
+
+	static void* getCurrentContext() { return s_pCurrentContext; }
+	static void setCurrentContext(void* pContext) { s_pCurrentContext = pContext; }
+
+	bool isEnabled(enumLogEvent enLogEvent) const { return (int)enLogEvent >= (int)m_enMinLevel; }
+	void write(enumLogEvent enLogEvent, const string& strEvent, const char* szKey = nullptr);
+	void flush();
+
+private: // Methods
+
+	void consume();
+	void notifyConsumer();
+	void deliver(const _log_entry& entry);
+	void deliverSummaries();
+	const char* formatTimeStamp(const chrono::system_clock::time_point& tpTime);
+};
+
+// ************************************************************************************************
+// Makes pContext the log context of this thread (the events of the log callback on the thread, e.g.
+// the engine's ones; the pipelines created on the thread)
+class _log_context_scope
+{
+
+private: // Members
+
+	void* m_pPreviousContext;
+
+public: // Methods
+
+	_log_context_scope(void* pContext)
+		: m_pPreviousContext(_log_pipeline::getCurrentContext())
+	{
+		_log_pipeline::setCurrentContext(pContext);
+	}
+
+	virtual ~_log_context_scope()
+	{
+		_log_pipeline::setCurrentContext(m_pPreviousContext);
+	}
+};
@@ -0,0 +1,562 @@
+#include "pch.h"
+#include "_metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <cstdlib>
+
+#ifdef _WINDOWS
+#include <psapi.h>
+#include <malloc.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__EMSCRIPTEN__)
+#include <emscripten/heap.h>
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#include <malloc/malloc.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <cstdio>
+#endif
+
+// ************************************************************************************************
+/*static*/ thread_local int64_t _metrics::s_iIfcEntitiesCount = 0;
+/*static*/ thread_local _metrics* _metrics::s_pCurrent = nullptr;
+/*static*/ thread_local enumPhase _metrics::s_enCurrentPhase = enumPhase::count;
+
+// ************************************************************************************************
+_metrics::_metrics()
+	: m_iTopObjectsCount(0)
+	, m_bEngineCalls(false)
+	, m_bAllocations(false)
+	, m_mapObjects()
+	, m_pCurrentObject(nullptr)
+	, m_pEngineCalls(new _engine_calls())
+	, m_pAllocations(new _allocations())
+{
+}
+
+/*virtual*/ _metrics::~_metrics()
+{
+	assert(s_pCurrent != this);
+
+	reset();
+
+	delete m_pEngineCalls;
+	delete m_pAllocations;
+}
+
+void _metrics::reset()
+{
+	assert(m_pCurrentObject == nullptr);
+
+	for (auto itObject : m_mapObjects)
+	{
+		delete itObject.second;
+	}
+	m_mapObjects.clear();
+
+	m_pEngineCalls->reset();
+	m_pEngineCalls->setEnabled(m_bEngineCalls);
+
+	resetAllocations(enumPhase::PreProcessing);
+}
+
+void _metrics::resetAllocations(enumPhase enFirstPhase)
+{
+	m_pAllocations->reset(enFirstPhase);
+	m_pAllocations->setEnabled(m_bAllocations);
+}
+
+_object_metrics* _metrics::beginObject(OwlInstance iInstance)
+{
+	assert(iInstance != 0);
+
+	_object_metrics* pPreviousObject = m_pCurrentObject;
+
+	auto itObject = m_mapObjects.find(iInstance);
+	if (itObject != m_mapObjects.end())
+	{
+		m_pCurrentObject = itObject->second;
+	}
+	else
+	{
+		m_mapObjects[iInstance] =
+			m_pCurrentObject = new _object_metrics(iInstance);
+	}
+
+	return pPreviousObject;
+}
+
+void _metrics::getSlowestObjects(vector<const _object_metrics*>& vecObjects) const
+{
+	vecObjects.clear();
+
+	for (auto itObject : m_mapObjects)
+	{
+		vecObjects.push_back(itObject.second);
+	}
+
+	sort(vecObjects.begin(), vecObjects.end(), [](const _object_metrics* pA, const _object_metrics* pB)
+		{
+			return pA->m_dElapsedTime + pA->m_dReadTime > pB->m_dElapsedTime + pB->m_dReadTime;
+		});
+
+	if ((int)vecObjects.size() > m_iTopObjectsCount)
+	{
+		vecObjects.resize(m_iTopObjectsCount);
+	}
+}
+
+void _metrics::getLargestObjects(vector<const _object_metrics*>& vecObjects) const
+{
+	vecObjects.clear();
+
+	for (auto itObject : m_mapObjects)
+	{
+		vecObjects.push_back(itObject.second);
+	}
+
+	sort(vecObjects.begin(), vecObjects.end(), [](const _object_metrics* pA, const _object_metrics* pB)
+		{
+			if (pA->m_iVerticesCount != pB->m_iVerticesCount)
+			{
+				return pA->m_iVerticesCount > pB->m_iVerticesCount;
+			}
+
+			return pA->m_iIfcEntitiesCount > pB->m_iIfcEntitiesCount;
+		});
+
+	if ((int)vecObjects.size() > m_iTopObjectsCount)
+	{
+		vecObjects.resize(m_iTopObjectsCount);
+	}
+}
+
+void _metrics::mergeObjects(_metrics* pMetrics)
+{
+	assert(pMetrics != nullptr);
+	assert(pMetrics->m_pCurrentObject == nullptr);
+
+	for (auto itObject : pMetrics->m_mapObjects)
+	{
+		auto itTarget = m_mapObjects.find(itObject.first);
+		if (itTarget == m_mapObjects.end())
+		{
+			m_mapObjects[itObject.first] = itObject.second;
+
+			continue;
+		}
+
+		// An object of the previous targets
+		itTarget->second->m_dElapsedTime += itObject.second->m_dElapsedTime;
+		itTarget->second->m_dReadTime += itObject.second->m_dReadTime;
+		itTarget->second->m_iOwlNodesCount += itObject.second->m_iOwlNodesCount;
+		itTarget->second->m_iFacesCount += itObject.second->m_iFacesCount;
+		itTarget->second->m_iVerticesCount += itObject.second->m_iVerticesCount;
+		itTarget->second->m_iIfcEntitiesCount += itObject.second->m_iIfcEntitiesCount;
+
+		delete itObject.second;
+	} // for (auto itObject : ...
+
+	pMetrics->m_mapObjects.clear();
+}
+
+// ************************************************************************************************
+_object_metrics_scope::_object_metrics_scope(_metrics* pMetrics, OwlInstance iInstance)
+	: m_pMetrics(pMetrics)
+	, m_pObjectMetrics(nullptr)
+	, m_pPreviousObjectMetrics(nullptr)
+	, m_tpStart()
+	, m_iIfcEntitiesCount(0)
+{
+	assert(m_pMetrics != nullptr);
+
+	if (!m_pMetrics->isEnabled())
+	{
+		return;
+	}
+
+	m_pPreviousObjectMetrics = m_pMetrics->beginObject(iInstance);
+	m_pObjectMetrics = m_pMetrics->getCurrentObject();
+	assert(m_pObjectMetrics != nullptr);
+
+	m_iIfcEntitiesCount = _metrics::getIfcEntitiesCount();
+	m_tpStart = chrono::steady_clock::now();
+}
+
+/*virtual*/ _object_metrics_scope::~_object_metrics_scope()
+{
+	if (m_pObjectMetrics == nullptr)
+	{
+		return;
+	}
+
+	m_pObjectMetrics->m_dElapsedTime += chrono::duration<double, milli>(chrono::steady_clock::now() - m_tpStart).count();
+	m_pObjectMetrics->m_iIfcEntitiesCount += _metrics::getIfcEntitiesCount() - m_iIfcEntitiesCount;
+
+	m_pMetrics->endObject(m_pPreviousObjectMetrics);
+}
+
+// ************************************************************************************************
+_engine_calls::_engine_calls()
+	: m_bEnabled(false)
+	, m_mtx()
+	, m_mapCalls()
+{
+}
+
+/*virtual*/ _engine_calls::~_engine_calls()
+{
+	reset();
+}
+
+void _engine_calls::reset()
+{
+	lock_guard<mutex> lock(m_mtx);
+
+	for (auto itCall : m_mapCalls)
+	{
+		delete itCall.second;
+	}
+	m_mapCalls.clear();
+}
+
+void _engine_calls::record(enumEngineCall enCall, const char* szCaller, double dElapsedTime)
+{
+	lock_guard<mutex> lock(m_mtx);
+
+	_engine_call_metrics* pCall = nullptr;
+
+	auto itCall = m_mapCalls.find({ enCall, szCaller });
+	if (itCall != m_mapCalls.end())
+	{
+		pCall = itCall->second;
+	}
+	else
+	{
+		m_mapCalls[{ enCall, szCaller }] =
+			pCall = new _engine_call_metrics(enCall, szCaller);
+	}
+
+	pCall->m_iCallsCount++;
+	pCall->m_dElapsedTime += dElapsedTime;
+}
+
+void _engine_calls::getCalls(vector<_engine_call_metrics>& vecCalls)
+{
+	lock_guard<mutex> lock(m_mtx);
+
+	vecCalls.clear();
+
+	for (auto itCall : m_mapCalls)
+	{
+		vecCalls.push_back(*itCall.second);
+	}
+
+	sort(vecCalls.begin(), vecCalls.end(), [](const _engine_call_metrics& a, const _engine_call_metrics& b)
+		{
+			return a.m_dElapsedTime > b.m_dElapsedTime;
+		});
+}
+
+/*static*/ const char* _engine_calls::getName(enumEngineCall enCall)
+{
+	switch (enCall)
+	{
+		case enumEngineCall::GetObjectProperty: return "GetObjectProperty";
+		case enumEngineCall::GetDatatypeProperty: return "GetDatatypeProperty";
+		case enumEngineCall::GetBoundingBox: return "GetBoundingBox";
+		case enumEngineCall::GetNameOfProperty: return "GetNameOfProperty";
+		case enumEngineCall::SetCharacterSerialization: return "SetCharacterSerialization";
+		case enumEngineCall::sdaiCreateInstanceBN: return "sdaiCreateInstanceBN";
+		case enumEngineCall::sdaiPutAttrBN: return "sdaiPutAttrBN";
+		case enumEngineCall::sdaiAppend: return "sdaiAppend";
+		default: assert(false); break;
+	}
+
+	return "";
+}
+
+// ************************************************************************************************
+_allocations::_allocations()
+	: m_bEnabled(false)
+	, m_iLiveBytes(0)
+	, m_arAllocationsCount()
+	, m_arAllocatedBytes()
+	, m_arPeakLiveBytes()
+	, m_arRSS()
+{
+	reset(enumPhase::Import);
+}
+
+/*virtual*/ _allocations::~_allocations()
+{
+}
+
+void _allocations::reset(enumPhase enFirstPhase)
+{
+	if (enFirstPhase == enumPhase::Import)
+	{
+		m_iLiveBytes = 0;
+	}
+
+	for (int iPhase = (int)enFirstPhase; iPhase < (int)enumPhase::count; iPhase++)
+	{
+		m_arAllocationsCount[iPhase] = 0;
+		m_arAllocatedBytes[iPhase] = 0;
+		m_arPeakLiveBytes[iPhase] = 0;
+		m_arRSS[iPhase] = 0;
+	}
+}
+
+void _allocations::onAllocate(enumPhase enPhase, size_t iSize)
+{
+	assert(enPhase < enumPhase::count);
+
+	int64_t iLiveBytes = m_iLiveBytes.fetch_add((int64_t)iSize, memory_order_relaxed) + (int64_t)iSize;
+
+	int iPhase = (int)enPhase;
+
+	m_arAllocationsCount[iPhase].fetch_add(1, memory_order_relaxed);
+	m_arAllocatedBytes[iPhase].fetch_add((int64_t)iSize, memory_order_relaxed);
+
+	int64_t iPeakLiveBytes = m_arPeakLiveBytes[iPhase].load(memory_order_relaxed);
+	while ((iLiveBytes > iPeakLiveBytes) &&
+		!m_arPeakLiveBytes[iPhase].compare_exchange_weak(iPeakLiveBytes, iLiveBytes, memory_order_relaxed))
+	{
+	}
+}
+
+// Clamped at 0 - the block may not be one of this conversion (see _allocations)
+void _allocations::onFree(size_t iSize)
+{
+	int64_t iLiveBytes = m_iLiveBytes.load(memory_order_relaxed);
+	while (!m_iLiveBytes.compare_exchange_weak(iLiveBytes, max<int64_t>(iLiveBytes - (int64_t)iSize, 0), memory_order_relaxed))
+	{
+	}
+}
+
+int64_t _allocations::getSampledRSS() const
+{
+	int64_t iRSS = 0;
+	for (int iPhase = 0; iPhase < (int)enumPhase::count; iPhase++)
+	{
+		iRSS = max(iRSS, m_arRSS[iPhase].load(memory_order_relaxed));
+	}
+
+	return iRSS;
+}
+
+void _allocations::sampleRSS(enumPhase enPhase)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	int64_t iRSS = getCurrentRSS();
+
+	int64_t iPreviousRSS = m_arRSS[(int)enPhase].load(memory_order_relaxed);
+	while ((iRSS > iPreviousRSS) &&
+		!m_arRSS[(int)enPhase].compare_exchange_weak(iPreviousRSS, iRSS, memory_order_relaxed))
+	{
+	}
+}
+
+/*static*/ int64_t _allocations::getPeakRSS()
+{
+#ifdef _WINDOWS
+	PROCESS_MEMORY_COUNTERS processMemoryCounters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &processMemoryCounters, sizeof(processMemoryCounters)))
+	{
+		return (int64_t)processMemoryCounters.PeakWorkingSetSize;
+	}
+
+	return 0;
+#elif defined(__EMSCRIPTEN__)
+	// The heap grows only
+	return (int64_t)emscripten_get_heap_size();
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#ifdef __APPLE__
+		return (int64_t)usage.ru_maxrss; // bytes
+#else
+		return (int64_t)usage.ru_maxrss * 1024; // KB
+#endif
+	}
+
+	return 0;
+#endif
+}
+
+/*static*/ int64_t _allocations::getCurrentRSS()
+{
+#ifdef _WINDOWS
+	PROCESS_MEMORY_COUNTERS processMemoryCounters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &processMemoryCounters, sizeof(processMemoryCounters)))
+	{
+		return (int64_t)processMemoryCounters.WorkingSetSize;
+	}
+
+	return 0;
+#elif defined(__EMSCRIPTEN__)
+	return (int64_t)emscripten_get_heap_size();
+#elif defined(__linux__)
+	// Pages: size resident ...
+	FILE* pFile = fopen("/proc/self/statm", "r");
+	if (pFile == nullptr)
+	{
+		return 0;
+	}
+
+	long long iSize = 0;
+	long long iResident = 0;
+	int iFields = fscanf(pFile, "%lld %lld", &iSize, &iResident);
+	fclose(pFile);
+
+	return iFields == 2 ? (int64_t)iResident * (int64_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+	// No portable current RSS
+	return getPeakRSS();
+#endif
+}
+
+/*static*/ const char* _allocations::getName(enumPhase enPhase)
+{
+	switch (enPhase)
+	{
+		case enumPhase::Import: return "Import";
+		case enumPhase::PreProcessing: return "Pre-processing";
+		case enumPhase::Export: return "Export";
+		case enumPhase::CityModel: return "City Model";
+		case enumPhase::Buildings: return "Buildings";
+		case enumPhase::Features: return "Features";
+		case enumPhase::Save: return "Save";
+		case enumPhase::PostProcessing: return "Post-processing";
+		default: assert(false); break;
+	}
+
+	return "";
+}
+
+#ifndef _GML2IFC_NO_ALLOCATIONS_METRICS
+// ************************************************************************************************
+// Global operator new/delete hooks; the size of a block is asked from the heap only if the allocations
+// of the thread are counted (see _metrics::getCurrentAllocations()), i.e. the blocks have no header
+// and a free is charged to the conversion of the freeing thread, not of the allocating one
+namespace
+{
+	size_t getBlockSize(void* p)
+	{
+#ifdef _WINDOWS
+		return _msize(p);
+#elif defined(__APPLE__)
+		return malloc_size(p);
+#else
+		return malloc_usable_size(p);
+#endif
+	}
+
+	void* allocate(size_t iSize)
+	{
+		void* p = malloc(iSize > 0 ? iSize : 1);
+		if (p == nullptr)
+		{
+			return nullptr;
+		}
+
+		_allocations* pAllocations = _metrics::getCurrentAllocations();
+		if (pAllocations != nullptr)
+		{
+			pAllocations->onAllocate(_metrics::getCurrentPhase(), getBlockSize(p));
+		}
+
+		return p;
+	}
+
+	void deallocate(void* p)
+	{
+		if (p == nullptr)
+		{
+			return;
+		}
+
+		_allocations* pAllocations = _metrics::getCurrentAllocations();
+		if (pAllocations != nullptr)
+		{
+			pAllocations->onFree(getBlockSize(p));
+		}
+
+		free(p);
+	}
+}
+
+void* operator new(size_t iSize)
+{
+	void* p = allocate(iSize);
+	if (p == nullptr)
+	{
+		throw bad_alloc();
+	}
+
+	return p;
+}
+
+void* operator new[](size_t iSize)
+{
+	void* p = allocate(iSize);
+	if (p == nullptr)
+	{
+		throw bad_alloc();
+	}
+
+	return p;
+}
+
+void* operator new(size_t iSize, const nothrow_t&) noexcept
+{
+	return allocate(iSize);
+}
+
+void* operator new[](size_t iSize, const nothrow_t&) noexcept
+{
+	return allocate(iSize);
+}
+
+void operator delete(void* p) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept
+{
+	deallocate(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept
+{
+	deallocate(p);
+}
+#endif // _GML2IFC_NO_ALLOCATIONS_METRICS
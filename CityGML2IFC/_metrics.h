@@ -0,0 +1,411 @@
+#pragma once
+
+#include "../include/engine.h"
+#include "../include/ifcengine.h"
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+using namespace std;
+
+// ************************************************************************************************
+enum class enumPhase : int
+{
+	Import = 0,
+	PreProcessing,
+	Export,
+	CityModel,
+	Buildings,
+	Features,
+	Save,
+	PostProcessing,
+	count,
+};
+
+// ************************************************************************************************
+// Allocations per conversion phase; a table per conversion (see _metrics)
+// The global operator new/delete hooks (see _metrics.cpp; _GML2IFC_NO_ALLOCATIONS_METRICS - none) count
+// the blocks of the threads of the conversion (see _metrics_scope) while '$METRICS $ALLOCATIONS ON' is set;
+// the live bytes are the bytes allocated minus the bytes freed on these threads, i.e. an estimate:
+// a block is not tagged with its conversion, i.e. a free is charged to the conversion of the freeing
+// thread (e.g. a block of another conversion or of the server, or one allocated before the counting
+// started); the live bytes are clamped at 0, i.e. they can be low, but never negative.
+// The current RSS is sampled at the end of each phase.
+class _allocations
+{
+
+private: // Members
+
+	atomic<bool> m_bEnabled;
+
+	atomic<int64_t> m_iLiveBytes;
+	atomic<int64_t> m_arAllocationsCount[(int)enumPhase::count];
+	atomic<int64_t> m_arAllocatedBytes[(int)enumPhase::count];
+	atomic<int64_t> m_arPeakLiveBytes[(int)enumPhase::count];
+	atomic<int64_t> m_arRSS[(int)enumPhase::count];
+
+public: // Methods
+
+	_allocations();
+	virtual ~_allocations();
+
+	void reset(enumPhase enFirstPhase);
+	void onAllocate(enumPhase enPhase, size_t iSize);
+	void onFree(size_t iSize);
+	void sampleRSS(enumPhase enPhase);
+	static int64_t getPeakRSS();
+	static int64_t getCurrentRSS();
+	static const char* getName(enumPhase enPhase);
+
+	bool isEnabled() const { return m_bEnabled.load(memory_order_relaxed); }
+	void setEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+
+	int64_t getAllocationsCount(enumPhase enPhase) const { return m_arAllocationsCount[(int)enPhase]; }
+	int64_t getAllocatedBytes(enumPhase enPhase) const { return m_arAllocatedBytes[(int)enPhase]; }
+	int64_t getPeakLiveBytes(enumPhase enPhase) const { return m_arPeakLiveBytes[(int)enPhase]; }
+	int64_t getSampledRSS() const; // All phases
+	int64_t getRSS(enumPhase enPhase) const { return m_arRSS[(int)enPhase]; }
+};
+
+// ************************************************************************************************
+enum class enumEngineCall : int
+{
+	GetObjectProperty = 0,
+	GetDatatypeProperty,
+	GetBoundingBox,
+	GetNameOfProperty,
+	SetCharacterSerialization,
+	sdaiCreateInstanceBN,
+	sdaiPutAttrBN,
+	sdaiAppend,
+	count,
+};
+
+// ************************************************************************************************
+class _engine_call_metrics
+{
+
+public: // Members
+
+	enumEngineCall m_enCall;
+	const char* m_szCaller; // __FUNCTION__
+	int64_t m_iCallsCount;
+	double m_dElapsedTime; // ms
+
+public: // Methods
+
+	_engine_call_metrics(enumEngineCall enCall, const char* szCaller)
+		: m_enCall(enCall)
+		, m_szCaller(szCaller)
+		, m_iCallsCount(0)
+		, m_dElapsedTime(0.)
+	{}
+
+	virtual ~_engine_call_metrics()
+	{}
+};
+
+// ************************************************************************************************
+// Calls per engine API function and calling exporter method; see the interposition macros in _gml2ifc.cpp.
+// A table per conversion (see _metrics); the calls are recorded in the table of the current thread.
+class _engine_calls
+{
+
+private: // Members
+
+	atomic<bool> m_bEnabled;
+	mutex m_mtx;
+	map<pair<enumEngineCall, const char*>, _engine_call_metrics*> m_mapCalls;
+
+public: // Methods
+
+	_engine_calls();
+	virtual ~_engine_calls();
+
+	void reset();
+	void record(enumEngineCall enCall, const char* szCaller, double dElapsedTime);
+	void getCalls(vector<_engine_call_metrics>& vecCalls);
+	static const char* getName(enumEngineCall enCall);
+
+	template<typename Function>
+	static auto call(enumEngineCall enCall, const char* szCaller, Function fnCall) -> decltype(fnCall());
+
+	bool isEnabled() const { return m_bEnabled.load(memory_order_relaxed); }
+	void setEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+};
+
+// ************************************************************************************************
+class _object_metrics
+{
+
+public: // Members
+
+	OwlInstance m_iInstance;
+	string m_strTag; // See _citygml_exporter::nameObjectMetrics()
+	string m_strClassName;
+	double m_dElapsedTime; // ms
+	double m_dReadTime; // ms; the city model (see _city_model)
+	int64_t m_iOwlNodesCount;
+	int64_t m_iFacesCount;
+	int64_t m_iVerticesCount;
+	int64_t m_iIfcEntitiesCount;
+
+public: // Methods
+
+	_object_metrics(OwlInstance iInstance)
+		: m_iInstance(iInstance)
+		, m_strTag()
+		, m_strClassName()
+		, m_dElapsedTime(0.)
+		, m_dReadTime(0.)
+		, m_iOwlNodesCount(0)
+		, m_iFacesCount(0)
+		, m_iVerticesCount(0)
+		, m_iIfcEntitiesCount(0)
+	{}
+
+	virtual ~_object_metrics()
+	{}
+};
+
+// ************************************************************************************************
+class _metrics
+{
+
+private: // Members
+
+	// Top-N slowest/largest objects; 0 - disabled
+	int m_iTopObjectsCount;
+
+	// Engine calls per API function and calling method
+	bool m_bEngineCalls;
+
+	// Allocations per phase
+	bool m_bAllocations;
+
+	map<OwlInstance, _object_metrics*> m_mapObjects; // Building/Feature : Metrics
+	_object_metrics* m_pCurrentObject;
+
+	_engine_calls* m_pEngineCalls;
+	_allocations* m_pAllocations;
+
+	// The conversion and the phase of this thread; see _metrics_scope, _phase_scope
+	static thread_local _metrics* s_pCurrent;
+	static thread_local enumPhase s_enCurrentPhase; // count - none
+
+	// Total count of the IFC entities created by the exporters on this thread; the per-object counts
+	// are differences, i.e. concurrent conversions (_conversion_server) don't mix
+	static thread_local int64_t s_iIfcEntitiesCount;
+
+public: // Methods
+
+	_metrics();
+	virtual ~_metrics();
+
+	void reset();
+	void resetAllocations(enumPhase enFirstPhase);
+
+	// Objects
+	_object_metrics* beginObject(OwlInstance iInstance);
+	void endObject(_object_metrics* pPreviousObject) { m_pCurrentObject = pPreviousObject; }
+	void getSlowestObjects(vector<const _object_metrics*>& vecObjects) const;
+	void getLargestObjects(vector<const _object_metrics*>& vecObjects) const;
+	void mergeObjects(_metrics* pMetrics); // Moves the objects of pMetrics (a chunk)
+
+	// Counters
+	void onOwlNode()
+	{
+		if (m_pCurrentObject != nullptr)
+		{
+			m_pCurrentObject->m_iOwlNodesCount++;
+		}
+	}
+
+	void onRead(int64_t iOwlNodesCount, double dReadTime)
+	{
+		if (m_pCurrentObject != nullptr)
+		{
+			m_pCurrentObject->m_iOwlNodesCount += iOwlNodesCount;
+			m_pCurrentObject->m_dReadTime += dReadTime;
+		}
+	}
+
+	void onBoundaryRepresentation(int64_t iFacesCount, int64_t iVerticesCount)
+	{
+		if (m_pCurrentObject != nullptr)
+		{
+			m_pCurrentObject->m_iFacesCount += iFacesCount;
+			m_pCurrentObject->m_iVerticesCount += iVerticesCount;
+		}
+	}
+
+	static SdaiInstance onIfcEntity(SdaiInstance iInstance)
+	{
+		s_iIfcEntitiesCount++;
+
+		return iInstance;
+	}
+
+	static int64_t getIfcEntitiesCount() { return s_iIfcEntitiesCount; }
+
+	static _metrics* getCurrent() { return s_pCurrent; }
+	static void setCurrent(_metrics* pMetrics) { s_pCurrent = pMetrics; }
+	static enumPhase getCurrentPhase() { return s_enCurrentPhase; }
+	static void setCurrentPhase(enumPhase enPhase) { s_enCurrentPhase = enPhase; }
+
+	// The allocations of this thread; nullptr - not counted
+	static _allocations* getCurrentAllocations()
+	{
+		if ((s_pCurrent == nullptr) || (s_enCurrentPhase == enumPhase::count) || !s_pCurrent->m_pAllocations->isEnabled())
+		{
+			return nullptr;
+		}
+
+		return s_pCurrent->m_pAllocations;
+	}
+
+	int getTopObjectsCount() const { return m_iTopObjectsCount; }
+	void setTopObjectsCount(int iTopObjectsCount) { m_iTopObjectsCount = iTopObjectsCount; }
+	bool isEnabled() const { return m_iTopObjectsCount > 0; }
+	bool getEngineCalls() const { return m_bEngineCalls; }
+	void setEngineCalls(bool bEngineCalls) { m_bEngineCalls = bEngineCalls; }
+	bool getAllocations() const { return m_bAllocations; }
+	void setAllocations(bool bAllocations) { m_bAllocations = bAllocations; }
+	const map<OwlInstance, _object_metrics*>& getObjects() const { return m_mapObjects; }
+	_object_metrics* getCurrentObject() const { return m_pCurrentObject; }
+	_engine_calls* getCalls() const { return m_pEngineCalls; }
+	_allocations* getPhaseAllocations() const { return m_pAllocations; }
+};
+
+// ************************************************************************************************
+// Makes pMetrics the conversion of this thread (the exporter's methods and its worker threads);
+// the outermost scope wins, i.e. the work of the nested exporters (chunks) goes to the outer conversion.
+// A worker thread takes the phase of the thread that started it (enPhase).
+class _metrics_scope
+{
+
+private: // Members
+
+	_metrics* m_pPreviousMetrics;
+	enumPhase m_enPreviousPhase;
+
+public: // Methods
+
+	_metrics_scope(_metrics* pMetrics, enumPhase enPhase = enumPhase::count)
+		: m_pPreviousMetrics(_metrics::getCurrent())
+		, m_enPreviousPhase(_metrics::getCurrentPhase())
+	{
+		if (m_pPreviousMetrics == nullptr)
+		{
+			_metrics::setCurrent(pMetrics);
+		}
+
+		if (enPhase != enumPhase::count)
+		{
+			_metrics::setCurrentPhase(enPhase);
+		}
+	}
+
+	virtual ~_metrics_scope()
+	{
+		_metrics::setCurrentPhase(m_enPreviousPhase);
+		_metrics::setCurrent(m_pPreviousMetrics);
+	}
+};
+
+// ************************************************************************************************
+class _phase_scope
+{
+
+private: // Members
+
+	enumPhase m_enPhase;
+	enumPhase m_enPreviousPhase;
+
+public: // Methods
+
+	_phase_scope(enumPhase enPhase)
+		: m_enPhase(enPhase)
+		, m_enPreviousPhase(_metrics::getCurrentPhase())
+	{
+		_metrics::setCurrentPhase(m_enPhase);
+	}
+
+	virtual ~_phase_scope()
+	{
+		if (_metrics::getCurrent() != nullptr)
+		{
+			_metrics::getCurrent()->getPhaseAllocations()->sampleRSS(m_enPhase);
+		}
+
+		_metrics::setCurrentPhase(m_enPreviousPhase);
+	}
+};
+
+// ************************************************************************************************
+class _engine_call_scope
+{
+
+private: // Members
+
+	enumEngineCall m_enCall;
+	const char* m_szCaller;
+	_engine_calls* m_pEngineCalls; // nullptr - disabled
+	chrono::steady_clock::time_point m_tpStart;
+
+public: // Methods
+
+	_engine_call_scope(enumEngineCall enCall, const char* szCaller)
+		: m_enCall(enCall)
+		, m_szCaller(szCaller)
+		, m_pEngineCalls(nullptr)
+		, m_tpStart()
+	{
+		_metrics* pMetrics = _metrics::getCurrent();
+		if ((pMetrics != nullptr) && pMetrics->getCalls()->isEnabled())
+		{
+			m_pEngineCalls = pMetrics->getCalls();
+			m_tpStart = chrono::steady_clock::now();
+		}
+	}
+
+	virtual ~_engine_call_scope()
+	{
+		if (m_pEngineCalls != nullptr)
+		{
+			m_pEngineCalls->record(m_enCall, m_szCaller, chrono::duration<double, milli>(chrono::steady_clock::now() - m_tpStart).count());
+		}
+	}
+};
+
+// ************************************************************************************************
+template<typename Function>
+/*static*/ auto _engine_calls::call(enumEngineCall enCall, const char* szCaller, Function fnCall) -> decltype(fnCall())
+{
+	_engine_call_scope scope(enCall, szCaller);
+
+	return fnCall();
+}
+
+// ************************************************************************************************
+// Attributes the work done in the scope to a Building/Feature
+class _object_metrics_scope
+{
+
+private: // Members
+
+	_metrics* m_pMetrics;
+	_object_metrics* m_pObjectMetrics;
+	_object_metrics* m_pPreviousObjectMetrics;
+	chrono::steady_clock::time_point m_tpStart;
+	int64_t m_iIfcEntitiesCount;
+
+public: // Methods
+
+	_object_metrics_scope(_metrics* pMetrics, OwlInstance iInstance);
+	virtual ~_object_metrics_scope();
+};
@@ -0,0 +1,397 @@
+#include "pch.h"
+#include "_output_stream.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+// ************************************************************************************************
+// Chunk size for engiSaveModelByStream()
+#define OUTPUT_STREAM_CHUNK_SIZE (4 * 1024 * 1024)
+
+// ************************************************************************************************
+/*static*/ thread_local _output_stream* _output_stream::s_pCurrentStream = nullptr;
+
+_output_stream::_output_stream()
+	: m_iBytesWritten(0)
+	, m_bFailed(false)
+{
+}
+
+/*virtual*/ _output_stream::~_output_stream()
+{
+}
+
+/*virtual*/ bool _output_stream::save(SdaiModel iSdaiModel)
+{
+	assert(iSdaiModel != 0);
+	assert(s_pCurrentStream == nullptr);
+
+	if (!begin())
+	{
+		return false;
+	}
+
+	s_pCurrentStream = this;
+
+	engiSaveModelByStream(iSdaiModel, (const void*)&_output_stream::writeCallback, OUTPUT_STREAM_CHUNK_SIZE);
+
+	s_pCurrentStream = nullptr;
+
+	return end();
+}
+
+bool _output_stream::begin()
+{
+	m_iBytesWritten = 0;
+	m_bFailed = false;
+
+	if (!open())
+	{
+		m_bFailed = true;
+	}
+
+	return !m_bFailed;
+}
+
+bool _output_stream::append(const unsigned char* szData, int64_t iSize)
+{
+	// The engine can't be stopped; the rest of the model is dropped
+	if (m_bFailed)
+	{
+		return false;
+	}
+
+	if (iSize <= 0)
+	{
+		return true;
+	}
+
+	if (!write(szData, iSize))
+	{
+		m_bFailed = true;
+
+		return false;
+	}
+
+	m_iBytesWritten += iSize;
+
+	return true;
+}
+
+bool _output_stream::end()
+{
+	// Called after a failure as well; releases the resources
+	if (!close())
+	{
+		m_bFailed = true;
+	}
+
+	return !m_bFailed;
+}
+
+/*static*/ void STDCALL _output_stream::writeCallback(unsigned char* szData, int64_t iSize)
+{
+	assert(s_pCurrentStream != nullptr);
+
+	s_pCurrentStream->append(szData, iSize);
+}
+
+// ************************************************************************************************
+_file_output_stream::_file_output_stream(const wstring& strFile)
+	: _output_stream()
+	, m_strFile(strFile)
+	, m_pFile(nullptr)
+{
+	assert(!m_strFile.empty());
+}
+
+/*virtual*/ _file_output_stream::~_file_output_stream()
+{
+	assert(m_pFile == nullptr);
+}
+
+/*virtual*/ bool _file_output_stream::save(SdaiModel iSdaiModel) /*override*/
+{
+	assert(iSdaiModel != 0);
+
+	sdaiSaveModelBNUnicode(iSdaiModel, m_strFile.c_str());
+
+	return true;
+}
+
+/*virtual*/ string _file_output_stream::getName() const /*override*/
+{
+	return (LPCSTR)CW2A(m_strFile.c_str());
+}
+
+/*virtual*/ bool _file_output_stream::open() /*override*/
+{
+	assert(m_pFile == nullptr);
+
+#ifdef _WINDOWS
+	m_pFile = _wfopen(m_strFile.c_str(), L"wb");
+#else
+	m_pFile = fopen((LPCSTR)CW2A(m_strFile.c_str()), "wb");
+#endif
+
+	return m_pFile != nullptr;
+}
+
+/*virtual*/ bool _file_output_stream::write(const unsigned char* szData, int64_t iSize) /*override*/
+{
+	assert(m_pFile != nullptr);
+
+	return fwrite(szData, 1, (size_t)iSize, m_pFile) == (size_t)iSize;
+}
+
+/*virtual*/ bool _file_output_stream::close() /*override*/
+{
+	if (m_pFile == nullptr)
+	{
+		return false;
+	}
+
+	bool bClosed = fclose(m_pFile) == 0;
+	m_pFile = nullptr;
+
+	if (!bClosed || isFailed())
+	{
+#ifdef _WINDOWS
+		_wremove(m_strFile.c_str());
+#else
+		remove((LPCSTR)CW2A(m_strFile.c_str()));
+#endif
+
+		return false;
+	}
+
+	return true;
+}
+
+// ************************************************************************************************
+_callback_output_stream::_callback_output_stream(_write_callback pWriteCallback, void* pContext)
+	: _output_stream()
+	, m_pWriteCallback(pWriteCallback)
+	, m_pContext(pContext)
+{
+	assert(m_pWriteCallback != nullptr);
+}
+
+/*virtual*/ _callback_output_stream::~_callback_output_stream()
+{
+}
+
+/*virtual*/ bool _callback_output_stream::write(const unsigned char* szData, int64_t iSize) /*override*/
+{
+	return (*m_pWriteCallback)(szData, iSize, m_pContext);
+}
+
+// ************************************************************************************************
+_fd_output_stream::_fd_output_stream(int iFD)
+	: _output_stream()
+	, m_iFD(iFD)
+{
+	assert(m_iFD >= 0);
+}
+
+/*virtual*/ _fd_output_stream::~_fd_output_stream()
+{
+}
+
+/*virtual*/ string _fd_output_stream::getName() const /*override*/
+{
+	return _string::format("fd %d", m_iFD);
+}
+
+/*virtual*/ bool _fd_output_stream::write(const unsigned char* szData, int64_t iSize) /*override*/
+{
+	assert(szData != nullptr);
+
+	while (iSize > 0)
+	{
+#ifdef _WINDOWS
+		int iWritten = ::_write(m_iFD, szData, (unsigned int)min<int64_t>(iSize, INT_MAX));
+#else
+		ssize_t iWritten = ::write(m_iFD, szData, (size_t)iSize);
+#endif
+		if (iWritten < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return false;
+		}
+
+		szData += iWritten;
+		iSize -= iWritten;
+	} // while (iSize > 0)
+
+	return true;
+}
+
+// ************************************************************************************************
+_stdout_output_stream::_stdout_output_stream()
+	: _fd_output_stream(1)
+{
+	// Anything buffered by stdio goes first
+	fflush(stdout);
+
+#ifdef _WINDOWS
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+/*virtual*/ _stdout_output_stream::~_stdout_output_stream()
+{
+}
+
+// ************************************************************************************************
+_memory_output_stream::_memory_output_stream()
+	: _output_stream()
+	, m_szBuffer(nullptr)
+	, m_iSize(0)
+	, m_iCapacity(0)
+	, m_bGrowable(true)
+	, m_bOverflow(false)
+{
+}
+
+_memory_output_stream::_memory_output_stream(unsigned char* szBuffer, size_t iCapacity)
+	: _output_stream()
+	, m_szBuffer(szBuffer)
+	, m_iSize(0)
+	, m_iCapacity(iCapacity)
+	, m_bGrowable(false)
+	, m_bOverflow(false)
+{
+	assert(m_szBuffer != nullptr);
+	assert(m_iCapacity > 0);
+}
+
+/*virtual*/ _memory_output_stream::~_memory_output_stream()
+{
+	if (m_bGrowable)
+	{
+		free(m_szBuffer);
+	}
+}
+
+/*virtual*/ bool _memory_output_stream::open() /*override*/
+{
+	m_iSize = 0;
+	m_bOverflow = false;
+
+	return true;
+}
+
+/*virtual*/ bool _memory_output_stream::close() /*override*/
+{
+	if (isFailed() || m_bOverflow)
+	{
+		return false;
+	}
+
+	// Release the reserve of the last growth
+	if (m_bGrowable && (m_iSize > 0) && (m_iSize < m_iCapacity))
+	{
+		auto szBuffer = (unsigned char*)realloc(m_szBuffer, m_iSize);
+		if (szBuffer != nullptr)
+		{
+			m_szBuffer = szBuffer;
+			m_iCapacity = m_iSize;
+		}
+	}
+
+	return true;
+}
+
+unsigned char* _memory_output_stream::detach(size_t& iSize)
+{
+	assert(m_bGrowable);
+
+	unsigned char* szBuffer = m_szBuffer;
+	iSize = m_iSize;
+
+	m_szBuffer = nullptr;
+	m_iSize = 0;
+	m_iCapacity = 0;
+
+	return szBuffer;
+}
+
+/*virtual*/ bool _memory_output_stream::write(const unsigned char* szData, int64_t iSize) /*override*/
+{
+	assert(szData != nullptr);
+
+	if (m_bOverflow)
+	{
+		return true;
+	}
+
+	if (m_iSize + (size_t)iSize > m_iCapacity)
+	{
+		if (!m_bGrowable)
+		{
+			// The rest is counted only; see close()
+			m_bOverflow = true;
+
+			return true;
+		}
+
+		size_t iCapacity = max<size_t>(m_iCapacity * 2, OUTPUT_STREAM_CHUNK_SIZE);
+		while (m_iSize + (size_t)iSize > iCapacity)
+		{
+			iCapacity *= 2;
+		}
+
+		auto szBuffer = (unsigned char*)realloc(m_szBuffer, iCapacity);
+		if (szBuffer == nullptr)
+		{
+			return false;
+		}
+
+		m_szBuffer = szBuffer;
+		m_iCapacity = iCapacity;
+	} // if (m_iSize + (size_t)iSize > m_iCapacity)
+
+	memcpy(m_szBuffer + m_iSize, szData, (size_t)iSize);
+	m_iSize += (size_t)iSize;
+
+	return true;
+}
+
+// ************************************************************************************************
+_size_output_stream::_size_output_stream()
+	: _output_stream()
+{
+}
+
+/*virtual*/ _size_output_stream::~_size_output_stream()
+{
+}
+
+/*virtual*/ bool _size_output_stream::save(SdaiModel iSdaiModel) /*override*/
+{
+	assert(iSdaiModel != 0);
+
+	int_t iSize = 0;
+	engiSaveModelByArray(iSdaiModel, nullptr, &iSize);
+
+	setBytesWritten((int64_t)iSize);
+
+	return true;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "../include/engine.h"
+#include "../include/ifcengine.h"
+
+#ifdef _WINDOWS
+#include "_log.h"
+#endif
+
+#ifdef __EMSCRIPTEN__
+#include "../gisengine/Parsers/_log.h"
+#endif
+
+#include <string>
+#include <cstdio>
+using namespace std;
+
+// ************************************************************************************************
+// Returns false to stop writing
+typedef bool(STDCALL* _write_callback)(const unsigned char* szData, int64_t iSize, void* pContext);
+
+// ************************************************************************************************
+// IFC output; the model is serialized by engiSaveModelByStream in large chunks
+class _output_stream
+{
+
+private: // Members
+
+	int64_t m_iBytesWritten;
+	bool m_bFailed;
+
+	// engiSaveModelByStream() callback has no context
+	static thread_local _output_stream* s_pCurrentStream;
+
+public: // Methods
+
+	_output_stream();
+	virtual ~_output_stream();
+
+	virtual bool save(SdaiModel iSdaiModel);
+	virtual string getName() const = 0;
+
+	// save(); a stream wrapping this one, e.g. _zip_output_stream
+	bool begin();
+	bool append(const unsigned char* szData, int64_t iSize);
+	bool end();
+
+	int64_t getBytesWritten() const { return m_iBytesWritten; }
+	bool isFailed() const { return m_bFailed; }
+	void setFailed() { m_bFailed = true; }
+
+protected: // Methods
+
+	virtual bool open() { return true; }
+	virtual bool write(const unsigned char* szData, int64_t iSize) = 0;
+	virtual bool close() { return true; }
+
+	void setBytesWritten(int64_t iBytesWritten) { m_iBytesWritten = iBytesWritten; }
+
+private: // Methods
+
+	static void STDCALL writeCallback(unsigned char* szData, int64_t iSize);
+};
+
+// ************************************************************************************************
+// save() - the engine writes the file itself (sdaiSaveModelBNUnicode); a stream wrapping this one
+// writes through stdio; an incomplete file is removed
+class _file_output_stream : public _output_stream
+{
+
+private: // Members
+
+	wstring m_strFile;
+	FILE* m_pFile;
+
+public: // Methods
+
+	_file_output_stream(const wstring& strFile);
+	virtual ~_file_output_stream();
+
+	virtual bool save(SdaiModel iSdaiModel) override;
+	virtual string getName() const override;
+
+	const wstring& getFile() const { return m_strFile; }
+
+protected: // Methods
+
+	virtual bool open() override;
+	virtual bool write(const unsigned char* szData, int64_t iSize) override;
+	virtual bool close() override;
+};
+
+// ************************************************************************************************
+class _callback_output_stream : public _output_stream
+{
+
+private: // Members
+
+	_write_callback m_pWriteCallback;
+	void* m_pContext;
+
+public: // Methods
+
+	_callback_output_stream(_write_callback pWriteCallback, void* pContext);
+	virtual ~_callback_output_stream();
+
+	virtual string getName() const override { return "callback"; }
+
+protected: // Methods
+
+	virtual bool write(const unsigned char* szData, int64_t iSize) override;
+};
+
+// ************************************************************************************************
+// Already open file descriptor, e.g. a pipe or a socket; not closed
+class _fd_output_stream : public _output_stream
+{
+
+private: // Members
+
+	int m_iFD;
+
+public: // Methods
+
+	_fd_output_stream(int iFD);
+	virtual ~_fd_output_stream();
+
+	virtual string getName() const override;
+
+	int getFD() const { return m_iFD; }
+
+protected: // Methods
+
+	virtual bool write(const unsigned char* szData, int64_t iSize) override;
+};
+
+// ************************************************************************************************
+class _stdout_output_stream : public _fd_output_stream
+{
+
+public: // Methods
+
+	_stdout_output_stream();
+	virtual ~_stdout_output_stream();
+
+	virtual string getName() const override { return "stdout"; }
+};
+
+// ************************************************************************************************
+// Caller's fixed-size buffer or a buffer allocated by malloc()/realloc(); the latter can be detached
+// and released by the caller with free(), e.g. Module._free() in the WebAssembly build.
+// A fixed-size buffer too small fails the stream; the bytes are still counted, i.e. getBytesWritten()
+// is the size needed.
+class _memory_output_stream : public _output_stream
+{
+
+private: // Members
+
+	unsigned char* m_szBuffer;
+	size_t m_iSize;
+	size_t m_iCapacity;
+	bool m_bGrowable;
+	bool m_bOverflow;
+
+public: // Methods
+
+	_memory_output_stream();
+	_memory_output_stream(unsigned char* szBuffer, size_t iCapacity);
+	virtual ~_memory_output_stream();
+
+	virtual string getName() const override { return "memory"; }
+
+	unsigned char* detach(size_t& iSize);
+
+	const unsigned char* getBuffer() const { return m_szBuffer; }
+	size_t getSize() const { return m_iSize; }
+	bool isOverflow() const { return m_bOverflow; }
+
+protected: // Methods
+
+	virtual bool open() override;
+	virtual bool write(const unsigned char* szData, int64_t iSize) override;
+	virtual bool close() override;
+};
+
+// ************************************************************************************************
+// Dry run; the size of the IFC file is calculated by the engine (engiSaveModelByArray), nothing is written;
+// the model is built as for any other stream, i.e. it costs a full conversion
+class _size_output_stream : public _output_stream
+{
+
+public: // Methods
+
+	_size_output_stream();
+	virtual ~_size_output_stream();
+
+	virtual bool save(SdaiModel iSdaiModel) override;
+	virtual string getName() const override { return "size"; }
+
+protected: // Methods
+
+	virtual bool write(const unsigned char* /*szData*/, int64_t /*iSize*/) override { return false; }
+};
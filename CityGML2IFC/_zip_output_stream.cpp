@@ -0,0 +1,633 @@
+#include "pch.h"
+#include "_zip_output_stream.h"
+
+#include <cassert>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+// ************************************************************************************************
+#define DEFLATE_WINDOW_SIZE 32768
+#define DEFLATE_WINDOW_MASK (DEFLATE_WINDOW_SIZE - 1)
+#define DEFLATE_HASH_SIZE 32768
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_MAX_CHAIN 32
+
+// Chunks waiting for the compression thread
+#define ZIP_MAX_PENDING_CHUNKS 4
+
+// Sizes and offsets above are stored in the ZIP64 records
+#define ZIP_MAX_32 0xFFFFFFFFll
+
+// ************************************************************************************************
+static const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int LENGTH_EXTRA_BITS[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const int DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const int DISTANCE_EXTRA_BITS[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// ************************************************************************************************
+static uint32_t deflateHash(const unsigned char* szData)
+{
+	return (((uint32_t)szData[0] << 10) ^ ((uint32_t)szData[1] << 5) ^ (uint32_t)szData[2]) & (DEFLATE_HASH_SIZE - 1);
+}
+
+static int lengthCode(int iLength)
+{
+	int iCode = 28;
+	while (LENGTH_BASE[iCode] > iLength)
+	{
+		iCode--;
+	}
+
+	return iCode;
+}
+
+static int distanceCode(int iDistance)
+{
+	return (int)(upper_bound(DISTANCE_BASE, DISTANCE_BASE + 30, iDistance) - DISTANCE_BASE) - 1;
+}
+
+static void put16(vector<unsigned char>& vecData, uint32_t iValue)
+{
+	vecData.push_back((unsigned char)(iValue & 0xFF));
+	vecData.push_back((unsigned char)((iValue >> 8) & 0xFF));
+}
+
+static void put32(vector<unsigned char>& vecData, uint32_t iValue)
+{
+	put16(vecData, iValue & 0xFFFF);
+	put16(vecData, iValue >> 16);
+}
+
+static void put64(vector<unsigned char>& vecData, uint64_t iValue)
+{
+	put32(vecData, (uint32_t)(iValue & 0xFFFFFFFF));
+	put32(vecData, (uint32_t)(iValue >> 32));
+}
+
+// ************************************************************************************************
+_deflater::_deflater()
+	: m_vecWindow()
+	, m_iWindowStart(0)
+	, m_iPosition(0)
+	, m_vecHead(DEFLATE_HASH_SIZE, -1)
+	, m_vecPrevious(DEFLATE_WINDOW_SIZE, -1)
+	, m_iBits(0)
+	, m_iBitsCount(0)
+{
+}
+
+/*virtual*/ _deflater::~_deflater()
+{
+}
+
+void _deflater::deflate(const unsigned char* szData, size_t iSize, bool bFinish, vector<unsigned char>& vecOutput)
+{
+	// BFINAL, BTYPE = 01 (fixed Huffman codes)
+	putBits(bFinish ? 1 : 0, 1, vecOutput);
+	putBits(1, 2, vecOutput);
+
+	if (iSize > 0)
+	{
+		m_vecWindow.insert(m_vecWindow.end(), szData, szData + iSize);
+	}
+
+	int64_t iEnd = m_iWindowStart + (int64_t)m_vecWindow.size();
+
+	// The tail is kept for the next call; a match can continue there
+	int64_t iLimit = bFinish ? iEnd : iEnd - DEFLATE_MAX_MATCH;
+
+	while (m_iPosition < iLimit)
+	{
+		const unsigned char* szCurrent = &m_vecWindow[(size_t)(m_iPosition - m_iWindowStart)];
+		int64_t iAvailable = iEnd - m_iPosition;
+
+		int iBestLength = 0;
+		int iBestDistance = 0;
+		if (iAvailable >= DEFLATE_MIN_MATCH)
+		{
+			int iMaxLength = (int)min<int64_t>(DEFLATE_MAX_MATCH, iAvailable);
+
+			int64_t iCandidate = m_vecHead[deflateHash(szCurrent)];
+			int iChain = DEFLATE_MAX_CHAIN;
+			while ((iCandidate >= 0) &&
+				(iCandidate < m_iPosition) &&
+				((m_iPosition - iCandidate) <= DEFLATE_WINDOW_SIZE) &&
+				(iChain-- > 0))
+			{
+				const unsigned char* szCandidate = &m_vecWindow[(size_t)(iCandidate - m_iWindowStart)];
+				if (szCandidate[iBestLength] == szCurrent[iBestLength])
+				{
+					int iLength = 0;
+					while ((iLength < iMaxLength) && (szCandidate[iLength] == szCurrent[iLength]))
+					{
+						iLength++;
+					}
+
+					if (iLength > iBestLength)
+					{
+						iBestLength = iLength;
+						iBestDistance = (int)(m_iPosition - iCandidate);
+
+						if (iLength == iMaxLength)
+						{
+							break;
+						}
+					}
+				} // if (szCandidate[iBestLength] == ...
+
+				int64_t iPrevious = m_vecPrevious[(size_t)(iCandidate & DEFLATE_WINDOW_MASK)];
+				if (iPrevious >= iCandidate)
+				{
+					// Overwritten
+					break;
+				}
+
+				iCandidate = iPrevious;
+			} // while ((iCandidate >= 0) && ...
+		} // if (iAvailable >= DEFLATE_MIN_MATCH)
+
+		if (iBestLength >= DEFLATE_MIN_MATCH)
+		{
+			putMatch(iBestLength, iBestDistance, vecOutput);
+
+			for (int i = 0; i < iBestLength; i++)
+			{
+				if (m_iPosition + DEFLATE_MIN_MATCH <= iEnd)
+				{
+					insert(m_iPosition);
+				}
+
+				m_iPosition++;
+			}
+		}
+		else
+		{
+			putLiteral(*szCurrent, vecOutput);
+
+			if (iAvailable >= DEFLATE_MIN_MATCH)
+			{
+				insert(m_iPosition);
+			}
+
+			m_iPosition++;
+		}
+	} // while (m_iPosition < iLimit)
+
+	// End of block
+	putLiteral(256, vecOutput);
+
+	if (bFinish)
+	{
+		if (m_iBitsCount > 0)
+		{
+			putBits(0, 8 - m_iBitsCount, vecOutput);
+		}
+
+		assert(m_iBitsCount == 0);
+	}
+
+	// History
+	int64_t iKeep = max<int64_t>(m_iWindowStart, m_iPosition - DEFLATE_WINDOW_SIZE);
+	if (iKeep > m_iWindowStart)
+	{
+		m_vecWindow.erase(m_vecWindow.begin(), m_vecWindow.begin() + (size_t)(iKeep - m_iWindowStart));
+		m_iWindowStart = iKeep;
+	}
+}
+
+void _deflater::insert(int64_t iPosition)
+{
+	uint32_t iHash = deflateHash(&m_vecWindow[(size_t)(iPosition - m_iWindowStart)]);
+
+	m_vecPrevious[(size_t)(iPosition & DEFLATE_WINDOW_MASK)] = m_vecHead[iHash];
+	m_vecHead[iHash] = iPosition;
+}
+
+void _deflater::putBits(uint32_t iValue, int iCount, vector<unsigned char>& vecOutput)
+{
+	m_iBits |= (uint64_t)iValue << m_iBitsCount;
+	m_iBitsCount += iCount;
+
+	while (m_iBitsCount >= 8)
+	{
+		vecOutput.push_back((unsigned char)(m_iBits & 0xFF));
+
+		m_iBits >>= 8;
+		m_iBitsCount -= 8;
+	}
+}
+
+void _deflater::putCode(uint32_t iCode, int iLength, vector<unsigned char>& vecOutput)
+{
+	// Huffman codes are packed starting with the most significant bit
+	uint32_t iReversed = 0;
+	for (int i = 0; i < iLength; i++)
+	{
+		iReversed = (iReversed << 1) | ((iCode >> i) & 1);
+	}
+
+	putBits(iReversed, iLength, vecOutput);
+}
+
+void _deflater::putLiteral(int iLiteral, vector<unsigned char>& vecOutput)
+{
+	if (iLiteral < 144)
+	{
+		putCode(0x30 + iLiteral, 8, vecOutput);
+	}
+	else if (iLiteral < 256)
+	{
+		putCode(0x190 + (iLiteral - 144), 9, vecOutput);
+	}
+	else if (iLiteral < 280)
+	{
+		putCode(iLiteral - 256, 7, vecOutput);
+	}
+	else
+	{
+		putCode(0xC0 + (iLiteral - 280), 8, vecOutput);
+	}
+}
+
+void _deflater::putMatch(int iLength, int iDistance, vector<unsigned char>& vecOutput)
+{
+	assert((iLength >= DEFLATE_MIN_MATCH) && (iLength <= DEFLATE_MAX_MATCH));
+	assert((iDistance >= 1) && (iDistance <= DEFLATE_WINDOW_SIZE));
+
+	int iLengthCode = lengthCode(iLength);
+	putLiteral(257 + iLengthCode, vecOutput);
+	putBits(iLength - LENGTH_BASE[iLengthCode], LENGTH_EXTRA_BITS[iLengthCode], vecOutput);
+
+	int iDistanceCode = distanceCode(iDistance);
+	putCode(iDistanceCode, 5, vecOutput);
+	putBits(iDistance - DISTANCE_BASE[iDistanceCode], DISTANCE_EXTRA_BITS[iDistanceCode], vecOutput);
+}
+
+// ************************************************************************************************
+_zip_output_stream::_zip_output_stream(_output_stream* pTarget, const string& strEntryName)
+	: _output_stream()
+	, m_pTarget(pTarget)
+	, m_strEntryName(strEntryName)
+	, m_deflater()
+	, m_vecCompressed()
+	, m_iCRC(0)
+	, m_iUncompressedSize(0)
+	, m_iCompressedSize(0)
+	, m_iDosTime(0)
+	, m_iDosDate(0)
+	, m_bCompressionFailed(false)
+#ifndef _GML2IFC_NO_THREADS
+	, m_pCompressor(nullptr)
+	, m_mtx()
+	, m_cvPending()
+	, m_cvFree()
+	, m_dqPendingChunks()
+	, m_vecFreeChunks()
+	, m_bFinished(false)
+#endif
+{
+	assert(m_pTarget != nullptr);
+	assert(!m_strEntryName.empty());
+}
+
+/*virtual*/ _zip_output_stream::~_zip_output_stream()
+{
+#ifndef _GML2IFC_NO_THREADS
+	assert(m_pCompressor == nullptr);
+#endif
+
+	deleteChunks();
+}
+
+/*static*/ uint32_t _zip_output_stream::crc32(uint32_t iCRC, const unsigned char* szData, size_t iSize)
+{
+	static const vector<uint32_t> s_vecTable = []()
+	{
+		vector<uint32_t> vecTable(256);
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t iValue = i;
+			for (int iBit = 0; iBit < 8; iBit++)
+			{
+				iValue = (iValue & 1) ? (0xEDB88320 ^ (iValue >> 1)) : (iValue >> 1);
+			}
+
+			vecTable[i] = iValue;
+		}
+
+		return vecTable;
+	}();
+
+	iCRC = ~iCRC;
+	for (size_t i = 0; i < iSize; i++)
+	{
+		iCRC = s_vecTable[(iCRC ^ szData[i]) & 0xFF] ^ (iCRC >> 8);
+	}
+
+	return ~iCRC;
+}
+
+/*virtual*/ bool _zip_output_stream::open() /*override*/
+{
+	if (!m_pTarget->begin())
+	{
+		return false;
+	}
+
+	m_deflater = _deflater();
+	m_iCRC = 0;
+	m_iUncompressedSize = 0;
+	m_iCompressedSize = 0;
+	m_bCompressionFailed = false;
+
+	time_t iTime = time(nullptr);
+	tm* pTime = localtime(&iTime);
+	m_iDosTime = (uint16_t)((pTime->tm_hour << 11) | (pTime->tm_min << 5) | (pTime->tm_sec / 2));
+	m_iDosDate = (uint16_t)(((pTime->tm_year - 80) << 9) | ((pTime->tm_mon + 1) << 5) | pTime->tm_mday);
+
+	if (!writeLocalFileHeader())
+	{
+		// E.g. an incomplete file is removed
+		m_pTarget->setFailed();
+		m_pTarget->end();
+
+		return false;
+	}
+
+#ifndef _GML2IFC_NO_THREADS
+	m_bFinished = false;
+	m_pCompressor = new thread([this]() { compress(); });
+#endif
+
+	return true;
+}
+
+/*virtual*/ bool _zip_output_stream::write(const unsigned char* szData, int64_t iSize) /*override*/
+{
+	if (m_bCompressionFailed)
+	{
+		return false;
+	}
+
+#ifdef _GML2IFC_NO_THREADS
+	return compress(szData, (size_t)iSize, false);
+#else
+	vector<unsigned char>* pChunk = nullptr;
+	{
+		unique_lock<mutex> lock(m_mtx);
+		m_cvFree.wait(lock, [this]() { return (m_dqPendingChunks.size() < ZIP_MAX_PENDING_CHUNKS) || m_bCompressionFailed; });
+
+		if (m_bCompressionFailed)
+		{
+			return false;
+		}
+
+		if (!m_vecFreeChunks.empty())
+		{
+			pChunk = m_vecFreeChunks.back();
+			m_vecFreeChunks.pop_back();
+		}
+	}
+
+	if (pChunk == nullptr)
+	{
+		pChunk = new vector<unsigned char>();
+	}
+
+	pChunk->assign(szData, szData + iSize);
+
+	{
+		lock_guard<mutex> lock(m_mtx);
+		m_dqPendingChunks.push_back(pChunk);
+	}
+
+	m_cvPending.notify_one();
+
+	return true;
+#endif // _GML2IFC_NO_THREADS
+}
+
+/*virtual*/ bool _zip_output_stream::close() /*override*/
+{
+#ifndef _GML2IFC_NO_THREADS
+	if (m_pCompressor != nullptr)
+	{
+		{
+			lock_guard<mutex> lock(m_mtx);
+			m_bFinished = true;
+		}
+
+		m_cvPending.notify_one();
+
+		m_pCompressor->join();
+
+		delete m_pCompressor;
+		m_pCompressor = nullptr;
+	}
+#endif // _GML2IFC_NO_THREADS
+
+	deleteChunks();
+
+	bool bResult = !isFailed() && !m_bCompressionFailed;
+	if (bResult)
+	{
+		bResult = compress(nullptr, 0, true) && writeTrailer();
+	}
+
+	if (!bResult)
+	{
+		// E.g. an incomplete file is removed
+		m_pTarget->setFailed();
+	}
+
+	return m_pTarget->end() && bResult;
+}
+
+void _zip_output_stream::compress()
+{
+#ifndef _GML2IFC_NO_THREADS
+	while (true)
+	{
+		vector<unsigned char>* pChunk = nullptr;
+		{
+			unique_lock<mutex> lock(m_mtx);
+			m_cvPending.wait(lock, [this]() { return !m_dqPendingChunks.empty() || m_bFinished; });
+
+			if (m_dqPendingChunks.empty())
+			{
+				// Finished
+				break;
+			}
+
+			pChunk = m_dqPendingChunks.front();
+			m_dqPendingChunks.pop_front();
+		}
+
+		if (!m_bCompressionFailed)
+		{
+			compress(pChunk->data(), pChunk->size(), false);
+		}
+
+		{
+			lock_guard<mutex> lock(m_mtx);
+			m_vecFreeChunks.push_back(pChunk);
+		}
+
+		m_cvFree.notify_one();
+	} // while (true)
+#endif // _GML2IFC_NO_THREADS
+}
+
+bool _zip_output_stream::compress(const unsigned char* szData, size_t iSize, bool bFinish)
+{
+	m_iCRC = crc32(m_iCRC, szData, iSize);
+	m_iUncompressedSize += iSize;
+
+	m_vecCompressed.clear();
+	m_deflater.deflate(szData, iSize, bFinish, m_vecCompressed);
+	m_iCompressedSize += m_vecCompressed.size();
+
+	if (!m_pTarget->append(m_vecCompressed.data(), (int64_t)m_vecCompressed.size()))
+	{
+		m_bCompressionFailed = true;
+
+#ifndef _GML2IFC_NO_THREADS
+		m_cvFree.notify_one();
+#endif
+
+		return false;
+	}
+
+	return true;
+}
+
+bool _zip_output_stream::writeLocalFileHeader()
+{
+	// Sizes and CRC follow the data (data descriptor)
+	vector<unsigned char> vecHeader;
+	put32(vecHeader, 0x04034B50);
+	put16(vecHeader, 20); // Version needed to extract
+	put16(vecHeader, 0x0008); // Data descriptor
+	put16(vecHeader, 8); // Deflate
+	put16(vecHeader, m_iDosTime);
+	put16(vecHeader, m_iDosDate);
+	put32(vecHeader, 0); // CRC
+	put32(vecHeader, 0); // Compressed size
+	put32(vecHeader, 0); // Uncompressed size
+	put16(vecHeader, (uint32_t)m_strEntryName.size());
+	put16(vecHeader, 0); // Extra field length
+	vecHeader.insert(vecHeader.end(), m_strEntryName.begin(), m_strEntryName.end());
+
+	return m_pTarget->append(vecHeader.data(), (int64_t)vecHeader.size());
+}
+
+bool _zip_output_stream::writeTrailer()
+{
+	// The local header doesn't know the sizes; the readers take them from the central directory
+	bool bZIP64Entry = (m_iUncompressedSize >= ZIP_MAX_32) || (m_iCompressedSize >= ZIP_MAX_32);
+
+	int64_t iLocalFileSize = 30 + (int64_t)m_strEntryName.size() + m_iCompressedSize + (bZIP64Entry ? 24 : 16);
+	bool bZIP64 = bZIP64Entry || (iLocalFileSize >= ZIP_MAX_32);
+
+	vector<unsigned char> vecTrailer;
+
+	// Data descriptor
+	put32(vecTrailer, 0x08074B50);
+	put32(vecTrailer, m_iCRC);
+	if (bZIP64Entry)
+	{
+		put64(vecTrailer, (uint64_t)m_iCompressedSize);
+		put64(vecTrailer, (uint64_t)m_iUncompressedSize);
+	}
+	else
+	{
+		put32(vecTrailer, (uint32_t)m_iCompressedSize);
+		put32(vecTrailer, (uint32_t)m_iUncompressedSize);
+	}
+
+	// Central directory
+	size_t iCentralDirectoryStart = vecTrailer.size();
+	put32(vecTrailer, 0x02014B50);
+	put16(vecTrailer, bZIP64Entry ? 45 : 20); // Version made by
+	put16(vecTrailer, bZIP64Entry ? 45 : 20); // Version needed to extract
+	put16(vecTrailer, 0x0008);
+	put16(vecTrailer, 8);
+	put16(vecTrailer, m_iDosTime);
+	put16(vecTrailer, m_iDosDate);
+	put32(vecTrailer, m_iCRC);
+	put32(vecTrailer, bZIP64Entry ? (uint32_t)ZIP_MAX_32 : (uint32_t)m_iCompressedSize);
+	put32(vecTrailer, bZIP64Entry ? (uint32_t)ZIP_MAX_32 : (uint32_t)m_iUncompressedSize);
+	put16(vecTrailer, (uint32_t)m_strEntryName.size());
+	put16(vecTrailer, bZIP64Entry ? 20 : 0); // Extra field length
+	put16(vecTrailer, 0); // Comment length
+	put16(vecTrailer, 0); // Disk number
+	put16(vecTrailer, 0); // Internal attributes
+	put32(vecTrailer, 0); // External attributes
+	put32(vecTrailer, 0); // Local header offset
+	vecTrailer.insert(vecTrailer.end(), m_strEntryName.begin(), m_strEntryName.end());
+
+	if (bZIP64Entry)
+	{
+		// ZIP64 extended information; the local header offset (0) fits
+		put16(vecTrailer, 0x0001);
+		put16(vecTrailer, 16);
+		put64(vecTrailer, (uint64_t)m_iUncompressedSize);
+		put64(vecTrailer, (uint64_t)m_iCompressedSize);
+	}
+
+	size_t iCentralDirectorySize = vecTrailer.size() - iCentralDirectoryStart;
+
+	if (bZIP64)
+	{
+		int64_t iEndOfCentralDirectory = iLocalFileSize + (int64_t)iCentralDirectorySize;
+
+		// ZIP64 end of central directory
+		put32(vecTrailer, 0x06064B50);
+		put64(vecTrailer, 44); // Size of the record (the rest)
+		put16(vecTrailer, 45); // Version made by
+		put16(vecTrailer, 45); // Version needed to extract
+		put32(vecTrailer, 0); // Disk number
+		put32(vecTrailer, 0); // Central directory disk
+		put64(vecTrailer, 1); // Entries on this disk
+		put64(vecTrailer, 1); // Entries
+		put64(vecTrailer, (uint64_t)iCentralDirectorySize);
+		put64(vecTrailer, (uint64_t)iLocalFileSize);
+
+		// ZIP64 end of central directory locator
+		put32(vecTrailer, 0x07064B50);
+		put32(vecTrailer, 0); // Disk with the ZIP64 end of central directory
+		put64(vecTrailer, (uint64_t)iEndOfCentralDirectory);
+		put32(vecTrailer, 1); // Disks
+	} // if (bZIP64)
+
+	// End of central directory
+	put32(vecTrailer, 0x06054B50);
+	put16(vecTrailer, 0); // Disk number
+	put16(vecTrailer, 0); // Central directory disk
+	put16(vecTrailer, 1); // Entries on this disk
+	put16(vecTrailer, 1); // Entries
+	put32(vecTrailer, (uint32_t)iCentralDirectorySize);
+	put32(vecTrailer, bZIP64 ? (uint32_t)ZIP_MAX_32 : (uint32_t)iLocalFileSize);
+	put16(vecTrailer, 0); // Comment length
+
+	return m_pTarget->append(vecTrailer.data(), (int64_t)vecTrailer.size());
+}
+
+void _zip_output_stream::deleteChunks()
+{
+#ifndef _GML2IFC_NO_THREADS
+	for (auto pChunk : m_dqPendingChunks)
+	{
+		delete pChunk;
+	}
+	m_dqPendingChunks.clear();
+
+	for (auto pChunk : m_vecFreeChunks)
+	{
+		delete pChunk;
+	}
+	m_vecFreeChunks.clear();
+#endif // _GML2IFC_NO_THREADS
+}
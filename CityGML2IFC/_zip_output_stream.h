@@ -0,0 +1,110 @@
+#pragma once
+
+#include "_output_stream.h"
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+using namespace std;
+
+// ************************************************************************************************
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#ifndef _GML2IFC_NO_THREADS
+#define _GML2IFC_NO_THREADS
+#endif
+#endif
+
+// ************************************************************************************************
+// Raw DEFLATE (RFC 1951); LZ77 over a 32 KB window, fixed Huffman codes, a block per call
+class _deflater
+{
+
+private: // Members
+
+	vector<unsigned char> m_vecWindow; // History (up to 32 KB) + input not compressed yet
+	int64_t m_iWindowStart; // Absolute position of m_vecWindow[0]
+	int64_t m_iPosition; // Absolute position of the next byte to compress
+	vector<int64_t> m_vecHead; // Hash : last absolute position
+	vector<int64_t> m_vecPrevious; // Absolute position & window mask : previous position with the same hash
+
+	uint64_t m_iBits;
+	int m_iBitsCount;
+
+public: // Methods
+
+	_deflater();
+	virtual ~_deflater();
+
+	// Appends the compressed data to vecOutput; bFinish - the last call
+	void deflate(const unsigned char* szData, size_t iSize, bool bFinish, vector<unsigned char>& vecOutput);
+
+private: // Methods
+
+	void insert(int64_t iPosition);
+	void putBits(uint32_t iValue, int iCount, vector<unsigned char>& vecOutput);
+	void putCode(uint32_t iCode, int iLength, vector<unsigned char>& vecOutput);
+	void putLiteral(int iLiteral, vector<unsigned char>& vecOutput);
+	void putMatch(int iLength, int iDistance, vector<unsigned char>& vecOutput);
+};
+
+// ************************************************************************************************
+// .ifcZIP - a ZIP archive with a single deflated .ifc entry written on the fly to another stream;
+// the compression runs on a separate thread and overlaps the serialization. The sizes follow the
+// data (data descriptor); ZIP64 records are written when a size or an offset needs 64 bits.
+class _zip_output_stream : public _output_stream
+{
+
+private: // Members
+
+	_output_stream* m_pTarget;
+	string m_strEntryName;
+
+	_deflater m_deflater;
+	vector<unsigned char> m_vecCompressed;
+	uint32_t m_iCRC;
+	int64_t m_iUncompressedSize;
+	int64_t m_iCompressedSize;
+	uint16_t m_iDosTime;
+	uint16_t m_iDosDate;
+	atomic<bool> m_bCompressionFailed;
+
+#ifndef _GML2IFC_NO_THREADS
+	thread* m_pCompressor;
+	mutex m_mtx;
+	condition_variable m_cvPending;
+	condition_variable m_cvFree;
+	deque<vector<unsigned char>*> m_dqPendingChunks;
+	vector<vector<unsigned char>*> m_vecFreeChunks;
+	bool m_bFinished;
+#endif
+
+public: // Methods
+
+	_zip_output_stream(_output_stream* pTarget, const string& strEntryName);
+	virtual ~_zip_output_stream();
+
+	virtual string getName() const override { return m_pTarget->getName(); }
+
+	int64_t getUncompressedSize() const { return m_iUncompressedSize; }
+	int64_t getCompressedSize() const { return m_iCompressedSize; }
+
+	static uint32_t crc32(uint32_t iCRC, const unsigned char* szData, size_t iSize);
+
+protected: // Methods
+
+	virtual bool open() override;
+	virtual bool write(const unsigned char* szData, int64_t iSize) override;
+	virtual bool close() override;
+
+private: // Methods
+
+	void compress();
+	bool compress(const unsigned char* szData, size_t iSize, bool bFinish);
+	bool writeLocalFileHeader();
+	bool writeTrailer();
+	void deleteChunks();
+};
@@ -13,6 +13,7 @@
 #define IDC_BUTTON_CLOSE                1003
 #define IDC_LIST_LODS                   1004
 #define IDC_CHECK_HIGHEST_LOD           1005
+#define IDC_BUTTON_CANCEL               1006
 
 // Next default values for new objects
 // 
@@ -20,7 +21,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        130
 #define _APS_NEXT_COMMAND_VALUE         32771
-#define _APS_NEXT_CONTROL_VALUE         1006
+#define _APS_NEXT_CONTROL_VALUE         1007
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
@@ -2,4 +2,22 @@ Copy-Item -Path ".\pch.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\pch.h" -Fo
 Copy-Item -Path ".\pch.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\pch.cpp" -Force
 Copy-Item -Path ".\_guid.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_guid.h" -Force
 Copy-Item -Path ".\_gml2ifc.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_gml2ifc.h" -Force
-Copy-Item -Path ".\_gml2ifc.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_gml2ifc.cpp" -Force
\ No newline at end of file
+Copy-Item -Path ".\_gml2ifc.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_gml2ifc.cpp" -Force
+Copy-Item -Path ".\_metrics.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_metrics.h" -Force
+Copy-Item -Path ".\_metrics.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_metrics.cpp" -Force
+Copy-Item -Path ".\_log_pipeline.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_log_pipeline.h" -Force
+Copy-Item -Path ".\_log_pipeline.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_log_pipeline.cpp" -Force
+Copy-Item -Path ".\_output_stream.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_output_stream.h" -Force
+Copy-Item -Path ".\_output_stream.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_output_stream.cpp" -Force
+Copy-Item -Path ".\_input_stream.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_input_stream.h" -Force
+Copy-Item -Path ".\_input_stream.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_input_stream.cpp" -Force
+Copy-Item -Path ".\_zip_output_stream.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_zip_output_stream.h" -Force
+Copy-Item -Path ".\_zip_output_stream.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_zip_output_stream.cpp" -Force
+Copy-Item -Path ".\_gml_splitter.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_gml_splitter.h" -Force
+Copy-Item -Path ".\_gml_splitter.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_gml_splitter.cpp" -Force
+Copy-Item -Path ".\_geometry_buffer.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_geometry_buffer.h" -Force
+Copy-Item -Path ".\_geometry_buffer.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_geometry_buffer.cpp" -Force
+Copy-Item -Path ".\_city_model.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_city_model.h" -Force
+Copy-Item -Path ".\_city_model.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_city_model.cpp" -Force
+Copy-Item -Path ".\_city_model_cache.h" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_city_model_cache.h" -Force
+Copy-Item -Path ".\_city_model_cache.cpp" -Destination "D:\RDF\emsdk-main\src\gml2ifc\_city_model_cache.cpp" -Force
\ No newline at end of file